@@ -24,9 +24,62 @@ SOFTWARE.
 
 #pragma once
 
+#include <cassert>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
 #include <type_traits>
 #include <algorithm>
+#include <vector>
+
+// Define NEON_PARALLEL for the Executor interface, ThreadPool and the parallel batch overloads.
+#if defined(NEON_PARALLEL)
+  #include <atomic>
+  #include <condition_variable>
+  #include <exception>
+  #include <functional>
+  #include <memory>
+  #include <mutex>
+  #include <thread>
+#endif
+
+// Define NEON_NO_SIMD to force the scalar code paths.
+#if !defined(NEON_NO_SIMD)
+  #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define NEON_SIMD_SSE2 1
+  #endif
+  #if defined(NEON_SIMD_SSE2) && (defined(__SSE4_1__) || defined(__AVX__))
+    #define NEON_SIMD_SSE41 1
+  #endif
+  #if defined(NEON_SIMD_SSE2) && defined(__AVX__)
+    #define NEON_SIMD_AVX 1
+  #endif
+  #if defined(NEON_SIMD_AVX) && defined(__FMA__)
+    #define NEON_SIMD_FMA 1
+  #endif
+  #if defined(NEON_SIMD_AVX) && (defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__)))
+    #define NEON_SIMD_F16C 1
+  #endif
+#endif
+
+// Multi-statement functions can only be constexpr from C++14 on.
+#if __cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+  #define NEON_CONSTEXPR14 constexpr
+#else
+  #define NEON_CONSTEXPR14 inline
+#endif
+
+#if defined(NEON_SIMD_AVX)
+  #include <immintrin.h>
+#elif defined(NEON_SIMD_SSE41)
+  #include <smmintrin.h>
+#elif defined(NEON_SIMD_SSE2)
+  #include <emmintrin.h>
+#endif
 
 namespace Neon
 {
@@ -34,68 +87,328 @@ namespace Neon
   constexpr double radToDeg = 180.0 / kPi;
   constexpr double degToRad = kPi / 180.0;
   
-  template<typename T> struct Vec3;
-  template<typename T> struct Vec4;
-
-  /* Vec2 */
-  template <typename T>
-  struct Vec2
+  template <typename T, unsigned int N> struct Vec;
+  template <typename T, unsigned int R, unsigned int C> struct Mat;
+  
+  template <typename T> using Vec2 = Vec<T, 2>;
+  template <typename T> using Vec3 = Vec<T, 3>;
+  template <typename T> using Vec4 = Vec<T, 4>;
+  template <typename T> using Mat2 = Mat<T, 2, 2>;
+  template <typename T> using Mat3 = Mat<T, 3, 3>;
+  template <typename T> using Mat4 = Mat<T, 4, 4>;
+  
+  // Non-square shapes are named rows x columns.
+  template <typename T> using Mat2x3 = Mat<T, 2, 3>;
+  template <typename T> using Mat3x2 = Mat<T, 3, 2>;
+  template <typename T> using Mat2x4 = Mat<T, 2, 4>;
+  template <typename T> using Mat4x2 = Mat<T, 4, 2>;
+  template <typename T> using Mat3x4 = Mat<T, 3, 4>;
+  template <typename T> using Mat4x3 = Mat<T, 4, 3>;
+  
+  template<typename T> struct Affine;
+  
+  // Precision of the sines and cosines used by the rotation and projection makers. Exact calls the standard
+  // library. Fast uses a minimax polynomial that is within 2 ulp of the exact value for |x| <= pi (float) and
+  // |x| <= 1e8 (double). Float stays within 1e-7 absolute error up to |x| = 8192, which near a zero of sin or
+  // cos can be more ulp; beyond that, range reduction loses accuracy and the result is no longer bounded by 1.
+  // Infinite and NaN angles give NaN.
+  enum class Precision
   {
-    T x, y;
+    Exact,
+    Fast
+  };
+  
+  namespace Detail
+  {
+    template <typename T, Precision Pr> struct SinCos;
+  }
+  
+#if defined(NEON_EXPR_TEMPLATES)
+  /* Expression templates */
+  // Define NEON_EXPR_TEMPLATES to make element-wise vector and matrix arithmetic (+, -, negation, scaling and
+  // the component-wise vector product) build expression nodes instead of temporaries. A chain such as
+  // a * s + b - c is evaluated in one pass when it is assigned to, or converted into, a concrete type.
+  // Nodes reference their operands, so do not keep them in auto variables past the full-expression.
+  namespace Detail
+  {
+    template <typename E>
+    struct ExprTraits
+    {
+      static const bool isOperand = false;
+      static const bool isNode = false;
+    };
+    
+    template <typename V, typename S, unsigned int N, bool IsVector>
+    struct LeafTraits
+    {
+      using Value = V;
+      using Scalar = S;
+      static const unsigned int count = N;
+      static const bool isVector = IsVector;
+      static const bool isOperand = true;
+      static const bool isNode = false;
+    };
+    
+    template <typename T, unsigned int N>
+    struct ExprTraits<Vec<T, N>> : LeafTraits<Vec<T, N>, T, N, true> {};
+    
+    template <typename T, unsigned int R, unsigned int C>
+    struct ExprTraits<Mat<T, R, C>> : LeafTraits<Mat<T, R, C>, T, R * C, false> {};
+    
+    // Scalar operand broadcast to every element.
+    template <typename T>
+    struct ScalarExpr
+    {
+      T t;
+    };
+    
+    template <typename Op, typename E, typename V>
+    struct UnaryExpr;
+    
+    template <typename Op, typename L, typename R, typename V>
+    struct BinaryExpr;
+    
+    template <typename Op, typename E, typename V>
+    struct ExprTraits<UnaryExpr<Op, E, V>> : ExprTraits<V>
+    {
+      static const bool isNode = true;
+    };
+    
+    template <typename Op, typename L, typename R, typename V>
+    struct ExprTraits<BinaryExpr<Op, L, R, V>> : ExprTraits<V>
+    {
+      static const bool isNode = true;
+    };
+    
+    // Vectors and matrices are held by reference, nodes and scalars by value.
+    template <typename E>
+    struct ExprStorage
+    {
+      using type = typename std::conditional<ExprTraits<E>::isNode, E, const E&>::type;
+    };
+    
+    template <typename T>
+    struct ExprStorage<ScalarExpr<T>>
+    {
+      using type = ScalarExpr<T>;
+    };
+    
+    template <typename Op, typename E, typename V>
+    struct UnaryExpr
+    {
+      typename ExprStorage<E>::type e;
+    };
+    
+    template <typename Op, typename L, typename R, typename V>
+    struct BinaryExpr
+    {
+      typename ExprStorage<L>::type lhs;
+      typename ExprStorage<R>::type rhs;
+    };
+    
+    template <typename E, typename V, bool = ExprTraits<E>::isNode>
+    struct IsExprOf : std::false_type {};
+    
+    template <typename E, typename V>
+    struct IsExprOf<E, V, true> : std::is_same<typename ExprTraits<E>::Value, V> {};
+    
+    template <typename L, typename R, bool = ExprTraits<L>::isOperand && ExprTraits<R>::isOperand>
+    struct SameShape : std::false_type {};
+    
+    template <typename L, typename R>
+    struct SameShape<L, R, true> : std::is_same<typename ExprTraits<L>::Value, typename ExprTraits<R>::Value> {};
+    
+    template <typename E, bool = ExprTraits<E>::isOperand>
+    struct IsVectorExpr : std::false_type {};
+    
+    template <typename E>
+    struct IsVectorExpr<E, true> : std::integral_constant<bool, ExprTraits<E>::isVector> {};
+    
+    template <typename E, bool = ExprTraits<E>::isOperand>
+    struct IsMatrixExpr : std::false_type {};
+    
+    template <typename E>
+    struct IsMatrixExpr<E, true> : std::integral_constant<bool, !ExprTraits<E>::isVector> {};
+    
+    struct NegOp
+    {
+      template <typename T>
+      static inline T apply(const T& a)
+      {
+        return -a;
+      }
+    };
+    
+    struct AddOp
+    {
+      template <typename T>
+      static inline T apply(const T& a, const T& b)
+      {
+        return a + b;
+      }
+    };
+    
+    struct SubOp
+    {
+      template <typename T>
+      static inline T apply(const T& a, const T& b)
+      {
+        return a - b;
+      }
+    };
+    
+    struct MulOp
+    {
+      template <typename T>
+      static inline T apply(const T& a, const T& b)
+      {
+        return a * b;
+      }
+    };
+    
+    struct DivOp
+    {
+      template <typename T>
+      static inline T apply(const T& a, const T& b)
+      {
+        return a / b;
+      }
+    };
     
-    explicit Vec2(T t = 0) : x(t), y(t)
+    // Element i of a leaf, scalar or node; matrices are indexed in their column-major storage order.
+    template <typename T, unsigned int N>
+    inline const T& element(const Vec<T, N>& v, unsigned int i)
     {
+      return v[i];
     }
     
-    Vec2(T _x, T _y) : x(_x), y(_y)
+    template <typename T, unsigned int R, unsigned int C>
+    inline const T& element(const Mat<T, R, C>& m, unsigned int i)
     {
+      return m.d[i / R][i % R];
     }
     
-    Vec2(const Vec2<T>& other)
+    template <typename T>
+    inline const T& element(const ScalarExpr<T>& s, unsigned int)
     {
-      x = other.x;
-      y = other.y;
+      return s.t;
     }
     
-    explicit Vec2(const Vec3<T>& other)
+    template <typename Op, typename E, typename V>
+    inline typename ExprTraits<V>::Scalar element(const UnaryExpr<Op, E, V>& u, unsigned int i)
     {
-      x = other.x;
-      y = other.y;
+      return Op::apply(element(u.e, i));
     }
     
-    explicit Vec2(const Vec4<T>& other)
+    template <typename Op, typename L, typename R, typename V>
+    inline typename ExprTraits<V>::Scalar element(const BinaryExpr<Op, L, R, V>& b, unsigned int i)
+    {
+      return Op::apply(element(b.lhs, i), element(b.rhs, i));
+    }
+    
+    template <typename Op, typename E>
+    using ScalarRhsExpr = BinaryExpr<Op, E, ScalarExpr<typename ExprTraits<E>::Scalar>, typename ExprTraits<E>::Value>;
+    
+    template <typename Op, typename E>
+    using ScalarLhsExpr = BinaryExpr<Op, ScalarExpr<typename ExprTraits<E>::Scalar>, E, typename ExprTraits<E>::Value>;
+  }
+  
+  template <typename E>
+  inline typename std::enable_if<Detail::ExprTraits<E>::isOperand,
+                                 Detail::UnaryExpr<Detail::NegOp, E, typename Detail::ExprTraits<E>::Value>>::type
+  operator-(const E& e)
+  {
+    return {e};
+  }
+  
+  template <typename L, typename R>
+  inline typename std::enable_if<Detail::SameShape<L, R>::value,
+                                 Detail::BinaryExpr<Detail::AddOp, L, R, typename Detail::ExprTraits<L>::Value>>::type
+  operator+(const L& lhs, const R& rhs)
+  {
+    return {lhs, rhs};
+  }
+  
+  template <typename L, typename R>
+  inline typename std::enable_if<Detail::SameShape<L, R>::value,
+                                 Detail::BinaryExpr<Detail::SubOp, L, R, typename Detail::ExprTraits<L>::Value>>::type
+  operator-(const L& lhs, const R& rhs)
+  {
+    return {lhs, rhs};
+  }
+  
+  // Component-wise product; only defined for vectors, matrix products stay eager.
+  template <typename L, typename R>
+  inline typename std::enable_if<Detail::SameShape<L, R>::value && Detail::IsVectorExpr<L>::value,
+                                 Detail::BinaryExpr<Detail::MulOp, L, R, typename Detail::ExprTraits<L>::Value>>::type
+  operator*(const L& lhs, const R& rhs)
+  {
+    return {lhs, rhs};
+  }
+  
+  template <typename E>
+  inline typename std::enable_if<Detail::ExprTraits<E>::isOperand, Detail::ScalarRhsExpr<Detail::MulOp, E>>::type
+  operator*(const E& e, const typename Detail::ExprTraits<E>::Scalar t)
+  {
+    return {e, {t}};
+  }
+  
+  template <typename E>
+  inline typename std::enable_if<Detail::ExprTraits<E>::isOperand, Detail::ScalarLhsExpr<Detail::MulOp, E>>::type
+  operator*(const typename Detail::ExprTraits<E>::Scalar t, const E& e)
+  {
+    return {{t}, e};
+  }
+  
+  template <typename E>
+  inline typename std::enable_if<Detail::IsVectorExpr<E>::value, Detail::ScalarRhsExpr<Detail::DivOp, E>>::type
+  operator/(const E& e, const typename Detail::ExprTraits<E>::Scalar t)
+  {
+    return {e, {t}};
+  }
+  
+  // Matrices scale by the reciprocal, as the eager operators do.
+  template <typename E>
+  inline typename std::enable_if<Detail::IsMatrixExpr<E>::value, Detail::ScalarRhsExpr<Detail::MulOp, E>>::type
+  operator/(const E& e, const typename Detail::ExprTraits<E>::Scalar t)
+  {
+    return {e, {1 / t}};
+  }
+#endif
+
+  /* Vec2 */
+  template <typename T>
+  struct Vec<T, 2>
+  {
+    T x, y;
+    
+    constexpr explicit Vec(T t = 0) : x(t), y(t)
     {
-      x = other.x;
-      y = other.y;
     }
     
-    Vec2& operator=(const Vec2<T>& other)
+    constexpr Vec(T _x, T _y) : x(_x), y(_y)
     {
-      if (this != &other)
-      {
-        x = other.x;
-        y = other.y;
-      }
-      return *this;
     }
     
-    Vec2& operator=(const Vec3<T>& other)
+    constexpr explicit Vec(const Vec3<T>& other) : x(other.x), y(other.y)
     {
-      if (this != &other)
-      {
-        x = other.x;
-        y = other.y;
-      }
+    }
+    
+    constexpr explicit Vec(const Vec4<T>& other) : x(other.x), y(other.y)
+    {
+    }
+    
+    NEON_CONSTEXPR14 Vec2<T>& operator=(const Vec3<T>& other)
+    {
+      x = other.x;
+      y = other.y;
       return *this;
     }
     
-    Vec2& operator=(const Vec4<T>& other)
+    NEON_CONSTEXPR14 Vec2<T>& operator=(const Vec4<T>& other)
     {
-      if (this != &other)
-      {
-        x = other.x;
-        y = other.y;
-      }
+      x = other.x;
+      y = other.y;
       return *this;
     }
     
@@ -109,396 +422,380 @@ namespace Neon
       return ((&x)[i]);
     }
     
-    friend inline Vec2<T> operator+(const Vec2<T>& lhs, const Vec2<T>& rhs)
+    NEON_CONSTEXPR14 Vec2<T>& operator+=(const Vec2<T>& v)
     {
-      return Vec2<T>{lhs.x + rhs.x, lhs.y + rhs.y};
+      x += v.x;
+      y += v.y;
+      return *this;
     }
     
-    inline Vec2<T>& operator+=(const Vec2<T>& v)
+    NEON_CONSTEXPR14 Vec2<T>& operator-=(const Vec2<T>& v)
     {
-      x += v.x;
-      y += v.y;
+      x -= v.x;
+      y -= v.y;
       return *this;
     }
     
-    friend inline Vec2<T> operator-(const Vec2<T>& v)
+    NEON_CONSTEXPR14 Vec2<T>& operator*=(const T t)
     {
-      return Vec2<T>{-v.x, -v.y};
+      x *= t;
+      y *= t;
+      return *this;
     }
     
-    friend inline Vec2<T> operator-(const Vec2<T>& lhs, const Vec2<T>& rhs)
+    NEON_CONSTEXPR14 Vec2<T>& operator*=(const Vec2<T>& v)
     {
-      return Vec2<T>{lhs.x - rhs.x, lhs.y - rhs.y};
+      x *= v.x;
+      y *= v.y;
+      return *this;
     }
     
-    inline Vec2<T>& operator-=(const Vec2<T>& v)
+    NEON_CONSTEXPR14 Vec2<T>& operator/=(const T t)
     {
-      x -= v.x;
-      y -= v.y;
+      x /= t;
+      y /= t;
       return *this;
     }
     
-    friend inline Vec2<T> operator*(const T t, const Vec2<T>& rhs)
+#if !defined(NEON_EXPR_TEMPLATES)
+    friend constexpr Vec2<T> operator+(const Vec2<T>& lhs, const Vec2<T>& rhs)
     {
-      return Vec2<T>{rhs.x * t, rhs.y * t};
+      return Vec2<T>{lhs.x + rhs.x, lhs.y + rhs.y};
     }
     
-    friend inline Vec2<T> operator*(const Vec2<T>& lhs, const T t)
+    friend constexpr Vec2<T> operator-(const Vec2<T>& v)
     {
-      return t * lhs;
+      return Vec2<T>{-v.x, -v.y};
     }
     
-    inline Vec2<T>& operator*=(const T t)
+    friend constexpr Vec2<T> operator-(const Vec2<T>& lhs, const Vec2<T>& rhs)
     {
-      x *= t;
-      y *= t;
-      return *this;
+      return Vec2<T>{lhs.x - rhs.x, lhs.y - rhs.y};
     }
     
-    friend inline Vec2<T> operator*(const Vec2<T>& lhs, const Vec2<T>& rhs)
+    friend constexpr Vec2<T> operator*(const T t, const Vec2<T>& rhs)
     {
-      return Vec2<T>{lhs.x * rhs.x, lhs.y * rhs.y};
+      return Vec2<T>{rhs.x * t, rhs.y * t};
     }
     
-    inline Vec2<T>& operator*=(const Vec2<T>& v)
+    friend constexpr Vec2<T> operator*(const Vec2<T>& lhs, const T t)
     {
-      x *= v.x;
-      y *= v.y;
-      return *this;
+      return t * lhs;
+    }
+    
+    friend constexpr Vec2<T> operator*(const Vec2<T>& lhs, const Vec2<T>& rhs)
+    {
+      return Vec2<T>{lhs.x * rhs.x, lhs.y * rhs.y};
     }
     
-    friend inline Vec2<T> operator/(const Vec2<T>& lhs, const T t)
+    friend constexpr Vec2<T> operator/(const Vec2<T>& lhs, const T t)
     {
       return Vec2<T>{lhs.x / t, lhs.y / t};
     }
+#else
+    template <typename E, typename = typename std::enable_if<Detail::IsExprOf<E, Vec2<T>>::value>::type>
+    Vec(const E& e)
+    {
+      *this = e;
+    }
     
-    inline Vec2<T>& operator/=(const T t)
+    template <typename E>
+    typename std::enable_if<Detail::IsExprOf<E, Vec2<T>>::value, Vec2<T>&>::type operator=(const E& e)
     {
-      x /= t;
-      y /= t;
+      for (unsigned int i = 0; i < 2; i++)
+        (*this)[i] = element(e, i);
       return *this;
     }
+#endif
   };
   
   /* Vec3 */
   template <typename T>
-  struct Vec3
+  struct Vec<T, 3>
   {
     T x, y, z;
     
-    explicit Vec3(T t = 0) : x(t), y(t), z(t)
+    constexpr explicit Vec(T t = 0) : x(t), y(t), z(t)
     {
     }
     
-    Vec3(T _x, T _y, T _z) : x(_x), y(_y), z(_z)
+    constexpr Vec(T _x, T _y, T _z) : x(_x), y(_y), z(_z)
     {
     }
     
-    explicit Vec3(const Vec2<T>& other, T z = 1)
+    constexpr explicit Vec(const Vec2<T>& other, T _z = 1) : x(other.x), y(other.y), z(_z)
+    {
+    }
+    
+    constexpr explicit Vec(const Vec4<T>& other) : x(other.x), y(other.y), z(other.z)
     {
-      x = other.x;
-      y = other.y;
-      this->z = z;
     }
     
-    Vec3(const Vec3<T>& other)
+    NEON_CONSTEXPR14 Vec3<T>& operator=(const Vec2<T>& other)
     {
       x = other.x;
       y = other.y;
-      z = other.z;
+      return *this;
     }
     
-    explicit Vec3(const Vec4<T>& other)
+    NEON_CONSTEXPR14 Vec3<T>& operator=(const Vec4<T>& other)
     {
       x = other.x;
       y = other.y;
       z = other.z;
+      return *this;
     }
     
-    Vec3& operator=(const Vec2<T>& other)
+    inline T& operator[](unsigned int i)
     {
-      if (this != &other)
-      {
-        x = other.x;
-        y = other.y;
-      }
-      return *this;
+      return ((&x)[i]);
     }
     
-    Vec3& operator=(const Vec3<T>& other)
+    inline const T& operator[](unsigned int i) const
     {
-      if (this != &other)
-      {
-        x = other.x;
-        y = other.y;
-        z = other.z;
-      }
-      return *this;
+      return ((&x)[i]);
     }
     
-    Vec3& operator=(const Vec4<T>& other)
+    NEON_CONSTEXPR14 Vec3<T>& operator+=(const Vec3<T>& v)
     {
-      if (this != &other)
-      {
-        x = other.x;
-        y = other.y;
-        z = other.z;
-      }
+      x += v.x;
+      y += v.y;
+      z += v.z;
       return *this;
     }
     
-    inline T& operator[](unsigned int i)
+    NEON_CONSTEXPR14 Vec3<T>& operator-=(const Vec3<T>& v)
     {
-      return ((&x)[i]);
+      x -= v.x;
+      y -= v.y;
+      z -= v.z;
+      return *this;
     }
     
-    inline const T& operator[](unsigned int i) const
+    NEON_CONSTEXPR14 Vec3<T>& operator*=(const T t)
     {
-      return ((&x)[i]);
+      x *= t;
+      y *= t;
+      z *= t;
+      return *this;
     }
     
-    friend inline Vec3<T> operator+(const Vec3<T>& lhs, const Vec3<T>& rhs)
+    NEON_CONSTEXPR14 Vec3<T>& operator*=(const Vec3<T>& v)
     {
-      return Vec3<T>{lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z};
+      x *= v.x;
+      y *= v.y;
+      z *= v.z;
+      return *this;
     }
     
-    inline Vec3<T>& operator+=(const Vec3<T>& v)
+    NEON_CONSTEXPR14 Vec3<T>& operator/=(const T t)
     {
-      x += v.x;
-      y += v.y;
-      z += v.z;
+      x /= t;
+      y /= t;
+      z /= t;
       return *this;
     }
     
-    friend inline Vec3<T> operator-(const Vec3<T>& v)
+#if !defined(NEON_EXPR_TEMPLATES)
+    friend constexpr Vec3<T> operator+(const Vec3<T>& lhs, const Vec3<T>& rhs)
     {
-      return Vec3<T>{-v.x, -v.y, -v.z};
+      return Vec3<T>{lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z};
     }
     
-    friend inline Vec3<T> operator-(const Vec3<T>& lhs, const Vec3<T>& rhs)
+    friend constexpr Vec3<T> operator-(const Vec3<T>& v)
     {
-      return Vec3<T>{lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z};
+      return Vec3<T>{-v.x, -v.y, -v.z};
     }
     
-    inline Vec3<T>& operator-=(const Vec3<T>& v)
+    friend constexpr Vec3<T> operator-(const Vec3<T>& lhs, const Vec3<T>& rhs)
     {
-      x -= v.x;
-      y -= v.y;
-      z -= v.z;
-      return *this;
+      return Vec3<T>{lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z};
     }
     
-    friend inline Vec3<T> operator*(const Vec3<T>& v, const T t)
+    friend constexpr Vec3<T> operator*(const Vec3<T>& v, const T t)
     {
       return Vec3<T>{v.x * t, v.y * t, v.z * t};
     }
     
-    friend inline Vec3<T> operator*(const T t, const Vec3<T>& v)
+    friend constexpr Vec3<T> operator*(const T t, const Vec3<T>& v)
     {
       return v * t;
     }
     
-    inline Vec3<T>& operator*=(const T t)
-    {
-      x *= t;
-      y *= t;
-      z *= t;
-      return *this;
-    }
-    
-    friend inline Vec3<T> operator*(const Vec3<T>& lhs, const Vec3<T>& rhs)
+    friend constexpr Vec3<T> operator*(const Vec3<T>& lhs, const Vec3<T>& rhs)
     {
       return Vec3<T>{lhs.x * rhs.x, lhs.y * rhs.y, lhs.z * rhs.z};
     }
     
-    inline Vec3<T>& operator*=(const Vec3<T>& v)
+    friend constexpr Vec3<T> operator/(const Vec3<T>& v, const T t)
     {
-      x *= v.x;
-      y *= v.y;
-      z *= v.z;
-      return *this;
+      return Vec3<T>{v.x / t, v.y / t, v.z / t};
     }
-    
-    friend inline Vec3<T> operator/(const Vec3<T>& v, const T t)
+#else
+    template <typename E, typename = typename std::enable_if<Detail::IsExprOf<E, Vec3<T>>::value>::type>
+    Vec(const E& e)
     {
-      return Vec3<T>{v.x / t, v.y / t, v.z / t};
+      *this = e;
     }
     
-    inline Vec3<T>& operator/=(const T t)
+    template <typename E>
+    typename std::enable_if<Detail::IsExprOf<E, Vec3<T>>::value, Vec3<T>&>::type operator=(const E& e)
     {
-      x /= t;
-      y /= t;
-      z /= t;
+      for (unsigned int i = 0; i < 3; i++)
+        (*this)[i] = element(e, i);
       return *this;
     }
+#endif
   };
   
   /* Vec4 */
   template <typename T>
-  struct Vec4
+  struct Vec<T, 4>
   {
     T x, y, z, w;
     
-    explicit Vec4(T t = 0) : x(t), y(t), z(t), w(t)
+    constexpr explicit Vec(T t = 0) : x(t), y(t), z(t), w(t)
     {
     }
     
-    Vec4(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w)
+    constexpr Vec(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w)
     {
     }
     
-    explicit Vec4(const Vec2<T>& other, T z = 0, T w = 0)
+    constexpr explicit Vec(const Vec2<T>& other, T _z = 0, T _w = 0) : x(other.x), y(other.y), z(_z), w(_w)
+    {
+    }
+    
+    constexpr explicit Vec(const Vec3<T>& other, T _w = 0) : x(other.x), y(other.y), z(other.z), w(_w)
     {
-      x = other.x;
-      y = other.y;
-      this->z = z;
-      this->w = w;
     }
     
-    explicit Vec4(const Vec3<T>& other, T w = 0)
+    NEON_CONSTEXPR14 Vec4<T>& operator=(const Vec2<T>& other)
     {
       x = other.x;
       y = other.y;
-      z = other.z;
-      this->w = w;
+      return *this;
     }
     
-    Vec4(const Vec4<T>& other)
+    NEON_CONSTEXPR14 Vec4<T>& operator=(const Vec3<T>& other)
     {
       x = other.x;
       y = other.y;
       z = other.z;
-      w = other.w;
+      return *this;
     }
     
-    Vec4& operator=(const Vec2<T>& other)
+    inline T& operator[](unsigned int i)
     {
-      if (this != &other)
-      {
-        x = other.x;
-        y = other.y;
-      }
-      return *this;
+      return ((&x)[i]);
     }
     
-    Vec4& operator=(const Vec3<T>& other)
+    inline const T& operator[](unsigned int i) const
     {
-      if (this != &other)
-      {
-        x = other.x;
-        y = other.y;
-        z = other.z;
-      }
-      return *this;
+      return ((&x)[i]);
     }
     
-    Vec4& operator=(const Vec4<T>& other)
+    NEON_CONSTEXPR14 Vec4<T>& operator+=(const Vec4<T>& v)
     {
-      if (this != &other)
-      {
-        x = other.x;
-        y = other.y;
-        z = other.z;
-        w = other.w;
-      }
+      x += v.x;
+      y += v.y;
+      z += v.z;
+      w += v.w;
       return *this;
     }
     
-    inline T& operator[](unsigned int i)
+    NEON_CONSTEXPR14 Vec4<T>& operator-=(const Vec4<T>& v)
     {
-      return ((&x)[i]);
+      x -= v.x;
+      y -= v.y;
+      z -= v.z;
+      w -= v.w;
+      return *this;
     }
     
-    inline const T& operator[](unsigned int i) const
+    NEON_CONSTEXPR14 Vec4<T>& operator*=(const T t)
     {
-      return ((&x)[i]);
+      x *= t;
+      y *= t;
+      z *= t;
+      w *= t;
+      return *this;
     }
     
-    friend inline Vec4<T> operator+(const Vec4<T>& lhs, const Vec4<T>& rhs)
+    NEON_CONSTEXPR14 Vec4<T>& operator*=(const Vec4<T>& v)
     {
-      return Vec4<T>{lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z, lhs.w + rhs.w};
+      x *= v.x;
+      y *= v.y;
+      z *= v.z;
+      w *= v.w;
+      return *this;
     }
     
-    inline Vec4<T>& operator+=(const Vec4<T>& v)
+    NEON_CONSTEXPR14 Vec4<T>& operator/=(const T t)
     {
-      x += v.x;
-      y += v.y;
-      z += v.z;
-      w += v.w;
+      x /= t;
+      y /= t;
+      z /= t;
+      w /= t;
       return *this;
     }
     
-    friend inline Vec4<T> operator-(const Vec4<T>& v)
+#if !defined(NEON_EXPR_TEMPLATES)
+    friend constexpr Vec4<T> operator+(const Vec4<T>& lhs, const Vec4<T>& rhs)
     {
-      return Vec4<T>{-v.x, -v.y, -v.z, -v.w};
+      return Vec4<T>{lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z, lhs.w + rhs.w};
     }
     
-    friend inline Vec4<T> operator-(const Vec4<T>& lhs, const Vec4<T>& rhs)
+    friend constexpr Vec4<T> operator-(const Vec4<T>& v)
     {
-      return Vec4<T>{lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z, lhs.w - rhs.w};
+      return Vec4<T>{-v.x, -v.y, -v.z, -v.w};
     }
     
-    inline Vec4<T>& operator-=(const Vec4<T>& v)
+    friend constexpr Vec4<T> operator-(const Vec4<T>& lhs, const Vec4<T>& rhs)
     {
-      x -= v.x;
-      y -= v.y;
-      z -= v.z;
-      w -= v.w;
-      return *this;
+      return Vec4<T>{lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z, lhs.w - rhs.w};
     }
     
-    friend inline Vec4<T> operator*(const Vec4<T>& lhs, const T t)
+    friend constexpr Vec4<T> operator*(const Vec4<T>& lhs, const T t)
     {
       return Vec4<T>{lhs.x * t, lhs.y * t, lhs.z * t, lhs.w * t};
     }
     
-    friend inline Vec4<T> operator*(const T t, const Vec4<T>& rhs)
+    friend constexpr Vec4<T> operator*(const T t, const Vec4<T>& rhs)
     {
       return rhs * t;
     }
     
-    inline Vec4<T>& operator*=(const T t)
-    {
-      x *= t;
-      y *= t;
-      z *= t;
-      w *= t;
-      return *this;
-    }
-    
-    friend inline Vec4<T> operator*(const Vec4<T>& lhs, const Vec4<T>& rhs)
+    friend constexpr Vec4<T> operator*(const Vec4<T>& lhs, const Vec4<T>& rhs)
     {
       return Vec4<T>{lhs.x * rhs.x, lhs.y * rhs.y, lhs.z * rhs.z, lhs.w * rhs.w};
     }
     
-    inline Vec4<T>& operator*=(const Vec4<T>& v)
+    friend constexpr Vec4<T> operator/(const Vec4<T>& lhs, const T t)
     {
-      x *= v.x;
-      y *= v.y;
-      z *= v.z;
-      w *= v.w;
-      return *this;
+      return Vec4<T>(lhs.x / t, lhs.y / t, lhs.z / t, lhs.w / t);
     }
-    
-    friend inline Vec4<T> operator/(const Vec4<T>& lhs, const T t)
+#else
+    template <typename E, typename = typename std::enable_if<Detail::IsExprOf<E, Vec4<T>>::value>::type>
+    Vec(const E& e)
     {
-      return Vec4<T>(lhs.x / t, lhs.y / t, lhs.z / t, lhs.w / t);
+      *this = e;
     }
     
-    inline Vec4<T>& operator/=(const T t)
+    template <typename E>
+    typename std::enable_if<Detail::IsExprOf<E, Vec4<T>>::value, Vec4<T>&>::type operator=(const E& e)
     {
-      x /= t;
-      y /= t;
-      z /= t;
-      w /= t;
+      for (unsigned int i = 0; i < 4; i++)
+        (*this)[i] = element(e, i);
       return *this;
     }
+#endif
   };
   
   /* Common vector operations */
   
   template <typename T>
-  inline T dot(const Vec2<T>& v1, const Vec2<T>& v2)
+  constexpr T dot(const Vec2<T>& v1, const Vec2<T>& v2)
   {
     return v1.x * v2.x + v1.y * v2.y;
   }
@@ -523,13 +820,19 @@ namespace Neon
   }
   
   template <typename T>
-  inline Vec2<T> project(const Vec2<T>& v1, const Vec2<T>& v2)
+  constexpr Vec2<T> lerp(const Vec2<T>& v1, const Vec2<T>& v2, T t)
+  {
+    return v1 + (v2 - v1) * t;
+  }
+  
+  template <typename T>
+  constexpr Vec2<T> project(const Vec2<T>& v1, const Vec2<T>& v2)
   {
     return (dot(v1, v2) / dot(v2, v2)) * v2;
   }
   
   template <typename T>
-  inline Vec2<T> reflect(const Vec2<T>& v, const Vec2<T>& n)
+  NEON_CONSTEXPR14 Vec2<T> reflect(const Vec2<T>& v, const Vec2<T>& n)
   {
     const Vec2<T> p = dot(v, n) / dot(n, n) * n;
     return v - 2 * p;
@@ -548,19 +851,19 @@ namespace Neon
   }
   
   template <typename T>
-  inline T dot(const Vec3<T>& v1, const Vec3<T>& v2)
+  constexpr T dot(const Vec3<T>& v1, const Vec3<T>& v2)
   {
     return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
   }
   
   template <typename T>
-  inline Vec3<T> cross(const Vec3<T>& v1, const Vec3<T>& v2)
+  constexpr Vec3<T> cross(const Vec3<T>& v1, const Vec3<T>& v2)
   {
     return Vec3<T>{v1.y * v2.z - v1.z * v2.y, v1.z * v2.x - v1.x * v2.z, v1.x * v2.y - v1.y * v2.x};
   }
   
   template <typename T>
-  inline T tripleProduct(const Vec3<T>& v1, const Vec3<T>& v2, const Vec3<T>& v3)
+  constexpr T tripleProduct(const Vec3<T>& v1, const Vec3<T>& v2, const Vec3<T>& v3)
   {
     return dot(v1, cross(v2, v3));
   }
@@ -585,13 +888,19 @@ namespace Neon
   }
   
   template <typename T>
-  inline Vec3<T> project(const Vec3<T>& v1, const Vec3<T>& v2)
+  constexpr Vec3<T> lerp(const Vec3<T>& v1, const Vec3<T>& v2, T t)
+  {
+    return v1 + (v2 - v1) * t;
+  }
+  
+  template <typename T>
+  constexpr Vec3<T> project(const Vec3<T>& v1, const Vec3<T>& v2)
   {
     return (dot(v1, v2) / dot(v2, v2)) * v2;
   }
   
   template <typename T>
-  inline Vec3<T> reflect(const Vec3<T>& v, const Vec3<T>& n)
+  NEON_CONSTEXPR14 Vec3<T> reflect(const Vec3<T>& v, const Vec3<T>& n)
   {
     const Vec3<T> p = dot(v, n) / dot(n, n) * n;
     return v - 2 * p;
@@ -602,24 +911,25 @@ namespace Neon
   {
     const T ctheta1 = dot(v, n);
     const T ctheta2 = std::sqrt(1 - ((eta * eta) * (1 - ctheta1 * ctheta1)));
-    const T vrefract = eta * v + (eta * ctheta1 - ctheta2) * n;
+    const Vec3<T> vrefract = eta * v + (eta * ctheta1 - ctheta2) * n;
     return vrefract;
   }
   
   // Right-Handed.
-  template <typename T>
+  template <typename T, Precision Pr = Precision::Exact>
   inline Vec3<T> rotate(const Vec3<T>& v, const Vec3<T>& n, T theta)
   {
     const Vec3<T> vproj = dot(v, n) * n;
     const Vec3<T> vrej = v - vproj;
-    const T cos = std::cos(theta);
-    const T sin = std::sin(theta);
+    T sin;
+    T cos;
+    Detail::SinCos<T, Pr>::run(theta, sin, cos);
     const Vec3<T> vcrossa = cross(n, v);
     return vproj + vrej * cos + vcrossa * sin;
   }
   
   template <typename T>
-  inline T dot(const Vec4<T>& v1, const Vec4<T>& v2)
+  constexpr T dot(const Vec4<T>& v1, const Vec4<T>& v2)
   {
     return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z + v1.w * v2.w;
   }
@@ -636,938 +946,8069 @@ namespace Neon
     return v / mag(v);
   }
   
-  /* Mat2 */
   template <typename T>
-  struct Mat2
+  constexpr Vec4<T> lerp(const Vec4<T>& v1, const Vec4<T>& v2, T t)
   {
-    static const unsigned short size = 2;
-    T d[2][2];
+    return v1 + (v2 - v1) * t;
+  }
   
-    explicit Mat2(T t = 1)
+  /* SIMD packs */
+  
+  namespace Detail
+  {
+    // Number of T lanes in the widest native register available.
+    template <typename T>
+    struct PackWidth
+    {
+      static const unsigned int value = 1;
+    };
+    
+#if defined(NEON_SIMD_AVX)
+    template <>
+    struct PackWidth<float>
+    {
+      static const unsigned int value = 8;
+    };
+    
+    template <>
+    struct PackWidth<double>
+    {
+      static const unsigned int value = 4;
+    };
+#elif defined(NEON_SIMD_SSE2)
+    template <>
+    struct PackWidth<float>
+    {
+      static const unsigned int value = 4;
+    };
+    
+    template <>
+    struct PackWidth<double>
+    {
+      static const unsigned int value = 2;
+    };
+#endif
+    
+    // Hardware estimate of 1 / sqrt(x), good to about 12 bits, where there is one and exact otherwise.
+    // Doubles are estimated in float; outside the normal float range they are computed exactly instead.
+    inline float rsqrtEstimate(float x)
+    {
+#if defined(NEON_SIMD_SSE2)
+      return _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+#else
+      return 1 / std::sqrt(x);
+#endif
+    }
+    
+    inline double rsqrtEstimate(double x)
+    {
+#if defined(NEON_SIMD_SSE2)
+      if (x >= static_cast<double>(std::numeric_limits<float>::min()) && x <= static_cast<double>(std::numeric_limits<float>::max()))
+        return static_cast<double>(rsqrtEstimate(static_cast<float>(x)));
+      return 1 / std::sqrt(x);
+#else
+      return 1 / std::sqrt(x);
+#endif
+    }
+    
+    // W lanes of T behaving like a T, so that Vec3<Pack<T>> and friends reuse the scalar formulas.
+    // Pack<T, 1> is the scalar fallback, also used for the tails of batched loops. load and store take pointers
+    // with any alignment.
+    template <typename T, unsigned int W = PackWidth<T>::value>
+    struct Pack;
+    
+    template <typename T>
+    struct Pack<T, 1>
+    {
+      using Scalar = T;
+      using Mask = bool;
+      static const unsigned int width = 1;
+      T v;
+      
+      Pack() = default;
+      
+      Pack(T t) : v(t)
+      {
+      }
+      
+      static inline Pack load(const T* p)
+      {
+        return Pack(*p);
+      }
+      
+      inline void store(T* p) const
+      {
+        *p = v;
+      }
+      
+      friend inline Pack operator+(Pack a, Pack b)
+      {
+        return Pack(a.v + b.v);
+      }
+      
+      friend inline Pack operator-(Pack a, Pack b)
+      {
+        return Pack(a.v - b.v);
+      }
+      
+      friend inline Pack operator*(Pack a, Pack b)
+      {
+        return Pack(a.v * b.v);
+      }
+      
+      friend inline Pack operator/(Pack a, Pack b)
+      {
+        return Pack(a.v / b.v);
+      }
+      
+      friend inline Pack operator-(Pack a)
+      {
+        return Pack(-a.v);
+      }
+      
+      friend inline Pack& operator+=(Pack& a, Pack b)
+      {
+        a.v += b.v;
+        return a;
+      }
+      
+      friend inline Pack& operator-=(Pack& a, Pack b)
+      {
+        a.v -= b.v;
+        return a;
+      }
+      
+      friend inline Pack& operator*=(Pack& a, Pack b)
+      {
+        a.v *= b.v;
+        return a;
+      }
+      
+      friend inline Pack& operator/=(Pack& a, Pack b)
+      {
+        a.v /= b.v;
+        return a;
+      }
+      
+      friend inline Mask operator<(Pack a, Pack b)
+      {
+        return a.v < b.v;
+      }
+      
+      friend inline Mask operator<=(Pack a, Pack b)
+      {
+        return a.v <= b.v;
+      }
+      
+      friend inline Mask operator>(Pack a, Pack b)
+      {
+        return a.v > b.v;
+      }
+      
+      friend inline Mask operator>=(Pack a, Pack b)
+      {
+        return a.v >= b.v;
+      }
+      
+      friend inline Mask operator==(Pack a, Pack b)
+      {
+        return a.v == b.v;
+      }
+      
+      friend inline Pack madd(Pack a, Pack b, Pack c)
+      {
+        return Pack(a.v * b.v + c.v);
+      }
+      
+      friend inline Pack sqrt(Pack a)
+      {
+        return Pack(std::sqrt(a.v));
+      }
+      
+      friend inline Pack rsqrtEstimate(Pack a)
+      {
+        return Pack(rsqrtEstimate(a.v));
+      }
+      
+      friend inline Pack abs(Pack a)
+      {
+        return Pack(std::abs(a.v));
+      }
+      
+      friend inline Pack min(Pack a, Pack b)
+      {
+        return Pack(std::min(a.v, b.v));
+      }
+      
+      friend inline Pack max(Pack a, Pack b)
+      {
+        return Pack(std::max(a.v, b.v));
+      }
+      
+      friend inline Pack select(Mask m, Pack a, Pack b)
+      {
+        return m ? a : b;
+      }
+    };
+    
+    inline unsigned int bits(bool m)
     {
-      d[0][0] = t; d[0][1] = 0;
-      d[1][0] = 0; d[1][1] = t;
+      return m ? 1u : 0u;
     }
     
-    Mat2(const Vec2<T>& col1, const Vec2<T>& col2)
+    inline bool any(bool m)
     {
-      d[0][0] = col1.x; d[0][1] = col1.y;
-      d[1][0] = col2.x; d[1][1] = col2.y;
+      return m;
     }
     
-    Mat2(T col1x, T col2x,
-         T col1y, T col2y)
+#if defined(NEON_SIMD_SSE2)
+    inline __m128 madd(__m128 a, __m128 b, __m128 c)
     {
-      d[0][0] = col1x; d[0][1] = col1y;
-      d[1][0] = col2x; d[1][1] = col2y;
+#if defined(NEON_SIMD_FMA)
+      return _mm_fmadd_ps(a, b, c);
+#else
+      return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
     }
     
-    Mat2(const Mat2<T>& other)
+    inline __m128d madd(__m128d a, __m128d b, __m128d c)
     {
-      d[0][0] = other(0, 0); d[1][0] = other(0, 1);
-      d[0][1] = other(1, 0); d[1][1] = other(1, 1);
+#if defined(NEON_SIMD_FMA)
+      return _mm_fmadd_pd(a, b, c);
+#else
+      return _mm_add_pd(_mm_mul_pd(a, b), c);
+#endif
     }
     
-    Mat2<T>& operator=(const Mat2<T>& other)
+    struct MaskF4
     {
-      if (this != &other)
+      __m128 m;
+      
+      friend inline MaskF4 operator&(MaskF4 a, MaskF4 b)
       {
-        d[0][0] = other.d[0][0]; d[1][0] = other.d[1][0];
-        d[0][1] = other.d[0][1]; d[1][1] = other.d[1][1];
+        return MaskF4{_mm_and_ps(a.m, b.m)};
       }
-      return *this;
-    }
+      
+      friend inline MaskF4 operator|(MaskF4 a, MaskF4 b)
+      {
+        return MaskF4{_mm_or_ps(a.m, b.m)};
+      }
+      
+      friend inline unsigned int bits(MaskF4 a)
+      {
+        return static_cast<unsigned int>(_mm_movemask_ps(a.m));
+      }
+      
+      friend inline bool any(MaskF4 a)
+      {
+        return _mm_movemask_ps(a.m) != 0;
+      }
+    };
+    
+    template <>
+    struct Pack<float, 4>
+    {
+      using Scalar = float;
+      using Mask = MaskF4;
+      static const unsigned int width = 4;
+      __m128 v;
+      
+      Pack() = default;
+      
+      Pack(float t) : v(_mm_set1_ps(t))
+      {
+      }
+      
+      explicit Pack(__m128 r) : v(r)
+      {
+      }
+      
+      static inline Pack load(const float* p)
+      {
+        return Pack(_mm_loadu_ps(p));
+      }
+      
+      inline void store(float* p) const
+      {
+        _mm_storeu_ps(p, v);
+      }
+      
+      friend inline Pack operator+(Pack a, Pack b)
+      {
+        return Pack(_mm_add_ps(a.v, b.v));
+      }
+      
+      friend inline Pack operator-(Pack a, Pack b)
+      {
+        return Pack(_mm_sub_ps(a.v, b.v));
+      }
+      
+      friend inline Pack operator*(Pack a, Pack b)
+      {
+        return Pack(_mm_mul_ps(a.v, b.v));
+      }
+      
+      friend inline Pack operator/(Pack a, Pack b)
+      {
+        return Pack(_mm_div_ps(a.v, b.v));
+      }
+      
+      friend inline Pack operator-(Pack a)
+      {
+        return Pack(_mm_xor_ps(a.v, _mm_set1_ps(-0.0f)));
+      }
+      
+      friend inline Pack& operator+=(Pack& a, Pack b)
+      {
+        return a = a + b;
+      }
+      
+      friend inline Pack& operator-=(Pack& a, Pack b)
+      {
+        return a = a - b;
+      }
+      
+      friend inline Pack& operator*=(Pack& a, Pack b)
+      {
+        return a = a * b;
+      }
+      
+      friend inline Pack& operator/=(Pack& a, Pack b)
+      {
+        return a = a / b;
+      }
+      
+      friend inline Mask operator<(Pack a, Pack b)
+      {
+        return Mask{_mm_cmplt_ps(a.v, b.v)};
+      }
+      
+      friend inline Mask operator<=(Pack a, Pack b)
+      {
+        return Mask{_mm_cmple_ps(a.v, b.v)};
+      }
+      
+      friend inline Mask operator>(Pack a, Pack b)
+      {
+        return Mask{_mm_cmpgt_ps(a.v, b.v)};
+      }
+      
+      friend inline Mask operator>=(Pack a, Pack b)
+      {
+        return Mask{_mm_cmpge_ps(a.v, b.v)};
+      }
+      
+      friend inline Mask operator==(Pack a, Pack b)
+      {
+        return Mask{_mm_cmpeq_ps(a.v, b.v)};
+      }
+      
+      friend inline Pack madd(Pack a, Pack b, Pack c)
+      {
+        return Pack(Detail::madd(a.v, b.v, c.v));
+      }
+      
+      friend inline Pack sqrt(Pack a)
+      {
+        return Pack(_mm_sqrt_ps(a.v));
+      }
+      
+      friend inline Pack rsqrtEstimate(Pack a)
+      {
+        return Pack(_mm_rsqrt_ps(a.v));
+      }
+      
+      friend inline Pack abs(Pack a)
+      {
+        return Pack(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v));
+      }
+      
+      friend inline Pack min(Pack a, Pack b)
+      {
+        return Pack(_mm_min_ps(a.v, b.v));
+      }
+      
+      friend inline Pack max(Pack a, Pack b)
+      {
+        return Pack(_mm_max_ps(a.v, b.v));
+      }
+      
+      friend inline Pack select(Mask m, Pack a, Pack b)
+      {
+#if defined(NEON_SIMD_SSE41)
+        return Pack(_mm_blendv_ps(b.v, a.v, m.m));
+#else
+        return Pack(_mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v)));
+#endif
+      }
+    };
     
-    inline Vec2<T>& operator[](unsigned int col)
+    struct MaskD2
     {
-      return *reinterpret_cast<Vec2<T>*>(d[col]);
-    }
+      __m128d m;
+      
+      friend inline MaskD2 operator&(MaskD2 a, MaskD2 b)
+      {
+        return MaskD2{_mm_and_pd(a.m, b.m)};
+      }
+      
+      friend inline MaskD2 operator|(MaskD2 a, MaskD2 b)
+      {
+        return MaskD2{_mm_or_pd(a.m, b.m)};
+      }
+      
+      friend inline unsigned int bits(MaskD2 a)
+      {
+        return static_cast<unsigned int>(_mm_movemask_pd(a.m));
+      }
+      
+      friend inline bool any(MaskD2 a)
+      {
+        return _mm_movemask_pd(a.m) != 0;
+      }
+    };
+    
+    template <>
+    struct Pack<double, 2>
+    {
+      using Scalar = double;
+      using Mask = MaskD2;
+      static const unsigned int width = 2;
+      __m128d v;
+      
+      Pack() = default;
+      
+      Pack(double t) : v(_mm_set1_pd(t))
+      {
+      }
+      
+      explicit Pack(__m128d r) : v(r)
+      {
+      }
+      
+      static inline Pack load(const double* p)
+      {
+        return Pack(_mm_loadu_pd(p));
+      }
+      
+      inline void store(double* p) const
+      {
+        _mm_storeu_pd(p, v);
+      }
+      
+      friend inline Pack operator+(Pack a, Pack b)
+      {
+        return Pack(_mm_add_pd(a.v, b.v));
+      }
+      
+      friend inline Pack operator-(Pack a, Pack b)
+      {
+        return Pack(_mm_sub_pd(a.v, b.v));
+      }
+      
+      friend inline Pack operator*(Pack a, Pack b)
+      {
+        return Pack(_mm_mul_pd(a.v, b.v));
+      }
+      
+      friend inline Pack operator/(Pack a, Pack b)
+      {
+        return Pack(_mm_div_pd(a.v, b.v));
+      }
+      
+      friend inline Pack operator-(Pack a)
+      {
+        return Pack(_mm_xor_pd(a.v, _mm_set1_pd(-0.0)));
+      }
+      
+      friend inline Pack& operator+=(Pack& a, Pack b)
+      {
+        return a = a + b;
+      }
+      
+      friend inline Pack& operator-=(Pack& a, Pack b)
+      {
+        return a = a - b;
+      }
+      
+      friend inline Pack& operator*=(Pack& a, Pack b)
+      {
+        return a = a * b;
+      }
+      
+      friend inline Pack& operator/=(Pack& a, Pack b)
+      {
+        return a = a / b;
+      }
+      
+      friend inline Mask operator<(Pack a, Pack b)
+      {
+        return Mask{_mm_cmplt_pd(a.v, b.v)};
+      }
+      
+      friend inline Mask operator<=(Pack a, Pack b)
+      {
+        return Mask{_mm_cmple_pd(a.v, b.v)};
+      }
+      
+      friend inline Mask operator>(Pack a, Pack b)
+      {
+        return Mask{_mm_cmpgt_pd(a.v, b.v)};
+      }
+      
+      friend inline Mask operator>=(Pack a, Pack b)
+      {
+        return Mask{_mm_cmpge_pd(a.v, b.v)};
+      }
+      
+      friend inline Mask operator==(Pack a, Pack b)
+      {
+        return Mask{_mm_cmpeq_pd(a.v, b.v)};
+      }
+      
+      friend inline Pack madd(Pack a, Pack b, Pack c)
+      {
+        return Pack(Detail::madd(a.v, b.v, c.v));
+      }
+      
+      friend inline Pack sqrt(Pack a)
+      {
+        return Pack(_mm_sqrt_pd(a.v));
+      }
+      
+      friend inline Pack rsqrtEstimate(Pack a)
+      {
+        const __m128d estimate = _mm_cvtps_pd(_mm_rsqrt_ps(_mm_cvtpd_ps(a.v)));
+        const __m128d outside = _mm_or_pd(_mm_cmplt_pd(a.v, _mm_set1_pd(static_cast<double>(std::numeric_limits<float>::min()))),
+                                          _mm_cmpgt_pd(a.v, _mm_set1_pd(static_cast<double>(std::numeric_limits<float>::max()))));
+        if (_mm_movemask_pd(outside) == 0)
+          return Pack(estimate);
+        const __m128d exact = _mm_div_pd(_mm_set1_pd(1.0), _mm_sqrt_pd(a.v));
+        return Pack(_mm_or_pd(_mm_and_pd(outside, exact), _mm_andnot_pd(outside, estimate)));
+      }
+      
+      friend inline Pack abs(Pack a)
+      {
+        return Pack(_mm_andnot_pd(_mm_set1_pd(-0.0), a.v));
+      }
+      
+      friend inline Pack min(Pack a, Pack b)
+      {
+        return Pack(_mm_min_pd(a.v, b.v));
+      }
+      
+      friend inline Pack max(Pack a, Pack b)
+      {
+        return Pack(_mm_max_pd(a.v, b.v));
+      }
+      
+      friend inline Pack select(Mask m, Pack a, Pack b)
+      {
+#if defined(NEON_SIMD_SSE41)
+        return Pack(_mm_blendv_pd(b.v, a.v, m.m));
+#else
+        return Pack(_mm_or_pd(_mm_and_pd(m.m, a.v), _mm_andnot_pd(m.m, b.v)));
+#endif
+      }
+    };
+#endif
     
-    inline const Vec2<T>& operator[](unsigned int col) const
+#if defined(NEON_SIMD_AVX)
+    struct MaskF8
     {
-      return *reinterpret_cast<const Vec2<T>*>(d[col]);
-    }
-    
-    inline T& operator()(unsigned int row, unsigned int col)
+      __m256 m;
+      
+      friend inline MaskF8 operator&(MaskF8 a, MaskF8 b)
+      {
+        return MaskF8{_mm256_and_ps(a.m, b.m)};
+      }
+      
+      friend inline MaskF8 operator|(MaskF8 a, MaskF8 b)
+      {
+        return MaskF8{_mm256_or_ps(a.m, b.m)};
+      }
+      
+      friend inline unsigned int bits(MaskF8 a)
+      {
+        return static_cast<unsigned int>(_mm256_movemask_ps(a.m));
+      }
+      
+      friend inline bool any(MaskF8 a)
+      {
+        return _mm256_movemask_ps(a.m) != 0;
+      }
+    };
+    
+    template <>
+    struct Pack<float, 8>
+    {
+      using Scalar = float;
+      using Mask = MaskF8;
+      static const unsigned int width = 8;
+      __m256 v;
+      
+      Pack() = default;
+      
+      Pack(float t) : v(_mm256_set1_ps(t))
+      {
+      }
+      
+      explicit Pack(__m256 r) : v(r)
+      {
+      }
+      
+      static inline Pack load(const float* p)
+      {
+        return Pack(_mm256_loadu_ps(p));
+      }
+      
+      inline void store(float* p) const
+      {
+        _mm256_storeu_ps(p, v);
+      }
+      
+      friend inline Pack operator+(Pack a, Pack b)
+      {
+        return Pack(_mm256_add_ps(a.v, b.v));
+      }
+      
+      friend inline Pack operator-(Pack a, Pack b)
+      {
+        return Pack(_mm256_sub_ps(a.v, b.v));
+      }
+      
+      friend inline Pack operator*(Pack a, Pack b)
+      {
+        return Pack(_mm256_mul_ps(a.v, b.v));
+      }
+      
+      friend inline Pack operator/(Pack a, Pack b)
+      {
+        return Pack(_mm256_div_ps(a.v, b.v));
+      }
+      
+      friend inline Pack operator-(Pack a)
+      {
+        return Pack(_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)));
+      }
+      
+      friend inline Pack& operator+=(Pack& a, Pack b)
+      {
+        return a = a + b;
+      }
+      
+      friend inline Pack& operator-=(Pack& a, Pack b)
+      {
+        return a = a - b;
+      }
+      
+      friend inline Pack& operator*=(Pack& a, Pack b)
+      {
+        return a = a * b;
+      }
+      
+      friend inline Pack& operator/=(Pack& a, Pack b)
+      {
+        return a = a / b;
+      }
+      
+      friend inline Mask operator<(Pack a, Pack b)
+      {
+        return Mask{_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)};
+      }
+      
+      friend inline Mask operator<=(Pack a, Pack b)
+      {
+        return Mask{_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)};
+      }
+      
+      friend inline Mask operator>(Pack a, Pack b)
+      {
+        return Mask{_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)};
+      }
+      
+      friend inline Mask operator>=(Pack a, Pack b)
+      {
+        return Mask{_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)};
+      }
+      
+      friend inline Mask operator==(Pack a, Pack b)
+      {
+        return Mask{_mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ)};
+      }
+      
+      friend inline Pack sqrt(Pack a)
+      {
+        return Pack(_mm256_sqrt_ps(a.v));
+      }
+      
+      friend inline Pack rsqrtEstimate(Pack a)
+      {
+        return Pack(_mm256_rsqrt_ps(a.v));
+      }
+      
+      friend inline Pack abs(Pack a)
+      {
+        return Pack(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v));
+      }
+      
+      friend inline Pack min(Pack a, Pack b)
+      {
+        return Pack(_mm256_min_ps(a.v, b.v));
+      }
+      
+      friend inline Pack max(Pack a, Pack b)
+      {
+        return Pack(_mm256_max_ps(a.v, b.v));
+      }
+      
+      friend inline Pack select(Mask m, Pack a, Pack b)
+      {
+        return Pack(_mm256_blendv_ps(b.v, a.v, m.m));
+      }
+      
+      friend inline Pack madd(Pack a, Pack b, Pack c)
+      {
+#if defined(NEON_SIMD_FMA)
+        return Pack(_mm256_fmadd_ps(a.v, b.v, c.v));
+#else
+        return a * b + c;
+#endif
+      }
+    };
+    
+    struct MaskD4
+    {
+      __m256d m;
+      
+      friend inline MaskD4 operator&(MaskD4 a, MaskD4 b)
+      {
+        return MaskD4{_mm256_and_pd(a.m, b.m)};
+      }
+      
+      friend inline MaskD4 operator|(MaskD4 a, MaskD4 b)
+      {
+        return MaskD4{_mm256_or_pd(a.m, b.m)};
+      }
+      
+      friend inline unsigned int bits(MaskD4 a)
+      {
+        return static_cast<unsigned int>(_mm256_movemask_pd(a.m));
+      }
+      
+      friend inline bool any(MaskD4 a)
+      {
+        return _mm256_movemask_pd(a.m) != 0;
+      }
+    };
+    
+    template <>
+    struct Pack<double, 4>
+    {
+      using Scalar = double;
+      using Mask = MaskD4;
+      static const unsigned int width = 4;
+      __m256d v;
+      
+      Pack() = default;
+      
+      Pack(double t) : v(_mm256_set1_pd(t))
+      {
+      }
+      
+      explicit Pack(__m256d r) : v(r)
+      {
+      }
+      
+      static inline Pack load(const double* p)
+      {
+        return Pack(_mm256_loadu_pd(p));
+      }
+      
+      inline void store(double* p) const
+      {
+        _mm256_storeu_pd(p, v);
+      }
+      
+      friend inline Pack operator+(Pack a, Pack b)
+      {
+        return Pack(_mm256_add_pd(a.v, b.v));
+      }
+      
+      friend inline Pack operator-(Pack a, Pack b)
+      {
+        return Pack(_mm256_sub_pd(a.v, b.v));
+      }
+      
+      friend inline Pack operator*(Pack a, Pack b)
+      {
+        return Pack(_mm256_mul_pd(a.v, b.v));
+      }
+      
+      friend inline Pack operator/(Pack a, Pack b)
+      {
+        return Pack(_mm256_div_pd(a.v, b.v));
+      }
+      
+      friend inline Pack operator-(Pack a)
+      {
+        return Pack(_mm256_xor_pd(a.v, _mm256_set1_pd(-0.0)));
+      }
+      
+      friend inline Pack& operator+=(Pack& a, Pack b)
+      {
+        return a = a + b;
+      }
+      
+      friend inline Pack& operator-=(Pack& a, Pack b)
+      {
+        return a = a - b;
+      }
+      
+      friend inline Pack& operator*=(Pack& a, Pack b)
+      {
+        return a = a * b;
+      }
+      
+      friend inline Pack& operator/=(Pack& a, Pack b)
+      {
+        return a = a / b;
+      }
+      
+      friend inline Mask operator<(Pack a, Pack b)
+      {
+        return Mask{_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)};
+      }
+      
+      friend inline Mask operator<=(Pack a, Pack b)
+      {
+        return Mask{_mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ)};
+      }
+      
+      friend inline Mask operator>(Pack a, Pack b)
+      {
+        return Mask{_mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ)};
+      }
+      
+      friend inline Mask operator>=(Pack a, Pack b)
+      {
+        return Mask{_mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ)};
+      }
+      
+      friend inline Mask operator==(Pack a, Pack b)
+      {
+        return Mask{_mm256_cmp_pd(a.v, b.v, _CMP_EQ_OQ)};
+      }
+      
+      friend inline Pack sqrt(Pack a)
+      {
+        return Pack(_mm256_sqrt_pd(a.v));
+      }
+      
+      friend inline Pack rsqrtEstimate(Pack a)
+      {
+        const __m256d estimate = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(a.v)));
+        const __m256d outside = _mm256_or_pd(_mm256_cmp_pd(a.v, _mm256_set1_pd(static_cast<double>(std::numeric_limits<float>::min())), _CMP_LT_OQ),
+                                             _mm256_cmp_pd(a.v, _mm256_set1_pd(static_cast<double>(std::numeric_limits<float>::max())), _CMP_GT_OQ));
+        if (_mm256_movemask_pd(outside) == 0)
+          return Pack(estimate);
+        const __m256d exact = _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_sqrt_pd(a.v));
+        return Pack(_mm256_blendv_pd(estimate, exact, outside));
+      }
+      
+      friend inline Pack abs(Pack a)
+      {
+        return Pack(_mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v));
+      }
+      
+      friend inline Pack min(Pack a, Pack b)
+      {
+        return Pack(_mm256_min_pd(a.v, b.v));
+      }
+      
+      friend inline Pack max(Pack a, Pack b)
+      {
+        return Pack(_mm256_max_pd(a.v, b.v));
+      }
+      
+      friend inline Pack select(Mask m, Pack a, Pack b)
+      {
+        return Pack(_mm256_blendv_pd(b.v, a.v, m.m));
+      }
+      
+      friend inline Pack madd(Pack a, Pack b, Pack c)
+      {
+#if defined(NEON_SIMD_FMA)
+        return Pack(_mm256_fmadd_pd(a.v, b.v, c.v));
+#else
+        return a * b + c;
+#endif
+      }
+    };
+#endif
+    
+    // Runs k.template run<P>(i) over [begin, end) with the widest pack, then finishes the tail one lane at a
+    // time. begin may be anywhere, such as the first triangle of a Bvh leaf, since Pack loads and stores are
+    // unaligned. Kernels that pack their per-element results into bit words (storeBits) are the exception:
+    // they need begin to be a multiple of Pack<T>::width, as it is for whole spans and for the chunks of the
+    // parallel overloads, so that one pack never straddles two words.
+    template <typename T, typename Kernel>
+    inline void forEachPack(std::size_t begin, std::size_t end, const Kernel& k)
+    {
+      const unsigned int width = Pack<T>::width;
+      const std::size_t body = end - (end - begin) % width;
+      std::size_t i = begin;
+      for (; i < body; i += width)
+        k.template run<Pack<T>>(i);
+      for (; i < end; i++)
+        k.template run<Pack<T, 1>>(i);
+    }
+    
+    template <typename T, typename Kernel>
+    inline void forEachPack(std::size_t count, const Kernel& k)
+    {
+      forEachPack<T>(0, count, k);
+    }
+  }
+  
+  /* Trigonometry */
+  
+  namespace Detail
+  {
+    // Minimax coefficients on [-pi/4, pi/4] (Cephes) and a three-part Cody-Waite split of pi/2.
+    template <typename T>
+    struct TrigConstants;
+    
+    template <>
+    struct TrigConstants<float>
+    {
+      static constexpr float twoOverPi = 0.636619772367581343f;
+      static constexpr float halfPi1 = 1.5703125f;
+      static constexpr float halfPi2 = 4.837512969970703125e-4f;
+      static constexpr float halfPi3 = 7.54978995489188216e-8f;
+      // Adding and subtracting this rounds to the nearest integer for |x| < 2^22.
+      static constexpr float roundMagic = 12582912.0f;
+      
+      template <typename P>
+      static inline P sin(P x, P x2)
+      {
+        return madd(madd(madd(P(-1.9515295891e-4f), x2, P(8.3321608736e-3f)), x2, P(-1.6666654611e-1f)), x2 * x, x);
+      }
+      
+      template <typename P>
+      static inline P cos(P x2)
+      {
+        const P p = madd(madd(P(2.443315711809948e-5f), x2, P(-1.388731625493765e-3f)), x2, P(4.166664568298827e-2f));
+        return madd(p, x2 * x2, madd(P(-0.5f), x2, P(1.0f)));
+      }
+    };
+    
+    template <>
+    struct TrigConstants<double>
+    {
+      static constexpr double twoOverPi = 0.636619772367581343075535053490057448;
+      static constexpr double halfPi1 = 1.57079625129699707031;
+      static constexpr double halfPi2 = 7.54978941586159635335e-8;
+      static constexpr double halfPi3 = 5.39030285815811905290e-15;
+      static constexpr double roundMagic = 6755399441055744.0;
+      
+      template <typename P>
+      static inline P sin(P x, P x2)
+      {
+        P p = madd(P(1.58962301576546568060e-10), x2, P(-2.50507477628578072866e-8));
+        p = madd(p, x2, P(2.75573136213857245213e-6));
+        p = madd(p, x2, P(-1.98412698295895385996e-4));
+        p = madd(p, x2, P(8.33333333332211858878e-3));
+        p = madd(p, x2, P(-1.66666666666666307295e-1));
+        return madd(p, x2 * x, x);
+      }
+      
+      template <typename P>
+      static inline P cos(P x2)
+      {
+        P p = madd(P(-1.13585365213876817300e-11), x2, P(2.08757008419747316778e-9));
+        p = madd(p, x2, P(-2.75573141792967388112e-7));
+        p = madd(p, x2, P(2.48015872888517045348e-5));
+        p = madd(p, x2, P(-1.38888888888730564116e-3));
+        p = madd(p, x2, P(4.16666666666665929218e-2));
+        return madd(p, x2 * x2, madd(P(-0.5), x2, P(1.0)));
+      }
+    };
+    
+    // Turns sin(r) and cos(r) into sin(x) and cos(x) for x = r + q * pi/2 by swapping and negating them
+    // according to q mod 4 = m: (s, c) is (sr, cr), (cr, -sr), (-sr, -cr) and (-cr, sr) for m = 0, 1, 2, 3.
+    template <typename P>
+    inline void applyQuadrant(P q, P sr, P cr, P& s, P& c)
+    {
+      const P magic(TrigConstants<typename P::Scalar>::roundMagic);
+      const P quarter = q * P(0.25f);
+      P f = (quarter + magic) - magic;
+      f = select(f > quarter, f - P(1), f);
+      const P m = madd(f, P(-4), q);
+      const typename P::Mask odd = abs(m - P(2)) == P(1);
+      const P s0 = select(odd, cr, sr);
+      const P c0 = select(odd, sr, cr);
+      s = select(m >= P(2), -s0, s0);
+      c = select(abs(m - P(1.5f)) < P(1), -c0, c0);
+    }
+    
+    // On scalars the selects above become unpredictable branches, so index with the integer quadrant instead.
+    // q is reduced mod 4 in floating point first: converting a huge q would overflow the integer, and an infinite
+    // or NaN q leaves m4 NaN, in which case sr and cr are NaN as well and any quadrant passes them through.
+    template <typename T>
+    inline void applyQuadrant(Pack<T, 1> q, Pack<T, 1> sr, Pack<T, 1> cr, Pack<T, 1>& s, Pack<T, 1>& c)
+    {
+      const T m4 = q.v - T(4) * std::floor(q.v * T(0.25));
+      const unsigned int m = m4 >= T(0) ? static_cast<unsigned int>(m4) : 0u;
+      const T v[2] = {sr.v, cr.v};
+      const T sign[2] = {1, -1};
+      s = v[m & 1u] * sign[m >> 1];
+      c = v[(m & 1u) ^ 1u] * sign[((m + 1u) >> 1) & 1u];
+    }
+    
+    // Polynomial sine and cosine on any pack: reduces x by the nearest multiple q of pi/2 and evaluates both
+    // polynomials on the remainder in [-pi/4, pi/4].
+    template <typename P>
+    inline void sinCosPoly(P x, P& s, P& c)
+    {
+      using C = TrigConstants<typename P::Scalar>;
+      const P magic(C::roundMagic);
+      const P q = (x * P(C::twoOverPi) + magic) - magic;
+      const P r = madd(q, P(-C::halfPi3), madd(q, P(-C::halfPi2), madd(q, P(-C::halfPi1), x)));
+      const P r2 = r * r;
+      applyQuadrant(q, C::sin(r, r2), C::cos(r2), s, c);
+    }
+    
+    template <typename T>
+    struct SinCos<T, Precision::Exact>
+    {
+      static inline void run(T x, T& s, T& c)
+      {
+        s = std::sin(x);
+        c = std::cos(x);
+      }
+    };
+    
+    template <typename T>
+    struct SinCos<T, Precision::Fast>
+    {
+      static inline void run(T x, T& s, T& c)
+      {
+        Pack<T, 1> ps;
+        Pack<T, 1> pc;
+        sinCosPoly(Pack<T, 1>(x), ps, pc);
+        s = ps.v;
+        c = pc.v;
+      }
+    };
+    
+    template <typename T, Precision Pr>
+    struct SinCosKernel
+    {
+      const T* x;
+      T* s;
+      T* c;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        for (unsigned int k = 0; k < P::width; k++)
+          SinCos<T, Pr>::run(x[i + k], s[i + k], c[i + k]);
+      }
+    };
+    
+    template <typename T>
+    struct SinCosKernel<T, Precision::Fast>
+    {
+      const T* x;
+      T* s;
+      T* c;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        P ps;
+        P pc;
+        sinCosPoly(P::load(x + i), ps, pc);
+        ps.store(s + i);
+        pc.store(c + i);
+      }
+    };
+  }
+  
+  template <typename T, Precision Pr = Precision::Exact>
+  inline void sinCos(T x, T& s, T& c)
+  {
+    Detail::SinCos<T, Pr>::run(x, s, c);
+  }
+  
+  // Element-wise sinCos of count angles. Precision::Fast evaluates Pack<T>::width angles at a time.
+  template <typename T, Precision Pr = Precision::Exact>
+  inline void sinCos(const T* x, T* s, T* c, std::size_t count)
+  {
+    Detail::forEachPack<T>(count, Detail::SinCosKernel<T, Pr>{x, s, c});
+  }
+  
+  /* Fast normalization */
+  
+  namespace Detail
+  {
+    // rsqrtEstimate followed by Steps Newton-Raphson iterations y' = y * (3 - x * y * y) / 2.
+    template <unsigned int Steps, typename P>
+    inline P rsqrtRefined(P x)
+    {
+      P y = rsqrtEstimate(x);
+      const P halfX = x * P(0.5f);
+      for (unsigned int k = 0; k < Steps; k++)
+        y = y * (P(1.5f) - halfX * y * y);
+      return y;
+    }
+  }
+  
+  // Approximate 1 / sqrt(x). The SSE/AVX estimate is good to about 12 bits and each Newton-Raphson step
+  // roughly doubles that: one step gives about 22 bits, two about 44. Without SIMD the estimate is exact, as it
+  // is for doubles outside the normal float range.
+  template <typename T, unsigned int Steps = 1>
+  inline T rsqrt(T x)
+  {
+    return Detail::rsqrtRefined<Steps>(Detail::Pack<T, 1>(x)).v;
+  }
+  
+  // v * rsqrt(dot(v, v)): one reciprocal square root and a multiply instead of a square root and a divide per
+  // component, at the precision of rsqrt<T, Steps>. A zero v gives NaNs; the overloads taking a fallback
+  // return it instead whenever dot(v, v) is zero or denormal.
+  template <typename T, unsigned int Steps = 1>
+  inline Vec2<T> normalizeFast(const Vec2<T>& v)
+  {
+    return Vec2<T>(v * rsqrt<T, Steps>(dot(v, v)));
+  }
+  
+  template <typename T, unsigned int Steps = 1>
+  inline Vec3<T> normalizeFast(const Vec3<T>& v)
+  {
+    return Vec3<T>(v * rsqrt<T, Steps>(dot(v, v)));
+  }
+  
+  template <typename T, unsigned int Steps = 1>
+  inline Vec4<T> normalizeFast(const Vec4<T>& v)
+  {
+    return Vec4<T>(v * rsqrt<T, Steps>(dot(v, v)));
+  }
+  
+  template <typename T, unsigned int Steps = 1>
+  inline Vec2<T> normalizeFast(const Vec2<T>& v, const Vec2<T>& fallback)
+  {
+    const T mag2 = dot(v, v);
+    return mag2 >= std::numeric_limits<T>::min() ? Vec2<T>(v * rsqrt<T, Steps>(mag2)) : fallback;
+  }
+  
+  template <typename T, unsigned int Steps = 1>
+  inline Vec3<T> normalizeFast(const Vec3<T>& v, const Vec3<T>& fallback)
+  {
+    const T mag2 = dot(v, v);
+    return mag2 >= std::numeric_limits<T>::min() ? Vec3<T>(v * rsqrt<T, Steps>(mag2)) : fallback;
+  }
+  
+  template <typename T, unsigned int Steps = 1>
+  inline Vec4<T> normalizeFast(const Vec4<T>& v, const Vec4<T>& fallback)
+  {
+    const T mag2 = dot(v, v);
+    return mag2 >= std::numeric_limits<T>::min() ? Vec4<T>(v * rsqrt<T, Steps>(mag2)) : fallback;
+  }
+  
+  /* Vector streams */
+  
+  namespace Detail
+  {
+    // Alignment of stream arrays; wide enough for aligned AVX loads.
+    const std::size_t kStreamAlignment = 32;
+    
+    inline void* alignedAlloc(std::size_t bytes, std::size_t alignment)
+    {
+      void* raw = std::malloc(bytes + alignment + sizeof(void*));
+      if (!raw)
+        throw std::bad_alloc();
+      const std::size_t address = reinterpret_cast<std::size_t>(raw) + sizeof(void*);
+      void* aligned = reinterpret_cast<void*>((address + alignment - 1) & ~(alignment - 1));
+      static_cast<void**>(aligned)[-1] = raw;
+      return aligned;
+    }
+    
+    inline void alignedFree(void* p)
+    {
+      if (p)
+        std::free(static_cast<void**>(p)[-1]);
+    }
+    
+    // N component arrays of T sharing one allocation. Each array starts on a kStreamAlignment boundary.
+    template <typename T, unsigned int N>
+    struct StreamStorage
+    {
+      explicit StreamStorage(std::size_t count = 0) : buffer(nullptr), count(0), stride(0)
+      {
+        resize(count);
+      }
+      
+      StreamStorage(const StreamStorage& other) : buffer(nullptr), count(0), stride(0)
+      {
+        resize(other.count);
+        for (unsigned int k = 0; k < N; k++)
+          std::copy(other.component(k), other.component(k) + count, component(k));
+      }
+      
+      StreamStorage(StreamStorage&& other) : buffer(other.buffer), count(other.count), stride(other.stride)
+      {
+        other.buffer = nullptr;
+        other.count = 0;
+        other.stride = 0;
+      }
+      
+      ~StreamStorage()
+      {
+        alignedFree(buffer);
+      }
+      
+      StreamStorage& operator=(const StreamStorage& other)
+      {
+        if (this != &other)
+        {
+          StreamStorage copy(other);
+          swap(copy);
+        }
+        return *this;
+      }
+      
+      StreamStorage& operator=(StreamStorage&& other)
+      {
+        if (this != &other)
+          swap(other);
+        return *this;
+      }
+      
+      inline std::size_t size() const
+      {
+        return count;
+      }
+      
+      // Keeps the first min(size(), newCount) elements; new elements are zero.
+      void resize(std::size_t newCount)
+      {
+        const std::size_t lanes = kStreamAlignment / sizeof(T);
+        const std::size_t newStride = (newCount + lanes - 1) / lanes * lanes;
+        if (newStride != stride)
+        {
+          T* newBuffer = newStride ? static_cast<T*>(alignedAlloc(newStride * N * sizeof(T), kStreamAlignment)) : nullptr;
+          const std::size_t kept = std::min(count, newCount);
+          for (unsigned int k = 0; k < N; k++)
+          {
+            std::copy(component(k), component(k) + kept, newBuffer + k * newStride);
+            std::fill(newBuffer + k * newStride + kept, newBuffer + (k + 1) * newStride, T(0));
+          }
+          alignedFree(buffer);
+          buffer = newBuffer;
+          stride = newStride;
+        }
+        else
+        {
+          for (unsigned int k = 0; k < N; k++)
+            std::fill(component(k) + std::min(count, newCount), component(k) + newCount, T(0));
+        }
+        count = newCount;
+      }
+      
+      inline T* component(unsigned int k)
+      {
+        return buffer + k * stride;
+      }
+      
+      inline const T* component(unsigned int k) const
+      {
+        return buffer + k * stride;
+      }
+      
+      void swap(StreamStorage& other)
+      {
+        std::swap(buffer, other.buffer);
+        std::swap(count, other.count);
+        std::swap(stride, other.stride);
+      }
+      
+    private:
+      T* buffer;
+      std::size_t count;
+      std::size_t stride;
+    };
+  }
+  
+  /* Vec3Stream */
+  // Structure-of-arrays counterpart of Vec3: x, y and z live in separate aligned arrays.
+  template <typename T>
+  struct Vec3Stream : Detail::StreamStorage<T, 3>
+  {
+    explicit Vec3Stream(std::size_t count = 0) : Detail::StreamStorage<T, 3>(count)
+    {
+    }
+    
+    Vec3Stream(const Vec3<T>* v, std::size_t count) : Detail::StreamStorage<T, 3>(count)
+    {
+      gather(v, count);
+    }
+    
+    inline T* x()
+    {
+      return this->component(0);
+    }
+    
+    inline T* y()
+    {
+      return this->component(1);
+    }
+    
+    inline T* z()
+    {
+      return this->component(2);
+    }
+    
+    inline const T* x() const
+    {
+      return this->component(0);
+    }
+    
+    inline const T* y() const
+    {
+      return this->component(1);
+    }
+    
+    inline const T* z() const
+    {
+      return this->component(2);
+    }
+    
+    inline Vec3<T> operator[](std::size_t i) const
+    {
+      return Vec3<T>{x()[i], y()[i], z()[i]};
+    }
+    
+    inline void set(std::size_t i, const Vec3<T>& v)
+    {
+      x()[i] = v.x;
+      y()[i] = v.y;
+      z()[i] = v.z;
+    }
+    
+    // AoS -> SoA. Resizes the stream to count.
+    void gather(const Vec3<T>* v, std::size_t count)
+    {
+      this->resize(count);
+      T* sx = x();
+      T* sy = y();
+      T* sz = z();
+      for (std::size_t i = 0; i < count; i++)
+      {
+        sx[i] = v[i].x;
+        sy[i] = v[i].y;
+        sz[i] = v[i].z;
+      }
+    }
+    
+    // SoA -> AoS. v must hold size() elements.
+    void scatter(Vec3<T>* v) const
+    {
+      const T* sx = x();
+      const T* sy = y();
+      const T* sz = z();
+      for (std::size_t i = 0; i < this->size(); i++)
+      {
+        v[i].x = sx[i];
+        v[i].y = sy[i];
+        v[i].z = sz[i];
+      }
+    }
+    
+    Vec3Stream<T>& operator+=(const Vec3Stream<T>& s);
+    Vec3Stream<T>& operator-=(const Vec3Stream<T>& s);
+    Vec3Stream<T>& operator*=(const Vec3Stream<T>& s);
+    Vec3Stream<T>& operator*=(const T t);
+  };
+  
+  /* Vec4Stream */
+  // Structure-of-arrays counterpart of Vec4: x, y, z and w live in separate aligned arrays.
+  template <typename T>
+  struct Vec4Stream : Detail::StreamStorage<T, 4>
+  {
+    explicit Vec4Stream(std::size_t count = 0) : Detail::StreamStorage<T, 4>(count)
+    {
+    }
+    
+    Vec4Stream(const Vec4<T>* v, std::size_t count) : Detail::StreamStorage<T, 4>(count)
+    {
+      gather(v, count);
+    }
+    
+    inline T* x()
+    {
+      return this->component(0);
+    }
+    
+    inline T* y()
+    {
+      return this->component(1);
+    }
+    
+    inline T* z()
+    {
+      return this->component(2);
+    }
+    
+    inline T* w()
+    {
+      return this->component(3);
+    }
+    
+    inline const T* x() const
+    {
+      return this->component(0);
+    }
+    
+    inline const T* y() const
+    {
+      return this->component(1);
+    }
+    
+    inline const T* z() const
+    {
+      return this->component(2);
+    }
+    
+    inline const T* w() const
+    {
+      return this->component(3);
+    }
+    
+    inline Vec4<T> operator[](std::size_t i) const
+    {
+      return Vec4<T>{x()[i], y()[i], z()[i], w()[i]};
+    }
+    
+    inline void set(std::size_t i, const Vec4<T>& v)
+    {
+      x()[i] = v.x;
+      y()[i] = v.y;
+      z()[i] = v.z;
+      w()[i] = v.w;
+    }
+    
+    // AoS -> SoA. Resizes the stream to count.
+    void gather(const Vec4<T>* v, std::size_t count)
+    {
+      this->resize(count);
+      T* sx = x();
+      T* sy = y();
+      T* sz = z();
+      T* sw = w();
+      for (std::size_t i = 0; i < count; i++)
+      {
+        sx[i] = v[i].x;
+        sy[i] = v[i].y;
+        sz[i] = v[i].z;
+        sw[i] = v[i].w;
+      }
+    }
+    
+    // SoA -> AoS. v must hold size() elements.
+    void scatter(Vec4<T>* v) const
+    {
+      const T* sx = x();
+      const T* sy = y();
+      const T* sz = z();
+      const T* sw = w();
+      for (std::size_t i = 0; i < this->size(); i++)
+      {
+        v[i].x = sx[i];
+        v[i].y = sy[i];
+        v[i].z = sz[i];
+        v[i].w = sw[i];
+      }
+    }
+    
+    Vec4Stream<T>& operator+=(const Vec4Stream<T>& s);
+    Vec4Stream<T>& operator-=(const Vec4Stream<T>& s);
+    Vec4Stream<T>& operator*=(const Vec4Stream<T>& s);
+    Vec4Stream<T>& operator*=(const T t);
+  };
+  
+  namespace Detail
+  {
+    template <typename P, typename T>
+    inline Vec3<P> streamLoad(const Vec3Stream<T>& s, std::size_t i)
+    {
+      return Vec3<P>{P::load(s.x() + i), P::load(s.y() + i), P::load(s.z() + i)};
+    }
+    
+    template <typename P, typename T>
+    inline Vec4<P> streamLoad(const Vec4Stream<T>& s, std::size_t i)
+    {
+      return Vec4<P>{P::load(s.x() + i), P::load(s.y() + i), P::load(s.z() + i), P::load(s.w() + i)};
+    }
+    
+    template <typename P, typename T>
+    inline void streamStore(Vec3Stream<T>& s, std::size_t i, const Vec3<P>& v)
+    {
+      v.x.store(s.x() + i);
+      v.y.store(s.y() + i);
+      v.z.store(s.z() + i);
+    }
+    
+    template <typename P, typename T>
+    inline void streamStore(Vec4Stream<T>& s, std::size_t i, const Vec4<P>& v)
+    {
+      v.x.store(s.x() + i);
+      v.y.store(s.y() + i);
+      v.z.store(s.z() + i);
+      v.w.store(s.w() + i);
+    }
+    
+    // Kernels run on one pack of stream elements; see forEachPack.
+    
+    template <typename S>
+    struct AddKernel
+    {
+      S& a;
+      const S& b;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        streamStore<P>(a, i, streamLoad<P>(a, i) + streamLoad<P>(b, i));
+      }
+    };
+    
+    template <typename S>
+    struct SubKernel
+    {
+      S& a;
+      const S& b;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        streamStore<P>(a, i, streamLoad<P>(a, i) - streamLoad<P>(b, i));
+      }
+    };
+    
+    template <typename S>
+    struct MulKernel
+    {
+      S& a;
+      const S& b;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        streamStore<P>(a, i, streamLoad<P>(a, i) * streamLoad<P>(b, i));
+      }
+    };
+    
+    template <typename S, typename T>
+    struct ScaleKernel
+    {
+      S& a;
+      T t;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        streamStore<P>(a, i, streamLoad<P>(a, i) * P(t));
+      }
+    };
+    
+    template <typename S, typename T>
+    struct DotKernel
+    {
+      const S& a;
+      const S& b;
+      T* out;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        dot(streamLoad<P>(a, i), streamLoad<P>(b, i)).store(out + i);
+      }
+    };
+    
+    template <typename S, typename T>
+    struct MagKernel
+    {
+      const S& a;
+      T* out;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        const auto v = streamLoad<P>(a, i);
+        sqrt(dot(v, v)).store(out + i);
+      }
+    };
+    
+    template <typename S, typename T>
+    struct DistanceKernel
+    {
+      const S& a;
+      const S& b;
+      T* out;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        auto v = streamLoad<P>(a, i);
+        v -= streamLoad<P>(b, i);
+        sqrt(dot(v, v)).store(out + i);
+      }
+    };
+    
+    template <typename S>
+    struct NormalizeKernel
+    {
+      const S& a;
+      S& out;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        const auto v = streamLoad<P>(a, i);
+        streamStore<P>(out, i, v * (P(1) / sqrt(dot(v, v))));
+      }
+    };
+    
+    template <typename P, typename T>
+    inline Vec3<P> broadcast(const Vec3<T>& v)
+    {
+      return Vec3<P>{P(v.x), P(v.y), P(v.z)};
+    }
+    
+    template <typename P, typename T>
+    inline Vec4<P> broadcast(const Vec4<T>& v)
+    {
+      return Vec4<P>{P(v.x), P(v.y), P(v.z), P(v.w)};
+    }
+    
+    template <typename P>
+    inline Vec3<P> select(typename P::Mask m, const Vec3<P>& a, const Vec3<P>& b)
+    {
+      return Vec3<P>{select(m, a.x, b.x), select(m, a.y, b.y), select(m, a.z, b.z)};
+    }
+    
+    template <typename P>
+    inline Vec4<P> select(typename P::Mask m, const Vec4<P>& a, const Vec4<P>& b)
+    {
+      return Vec4<P>{select(m, a.x, b.x), select(m, a.y, b.y), select(m, a.z, b.z), select(m, a.w, b.w)};
+    }
+    
+    template <typename S, unsigned int Steps>
+    struct NormalizeFastKernel
+    {
+      const S& a;
+      S& out;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        const auto v = streamLoad<P>(a, i);
+        streamStore<P>(out, i, v * rsqrtRefined<Steps>(dot(v, v)));
+      }
+    };
+    
+    template <typename S, typename V, unsigned int Steps>
+    struct NormalizeFastSafeKernel
+    {
+      const S& a;
+      const V& fallback;
+      S& out;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        using T = typename P::Scalar;
+        using VP = decltype(streamLoad<P>(a, i));
+        const VP v = streamLoad<P>(a, i);
+        const P mag2 = dot(v, v);
+        const VP normalized = v * rsqrtRefined<Steps>(mag2);
+        streamStore<P>(out, i, select(mag2 >= P(std::numeric_limits<T>::min()), normalized, broadcast<P>(fallback)));
+      }
+    };
+    
+    template <typename T>
+    struct CrossKernel
+    {
+      const Vec3Stream<T>& a;
+      const Vec3Stream<T>& b;
+      Vec3Stream<T>& out;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        streamStore<P>(out, i, cross(streamLoad<P>(a, i), streamLoad<P>(b, i)));
+      }
+    };
+    
+    template <typename T>
+    struct ProjectKernel
+    {
+      const Vec3Stream<T>& a;
+      const Vec3Stream<T>& b;
+      Vec3Stream<T>& out;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        const Vec3<P> v1 = streamLoad<P>(a, i);
+        const Vec3<P> v2 = streamLoad<P>(b, i);
+        streamStore<P>(out, i, (dot(v1, v2) / dot(v2, v2)) * v2);
+      }
+    };
+    
+    template <typename T>
+    struct ReflectKernel
+    {
+      const Vec3Stream<T>& v;
+      const Vec3Stream<T>& n;
+      Vec3Stream<T>& out;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        const Vec3<P> vi = streamLoad<P>(v, i);
+        const Vec3<P> ni = streamLoad<P>(n, i);
+        const Vec3<P> p = dot(vi, ni) / dot(ni, ni) * ni;
+        streamStore<P>(out, i, vi - P(2) * p);
+      }
+    };
+    
+    template <typename T>
+    struct RefractKernel
+    {
+      const Vec3Stream<T>& v;
+      const Vec3Stream<T>& n;
+      T eta;
+      Vec3Stream<T>& out;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        const Vec3<P> vi = streamLoad<P>(v, i);
+        const Vec3<P> ni = streamLoad<P>(n, i);
+        const P e(eta);
+        const P ctheta1 = dot(vi, ni);
+        const P ctheta2 = sqrt(P(1) - ((e * e) * (P(1) - ctheta1 * ctheta1)));
+        streamStore<P>(out, i, e * vi + (e * ctheta1 - ctheta2) * ni);
+      }
+    };
+    
+    template <typename T>
+    struct RotateKernel
+    {
+      const Vec3Stream<T>& v;
+      const Vec3<T>& n;
+      T cos;
+      T sin;
+      Vec3Stream<T>& out;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        const Vec3<P> vi = streamLoad<P>(v, i);
+        const Vec3<P> np{P(n.x), P(n.y), P(n.z)};
+        const Vec3<P> vproj = dot(vi, np) * np;
+        const Vec3<P> vrej = vi - vproj;
+        const Vec3<P> vcrossa = cross(np, vi);
+        streamStore<P>(out, i, vproj + vrej * P(cos) + vcrossa * P(sin));
+      }
+    };
+  }
+  
+  template <typename T>
+  inline Vec3Stream<T>& Vec3Stream<T>::operator+=(const Vec3Stream<T>& s)
+  {
+    Detail::forEachPack<T>(this->size(), Detail::AddKernel<Vec3Stream<T>>{*this, s});
+    return *this;
+  }
+  
+  template <typename T>
+  inline Vec3Stream<T>& Vec3Stream<T>::operator-=(const Vec3Stream<T>& s)
+  {
+    Detail::forEachPack<T>(this->size(), Detail::SubKernel<Vec3Stream<T>>{*this, s});
+    return *this;
+  }
+  
+  template <typename T>
+  inline Vec3Stream<T>& Vec3Stream<T>::operator*=(const Vec3Stream<T>& s)
+  {
+    Detail::forEachPack<T>(this->size(), Detail::MulKernel<Vec3Stream<T>>{*this, s});
+    return *this;
+  }
+  
+  template <typename T>
+  inline Vec3Stream<T>& Vec3Stream<T>::operator*=(const T t)
+  {
+    Detail::forEachPack<T>(this->size(), Detail::ScaleKernel<Vec3Stream<T>, T>{*this, t});
+    return *this;
+  }
+  
+  template <typename T>
+  inline Vec4Stream<T>& Vec4Stream<T>::operator+=(const Vec4Stream<T>& s)
+  {
+    Detail::forEachPack<T>(this->size(), Detail::AddKernel<Vec4Stream<T>>{*this, s});
+    return *this;
+  }
+  
+  template <typename T>
+  inline Vec4Stream<T>& Vec4Stream<T>::operator-=(const Vec4Stream<T>& s)
+  {
+    Detail::forEachPack<T>(this->size(), Detail::SubKernel<Vec4Stream<T>>{*this, s});
+    return *this;
+  }
+  
+  template <typename T>
+  inline Vec4Stream<T>& Vec4Stream<T>::operator*=(const Vec4Stream<T>& s)
+  {
+    Detail::forEachPack<T>(this->size(), Detail::MulKernel<Vec4Stream<T>>{*this, s});
+    return *this;
+  }
+  
+  template <typename T>
+  inline Vec4Stream<T>& Vec4Stream<T>::operator*=(const T t)
+  {
+    Detail::forEachPack<T>(this->size(), Detail::ScaleKernel<Vec4Stream<T>, T>{*this, t});
+    return *this;
+  }
+  
+  /* Common stream operations */
+  // Element-wise versions of the vector operations above. Binary operations expect streams of equal size;
+  // scalar results go to arrays of size() elements and vector results resize the output stream.
+  // Outputs may alias inputs.
+  
+  template <typename T>
+  inline void dot(const Vec3Stream<T>& a, const Vec3Stream<T>& b, T* out)
+  {
+    Detail::forEachPack<T>(a.size(), Detail::DotKernel<Vec3Stream<T>, T>{a, b, out});
+  }
+  
+  template <typename T>
+  inline void cross(const Vec3Stream<T>& a, const Vec3Stream<T>& b, Vec3Stream<T>& out)
+  {
+    out.resize(a.size());
+    Detail::forEachPack<T>(a.size(), Detail::CrossKernel<T>{a, b, out});
+  }
+  
+  template <typename T>
+  inline void mag(const Vec3Stream<T>& a, T* out)
+  {
+    Detail::forEachPack<T>(a.size(), Detail::MagKernel<Vec3Stream<T>, T>{a, out});
+  }
+  
+  template <typename T>
+  inline void distance(const Vec3Stream<T>& a, const Vec3Stream<T>& b, T* out)
+  {
+    Detail::forEachPack<T>(a.size(), Detail::DistanceKernel<Vec3Stream<T>, T>{a, b, out});
+  }
+  
+  template <typename T>
+  inline void normalize(const Vec3Stream<T>& a, Vec3Stream<T>& out)
+  {
+    out.resize(a.size());
+    Detail::forEachPack<T>(a.size(), Detail::NormalizeKernel<Vec3Stream<T>>{a, out});
+  }
+  
+  template <typename T, unsigned int Steps = 1>
+  inline void normalizeFast(const Vec3Stream<T>& a, Vec3Stream<T>& out)
+  {
+    out.resize(a.size());
+    Detail::forEachPack<T>(a.size(), Detail::NormalizeFastKernel<Vec3Stream<T>, Steps>{a, out});
+  }
+  
+  template <typename T, unsigned int Steps = 1>
+  inline void normalizeFast(const Vec3Stream<T>& a, const Vec3<T>& fallback, Vec3Stream<T>& out)
+  {
+    out.resize(a.size());
+    Detail::forEachPack<T>(a.size(), Detail::NormalizeFastSafeKernel<Vec3Stream<T>, Vec3<T>, Steps>{a, fallback, out});
+  }
+  
+  template <typename T>
+  inline void project(const Vec3Stream<T>& a, const Vec3Stream<T>& b, Vec3Stream<T>& out)
+  {
+    out.resize(a.size());
+    Detail::forEachPack<T>(a.size(), Detail::ProjectKernel<T>{a, b, out});
+  }
+  
+  template <typename T>
+  inline void reflect(const Vec3Stream<T>& v, const Vec3Stream<T>& n, Vec3Stream<T>& out)
+  {
+    out.resize(v.size());
+    Detail::forEachPack<T>(v.size(), Detail::ReflectKernel<T>{v, n, out});
+  }
+  
+  template <typename T>
+  inline void refract(const Vec3Stream<T>& v, const Vec3Stream<T>& n, T eta, Vec3Stream<T>& out)
+  {
+    out.resize(v.size());
+    Detail::forEachPack<T>(v.size(), Detail::RefractKernel<T>{v, n, eta, out});
+  }
+  
+  // Rotates every vector about the same axis n by theta. Right-Handed.
+  template <typename T, Precision Pr = Precision::Exact>
+  inline void rotate(const Vec3Stream<T>& v, const Vec3<T>& n, T theta, Vec3Stream<T>& out)
+  {
+    T sin;
+    T cos;
+    sinCos<T, Pr>(theta, sin, cos);
+    out.resize(v.size());
+    Detail::forEachPack<T>(v.size(), Detail::RotateKernel<T>{v, n, cos, sin, out});
+  }
+  
+  template <typename T>
+  inline void dot(const Vec4Stream<T>& a, const Vec4Stream<T>& b, T* out)
+  {
+    Detail::forEachPack<T>(a.size(), Detail::DotKernel<Vec4Stream<T>, T>{a, b, out});
+  }
+  
+  template <typename T>
+  inline void mag(const Vec4Stream<T>& a, T* out)
+  {
+    Detail::forEachPack<T>(a.size(), Detail::MagKernel<Vec4Stream<T>, T>{a, out});
+  }
+  
+  template <typename T>
+  inline void normalize(const Vec4Stream<T>& a, Vec4Stream<T>& out)
+  {
+    out.resize(a.size());
+    Detail::forEachPack<T>(a.size(), Detail::NormalizeKernel<Vec4Stream<T>>{a, out});
+  }
+  
+  template <typename T, unsigned int Steps = 1>
+  inline void normalizeFast(const Vec4Stream<T>& a, Vec4Stream<T>& out)
+  {
+    out.resize(a.size());
+    Detail::forEachPack<T>(a.size(), Detail::NormalizeFastKernel<Vec4Stream<T>, Steps>{a, out});
+  }
+  
+  template <typename T, unsigned int Steps = 1>
+  inline void normalizeFast(const Vec4Stream<T>& a, const Vec4<T>& fallback, Vec4Stream<T>& out)
+  {
+    out.resize(a.size());
+    Detail::forEachPack<T>(a.size(), Detail::NormalizeFastSafeKernel<Vec4Stream<T>, Vec4<T>, Steps>{a, fallback, out});
+  }
+  
+  /* Mat2 */
+  template <typename T>
+  struct Mat<T, 2, 2>
+  {
+    static const unsigned short size = 2;
+    T d[2][2];
+  
+    constexpr explicit Mat(T t = 1)
+      : d{{t, 0},
+          {0, t}}
+    {
+    }
+    
+    constexpr Mat(const Vec2<T>& col1, const Vec2<T>& col2)
+      : d{{col1.x, col1.y},
+          {col2.x, col2.y}}
+    {
+    }
+    
+    constexpr Mat(T col1x, T col2x,
+                  T col1y, T col2y)
+      : d{{col1x, col1y},
+          {col2x, col2y}}
+    {
+    }
+    
+    inline Vec2<T>& operator[](unsigned int col)
+    {
+      return *reinterpret_cast<Vec2<T>*>(d[col]);
+    }
+    
+    inline const Vec2<T>& operator[](unsigned int col) const
+    {
+      return *reinterpret_cast<const Vec2<T>*>(d[col]);
+    }
+    
+    inline T& operator()(unsigned int row, unsigned int col)
+    {
+      return d[col][row];
+    }
+    
+    inline const T& operator()(unsigned int row, unsigned int col) const
+    {
+      return d[col][row];
+    }
+    
+    NEON_CONSTEXPR14 Mat2<T>& operator+=(const Mat2<T>& m)
+    {
+      d[0][0] += m.d[0][0]; d[1][0] += m.d[1][0];
+      d[0][1] += m.d[0][1]; d[1][1] += m.d[1][1];
+      return *this;
+    }
+    
+    NEON_CONSTEXPR14 Mat2<T>& operator-=(const Mat2<T>& m)
+    {
+      d[0][0] -= m.d[0][0]; d[1][0] -= m.d[1][0];
+      d[0][1] -= m.d[0][1]; d[1][1] -= m.d[1][1];
+      return *this;
+    }
+    
+    NEON_CONSTEXPR14 Mat2<T>& operator*=(const T t)
+    {
+      d[0][0] *= t; d[1][0] *= t;
+      d[0][1] *= t; d[1][1] *= t;
+      return *this;
+    }
+    
+    constexpr Vec2<T> operator*(const Vec2<T>& v) const
+    {
+      return Vec2<T>(d[0][0] * v.x + d[1][0] * v.y,
+                     d[0][1] * v.x + d[1][1] * v.y);
+    }
+    
+    friend NEON_CONSTEXPR14 Mat2<T> operator*(const Mat2<T>& lhs, const Mat2<T>& rhs)
+    {
+      const T v1x = lhs.d[0][0] * rhs.d[0][0] + lhs.d[1][0] * rhs.d[0][1];
+      const T v2x = lhs.d[0][0] * rhs.d[1][0] + lhs.d[1][0] * rhs.d[1][1];
+      const T v1y = lhs.d[0][1] * rhs.d[0][0] + lhs.d[1][1] * rhs.d[0][1];
+      const T v2y = lhs.d[0][1] * rhs.d[1][0] + lhs.d[1][1] * rhs.d[1][1];
+      return Mat2<T>(v1x, v2x,
+                     v1y, v2y);
+    }
+    
+    friend constexpr Mat2<T> operator/(const T t, const Mat2<T>& m)
+    {
+      return m * t;
+    }
+    
+    NEON_CONSTEXPR14 Mat2<T>& operator/=(const T t)
+    {
+      const T d = 1 / t;
+      return *this *= d;
+    }
+    
+#if !defined(NEON_EXPR_TEMPLATES)
+    friend constexpr Mat2<T> operator+(const Mat2<T>& lhs, const Mat2<T>& rhs)
+    {
+      return Mat2<T>{lhs.d[0][0] + rhs.d[0][0], lhs.d[1][0] + rhs.d[1][0],
+                     lhs.d[0][1] + rhs.d[0][1], lhs.d[1][1] + rhs.d[1][1]};
+    }
+    
+    constexpr Mat2<T> operator-() const
+    {
+      return Mat2<T>(-d[0][0], -d[1][0],
+                     -d[0][1], -d[1][1]);
+    }
+    
+    friend constexpr Mat2<T> operator-(const Mat2<T>& lhs, const Mat2<T>& rhs)
+    {
+      return Mat2<T>{lhs.d[0][0] - rhs.d[0][0], lhs.d[1][0] - rhs.d[1][0],
+                     lhs.d[0][1] - rhs.d[0][1], lhs.d[1][1] - rhs.d[1][1]};
+    }
+    
+    constexpr Mat2<T> operator*(const T t) const
+    {
+      return Mat2<T>(d[0][0] * t, d[1][0] * t,
+                     d[0][1] * t, d[1][1] * t);
+    }
+    
+    friend constexpr Mat2<T> operator*(const T t, const Mat2<T>& m)
+    {
+      return m * t;
+    }
+    
+    constexpr Mat2<T> operator/(const T t) const
+    {
+      return *this * (1 / t);
+    }
+#else
+    template <typename E, typename = typename std::enable_if<Detail::IsExprOf<E, Mat2<T>>::value>::type>
+    Mat(const E& e)
+    {
+      *this = e;
+    }
+    
+    template <typename E>
+    typename std::enable_if<Detail::IsExprOf<E, Mat2<T>>::value, Mat2<T>&>::type operator=(const E& e)
+    {
+      for (unsigned int i = 0; i < 4; i++)
+        d[i / 2][i % 2] = element(e, i);
+      return *this;
+    }
+#endif
+    
+    inline T* data()
+    {
+      return d[0];
+    }
+  };
+  
+  /* Mat3 */
+  template <typename T>
+  struct Mat<T, 3, 3>
+  {
+    static const unsigned short size = 3;
+    T d[3][3];
+    
+    constexpr explicit Mat(T t = 1)
+      : d{{t, 0, 0},
+          {0, t, 0},
+          {0, 0, t}}
+    {
+    }
+    
+    constexpr Mat(const Vec3<T>& col1, const Vec3<T>& col2, const Vec3<T>& col3)
+      : d{{col1.x, col1.y, col1.z},
+          {col2.x, col2.y, col2.z},
+          {col3.x, col3.y, col3.z}}
+    {
+    }
+    
+    constexpr Mat(T col1x, T col2x, T col3x,
+                  T col1y, T col2y, T col3y,
+                  T col1z, T col2z, T col3z)
+      : d{{col1x, col1y, col1z},
+          {col2x, col2y, col2z},
+          {col3x, col3y, col3z}}
+    {
+    }
+    
+    constexpr Mat(const Mat2<T>& other)
+      : d{{other.d[0][0], other.d[0][1], 0},
+          {other.d[1][0], other.d[1][1], 0},
+          {0,             0,             0}}
+    {
+    }
+    
+    // The upper-left 3x3 of a Mat4: its linear part when it is an affine transform.
+    constexpr explicit Mat(const Mat<T, 4, 4>& other)
+      : d{{other.d[0][0], other.d[0][1], other.d[0][2]},
+          {other.d[1][0], other.d[1][1], other.d[1][2]},
+          {other.d[2][0], other.d[2][1], other.d[2][2]}}
+    {
+    }
+    
+    inline Vec3<T>& operator[](unsigned int col)
+    {
+      return *reinterpret_cast<Vec3<T>*>(d[col]);
+    }
+    
+    inline const Vec3<T>& operator[](unsigned int col) const
+    {
+      return *reinterpret_cast<const Vec3<T>*>(d[col]);
+    }
+    
+    inline T& operator()(unsigned int row, unsigned int col)
+    {
+      return d[col][row];
+    }
+    
+    inline const T& operator()(unsigned int row, unsigned int col) const
+    {
+      return d[col][row];
+    }
+    
+    NEON_CONSTEXPR14 Mat3<T>& operator+=(const Mat3<T>& m)
+    {
+      d[0][0] += m.d[0][0]; d[1][0] += m.d[1][0]; d[2][0] += m.d[2][0];
+      d[0][1] += m.d[0][1]; d[1][1] += m.d[1][1]; d[2][1] += m.d[2][1];
+      d[0][2] += m.d[0][2]; d[1][2] += m.d[1][2]; d[2][2] += m.d[2][2];
+      return *this;
+    }
+    
+    NEON_CONSTEXPR14 Mat3<T>& operator-=(const Mat3<T>& m)
+    {
+      d[0][0] -= m.d[0][0]; d[1][0] -= m.d[1][0]; d[2][0] -= m.d[2][0];
+      d[0][1] -= m.d[0][1]; d[1][1] -= m.d[1][1]; d[2][1] -= m.d[2][1];
+      d[0][2] -= m.d[0][2]; d[1][2] -= m.d[1][2]; d[2][2] -= m.d[2][2];
+      return *this;
+    }
+    
+    NEON_CONSTEXPR14 Mat3<T>& operator*=(const T t)
+    {
+      d[0][0] *= t; d[1][0] *= t; d[2][0] *= t;
+      d[0][1] *= t; d[1][1] *= t; d[2][1] *= t;
+      d[0][2] *= t; d[1][2] *= t; d[2][2] *= t;
+      return *this;
+    }
+    
+    constexpr Vec3<T> operator*(const Vec3<T>& v) const
+    {
+      return Vec3<T>(d[0][0] * v.x + d[1][0] * v.y + d[2][0] * v.z,
+                     d[0][1] * v.x + d[1][1] * v.y + d[2][1] * v.z,
+                     d[0][2] * v.x + d[1][2] * v.y + d[2][2] * v.z);
+    }
+    
+    friend NEON_CONSTEXPR14 Mat3<T> operator*(const Mat3<T>& lhs, const Mat3<T>& rhs)
+    {
+      const T v1x = lhs.d[0][0] * rhs.d[0][0] + lhs.d[1][0] * rhs.d[0][1] + lhs.d[2][0] * rhs.d[0][2];
+      const T v2x = lhs.d[0][0] * rhs.d[1][0] + lhs.d[1][0] * rhs.d[1][1] + lhs.d[2][0] * rhs.d[1][2];
+      const T v3x = lhs.d[0][0] * rhs.d[2][0] + lhs.d[1][0] * rhs.d[2][1] + lhs.d[2][0] * rhs.d[2][2];
+      const T v1y = lhs.d[0][1] * rhs.d[0][0] + lhs.d[1][1] * rhs.d[0][1] + lhs.d[2][1] * rhs.d[0][2];
+      const T v2y = lhs.d[0][1] * rhs.d[1][0] + lhs.d[1][1] * rhs.d[1][1] + lhs.d[2][1] * rhs.d[1][2];
+      const T v3y = lhs.d[0][1] * rhs.d[2][0] + lhs.d[1][1] * rhs.d[2][1] + lhs.d[2][1] * rhs.d[2][2];
+      const T v1z = lhs.d[0][2] * rhs.d[0][0] + lhs.d[1][2] * rhs.d[0][1] + lhs.d[2][2] * rhs.d[0][2];
+      const T v2z = lhs.d[0][2] * rhs.d[1][0] + lhs.d[1][2] * rhs.d[1][1] + lhs.d[2][2] * rhs.d[1][2];
+      const T v3z = lhs.d[0][2] * rhs.d[2][0] + lhs.d[1][2] * rhs.d[2][1] + lhs.d[2][2] * rhs.d[2][2];
+      return Mat3<T>{v1x, v2x, v3x,
+                     v1y, v2y, v3y,
+                     v1z, v2z, v3z};
+    }
+    
+    friend constexpr Mat3<T> operator/(const T t, const Mat3<T>& m)
+    {
+      return m * t;
+    }
+    
+    NEON_CONSTEXPR14 Mat3<T>& operator/=(const T t)
+    {
+      const T d = 1 / t;
+      return *this *= d;
+    }
+    
+#if !defined(NEON_EXPR_TEMPLATES)
+    friend constexpr Mat3<T> operator+(const Mat3<T>& lhs, const Mat3<T>& rhs)
+    {
+      return Mat3<T>{lhs.d[0][0] + rhs.d[0][0], lhs.d[1][0] + rhs.d[1][0], lhs.d[2][0] + rhs.d[2][0],
+                     lhs.d[0][1] + rhs.d[0][1], lhs.d[1][1] + rhs.d[1][1], lhs.d[2][1] + rhs.d[2][1],
+                     lhs.d[0][2] + rhs.d[0][2], lhs.d[1][2] + rhs.d[1][2], lhs.d[2][2] + rhs.d[2][2]};
+    }
+    
+    constexpr Mat3<T> operator-() const
+    {
+      return Mat3<T>(-d[0][0], -d[1][0], -d[2][0],
+                     -d[0][1], -d[1][1], -d[2][1],
+                     -d[0][2], -d[1][2], -d[2][2]);
+    }
+    
+    friend constexpr Mat3<T> operator-(const Mat3<T>& lhs, const Mat3<T>& rhs)
+    {
+      return Mat3<T>{lhs.d[0][0] - rhs.d[0][0], lhs.d[1][0] - rhs.d[1][0], lhs.d[2][0] - rhs.d[2][0],
+                     lhs.d[0][1] - rhs.d[0][1], lhs.d[1][1] - rhs.d[1][1], lhs.d[2][1] - rhs.d[2][1],
+                     lhs.d[0][2] - rhs.d[0][2], lhs.d[1][2] - rhs.d[1][2], lhs.d[2][2] - rhs.d[2][2]};
+    }
+    
+    constexpr Mat3<T> operator*(const T t) const
+    {
+      return Mat3<T>(d[0][0] * t, d[1][0] * t, d[2][0] * t,
+                     d[0][1] * t, d[1][1] * t, d[2][1] * t,
+                     d[0][2] * t, d[1][2] * t, d[2][2] * t);
+    }
+    
+    friend constexpr Mat3<T> operator*(const T t, const Mat3<T>& m)
+    {
+      return m * t;
+    }
+    
+    constexpr Mat3<T> operator/(const T t) const
+    {
+      return *this * (1 / t);
+    }
+#else
+    template <typename E, typename = typename std::enable_if<Detail::IsExprOf<E, Mat3<T>>::value>::type>
+    Mat(const E& e)
+    {
+      *this = e;
+    }
+    
+    template <typename E>
+    typename std::enable_if<Detail::IsExprOf<E, Mat3<T>>::value, Mat3<T>&>::type operator=(const E& e)
+    {
+      for (unsigned int i = 0; i < 9; i++)
+        d[i / 3][i % 3] = element(e, i);
+      return *this;
+    }
+#endif
+    
+    inline T* data()
+    {
+      return d[0];
+    }
+  };
+  
+  /* SIMD kernels */
+  
+  namespace Detail
+  {
+    // Column-major 4x4 product: out = a * b. out may alias a or b.
+    template <typename T>
+    inline void mat4Mul(const T (&a)[4][4], const T (&b)[4][4], T (&out)[4][4])
+    {
+      const T v1x = a[0][0] * b[0][0] + a[1][0] * b[0][1] + a[2][0] * b[0][2] + a[3][0] * b[0][3];
+      const T v2x = a[0][0] * b[1][0] + a[1][0] * b[1][1] + a[2][0] * b[1][2] + a[3][0] * b[1][3];
+      const T v3x = a[0][0] * b[2][0] + a[1][0] * b[2][1] + a[2][0] * b[2][2] + a[3][0] * b[2][3];
+      const T v4x = a[0][0] * b[3][0] + a[1][0] * b[3][1] + a[2][0] * b[3][2] + a[3][0] * b[3][3];
+      const T v1y = a[0][1] * b[0][0] + a[1][1] * b[0][1] + a[2][1] * b[0][2] + a[3][1] * b[0][3];
+      const T v2y = a[0][1] * b[1][0] + a[1][1] * b[1][1] + a[2][1] * b[1][2] + a[3][1] * b[1][3];
+      const T v3y = a[0][1] * b[2][0] + a[1][1] * b[2][1] + a[2][1] * b[2][2] + a[3][1] * b[2][3];
+      const T v4y = a[0][1] * b[3][0] + a[1][1] * b[3][1] + a[2][1] * b[3][2] + a[3][1] * b[3][3];
+      const T v1z = a[0][2] * b[0][0] + a[1][2] * b[0][1] + a[2][2] * b[0][2] + a[3][2] * b[0][3];
+      const T v2z = a[0][2] * b[1][0] + a[1][2] * b[1][1] + a[2][2] * b[1][2] + a[3][2] * b[1][3];
+      const T v3z = a[0][2] * b[2][0] + a[1][2] * b[2][1] + a[2][2] * b[2][2] + a[3][2] * b[2][3];
+      const T v4z = a[0][2] * b[3][0] + a[1][2] * b[3][1] + a[2][2] * b[3][2] + a[3][2] * b[3][3];
+      const T v1w = a[0][3] * b[0][0] + a[1][3] * b[0][1] + a[2][3] * b[0][2] + a[3][3] * b[0][3];
+      const T v2w = a[0][3] * b[1][0] + a[1][3] * b[1][1] + a[2][3] * b[1][2] + a[3][3] * b[1][3];
+      const T v3w = a[0][3] * b[2][0] + a[1][3] * b[2][1] + a[2][3] * b[2][2] + a[3][3] * b[2][3];
+      const T v4w = a[0][3] * b[3][0] + a[1][3] * b[3][1] + a[2][3] * b[3][2] + a[3][3] * b[3][3];
+      out[0][0] = v1x; out[0][1] = v1y; out[0][2] = v1z; out[0][3] = v1w;
+      out[1][0] = v2x; out[1][1] = v2y; out[1][2] = v2z; out[1][3] = v2w;
+      out[2][0] = v3x; out[2][1] = v3y; out[2][2] = v3z; out[2][3] = v3w;
+      out[3][0] = v4x; out[3][1] = v4y; out[3][2] = v4z; out[3][3] = v4w;
+    }
+    
+    // Column-major 3x4 affine product: out = a * b with implicit last rows (0, 0, 0, 1). out may alias a or b.
+    template <typename T>
+    inline void affineMul(const T (&a)[4][3], const T (&b)[4][3], T (&out)[4][3])
+    {
+      T r[4][3];
+      for (unsigned int j = 0; j < 4; j++)
+      {
+        for (unsigned int i = 0; i < 3; i++)
+          r[j][i] = a[0][i] * b[j][0] + a[1][i] * b[j][1] + a[2][i] * b[j][2];
+      }
+      r[3][0] += a[3][0];
+      r[3][1] += a[3][1];
+      r[3][2] += a[3][2];
+      std::copy(r[0], r[0] + 12, out[0]);
+    }
+    
+    // out = m * v, where v and out point to four contiguous components. out may alias v.
+    template <typename T>
+    inline void mat4MulVec4(const T (&m)[4][4], const T* v, T* out)
+    {
+      const T x = v[0];
+      const T y = v[1];
+      const T z = v[2];
+      const T w = v[3];
+      out[0] = m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0] * w;
+      out[1] = m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1] * w;
+      out[2] = m[0][2] * x + m[1][2] * y + m[2][2] * z + m[3][2] * w;
+      out[3] = m[0][3] * x + m[1][3] * y + m[2][3] * z + m[3][3] * w;
+    }
+    
+#if defined(NEON_SIMD_SSE2)
+    // Broadcast-multiply-add of the columns of m by the four components of v.
+    inline __m128 mat4MulColumn(const __m128 (&m)[4], const float* v)
+    {
+      __m128 r = _mm_mul_ps(m[0], _mm_set1_ps(v[0]));
+      r = madd(m[1], _mm_set1_ps(v[1]), r);
+      r = madd(m[2], _mm_set1_ps(v[2]), r);
+      return madd(m[3], _mm_set1_ps(v[3]), r);
+    }
+    
+    inline void mat4Mul(const float (&a)[4][4], const float (&b)[4][4], float (&out)[4][4])
+    {
+      const __m128 ac[4] = {_mm_loadu_ps(a[0]), _mm_loadu_ps(a[1]), _mm_loadu_ps(a[2]), _mm_loadu_ps(a[3])};
+#if defined(NEON_SIMD_AVX)
+      // Two result columns per iteration: each 128-bit lane holds one column.
+      const __m256 ac0 = _mm256_insertf128_ps(_mm256_castps128_ps256(ac[0]), ac[0], 1);
+      const __m256 ac1 = _mm256_insertf128_ps(_mm256_castps128_ps256(ac[1]), ac[1], 1);
+      const __m256 ac2 = _mm256_insertf128_ps(_mm256_castps128_ps256(ac[2]), ac[2], 1);
+      const __m256 ac3 = _mm256_insertf128_ps(_mm256_castps128_ps256(ac[3]), ac[3], 1);
+      for (unsigned int j = 0; j < 4; j += 2)
+      {
+        const __m256 bc = _mm256_loadu_ps(b[j]);
+        __m256 r = _mm256_mul_ps(ac0, _mm256_permute_ps(bc, 0x00));
+#if defined(NEON_SIMD_FMA)
+        r = _mm256_fmadd_ps(ac1, _mm256_permute_ps(bc, 0x55), r);
+        r = _mm256_fmadd_ps(ac2, _mm256_permute_ps(bc, 0xAA), r);
+        r = _mm256_fmadd_ps(ac3, _mm256_permute_ps(bc, 0xFF), r);
+#else
+        r = _mm256_add_ps(_mm256_mul_ps(ac1, _mm256_permute_ps(bc, 0x55)), r);
+        r = _mm256_add_ps(_mm256_mul_ps(ac2, _mm256_permute_ps(bc, 0xAA)), r);
+        r = _mm256_add_ps(_mm256_mul_ps(ac3, _mm256_permute_ps(bc, 0xFF)), r);
+#endif
+        _mm256_storeu_ps(out[j], r);
+      }
+#else
+      for (unsigned int j = 0; j < 4; j++)
+        _mm_storeu_ps(out[j], mat4MulColumn(ac, b[j]));
+#endif
+    }
+    
+    // The twelve floats are read as overlapping 4-wide loads that stay in bounds; lane 3 of each column is garbage.
+    inline void affineMul(const float (&a)[4][3], const float (&b)[4][3], float (&out)[4][3])
+    {
+      const float* af = a[0];
+      const float* bf = b[0];
+      const __m128 ac[4] = {_mm_loadu_ps(af), _mm_loadu_ps(af + 3), _mm_loadu_ps(af + 6),
+                            _mm_shuffle_ps(_mm_loadu_ps(af + 8), _mm_loadu_ps(af + 8), _MM_SHUFFLE(3, 3, 2, 1))};
+      __m128 r[4];
+      for (unsigned int j = 0; j < 4; j++)
+      {
+        const float* bj = bf + 3 * j;
+        r[j] = madd(ac[2], _mm_set1_ps(bj[2]), madd(ac[1], _mm_set1_ps(bj[1]), _mm_mul_ps(ac[0], _mm_set1_ps(bj[0]))));
+      }
+      r[3] = _mm_add_ps(r[3], ac[3]);
+      float* of = out[0];
+      _mm_storeu_ps(of, r[0]);
+      _mm_storeu_ps(of + 3, r[1]);
+      _mm_storeu_ps(of + 6, r[2]);
+      const __m128 tail = _mm_shuffle_ps(r[2], r[3], _MM_SHUFFLE(0, 0, 2, 2));
+      _mm_storeu_ps(of + 8, _mm_shuffle_ps(tail, r[3], _MM_SHUFFLE(2, 1, 2, 0)));
+    }
+    
+    inline void mat4MulVec4(const float (&m)[4][4], const float* v, float* out)
+    {
+      const __m128 mc[4] = {_mm_loadu_ps(m[0]), _mm_loadu_ps(m[1]), _mm_loadu_ps(m[2]), _mm_loadu_ps(m[3])};
+      _mm_storeu_ps(out, mat4MulColumn(mc, v));
+    }
+    
+#if defined(NEON_SIMD_AVX)
+    inline __m256d mat4MulColumn(const __m256d (&m)[4], const double* v)
+    {
+      __m256d r = _mm256_mul_pd(m[0], _mm256_broadcast_sd(v));
+#if defined(NEON_SIMD_FMA)
+      r = _mm256_fmadd_pd(m[1], _mm256_broadcast_sd(v + 1), r);
+      r = _mm256_fmadd_pd(m[2], _mm256_broadcast_sd(v + 2), r);
+      return _mm256_fmadd_pd(m[3], _mm256_broadcast_sd(v + 3), r);
+#else
+      r = _mm256_add_pd(_mm256_mul_pd(m[1], _mm256_broadcast_sd(v + 1)), r);
+      r = _mm256_add_pd(_mm256_mul_pd(m[2], _mm256_broadcast_sd(v + 2)), r);
+      return _mm256_add_pd(_mm256_mul_pd(m[3], _mm256_broadcast_sd(v + 3)), r);
+#endif
+    }
+    
+    inline void mat4Mul(const double (&a)[4][4], const double (&b)[4][4], double (&out)[4][4])
+    {
+      const __m256d ac[4] = {_mm256_loadu_pd(a[0]), _mm256_loadu_pd(a[1]), _mm256_loadu_pd(a[2]), _mm256_loadu_pd(a[3])};
+      for (unsigned int j = 0; j < 4; j++)
+        _mm256_storeu_pd(out[j], mat4MulColumn(ac, b[j]));
+    }
+    
+    inline void mat4MulVec4(const double (&m)[4][4], const double* v, double* out)
+    {
+      const __m256d mc[4] = {_mm256_loadu_pd(m[0]), _mm256_loadu_pd(m[1]), _mm256_loadu_pd(m[2]), _mm256_loadu_pd(m[3])};
+      _mm256_storeu_pd(out, mat4MulColumn(mc, v));
+    }
+#else
+    // SSE2 splits each column into its xy and zw halves.
+    inline void mat4MulColumn(const __m128d (&lo)[4], const __m128d (&hi)[4], const double* v, double* out)
+    {
+      const __m128d vx = _mm_set1_pd(v[0]);
+      const __m128d vy = _mm_set1_pd(v[1]);
+      const __m128d vz = _mm_set1_pd(v[2]);
+      const __m128d vw = _mm_set1_pd(v[3]);
+      const __m128d rlo = madd(lo[3], vw, madd(lo[2], vz, madd(lo[1], vy, _mm_mul_pd(lo[0], vx))));
+      const __m128d rhi = madd(hi[3], vw, madd(hi[2], vz, madd(hi[1], vy, _mm_mul_pd(hi[0], vx))));
+      _mm_storeu_pd(out, rlo);
+      _mm_storeu_pd(out + 2, rhi);
+    }
+    
+    inline void mat4Mul(const double (&a)[4][4], const double (&b)[4][4], double (&out)[4][4])
+    {
+      const __m128d lo[4] = {_mm_loadu_pd(a[0]), _mm_loadu_pd(a[1]), _mm_loadu_pd(a[2]), _mm_loadu_pd(a[3])};
+      const __m128d hi[4] = {_mm_loadu_pd(a[0] + 2), _mm_loadu_pd(a[1] + 2), _mm_loadu_pd(a[2] + 2), _mm_loadu_pd(a[3] + 2)};
+      for (unsigned int j = 0; j < 4; j++)
+        mat4MulColumn(lo, hi, b[j], out[j]);
+    }
+    
+    inline void mat4MulVec4(const double (&m)[4][4], const double* v, double* out)
+    {
+      const __m128d lo[4] = {_mm_loadu_pd(m[0]), _mm_loadu_pd(m[1]), _mm_loadu_pd(m[2]), _mm_loadu_pd(m[3])};
+      const __m128d hi[4] = {_mm_loadu_pd(m[0] + 2), _mm_loadu_pd(m[1] + 2), _mm_loadu_pd(m[2] + 2), _mm_loadu_pd(m[3] + 2)};
+      mat4MulColumn(lo, hi, v, out);
+    }
+#endif
+#endif
+  }
+  
+  /* Mat4 */
+  template <typename T>
+  struct Mat<T, 4, 4>
+  {
+    static const unsigned short size = 4;
+    T d[4][4];
+    
+    constexpr explicit Mat(T t = 1)
+      : d{{t, 0, 0, 0},
+          {0, t, 0, 0},
+          {0, 0, t, 0},
+          {0, 0, 0, t}}
+    {
+    }
+    
+    constexpr Mat(const Vec4<T>& col1, const Vec4<T>& col2, const Vec4<T>& col3, const Vec4<T>& col4)
+      : d{{col1.x, col1.y, col1.z, col1.w},
+          {col2.x, col2.y, col2.z, col2.w},
+          {col3.x, col3.y, col3.z, col3.w},
+          {col4.x, col4.y, col4.z, col4.w}}
+    {
+    }
+    
+    constexpr Mat(T col1x, T col2x, T col3x, T col4x,
+                  T col1y, T col2y, T col3y, T col4y,
+                  T col1z, T col2z, T col3z, T col4z,
+                  T col1w, T col2w, T col3w, T col4w)
+      : d{{col1x, col1y, col1z, col1w},
+          {col2x, col2y, col2z, col2w},
+          {col3x, col3y, col3z, col3w},
+          {col4x, col4y, col4z, col4w}}
+    {
+    }
+    
+    constexpr Mat(const Mat2<T>& other)
+      : d{{other.d[0][0], other.d[0][1], 0, 0},
+          {other.d[1][0], other.d[1][1], 0, 0},
+          {0,             0,             0, 0},
+          {0,             0,             0, 0}}
+    {
+    }
+    
+    constexpr Mat(const Mat3<T>& other)
+      : d{{other.d[0][0], other.d[0][1], other.d[0][2], 0},
+          {other.d[1][0], other.d[1][1], other.d[1][2], 0},
+          {other.d[2][0], other.d[2][1], other.d[2][2], 0},
+          {0,             0,             0,             0}}
+    {
+    }
+    
+    constexpr explicit Mat(const Affine<T>& other)
+      : d{{other.d[0][0], other.d[0][1], other.d[0][2], 0},
+          {other.d[1][0], other.d[1][1], other.d[1][2], 0},
+          {other.d[2][0], other.d[2][1], other.d[2][2], 0},
+          {other.d[3][0], other.d[3][1], other.d[3][2], 1}}
+    {
+    }
+    
+    inline Vec4<T>& operator[](unsigned int col)
+    {
+      return *reinterpret_cast<Vec4<T>*>(d[col]);
+    }
+    
+    inline const Vec4<T>& operator[](unsigned int col) const
+    {
+      return *reinterpret_cast<const Vec4<T>*>(d[col]);
+    }
+    
+    inline T& operator()(unsigned int row, unsigned int col)
+    {
+      return d[col][row];
+    }
+    
+    inline const T& operator()(unsigned int row, unsigned int col) const
+    {
+      return d[col][row];
+    }
+    
+    NEON_CONSTEXPR14 Mat4<T>& operator+=(const Mat4<T>& m)
+    {
+      d[0][0] += m.d[0][0]; d[1][0] += m.d[1][0]; d[2][0] += m.d[2][0]; d[3][0] += m.d[3][0];
+      d[0][1] += m.d[0][1]; d[1][1] += m.d[1][1]; d[2][1] += m.d[2][1]; d[3][1] += m.d[3][1];
+      d[0][2] += m.d[0][2]; d[1][2] += m.d[1][2]; d[2][2] += m.d[2][2]; d[3][2] += m.d[3][2];
+      d[0][3] += m.d[0][3]; d[1][3] += m.d[1][3]; d[2][3] += m.d[2][3]; d[3][3] += m.d[3][3];
+      return *this;
+    }
+    
+    NEON_CONSTEXPR14 Mat4<T>& operator-=(const Mat4<T>& m)
+    {
+      d[0][0] -= m.d[0][0]; d[1][0] -= m.d[1][0]; d[2][0] -= m.d[2][0]; d[3][0] -= m.d[3][0];
+      d[0][1] -= m.d[0][1]; d[1][1] -= m.d[1][1]; d[2][1] -= m.d[2][1]; d[3][1] -= m.d[3][1];
+      d[0][2] -= m.d[0][2]; d[1][2] -= m.d[1][2]; d[2][2] -= m.d[2][2]; d[3][2] -= m.d[3][2];
+      d[0][3] -= m.d[0][3]; d[1][3] -= m.d[1][3]; d[2][3] -= m.d[2][3]; d[3][3] -= m.d[3][3];
+      return *this;
+    }
+    
+    NEON_CONSTEXPR14 Mat4<T>& operator*=(const T t)
+    {
+      d[0][0] *= t; d[1][0] *= t; d[2][0] *= t; d[3][0] *= t;
+      d[0][1] *= t; d[1][1] *= t; d[2][1] *= t; d[3][1] *= t;
+      d[0][2] *= t; d[1][2] *= t; d[2][2] *= t; d[3][2] *= t;
+      d[0][3] *= t; d[1][3] *= t; d[2][3] *= t; d[3][3] *= t;
+      return *this;
+    }
+    
+    inline Vec4<T> operator*(const Vec4<T>& v) const
+    {
+      Vec4<T> result;
+      Detail::mat4MulVec4(d, &v.x, &result.x);
+      return result;
+    }
+    
+    friend inline Mat4<T> operator*(const Mat4<T>& lhs, const Mat4<T>& rhs)
+    {
+      Mat4<T> result;
+      Detail::mat4Mul(lhs.d, rhs.d, result.d);
+      return result;
+    }
+    
+    friend constexpr Mat4<T> operator/(const T t, const Mat4<T>& m)
+    {
+      return m * t;
+    }
+    
+    NEON_CONSTEXPR14 Mat4<T>& operator/=(const T t)
+    {
+      const T d = 1 / t;
+      return *this *= d;
+    }
+    
+#if !defined(NEON_EXPR_TEMPLATES)
+    friend constexpr Mat4<T> operator+(const Mat4<T>& lhs, const Mat4<T>& rhs)
+    {
+      return Mat4<T>{lhs.d[0][0] + rhs.d[0][0], lhs.d[1][0] + rhs.d[1][0], lhs.d[2][0] + rhs.d[2][0], lhs.d[3][0] + rhs.d[3][0],
+                     lhs.d[0][1] + rhs.d[0][1], lhs.d[1][1] + rhs.d[1][1], lhs.d[2][1] + rhs.d[2][1], lhs.d[3][1] + rhs.d[3][1],
+                     lhs.d[0][2] + rhs.d[0][2], lhs.d[1][2] + rhs.d[1][2], lhs.d[2][2] + rhs.d[2][2], lhs.d[3][2] + rhs.d[3][2],
+                     lhs.d[0][3] + rhs.d[0][3], lhs.d[1][3] + rhs.d[1][3], lhs.d[2][3] + rhs.d[2][3], lhs.d[3][3] + rhs.d[3][3]};
+    }
+    
+    constexpr Mat4<T> operator-() const
+    {
+      return Mat4<T>{-d[0][0], -d[1][0], -d[2][0], -d[3][0],
+                     -d[0][1], -d[1][1], -d[2][1], -d[3][1],
+                     -d[0][2], -d[1][2], -d[2][2], -d[3][2],
+                     -d[0][3], -d[1][3], -d[2][3], -d[3][3]};
+    }
+    
+    friend constexpr Mat4<T> operator-(const Mat4<T>& lhs, const Mat4<T>& rhs)
+    {
+      return Mat4<T>{lhs.d[0][0] - rhs.d[0][0], lhs.d[1][0] - rhs.d[1][0], lhs.d[2][0] - rhs.d[2][0], lhs.d[3][0] - rhs.d[3][0],
+                     lhs.d[0][1] - rhs.d[0][1], lhs.d[1][1] - rhs.d[1][1], lhs.d[2][1] - rhs.d[2][1], lhs.d[3][1] - rhs.d[3][1],
+                     lhs.d[0][2] - rhs.d[0][2], lhs.d[1][2] - rhs.d[1][2], lhs.d[2][2] - rhs.d[2][2], lhs.d[3][2] - rhs.d[3][2],
+                     lhs.d[0][3] - rhs.d[0][3], lhs.d[1][3] - rhs.d[1][3], lhs.d[2][3] - rhs.d[2][3], lhs.d[3][3] - rhs.d[3][3]};
+    }
+    
+    constexpr Mat4<T> operator*(const T t) const
+    {
+      return Mat4<T>{d[0][0] * t, d[1][0] * t, d[2][0] * t, d[3][0] * t,
+                     d[0][1] * t, d[1][1] * t, d[2][1] * t, d[3][1] * t,
+                     d[0][2] * t, d[1][2] * t, d[2][2] * t, d[3][2] * t,
+                     d[0][3] * t, d[1][3] * t, d[2][3] * t, d[3][3] * t};
+    }
+    
+    friend constexpr Mat4<T> operator*(const T t, const Mat4<T>& m)
+    {
+      return m * t;
+    }
+    
+    constexpr Mat4<T> operator/(const T t) const
+    {
+      return *this * (1 / t);
+    }
+#else
+    template <typename E, typename = typename std::enable_if<Detail::IsExprOf<E, Mat4<T>>::value>::type>
+    Mat(const E& e)
+    {
+      *this = e;
+    }
+    
+    template <typename E>
+    typename std::enable_if<Detail::IsExprOf<E, Mat4<T>>::value, Mat4<T>&>::type operator=(const E& e)
+    {
+      for (unsigned int i = 0; i < 16; i++)
+        d[i / 4][i % 4] = element(e, i);
+      return *this;
+    }
+#endif
+    
+    inline T* data()
+    {
+      return d[0];
+    }
+  };
+  
+  /* Common matrix operations */
+  
+  template <typename T>
+  constexpr T determinant(const Mat2<T>& m)
+  {
+    return m.d[0][0] * m.d[1][1] - m.d[1][0] * m.d[0][1];
+  }
+  
+  template <typename T>
+  NEON_CONSTEXPR14 Mat2<T> inverse(const Mat2<T>& m)
+  {
+    const T di = 1 / determinant(m);
+    return Mat2<T>{di * m.d[1][1], -di * m.d[1][0], -di * m.d[0][1], di * m.d[0][0]};
+  }
+  
+  template <typename T>
+  NEON_CONSTEXPR14 T determinant(const Mat3<T>& m)
+  {
+    const T x = m.d[0][0] * (m.d[1][1] * m.d[2][2] - m.d[2][1] * m.d[1][2]);
+    const T y = m.d[1][0] * (m.d[0][1] * m.d[2][2] - m.d[2][1] * m.d[0][2]);
+    const T z = m.d[2][0] * (m.d[0][1] * m.d[1][2] - m.d[1][1] * m.d[0][2]);
+    return x - y + z;
+  }
+  
+  template <typename T>
+  NEON_CONSTEXPR14 Mat3<T> inverse(const Mat3<T>& m)
+  {
+    // https://en.wikipedia.org/wiki/Invertible_matrix#Inversion_of_3_%C3%97_3_matrices
+    // The cross products of the columns are the rows of the inverse, times the determinant.
+    const Vec3<T> v0{m.d[0][0], m.d[0][1], m.d[0][2]};
+    const Vec3<T> v1{m.d[1][0], m.d[1][1], m.d[1][2]};
+    const Vec3<T> v2{m.d[2][0], m.d[2][1], m.d[2][2]};
+    Vec3<T> a = cross(v1, v2);
+    Vec3<T> b = cross(v2, v0);
+    Vec3<T> c = cross(v0, v1);
+    const T detInv = 1 / dot(v0, a);
+    a = a * detInv;
+    b = b * detInv;
+    c = c * detInv;
+    return Mat3<T>(a.x, a.y, a.z,
+                   b.x, b.y, b.z,
+                   c.x, c.y, c.z);
+  }
+  
+  template <typename T>
+  NEON_CONSTEXPR14 T determinant(const Mat4<T>& m)
+  {
+    const Vec3<T> v1{m.d[0][0], m.d[0][1], m.d[0][2]};
+    const Vec3<T> v2{m.d[1][0], m.d[1][1], m.d[1][2]};
+    const Vec3<T> v3{m.d[2][0], m.d[2][1], m.d[2][2]};
+    const Vec3<T> v4{m.d[3][0], m.d[3][1], m.d[3][2]};
+    const T x = m.d[0][3];
+    const T y = m.d[1][3];
+    const T z = m.d[2][3];
+    const T w = m.d[3][3];
+    const Vec3<T> s = cross(v1, v2);
+    const Vec3<T> t = cross(v3, v4);
+    const Vec3<T> u = v1 * y - v2 * x;
+    const Vec3<T> v = v3 * w - v4 * z;
+    return dot(s, v) + dot(t, u);
+  }
+  
+  namespace Detail
+  {
+    // reciprocal(det) gives the factor applied to the adjugate, so batched callers can trap singular matrices.
+    template <typename T, typename Reciprocal>
+    NEON_CONSTEXPR14 Mat4<T> inverse(const Mat4<T>& m, Reciprocal reciprocal)
+    {
+      const Vec3<T> a{m.d[0][0], m.d[0][1], m.d[0][2]};
+      const Vec3<T> b{m.d[1][0], m.d[1][1], m.d[1][2]};
+      const Vec3<T> c{m.d[2][0], m.d[2][1], m.d[2][2]};
+      const Vec3<T> d{m.d[3][0], m.d[3][1], m.d[3][2]};
+      const T x = m.d[0][3];
+      const T y = m.d[1][3];
+      const T z = m.d[2][3];
+      const T w = m.d[3][3];
+      Vec3<T> s = cross(a, b);
+      Vec3<T> t = cross(c, d);
+      Vec3<T> u = a * y - b * x;
+      Vec3<T> v = c * w - d * z;
+      const T detInv = reciprocal(dot(s, v) + dot(t, u));
+      s *= detInv;
+      t *= detInv;
+      u *= detInv;
+      v *= detInv;
+      const Vec3<T> r0 = cross(b, v) + t * y;
+      const Vec3<T> r1 = cross(v, a) - t * x;
+      const Vec3<T> r2 = cross(d, u) + s * w;
+      const Vec3<T> r3 = cross(u, c) - s * z;
+      return Mat4<T>{r0.x, r0.y, r0.z, -dot(b, t),
+                     r1.x, r1.y, r1.z, dot(a, t),
+                     r2.x, r2.y, r2.z, -dot(d, s),
+                     r3.x, r3.y, r3.z, dot(c, s)};
+    }
+    
+    template <typename T>
+    struct Reciprocal
+    {
+      constexpr T operator()(T t) const
+      {
+        return 1 / t;
+      }
+    };
+  }
+  
+  template <typename T>
+  NEON_CONSTEXPR14 Mat4<T> inverse(const Mat4<T>& m)
+  {
+    return Detail::inverse(m, Detail::Reciprocal<T>());
+  }
+  
+  template <typename T, unsigned int N>
+  inline Mat<T, N, N>& transpose(Mat<T, N, N>& m)
+  {
+    for (unsigned int i = 0; i < N; i++)
+      for (unsigned int j = i + 1; j < N; j++)
+        std::swap(m.d[j][i], m.d[i][j]);
+    return m;
+  }
+  
+  template <typename T, unsigned int R, unsigned int C>
+  NEON_CONSTEXPR14 Mat<T, C, R> transpose(const Mat<T, R, C>& m)
+  {
+    Mat<T, C, R> mt(0);
+    for (unsigned int i = 0; i < C; i++)
+      for (unsigned int j = 0; j < R; j++)
+        mt.d[j][i] = m.d[i][j];
+    return mt;
+  }
+  
+  // The matrix normalMatrix returns. InverseTranspose maps normals exactly. Cofactor skips the divide by the
+  // determinant, so its result is that one scaled by the determinant: it is enough for shaders that renormalize,
+  // as long as the determinant is positive, and it stays finite for singular matrices.
+  enum class NormalForm
+  {
+    InverseTranspose,
+    Cofactor
+  };
+  
+  namespace Detail
+  {
+    // The columns of the cofactor matrix of [c0 c1 c2] are the cross products of the other two columns.
+    template <NormalForm F, typename T>
+    NEON_CONSTEXPR14 Mat3<T> normalMatrixOf(const T* c0, const T* c1, const T* c2)
+    {
+      const Vec3<T> a{c0[0], c0[1], c0[2]};
+      const Vec3<T> b{c1[0], c1[1], c1[2]};
+      const Vec3<T> c{c2[0], c2[1], c2[2]};
+      const Vec3<T> n0 = cross(b, c);
+      if (F == NormalForm::Cofactor)
+        return Mat3<T>(n0, cross(c, a), cross(a, b));
+      const T detInv = T(1) / dot(a, n0);
+      return Mat3<T>(n0 * detInv, cross(c, a) * detInv, cross(a, b) * detInv);
+    }
+  }
+  
+  // transpose(inverse(Mat3<T>(m))), the matrix that takes normals through m, from three cross products.
+  template <typename T, NormalForm F = NormalForm::InverseTranspose>
+  NEON_CONSTEXPR14 Mat3<T> normalMatrix(const Mat3<T>& m)
+  {
+    return Detail::normalMatrixOf<F>(m.d[0], m.d[1], m.d[2]);
+  }
+  
+  template <typename T, NormalForm F = NormalForm::InverseTranspose>
+  NEON_CONSTEXPR14 Mat3<T> normalMatrix(const Mat4<T>& m)
+  {
+    return Detail::normalMatrixOf<F>(m.d[0], m.d[1], m.d[2]);
+  }
+  
+  template <typename T, NormalForm F = NormalForm::InverseTranspose>
+  NEON_CONSTEXPR14 Mat3<T> normalMatrix(const Affine<T>& m)
+  {
+    return Detail::normalMatrixOf<F>(m.d[0], m.d[1], m.d[2]);
+  }
+  
+  /* Generic vectors and matrices */
+  // Vec<T, N> and Mat<T, R, C> (R rows by C columns, stored column-major) cover the sizes that have no
+  // hand-written specialization above, such as 3x4 or 2x3 matrices. Their element loops go through
+  // Detail::Unroll so they are expanded at compile time.
+  
+  namespace Detail
+  {
+    // Calls f(0), ..., f(N - 1).
+    template <unsigned int N>
+    struct Unroll
+    {
+      template <typename F>
+      static inline void run(const F& f)
+      {
+        Unroll<N - 1>::run(f);
+        f(N - 1);
+      }
+    };
+    
+    template <>
+    struct Unroll<0>
+    {
+      template <typename F>
+      static inline void run(const F&)
+      {
+      }
+    };
+  }
+  
+  template <typename T, unsigned int N>
+  struct Vec
+  {
+    T d[N];
+    
+    explicit Vec(T t = 0)
+    {
+      Detail::Unroll<N>::run([&](unsigned int i) { d[i] = t; });
+    }
+    
+    template <typename... Ts, typename = typename std::enable_if<sizeof...(Ts) + 1 == N>::type>
+    constexpr Vec(T first, Ts... rest) : d{first, static_cast<T>(rest)...}
+    {
+    }
+    
+    inline T& operator[](unsigned int i)
+    {
+      return d[i];
+    }
+    
+    inline const T& operator[](unsigned int i) const
+    {
+      return d[i];
+    }
+    
+    inline Vec<T, N>& operator+=(const Vec<T, N>& v)
+    {
+      Detail::Unroll<N>::run([&](unsigned int i) { d[i] += v.d[i]; });
+      return *this;
+    }
+    
+    inline Vec<T, N>& operator-=(const Vec<T, N>& v)
+    {
+      Detail::Unroll<N>::run([&](unsigned int i) { d[i] -= v.d[i]; });
+      return *this;
+    }
+    
+    inline Vec<T, N>& operator*=(const T t)
+    {
+      Detail::Unroll<N>::run([&](unsigned int i) { d[i] *= t; });
+      return *this;
+    }
+    
+    inline Vec<T, N>& operator*=(const Vec<T, N>& v)
+    {
+      Detail::Unroll<N>::run([&](unsigned int i) { d[i] *= v.d[i]; });
+      return *this;
+    }
+    
+    inline Vec<T, N>& operator/=(const T t)
+    {
+      Detail::Unroll<N>::run([&](unsigned int i) { d[i] /= t; });
+      return *this;
+    }
+    
+    inline T* data()
+    {
+      return d;
+    }
+    
+#if !defined(NEON_EXPR_TEMPLATES)
+    friend inline Vec<T, N> operator+(Vec<T, N> lhs, const Vec<T, N>& rhs)
+    {
+      return lhs += rhs;
+    }
+    
+    friend inline Vec<T, N> operator-(const Vec<T, N>& v)
+    {
+      return v * T(-1);
+    }
+    
+    friend inline Vec<T, N> operator-(Vec<T, N> lhs, const Vec<T, N>& rhs)
+    {
+      return lhs -= rhs;
+    }
+    
+    friend inline Vec<T, N> operator*(Vec<T, N> v, const T t)
+    {
+      return v *= t;
+    }
+    
+    friend inline Vec<T, N> operator*(const T t, Vec<T, N> v)
+    {
+      return v *= t;
+    }
+    
+    friend inline Vec<T, N> operator*(Vec<T, N> lhs, const Vec<T, N>& rhs)
+    {
+      return lhs *= rhs;
+    }
+    
+    friend inline Vec<T, N> operator/(Vec<T, N> v, const T t)
+    {
+      return v /= t;
+    }
+#else
+    template <typename E, typename = typename std::enable_if<Detail::IsExprOf<E, Vec<T, N>>::value>::type>
+    Vec(const E& e)
+    {
+      *this = e;
+    }
+    
+    template <typename E>
+    typename std::enable_if<Detail::IsExprOf<E, Vec<T, N>>::value, Vec<T, N>&>::type operator=(const E& e)
+    {
+      Detail::Unroll<N>::run([&](unsigned int i) { d[i] = element(e, i); });
+      return *this;
+    }
+#endif
+  };
+  
+  template <typename T, unsigned int R, unsigned int C>
+  struct Mat
+  {
+    T d[C][R];
+    
+    // t on the main diagonal, zero elsewhere.
+    explicit Mat(T t = 1)
+    {
+      Detail::Unroll<R * C>::run([&](unsigned int i) { d[i / R][i % R] = i / R == i % R ? t : T(0); });
+    }
+    
+    // Entries are given row by row, like the square matrices.
+    template <typename... Ts, typename = typename std::enable_if<sizeof...(Ts) + 1 == R * C && (R * C > 1)>::type>
+    Mat(T first, Ts... rest)
+    {
+      const T e[] = {first, static_cast<T>(rest)...};
+      Detail::Unroll<R * C>::run([&](unsigned int i) { d[i / R][i % R] = e[(i % R) * C + i / R]; });
+    }
+    
+    inline Vec<T, R>& operator[](unsigned int col)
+    {
+      return *reinterpret_cast<Vec<T, R>*>(d[col]);
+    }
+    
+    inline const Vec<T, R>& operator[](unsigned int col) const
+    {
+      return *reinterpret_cast<const Vec<T, R>*>(d[col]);
+    }
+    
+    inline T& operator()(unsigned int row, unsigned int col)
+    {
+      return d[col][row];
+    }
+    
+    inline const T& operator()(unsigned int row, unsigned int col) const
+    {
+      return d[col][row];
+    }
+    
+    inline Mat<T, R, C>& operator+=(const Mat<T, R, C>& m)
+    {
+      Detail::Unroll<R * C>::run([&](unsigned int i) { d[i / R][i % R] += m.d[i / R][i % R]; });
+      return *this;
+    }
+    
+    inline Mat<T, R, C>& operator-=(const Mat<T, R, C>& m)
+    {
+      Detail::Unroll<R * C>::run([&](unsigned int i) { d[i / R][i % R] -= m.d[i / R][i % R]; });
+      return *this;
+    }
+    
+    inline Mat<T, R, C>& operator*=(const T t)
+    {
+      Detail::Unroll<R * C>::run([&](unsigned int i) { d[i / R][i % R] *= t; });
+      return *this;
+    }
+    
+    inline Mat<T, R, C>& operator/=(const T t)
+    {
+      return *this *= 1 / t;
+    }
+    
+    inline T* data()
+    {
+      return d[0];
+    }
+    
+#if !defined(NEON_EXPR_TEMPLATES)
+    friend inline Mat<T, R, C> operator+(Mat<T, R, C> lhs, const Mat<T, R, C>& rhs)
+    {
+      return lhs += rhs;
+    }
+    
+    friend inline Mat<T, R, C> operator-(const Mat<T, R, C>& m)
+    {
+      return m * T(-1);
+    }
+    
+    friend inline Mat<T, R, C> operator-(Mat<T, R, C> lhs, const Mat<T, R, C>& rhs)
+    {
+      return lhs -= rhs;
+    }
+    
+    friend inline Mat<T, R, C> operator*(Mat<T, R, C> m, const T t)
+    {
+      return m *= t;
+    }
+    
+    friend inline Mat<T, R, C> operator*(const T t, Mat<T, R, C> m)
+    {
+      return m *= t;
+    }
+    
+    friend inline Mat<T, R, C> operator/(Mat<T, R, C> m, const T t)
+    {
+      return m /= t;
+    }
+#else
+    template <typename E, typename = typename std::enable_if<Detail::IsExprOf<E, Mat<T, R, C>>::value>::type>
+    Mat(const E& e)
+    {
+      *this = e;
+    }
+    
+    template <typename E>
+    typename std::enable_if<Detail::IsExprOf<E, Mat<T, R, C>>::value, Mat<T, R, C>&>::type operator=(const E& e)
+    {
+      Detail::Unroll<R * C>::run([&](unsigned int i) { d[i / R][i % R] = element(e, i); });
+      return *this;
+    }
+#endif
+  };
+  
+  template <typename T, unsigned int N>
+  inline T dot(const Vec<T, N>& v1, const Vec<T, N>& v2)
+  {
+    T result = 0;
+    Detail::Unroll<N>::run([&](unsigned int i) { result += v1[i] * v2[i]; });
+    return result;
+  }
+  
+  template <typename T, unsigned int N>
+  inline T mag(const Vec<T, N>& v)
+  {
+    return std::sqrt(dot(v, v));
+  }
+  
+  template <typename T, unsigned int N>
+  inline Vec<T, N> normalize(const Vec<T, N>& v)
+  {
+    return v / mag(v);
+  }
+  
+  // Products between any compatible shapes; the hand-written Mat2/3/4 operators take precedence.
+  template <typename T, unsigned int R, unsigned int K, unsigned int C>
+  inline Mat<T, R, C> operator*(const Mat<T, R, K>& lhs, const Mat<T, K, C>& rhs)
+  {
+    Mat<T, R, C> result(0);
+    Detail::Unroll<R * C>::run([&](unsigned int i)
+    {
+      Detail::Unroll<K>::run([&](unsigned int k) { result.d[i / R][i % R] += lhs.d[k][i % R] * rhs.d[i / R][k]; });
+    });
+    return result;
+  }
+  
+  template <typename T, unsigned int R, unsigned int C>
+  inline Vec<T, R> operator*(const Mat<T, R, C>& m, const Vec<T, C>& v)
+  {
+    Vec<T, R> result(0);
+    Detail::Unroll<R * C>::run([&](unsigned int i) { result[i % R] += m.d[i / R][i % R] * v[i / R]; });
+    return result;
+  }
+  
+  /* Affine */
+  // 3x4 column-major transform whose implicit last row is (0, 0, 0, 1): three linear columns and a translation.
+  template <typename T>
+  struct Affine
+  {
+    T d[4][3];
+    
+    constexpr explicit Affine(T t = 1)
+      : d{{t, 0, 0},
+          {0, t, 0},
+          {0, 0, t},
+          {0, 0, 0}}
+    {
+    }
+    
+    constexpr Affine(T col1x, T col2x, T col3x, T col4x,
+                     T col1y, T col2y, T col3y, T col4y,
+                     T col1z, T col2z, T col3z, T col4z)
+      : d{{col1x, col1y, col1z},
+          {col2x, col2y, col2z},
+          {col3x, col3y, col3z},
+          {col4x, col4y, col4z}}
+    {
+    }
+    
+    constexpr explicit Affine(const Mat3<T>& linear, const Vec3<T>& translation = Vec3<T>(0))
+      : d{{linear.d[0][0], linear.d[0][1], linear.d[0][2]},
+          {linear.d[1][0], linear.d[1][1], linear.d[1][2]},
+          {linear.d[2][0], linear.d[2][1], linear.d[2][2]},
+          {translation.x,  translation.y,  translation.z}}
+    {
+    }
+    
+    // Drops the last row of m, which is assumed to be (0, 0, 0, 1).
+    constexpr explicit Affine(const Mat4<T>& m)
+      : d{{m.d[0][0], m.d[0][1], m.d[0][2]},
+          {m.d[1][0], m.d[1][1], m.d[1][2]},
+          {m.d[2][0], m.d[2][1], m.d[2][2]},
+          {m.d[3][0], m.d[3][1], m.d[3][2]}}
+    {
+    }
+    
+    inline Vec3<T>& operator[](unsigned int col)
+    {
+      return *reinterpret_cast<Vec3<T>*>(d[col]);
+    }
+    
+    inline const Vec3<T>& operator[](unsigned int col) const
+    {
+      return *reinterpret_cast<const Vec3<T>*>(d[col]);
+    }
+    
+    inline T& operator()(unsigned int row, unsigned int col)
+    {
+      return d[col][row];
+    }
+    
+    inline const T& operator()(unsigned int row, unsigned int col) const
+    {
+      return d[col][row];
+    }
+    
+    inline Mat3<T> linear() const
+    {
+      return Mat3<T>{(*this)[0], (*this)[1], (*this)[2]};
+    }
+    
+    inline const Vec3<T>& translation() const
+    {
+      return (*this)[3];
+    }
+    
+    inline Vec4<T> operator*(const Vec4<T>& v) const
+    {
+      return Vec4<T>{d[0][0] * v.x + d[1][0] * v.y + d[2][0] * v.z + d[3][0] * v.w,
+                     d[0][1] * v.x + d[1][1] * v.y + d[2][1] * v.z + d[3][1] * v.w,
+                     d[0][2] * v.x + d[1][2] * v.y + d[2][2] * v.z + d[3][2] * v.w,
+                     v.w};
+    }
+    
+    friend inline Affine<T> operator*(const Affine<T>& lhs, const Affine<T>& rhs)
+    {
+      Affine<T> result;
+      Detail::affineMul(lhs.d, rhs.d, result.d);
+      return result;
+    }
+    
+    inline T* data()
+    {
+      return d[0];
+    }
+  };
+  
+  // p is a point (w = 1).
+  template <typename T>
+  inline Vec3<T> transformPoint(const Affine<T>& a, const Vec3<T>& p)
+  {
+    return Vec3<T>{a.d[0][0] * p.x + a.d[1][0] * p.y + a.d[2][0] * p.z + a.d[3][0],
+                   a.d[0][1] * p.x + a.d[1][1] * p.y + a.d[2][1] * p.z + a.d[3][1],
+                   a.d[0][2] * p.x + a.d[1][2] * p.y + a.d[2][2] * p.z + a.d[3][2]};
+  }
+  
+  // v is a direction (w = 0).
+  template <typename T>
+  inline Vec3<T> transformVector(const Affine<T>& a, const Vec3<T>& v)
+  {
+    return Vec3<T>{a.d[0][0] * v.x + a.d[1][0] * v.y + a.d[2][0] * v.z,
+                   a.d[0][1] * v.x + a.d[1][1] * v.y + a.d[2][1] * v.z,
+                   a.d[0][2] * v.x + a.d[1][2] * v.y + a.d[2][2] * v.z};
+  }
+  
+  template <typename T>
+  inline T determinant(const Affine<T>& a)
+  {
+    return dot(a[0], cross(a[1], a[2]));
+  }
+  
+  // Inverts the 3x3 part and maps the translation through it.
+  template <typename T>
+  inline Affine<T> inverse(const Affine<T>& a)
+  {
+    const Mat3<T> li = inverse(a.linear());
+    return Affine<T>{li, -(li * a.translation())};
+  }
+  
+  // Fast inverse when the linear part is a pure rotation: transposes it instead of inverting.
+  template <typename T>
+  inline Affine<T> inverseRigid(const Affine<T>& a)
+  {
+    const Vec3<T>& t = a.translation();
+    return Affine<T>{a.d[0][0], a.d[0][1], a.d[0][2], -dot(a[0], t),
+                     a.d[1][0], a.d[1][1], a.d[1][2], -dot(a[1], t),
+                     a.d[2][0], a.d[2][1], a.d[2][2], -dot(a[2], t)};
+  }
+  
+  /* Transform hierarchy */
+  // Flat scene graph with world(i) = world(parent(i)) * local(i). Nodes live in parallel arrays in the order
+  // they were added and a node can only be added under an existing one, so parents always precede their
+  // children. setLocal only marks a node dirty; update() then walks the arrays once, front to back, and
+  // recomputes the world transforms (and, if kept, their inverses) of dirty nodes and their descendants only.
+  template <typename T>
+  struct TransformHierarchy
+  {
+    static const std::size_t kNoParent = static_cast<std::size_t>(-1);
+    
+    explicit TransformHierarchy(bool withInverses = false) : keepInverses(withInverses)
+    {
+    }
+    
+    inline std::size_t size() const
+    {
+      return parents.size();
+    }
+    
+    void reserve(std::size_t count)
+    {
+      parents.reserve(count);
+      locals.reserve(count);
+      worlds.reserve(count);
+      dirty.reserve(count);
+      if (keepInverses)
+        inverses.reserve(count);
+    }
+    
+    // Returns the index of the new node. parent must be kNoParent or an index returned earlier.
+    std::size_t add(const Affine<T>& local, std::size_t parent = kNoParent)
+    {
+      assert(parent == kNoParent || parent < size());
+      parents.push_back(parent);
+      locals.push_back(local);
+      worlds.push_back(local);
+      dirty.push_back(1);
+      if (keepInverses)
+        inverses.push_back(Affine<T>());
+      return parents.size() - 1;
+    }
+    
+    inline void setLocal(std::size_t i, const Affine<T>& local)
+    {
+      locals[i] = local;
+      dirty[i] = 1;
+    }
+    
+    inline std::size_t parent(std::size_t i) const
+    {
+      return parents[i];
+    }
+    
+    inline const Affine<T>& local(std::size_t i) const
+    {
+      return locals[i];
+    }
+    
+    // Up to date as of the last update().
+    inline const Affine<T>& world(std::size_t i) const
+    {
+      return worlds[i];
+    }
+    
+    // Only kept when the hierarchy was made with withInverses set.
+    inline const Affine<T>& worldInverse(std::size_t i) const
+    {
+      assert(keepInverses);
+      return inverses[i];
+    }
+    
+    inline bool isDirty(std::size_t i) const
+    {
+      return dirty[i] != 0;
+    }
+    
+    // Dirtiness flows from parents to children in the same pass, since a parent's flag is final by the time its
+    // children are visited. Clean nodes cost one flag test.
+    void update()
+    {
+      const std::size_t count = parents.size();
+      for (std::size_t i = 0; i < count; i++)
+      {
+        const std::size_t p = parents[i];
+        if (p != kNoParent)
+          dirty[i] |= dirty[p];
+        if (!dirty[i])
+          continue;
+        worlds[i] = p == kNoParent ? locals[i] : worlds[p] * locals[i];
+        if (keepInverses)
+          inverses[i] = inverse(worlds[i]);
+      }
+      std::fill(dirty.begin(), dirty.end(), static_cast<unsigned char>(0));
+    }
+    
+  private:
+    std::vector<std::size_t> parents;
+    std::vector<Affine<T>> locals;
+    std::vector<Affine<T>> worlds;
+    std::vector<Affine<T>> inverses;
+    std::vector<unsigned char> dirty;
+    bool keepInverses;
+  };
+  
+  template <typename T>
+  const std::size_t TransformHierarchy<T>::kNoParent;
+  
+  /* Quat */
+  // Rotation quaternion x*i + y*j + z*k + w, following the right-handed conventions of the rotation makers.
+  template <typename T>
+  struct Quat
+  {
+    T x, y, z, w;
+    
+    constexpr Quat() : x(0), y(0), z(0), w(1)
+    {
+    }
+    
+    constexpr Quat(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w)
+    {
+    }
+    
+    constexpr Quat(const Vec3<T>& v, T _w) : x(v.x), y(v.y), z(v.z), w(_w)
+    {
+    }
+    
+    inline const Vec3<T>& vec() const
+    {
+      return *reinterpret_cast<const Vec3<T>*>(&x);
+    }
+    
+    friend constexpr Quat<T> operator+(const Quat<T>& lhs, const Quat<T>& rhs)
+    {
+      return Quat<T>{lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z, lhs.w + rhs.w};
+    }
+    
+    friend constexpr Quat<T> operator-(const Quat<T>& q)
+    {
+      return Quat<T>{-q.x, -q.y, -q.z, -q.w};
+    }
+    
+    friend constexpr Quat<T> operator-(const Quat<T>& lhs, const Quat<T>& rhs)
+    {
+      return Quat<T>{lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z, lhs.w - rhs.w};
+    }
+    
+    friend constexpr Quat<T> operator*(const Quat<T>& q, const T t)
+    {
+      return Quat<T>{q.x * t, q.y * t, q.z * t, q.w * t};
+    }
+    
+    friend constexpr Quat<T> operator*(const T t, const Quat<T>& q)
+    {
+      return q * t;
+    }
+    
+    // Hamilton product: rotates by rhs first, then by lhs.
+    friend constexpr Quat<T> operator*(const Quat<T>& lhs, const Quat<T>& rhs)
+    {
+      return Quat<T>{lhs.w * rhs.x + lhs.x * rhs.w + lhs.y * rhs.z - lhs.z * rhs.y,
+                     lhs.w * rhs.y - lhs.x * rhs.z + lhs.y * rhs.w + lhs.z * rhs.x,
+                     lhs.w * rhs.z + lhs.x * rhs.y - lhs.y * rhs.x + lhs.z * rhs.w,
+                     lhs.w * rhs.w - lhs.x * rhs.x - lhs.y * rhs.y - lhs.z * rhs.z};
+    }
+    
+    inline Vec3<T> operator*(const Vec3<T>& v) const;
+  };
+  
+  template <typename T>
+  inline T dot(const Quat<T>& q1, const Quat<T>& q2)
+  {
+    return q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
+  }
+  
+  template <typename T>
+  inline T mag(const Quat<T>& q)
+  {
+    return std::sqrt(dot(q, q));
+  }
+  
+  template <typename T>
+  inline Quat<T> normalize(const Quat<T>& q)
+  {
+    return q * (1 / mag(q));
+  }
+  
+  template <typename T>
+  inline Quat<T> conjugate(const Quat<T>& q)
+  {
+    return Quat<T>{-q.x, -q.y, -q.z, q.w};
+  }
+  
+  template <typename T>
+  inline Quat<T> inverse(const Quat<T>& q)
+  {
+    return conjugate(q) * (1 / dot(q, q));
+  }
+  
+  // q is assumed to be normalized. v + 2w(u x v) + 2u x (u x v), with u the vector part of q.
+  template <typename T>
+  inline Vec3<T> rotate(const Quat<T>& q, const Vec3<T>& v)
+  {
+    const Vec3<T>& u = q.vec();
+    const Vec3<T> t = 2 * cross(u, v);
+    return v + q.w * t + cross(u, t);
+  }
+  
+  template <typename T>
+  inline Vec3<T> Quat<T>::operator*(const Vec3<T>& v) const
+  {
+    return rotate(*this, v);
+  }
+  
+  // Normalized lerp along the shorter arc.
+  template <typename T>
+  inline Quat<T> nlerp(const Quat<T>& q1, const Quat<T>& q2, T t)
+  {
+    const T t2 = dot(q1, q2) < 0 ? -t : t;
+    return normalize(q1 * (1 - t) + q2 * t2);
+  }
+  
+  // Spherical lerp along the shorter arc; falls back to nlerp for nearly parallel inputs.
+  template <typename T>
+  inline Quat<T> slerp(const Quat<T>& q1, const Quat<T>& q2, T t)
+  {
+    T cosTheta = dot(q1, q2);
+    const T sign = cosTheta < 0 ? T(-1) : T(1);
+    cosTheta *= sign;
+    if (cosTheta > T(0.9995))
+      return nlerp(q1, q2, t);
+    const T theta = std::acos(cosTheta);
+    const T sinThetaInv = 1 / std::sin(theta);
+    const T w1 = std::sin((1 - t) * theta) * sinThetaInv;
+    const T w2 = std::sin(t * theta) * sinThetaInv * sign;
+    return q1 * w1 + q2 * w2;
+  }
+  
+  // Axis is assumed to be normalized.
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Quat<T> makeQuat(const Vec3<T>& axis, T angle)
+  {
+    T s;
+    T c;
+    sinCos<T, Pr>(angle / 2, s, c);
+    return Quat<T>{axis * s, c};
+  }
+  
+  // This is yaw(y-axis) * pitch(x-axis) * roll(z-axis), matching makeRotation3D(yaw, pitch, roll).
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Quat<T> makeQuat(T yaw, T pitch, T roll)
+  {
+    T sy;
+    T cy;
+    T sp;
+    T cp;
+    T sr;
+    T cr;
+    sinCos<T, Pr>(yaw / 2, sy, cy);
+    sinCos<T, Pr>(pitch / 2, sp, cp);
+    sinCos<T, Pr>(roll / 2, sr, cr);
+    return Quat<T>{cy * sp * cr + sy * cp * sr,
+                   sy * cp * cr - cy * sp * sr,
+                   cy * cp * sr - sy * sp * cr,
+                   cy * cp * cr + sy * sp * sr};
+  }
+  
+  // m is assumed to be a rotation.
+  template <typename T>
+  inline Quat<T> makeQuat(const Mat3<T>& m)
+  {
+    // https://en.wikipedia.org/wiki/Rotation_matrix#Quaternion
+    const T trace = m(0, 0) + m(1, 1) + m(2, 2);
+    if (trace > 0)
+    {
+      const T s = 2 * std::sqrt(trace + 1);
+      const T sInv = 1 / s;
+      return Quat<T>{(m(2, 1) - m(1, 2)) * sInv, (m(0, 2) - m(2, 0)) * sInv, (m(1, 0) - m(0, 1)) * sInv, s / 4};
+    }
+    else if (m(0, 0) > m(1, 1) && m(0, 0) > m(2, 2))
+    {
+      const T s = 2 * std::sqrt(1 + m(0, 0) - m(1, 1) - m(2, 2));
+      const T sInv = 1 / s;
+      return Quat<T>{s / 4, (m(0, 1) + m(1, 0)) * sInv, (m(0, 2) + m(2, 0)) * sInv, (m(2, 1) - m(1, 2)) * sInv};
+    }
+    else if (m(1, 1) > m(2, 2))
+    {
+      const T s = 2 * std::sqrt(1 + m(1, 1) - m(0, 0) - m(2, 2));
+      const T sInv = 1 / s;
+      return Quat<T>{(m(0, 1) + m(1, 0)) * sInv, s / 4, (m(1, 2) + m(2, 1)) * sInv, (m(0, 2) - m(2, 0)) * sInv};
+    }
+    else
+    {
+      const T s = 2 * std::sqrt(1 + m(2, 2) - m(0, 0) - m(1, 1));
+      const T sInv = 1 / s;
+      return Quat<T>{(m(0, 2) + m(2, 0)) * sInv, (m(1, 2) + m(2, 1)) * sInv, s / 4, (m(1, 0) - m(0, 1)) * sInv};
+    }
+  }
+  
+  // The upper 3x3 of m is assumed to be a rotation.
+  template <typename T>
+  inline Quat<T> makeQuat(const Mat4<T>& m)
+  {
+    return makeQuat(Mat3<T>{m(0, 0), m(0, 1), m(0, 2),
+                            m(1, 0), m(1, 1), m(1, 2),
+                            m(2, 0), m(2, 1), m(2, 2)});
+  }
+  
+  // q is assumed to be normalized.
+  template <typename T>
+  inline Mat3<T> makeRotation3D(const Quat<T>& q)
+  {
+    const T x2 = q.x + q.x;
+    const T y2 = q.y + q.y;
+    const T z2 = q.z + q.z;
+    const T xx = q.x * x2;
+    const T yy = q.y * y2;
+    const T zz = q.z * z2;
+    const T xy = q.x * y2;
+    const T xz = q.x * z2;
+    const T yz = q.y * z2;
+    const T wx = q.w * x2;
+    const T wy = q.w * y2;
+    const T wz = q.w * z2;
+    return Mat3<T>{1 - (yy + zz), xy - wz,       xz + wy,
+                   xy + wz,       1 - (xx + zz), yz - wx,
+                   xz - wy,       yz + wx,       1 - (xx + yy)};
+  }
+  
+  template <typename T>
+  inline Mat4<T> makeRotation4D(const Quat<T>& q)
+  {
+    Mat4<T> result{makeRotation3D(q)};
+    result.d[3][3] = 1;
+    return result;
+  }
+  
+  /* Dual quaternion */
+  // Rigid transform real + eps * dual with eps^2 = 0. A unit dual quaternion rotates by real and then translates by
+  // t, with dual = t * real / 2 for the pure quaternion t.
+  template <typename T>
+  struct DualQuat
+  {
+    Quat<T> real;
+    Quat<T> dual;
+    
+    constexpr DualQuat() : real(), dual(0, 0, 0, 0)
+    {
+    }
+    
+    constexpr DualQuat(const Quat<T>& _real, const Quat<T>& _dual) : real(_real), dual(_dual)
+    {
+    }
+    
+    friend constexpr DualQuat<T> operator+(const DualQuat<T>& lhs, const DualQuat<T>& rhs)
+    {
+      return DualQuat<T>{lhs.real + rhs.real, lhs.dual + rhs.dual};
+    }
+    
+    friend constexpr DualQuat<T> operator-(const DualQuat<T>& dq)
+    {
+      return DualQuat<T>{-dq.real, -dq.dual};
+    }
+    
+    friend constexpr DualQuat<T> operator*(const DualQuat<T>& dq, const T t)
+    {
+      return DualQuat<T>{dq.real * t, dq.dual * t};
+    }
+    
+    friend constexpr DualQuat<T> operator*(const T t, const DualQuat<T>& dq)
+    {
+      return dq * t;
+    }
+    
+    // Composition: applies rhs first, then lhs.
+    friend constexpr DualQuat<T> operator*(const DualQuat<T>& lhs, const DualQuat<T>& rhs)
+    {
+      return DualQuat<T>{lhs.real * rhs.real, lhs.real * rhs.dual + lhs.dual * rhs.real};
+    }
+  };
+  
+  // rotation is assumed to be normalized.
+  template <typename T>
+  inline DualQuat<T> makeDualQuat(const Quat<T>& rotation, const Vec3<T>& translation)
+  {
+    return DualQuat<T>{rotation, Quat<T>{translation, 0} * rotation * T(0.5)};
+  }
+  
+  // The upper 3x3 of m is assumed to be a rotation.
+  template <typename T>
+  inline DualQuat<T> makeDualQuat(const Mat4<T>& m)
+  {
+    return makeDualQuat(makeQuat(m), Vec3<T>{m.d[3][0], m.d[3][1], m.d[3][2]});
+  }
+  
+  // dq is assumed to be normalized.
+  template <typename T>
+  inline Vec3<T> translation(const DualQuat<T>& dq)
+  {
+    const Vec3<T>& r = dq.real.vec();
+    const Vec3<T>& d = dq.dual.vec();
+    return Vec3<T>(2 * (dq.real.w * d - dq.dual.w * r + cross(r, d)));
+  }
+  
+  // dq is assumed to be normalized.
+  template <typename T>
+  inline Mat4<T> makeTransform4D(const DualQuat<T>& dq)
+  {
+    Mat4<T> result = makeRotation4D(dq.real);
+    const Vec3<T> t = translation(dq);
+    result.d[3][0] = t.x;
+    result.d[3][1] = t.y;
+    result.d[3][2] = t.z;
+    return result;
+  }
+  
+  // Scales dq to a unit real part and removes the component of the dual part along it, so that dq is a rigid
+  // transform again after blending or accumulated round-off.
+  template <typename T>
+  inline DualQuat<T> normalize(const DualQuat<T>& dq)
+  {
+    const T magInv = 1 / mag(dq.real);
+    const Quat<T> real = dq.real * magInv;
+    const Quat<T> dual = dq.dual * magInv;
+    return DualQuat<T>{real, dual - real * dot(real, dual)};
+  }
+  
+  // Conjugates both parts; this is the inverse of a unit dual quaternion.
+  template <typename T>
+  inline DualQuat<T> conjugate(const DualQuat<T>& dq)
+  {
+    return DualQuat<T>{conjugate(dq.real), conjugate(dq.dual)};
+  }
+  
+  template <typename T>
+  inline DualQuat<T> inverse(const DualQuat<T>& dq)
+  {
+    const Quat<T> realInv = inverse(dq.real);
+    return DualQuat<T>{realInv, -(realInv * dq.dual * realInv)};
+  }
+  
+  // dq is assumed to be normalized. p is a point (w = 1).
+  template <typename T>
+  inline Vec3<T> transformPoint(const DualQuat<T>& dq, const Vec3<T>& p)
+  {
+    return rotate(dq.real, p) + translation(dq);
+  }
+  
+  // dq is assumed to be normalized. v is a direction (w = 0).
+  template <typename T>
+  inline Vec3<T> transformVector(const DualQuat<T>& dq, const Vec3<T>& v)
+  {
+    return rotate(dq.real, v);
+  }
+  
+  // Dual quaternion linear blending (Kavan et al. 2007): sums weights[i] * dqs[i], flipping each term onto the
+  // hemisphere of dqs[0] so that the blend takes the shorter path, and normalizes the result.
+  template <typename T>
+  inline DualQuat<T> blend(const DualQuat<T>* dqs, const T* weights, std::size_t count)
+  {
+    DualQuat<T> result{Quat<T>{0, 0, 0, 0}, Quat<T>{0, 0, 0, 0}};
+    for (std::size_t i = 0; i < count; i++)
+      result = result + dqs[i] * (dot(dqs[i].real, dqs[0].real) < 0 ? -weights[i] : weights[i]);
+    return normalize(result);
+  }
+  
+  namespace Detail
+  {
+    // Gathers bone k of the P::width vertices starting at i, one vertex per lane.
+    template <typename P, typename T>
+    struct BoneGather
+    {
+      static inline void load(const DualQuat<T>* bones, const std::uint32_t* indices, std::size_t i, unsigned int k,
+                              Quat<P>& real, Quat<P>& dual)
+      {
+        T lanes[8][P::width];
+        for (unsigned int l = 0; l < P::width; l++)
+        {
+          const DualQuat<T>& b = bones[indices[4 * (i + l) + k]];
+          lanes[0][l] = b.real.x;
+          lanes[1][l] = b.real.y;
+          lanes[2][l] = b.real.z;
+          lanes[3][l] = b.real.w;
+          lanes[4][l] = b.dual.x;
+          lanes[5][l] = b.dual.y;
+          lanes[6][l] = b.dual.z;
+          lanes[7][l] = b.dual.w;
+        }
+        real = Quat<P>{P::load(lanes[0]), P::load(lanes[1]), P::load(lanes[2]), P::load(lanes[3])};
+        dual = Quat<P>{P::load(lanes[4]), P::load(lanes[5]), P::load(lanes[6]), P::load(lanes[7])};
+      }
+    };
+    
+#if defined(NEON_SIMD_SSE2)
+    // Each part of a bone is one register; a 4x4 transpose turns four bones into one lane each.
+    template <>
+    struct BoneGather<Pack<float, 4>, float>
+    {
+      static inline void load(const DualQuat<float>* bones, const std::uint32_t* indices, std::size_t i, unsigned int k,
+                              Quat<Pack<float, 4>>& real, Quat<Pack<float, 4>>& dual)
+      {
+        const std::uint32_t* index = indices + 4 * i + k;
+        const DualQuat<float>& b0 = bones[index[0]];
+        const DualQuat<float>& b1 = bones[index[4]];
+        const DualQuat<float>& b2 = bones[index[8]];
+        const DualQuat<float>& b3 = bones[index[12]];
+        __m128 r0 = _mm_loadu_ps(&b0.real.x);
+        __m128 r1 = _mm_loadu_ps(&b1.real.x);
+        __m128 r2 = _mm_loadu_ps(&b2.real.x);
+        __m128 r3 = _mm_loadu_ps(&b3.real.x);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        real = Quat<Pack<float, 4>>{Pack<float, 4>(r0), Pack<float, 4>(r1), Pack<float, 4>(r2), Pack<float, 4>(r3)};
+        __m128 d0 = _mm_loadu_ps(&b0.dual.x);
+        __m128 d1 = _mm_loadu_ps(&b1.dual.x);
+        __m128 d2 = _mm_loadu_ps(&b2.dual.x);
+        __m128 d3 = _mm_loadu_ps(&b3.dual.x);
+        _MM_TRANSPOSE4_PS(d0, d1, d2, d3);
+        dual = Quat<Pack<float, 4>>{Pack<float, 4>(d0), Pack<float, 4>(d1), Pack<float, 4>(d2), Pack<float, 4>(d3)};
+      }
+    };
+    
+    // Two bones, each four registers of two components.
+    template <>
+    struct BoneGather<Pack<double, 2>, double>
+    {
+      static inline void load(const DualQuat<double>* bones, const std::uint32_t* indices, std::size_t i, unsigned int k,
+                              Quat<Pack<double, 2>>& real, Quat<Pack<double, 2>>& dual)
+      {
+        const double* b0 = &bones[indices[4 * i + k]].real.x;
+        const double* b1 = &bones[indices[4 * i + 4 + k]].real.x;
+        Pack<double, 2> lanes[8];
+        for (unsigned int c = 0; c < 8; c += 2)
+        {
+          const __m128d v0 = _mm_loadu_pd(b0 + c);
+          const __m128d v1 = _mm_loadu_pd(b1 + c);
+          lanes[c] = Pack<double, 2>(_mm_unpacklo_pd(v0, v1));
+          lanes[c + 1] = Pack<double, 2>(_mm_unpackhi_pd(v0, v1));
+        }
+        real = Quat<Pack<double, 2>>{lanes[0], lanes[1], lanes[2], lanes[3]};
+        dual = Quat<Pack<double, 2>>{lanes[4], lanes[5], lanes[6], lanes[7]};
+      }
+    };
+#endif
+    
+#if defined(NEON_SIMD_AVX)
+    // Eight vertices: the low and high halves are two four-bone transposes.
+    template <>
+    struct BoneGather<Pack<float, 8>, float>
+    {
+      static inline void load(const DualQuat<float>* bones, const std::uint32_t* indices, std::size_t i, unsigned int k,
+                              Quat<Pack<float, 8>>& real, Quat<Pack<float, 8>>& dual)
+      {
+        using Half = BoneGather<Pack<float, 4>, float>;
+        Quat<Pack<float, 4>> realLo;
+        Quat<Pack<float, 4>> dualLo;
+        Quat<Pack<float, 4>> realHi;
+        Quat<Pack<float, 4>> dualHi;
+        Half::load(bones, indices, i, k, realLo, dualLo);
+        Half::load(bones, indices, i + 4, k, realHi, dualHi);
+        real = Quat<Pack<float, 8>>{combine(realLo.x, realHi.x), combine(realLo.y, realHi.y), combine(realLo.z, realHi.z), combine(realLo.w, realHi.w)};
+        dual = Quat<Pack<float, 8>>{combine(dualLo.x, dualHi.x), combine(dualLo.y, dualHi.y), combine(dualLo.z, dualHi.z), combine(dualLo.w, dualHi.w)};
+      }
+      
+    private:
+      static inline Pack<float, 8> combine(Pack<float, 4> lo, Pack<float, 4> hi)
+      {
+        return Pack<float, 8>(_mm256_insertf128_ps(_mm256_castps128_ps256(lo.v), hi.v, 1));
+      }
+    };
+    
+    template <>
+    struct BoneGather<Pack<double, 4>, double>
+    {
+      static inline void load(const DualQuat<double>* bones, const std::uint32_t* indices, std::size_t i, unsigned int k,
+                              Quat<Pack<double, 4>>& real, Quat<Pack<double, 4>>& dual)
+      {
+        const std::uint32_t* index = indices + 4 * i + k;
+        const DualQuat<double>& b0 = bones[index[0]];
+        const DualQuat<double>& b1 = bones[index[4]];
+        const DualQuat<double>& b2 = bones[index[8]];
+        const DualQuat<double>& b3 = bones[index[12]];
+        real = transpose(_mm256_loadu_pd(&b0.real.x), _mm256_loadu_pd(&b1.real.x), _mm256_loadu_pd(&b2.real.x), _mm256_loadu_pd(&b3.real.x));
+        dual = transpose(_mm256_loadu_pd(&b0.dual.x), _mm256_loadu_pd(&b1.dual.x), _mm256_loadu_pd(&b2.dual.x), _mm256_loadu_pd(&b3.dual.x));
+      }
+      
+    private:
+      static inline Quat<Pack<double, 4>> transpose(__m256d q0, __m256d q1, __m256d q2, __m256d q3)
+      {
+        const __m256d xz01 = _mm256_unpacklo_pd(q0, q1);
+        const __m256d yw01 = _mm256_unpackhi_pd(q0, q1);
+        const __m256d xz23 = _mm256_unpacklo_pd(q2, q3);
+        const __m256d yw23 = _mm256_unpackhi_pd(q2, q3);
+        return Quat<Pack<double, 4>>{Pack<double, 4>(_mm256_permute2f128_pd(xz01, xz23, 0x20)),
+                                     Pack<double, 4>(_mm256_permute2f128_pd(yw01, yw23, 0x20)),
+                                     Pack<double, 4>(_mm256_permute2f128_pd(xz01, xz23, 0x31)),
+                                     Pack<double, 4>(_mm256_permute2f128_pd(yw01, yw23, 0x31))};
+      }
+    };
+#endif
+    
+    template <typename P>
+    inline P dotLanes(const Quat<P>& a, const Quat<P>& b)
+    {
+      return madd(a.x, b.x, madd(a.y, b.y, madd(a.z, b.z, a.w * b.w)));
+    }
+    
+    template <typename P>
+    inline void maddLanes(const Quat<P>& q, P w, Quat<P>& acc)
+    {
+      acc.x = madd(q.x, w, acc.x);
+      acc.y = madd(q.y, w, acc.y);
+      acc.z = madd(q.z, w, acc.z);
+      acc.w = madd(q.w, w, acc.w);
+    }
+    
+    template <typename T>
+    struct SkinKernel
+    {
+      const DualQuat<T>* bones;
+      const Vec3Stream<T>& positions;
+      const Vec3Stream<T>* normals;
+      const Vec4Stream<T>& weights;
+      const std::uint32_t* indices;
+      Vec3Stream<T>& outPositions;
+      Vec3Stream<T>* outNormals;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        const Vec4<P> w = streamLoad<P>(weights, i);
+        const P wk[4] = {w.x, w.y, w.z, w.w};
+        Quat<P> r0;
+        Quat<P> d0;
+        BoneGather<P, T>::load(bones, indices, i, 0, r0, d0);
+        Quat<P> real{r0.x * wk[0], r0.y * wk[0], r0.z * wk[0], r0.w * wk[0]};
+        Quat<P> dual{d0.x * wk[0], d0.y * wk[0], d0.z * wk[0], d0.w * wk[0]};
+        for (unsigned int k = 1; k < 4; k++)
+        {
+          Quat<P> r;
+          Quat<P> d;
+          BoneGather<P, T>::load(bones, indices, i, k, r, d);
+          const P wSigned = select(dotLanes(r, r0) < P(0), -wk[k], wk[k]);
+          maddLanes(r, wSigned, real);
+          maddLanes(d, wSigned, dual);
+        }
+        
+        // Only the direction of real matters for the rotation; the translation needs both parts scaled by 1/|real|.
+        const P magInv = P(1) / sqrt(dotLanes(real, real));
+        const Vec3<P> u{real.x * magInv, real.y * magInv, real.z * magInv};
+        const P s = real.w * magInv;
+        const Vec3<P> dv{dual.x * magInv, dual.y * magInv, dual.z * magInv};
+        const P ds = dual.w * magInv;
+        const Vec3<P> t = (s * dv - ds * u + cross(u, dv)) * P(2);
+        
+        const Vec3<P> p = streamLoad<P>(positions, i);
+        const Vec3<P> tp = cross(u, p) * P(2);
+        streamStore<P>(outPositions, i, Vec3<P>(p + s * tp + cross(u, tp) + t));
+        if (normals)
+        {
+          const Vec3<P> n = streamLoad<P>(*normals, i);
+          const Vec3<P> tn = cross(u, n) * P(2);
+          streamStore<P>(*outNormals, i, Vec3<P>(n + s * tn + cross(u, tn)));
+        }
+      }
+    };
+  }
+  
+  // Dual quaternion skinning of every vertex in positions: blends the four bones indices[4 * i + k], k = 0..3,
+  // with weights (x, y, z, w)[i] as in blend() and writes the transformed position to outPositions. Bones are
+  // assumed to be normalized and the weights of a vertex to sum to one. Runs Pack<T>::width vertices at a time.
+  template <typename T>
+  inline void skin(const DualQuat<T>* bones, const Vec3Stream<T>& positions, const Vec4Stream<T>& weights,
+                   const std::uint32_t* indices, Vec3Stream<T>& outPositions)
+  {
+    outPositions.resize(positions.size());
+    Detail::forEachPack<T>(positions.size(), Detail::SkinKernel<T>{bones, positions, nullptr, weights, indices, outPositions, nullptr});
+  }
+  
+  // Also rotates normals, which must have the size of positions, into outNormals.
+  template <typename T>
+  inline void skin(const DualQuat<T>* bones, const Vec3Stream<T>& positions, const Vec3Stream<T>& normals,
+                   const Vec4Stream<T>& weights, const std::uint32_t* indices, Vec3Stream<T>& outPositions, Vec3Stream<T>& outNormals)
+  {
+    outPositions.resize(positions.size());
+    outNormals.resize(positions.size());
+    Detail::forEachPack<T>(positions.size(), Detail::SkinKernel<T>{bones, positions, &normals, weights, indices, outPositions, &outNormals});
+  }
+  
+  /* Batched transforms */
+  
+  namespace Detail
+  {
+    // Lanes per iteration when transforming AoS Vec3/Vec4 arrays; see aosLoad/aosStore.
+    template <typename T>
+    struct AosPackWidth
+    {
+      static const unsigned int value = 1;
+    };
+    
+#if defined(NEON_SIMD_SSE2)
+    template <>
+    struct AosPackWidth<float>
+    {
+      static const unsigned int value = 4;
+    };
+    
+    template <>
+    struct AosPackWidth<double>
+    {
+      static const unsigned int value = 2;
+    };
+#endif
+    
+    template <typename T>
+    inline Vec3<Pack<T, 1>> aosLoad(const Vec3<T>* p)
+    {
+      return Vec3<Pack<T, 1>>{p->x, p->y, p->z};
+    }
+    
+    template <typename T>
+    inline void aosStore(Vec3<T>* p, const Vec3<Pack<T, 1>>& v)
+    {
+      p->x = v.x.v;
+      p->y = v.y.v;
+      p->z = v.z.v;
+    }
+    
+#if defined(NEON_SIMD_SSE2)
+    // Four packed Vec3f are three registers: x0y0z0x1 y1z1x2y2 z2x3y3z3.
+    inline Vec3<Pack<float, 4>> aosLoad(const Vec3<float>* p)
+    {
+      const float* f = &p->x;
+      const __m128 a = _mm_loadu_ps(f);
+      const __m128 b = _mm_loadu_ps(f + 4);
+      const __m128 c = _mm_loadu_ps(f + 8);
+      const __m128 xx = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+      const __m128 y01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+      const __m128 y23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+      const __m128 zz = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+      return Vec3<Pack<float, 4>>{Pack<float, 4>(_mm_shuffle_ps(a, xx, _MM_SHUFFLE(2, 0, 3, 0))),
+                                  Pack<float, 4>(_mm_shuffle_ps(y01, y23, _MM_SHUFFLE(2, 0, 2, 0))),
+                                  Pack<float, 4>(_mm_shuffle_ps(zz, c, _MM_SHUFFLE(3, 0, 2, 0)))};
+    }
+    
+    inline void aosStore(Vec3<float>* p, const Vec3<Pack<float, 4>>& v)
+    {
+      const __m128 xy = _mm_unpacklo_ps(v.x.v, v.y.v);
+      const __m128 zx = _mm_shuffle_ps(v.z.v, v.x.v, _MM_SHUFFLE(1, 1, 0, 0));
+      const __m128 yz1 = _mm_shuffle_ps(v.y.v, v.z.v, _MM_SHUFFLE(1, 1, 1, 1));
+      const __m128 xy2 = _mm_shuffle_ps(v.x.v, v.y.v, _MM_SHUFFLE(2, 2, 2, 2));
+      const __m128 zx2 = _mm_shuffle_ps(v.z.v, v.x.v, _MM_SHUFFLE(3, 3, 2, 2));
+      const __m128 yz = _mm_unpackhi_ps(v.y.v, v.z.v);
+      float* f = &p->x;
+      _mm_storeu_ps(f, _mm_shuffle_ps(xy, zx, _MM_SHUFFLE(2, 0, 1, 0)));
+      _mm_storeu_ps(f + 4, _mm_shuffle_ps(yz1, xy2, _MM_SHUFFLE(2, 0, 2, 0)));
+      _mm_storeu_ps(f + 8, _mm_shuffle_ps(zx2, yz, _MM_SHUFFLE(3, 2, 2, 0)));
+    }
+    
+    // Two packed Vec3d are three registers: x0y0 z0x1 y1z1.
+    inline Vec3<Pack<double, 2>> aosLoad(const Vec3<double>* p)
+    {
+      const double* f = &p->x;
+      const __m128d a = _mm_loadu_pd(f);
+      const __m128d b = _mm_loadu_pd(f + 2);
+      const __m128d c = _mm_loadu_pd(f + 4);
+      return Vec3<Pack<double, 2>>{Pack<double, 2>(_mm_shuffle_pd(a, b, 2)),
+                                   Pack<double, 2>(_mm_shuffle_pd(a, c, 1)),
+                                   Pack<double, 2>(_mm_shuffle_pd(b, c, 2))};
+    }
+    
+    inline void aosStore(Vec3<double>* p, const Vec3<Pack<double, 2>>& v)
+    {
+      double* f = &p->x;
+      _mm_storeu_pd(f, _mm_shuffle_pd(v.x.v, v.y.v, 0));
+      _mm_storeu_pd(f + 2, _mm_shuffle_pd(v.z.v, v.x.v, 2));
+      _mm_storeu_pd(f + 4, _mm_shuffle_pd(v.y.v, v.z.v, 3));
+    }
+#endif
+    
+    // Matrix entries broadcast once per batch.
+    template <typename P, typename T>
+    inline Mat4<P> broadcast(const Mat4<T>& m)
+    {
+      Mat4<P> result;
+      for (unsigned int i = 0; i < 4; i++)
+        for (unsigned int j = 0; j < 4; j++)
+          result.d[i][j] = P(m.d[i][j]);
+      return result;
+    }
+    
+    template <typename P>
+    inline P transformRow(const Mat4<P>& m, unsigned int row, const Vec3<P>& v)
+    {
+      return madd(m.d[0][row], v.x, madd(m.d[1][row], v.y, m.d[2][row] * v.z));
+    }
+    
+    template <typename P>
+    inline Vec3<P> transformPoint(const Mat4<P>& m, const Vec3<P>& v)
+    {
+      return Vec3<P>{transformRow(m, 0, v) + m.d[3][0],
+                     transformRow(m, 1, v) + m.d[3][1],
+                     transformRow(m, 2, v) + m.d[3][2]};
+    }
+    
+    template <typename P>
+    inline Vec3<P> transformVector(const Mat4<P>& m, const Vec3<P>& v)
+    {
+      return Vec3<P>{transformRow(m, 0, v), transformRow(m, 1, v), transformRow(m, 2, v)};
+    }
+    
+    template <typename P>
+    inline Vec3<P> transformPointProjective(const Mat4<P>& m, const Vec3<P>& v)
+    {
+      const P wInv = P(1) / (transformRow(m, 3, v) + m.d[3][3]);
+      return transformPoint(m, v) * wInv;
+    }
+    
+    enum class TransformKind
+    {
+      Point,
+      Vector,
+      PointProjective
+    };
+    
+    template <TransformKind K, typename P>
+    inline typename std::enable_if<K == TransformKind::Point, Vec3<P>>::type
+    transform(const Mat4<P>& m, const Vec3<P>& v)
+    {
+      return transformPoint(m, v);
+    }
+    
+    template <TransformKind K, typename P>
+    inline typename std::enable_if<K == TransformKind::Vector, Vec3<P>>::type
+    transform(const Mat4<P>& m, const Vec3<P>& v)
+    {
+      return transformVector(m, v);
+    }
+    
+    template <TransformKind K, typename P>
+    inline typename std::enable_if<K == TransformKind::PointProjective, Vec3<P>>::type
+    transform(const Mat4<P>& m, const Vec3<P>& v)
+    {
+      return transformPointProjective(m, v);
+    }
+    
+    template <TransformKind K, typename T>
+    inline void transformArray(const Mat4<T>& m, const Vec3<T>* src, Vec3<T>* dst, std::size_t count)
+    {
+      using P = Pack<T, AosPackWidth<T>::value>;
+      const Mat4<P> mp = broadcast<P>(m);
+      const Mat4<Pack<T, 1>> ms = broadcast<Pack<T, 1>>(m);
+      const std::size_t body = count - count % P::width;
+      std::size_t i = 0;
+      for (; i < body; i += P::width)
+        aosStore(dst + i, transform<K>(mp, aosLoad(src + i)));
+      for (; i < count; i++)
+        aosStore(dst + i, transform<K>(ms, aosLoad<T>(src + i)));
+    }
+    
+    template <TransformKind K, typename T>
+    struct TransformStreamKernel
+    {
+      const Mat4<T>& m;
+      const Vec3Stream<T>& src;
+      Vec3Stream<T>& dst;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        streamStore<P>(dst, i, transform<K>(broadcast<P>(m), streamLoad<P>(src, i)));
+      }
+    };
+    
+    template <typename T>
+    struct TransformStream4Kernel
+    {
+      const Mat4<T>& m;
+      const Vec4Stream<T>& src;
+      Vec4Stream<T>& dst;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        streamStore<P>(dst, i, broadcast<P>(m) * streamLoad<P>(src, i));
+      }
+    };
+  }
+  
+  // Transforms count points (w = 1) by m. dst may be src.
+  template <typename T>
+  inline void transformPoints(const Mat4<T>& m, const Vec3<T>* src, Vec3<T>* dst, std::size_t count)
+  {
+    Detail::transformArray<Detail::TransformKind::Point>(m, src, dst, count);
+  }
+  
+  template <typename T>
+  inline void transformPoints(const Mat4<T>& m, Vec3<T>* points, std::size_t count)
+  {
+    transformPoints(m, points, points, count);
+  }
+  
+  // Transforms count directions (w = 0) by m, ignoring translation. dst may be src.
+  template <typename T>
+  inline void transformVectors(const Mat4<T>& m, const Vec3<T>* src, Vec3<T>* dst, std::size_t count)
+  {
+    Detail::transformArray<Detail::TransformKind::Vector>(m, src, dst, count);
+  }
+  
+  template <typename T>
+  inline void transformVectors(const Mat4<T>& m, Vec3<T>* vectors, std::size_t count)
+  {
+    transformVectors(m, vectors, vectors, count);
+  }
+  
+  // Transforms count points (w = 1) by m followed by the perspective divide. dst may be src.
+  template <typename T>
+  inline void transformPointsProjective(const Mat4<T>& m, const Vec3<T>* src, Vec3<T>* dst, std::size_t count)
+  {
+    Detail::transformArray<Detail::TransformKind::PointProjective>(m, src, dst, count);
+  }
+  
+  template <typename T>
+  inline void transformPointsProjective(const Mat4<T>& m, Vec3<T>* points, std::size_t count)
+  {
+    transformPointsProjective(m, points, points, count);
+  }
+  
+  // dst[i] = m * src[i]. dst may be src.
+  template <typename T>
+  inline void transform(const Mat4<T>& m, const Vec4<T>* src, Vec4<T>* dst, std::size_t count)
+  {
+    // dst may also alias m, so each store would force the columns to be reloaded. The local copy cannot be
+    // aliased, which lets them stay in registers across the loop.
+    const Mat4<T> local = m;
+    for (std::size_t i = 0; i < count; i++)
+      Detail::mat4MulVec4(local.d, &src[i].x, &dst[i].x);
+  }
+  
+  template <typename T>
+  inline void transform(const Mat4<T>& m, Vec4<T>* v, std::size_t count)
+  {
+    transform(m, v, v, count);
+  }
+  
+  template <typename T>
+  inline void transformPoints(const Mat4<T>& m, const Vec3Stream<T>& src, Vec3Stream<T>& dst)
+  {
+    dst.resize(src.size());
+    Detail::forEachPack<T>(src.size(), Detail::TransformStreamKernel<Detail::TransformKind::Point, T>{m, src, dst});
+  }
+  
+  template <typename T>
+  inline void transformVectors(const Mat4<T>& m, const Vec3Stream<T>& src, Vec3Stream<T>& dst)
+  {
+    dst.resize(src.size());
+    Detail::forEachPack<T>(src.size(), Detail::TransformStreamKernel<Detail::TransformKind::Vector, T>{m, src, dst});
+  }
+  
+  template <typename T>
+  inline void transformPointsProjective(const Mat4<T>& m, const Vec3Stream<T>& src, Vec3Stream<T>& dst)
+  {
+    dst.resize(src.size());
+    Detail::forEachPack<T>(src.size(), Detail::TransformStreamKernel<Detail::TransformKind::PointProjective, T>{m, src, dst});
+  }
+  
+  template <typename T>
+  inline void transform(const Mat4<T>& m, const Vec4Stream<T>& src, Vec4Stream<T>& dst)
+  {
+    dst.resize(src.size());
+    Detail::forEachPack<T>(src.size(), Detail::TransformStream4Kernel<T>{m, src, dst});
+  }
+  
+  /* Batched matrix operations */
+  
+  namespace Detail
+  {
+    // Converts between P::width consecutive matrices and one matrix whose entries hold one matrix per lane.
+    template <typename P, typename T>
+    struct LaneTranspose
+    {
+      static inline Mat4<P> load(const Mat4<T>* m)
+      {
+        Mat4<P> result;
+        T lanes[P::width];
+        for (unsigned int i = 0; i < 4; i++)
+        {
+          for (unsigned int j = 0; j < 4; j++)
+          {
+            for (unsigned int k = 0; k < P::width; k++)
+              lanes[k] = m[k].d[i][j];
+            result.d[i][j] = P::load(lanes);
+          }
+        }
+        return result;
+      }
+      
+      static inline void store(const Mat4<P>& lanesMatrix, Mat4<T>* m)
+      {
+        T lanes[P::width];
+        for (unsigned int i = 0; i < 4; i++)
+        {
+          for (unsigned int j = 0; j < 4; j++)
+          {
+            lanesMatrix.d[i][j].store(lanes);
+            for (unsigned int k = 0; k < P::width; k++)
+              m[k].d[i][j] = lanes[k];
+          }
+        }
+      }
+    };
+    
+#if defined(NEON_SIMD_SSE2)
+    // Four matrices: each column is a 4x4 transpose.
+    template <>
+    struct LaneTranspose<Pack<float, 4>, float>
+    {
+      static inline Mat4<Pack<float, 4>> load(const Mat4<float>* m)
+      {
+        Mat4<Pack<float, 4>> result;
+        for (unsigned int i = 0; i < 4; i++)
+        {
+          __m128 r0 = _mm_loadu_ps(m[0].d[i]);
+          __m128 r1 = _mm_loadu_ps(m[1].d[i]);
+          __m128 r2 = _mm_loadu_ps(m[2].d[i]);
+          __m128 r3 = _mm_loadu_ps(m[3].d[i]);
+          _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+          result.d[i][0] = Pack<float, 4>(r0);
+          result.d[i][1] = Pack<float, 4>(r1);
+          result.d[i][2] = Pack<float, 4>(r2);
+          result.d[i][3] = Pack<float, 4>(r3);
+        }
+        return result;
+      }
+      
+      static inline void store(const Mat4<Pack<float, 4>>& lanesMatrix, Mat4<float>* m)
+      {
+        for (unsigned int i = 0; i < 4; i++)
+        {
+          __m128 r0 = lanesMatrix.d[i][0].v;
+          __m128 r1 = lanesMatrix.d[i][1].v;
+          __m128 r2 = lanesMatrix.d[i][2].v;
+          __m128 r3 = lanesMatrix.d[i][3].v;
+          _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+          _mm_storeu_ps(m[0].d[i], r0);
+          _mm_storeu_ps(m[1].d[i], r1);
+          _mm_storeu_ps(m[2].d[i], r2);
+          _mm_storeu_ps(m[3].d[i], r3);
+        }
+      }
+    };
+#endif
+    
+#if defined(NEON_SIMD_AVX)
+    // Eight matrices: the low and high halves are two four-matrix transposes.
+    template <>
+    struct LaneTranspose<Pack<float, 8>, float>
+    {
+      static inline Mat4<Pack<float, 8>> load(const Mat4<float>* m)
+      {
+        using Half = LaneTranspose<Pack<float, 4>, float>;
+        const Mat4<Pack<float, 4>> lo = Half::load(m);
+        const Mat4<Pack<float, 4>> hi = Half::load(m + 4);
+        Mat4<Pack<float, 8>> result;
+        for (unsigned int i = 0; i < 4; i++)
+          for (unsigned int j = 0; j < 4; j++)
+            result.d[i][j] = Pack<float, 8>(_mm256_insertf128_ps(_mm256_castps128_ps256(lo.d[i][j].v), hi.d[i][j].v, 1));
+        return result;
+      }
+      
+      static inline void store(const Mat4<Pack<float, 8>>& lanesMatrix, Mat4<float>* m)
+      {
+        using Half = LaneTranspose<Pack<float, 4>, float>;
+        Mat4<Pack<float, 4>> lo;
+        Mat4<Pack<float, 4>> hi;
+        for (unsigned int i = 0; i < 4; i++)
+        {
+          for (unsigned int j = 0; j < 4; j++)
+          {
+            lo.d[i][j] = Pack<float, 4>(_mm256_castps256_ps128(lanesMatrix.d[i][j].v));
+            hi.d[i][j] = Pack<float, 4>(_mm256_extractf128_ps(lanesMatrix.d[i][j].v, 1));
+          }
+        }
+        Half::store(lo, m);
+        Half::store(hi, m + 4);
+      }
+    };
+#endif
+    
+    template <typename P, typename T>
+    inline void inverseLanes(const Mat4<T>* src, Mat4<T>* dst, bool* singular)
+    {
+      const Mat4<P> m = LaneTranspose<P, T>::load(src);
+      P det(0);
+      const Mat4<P> result = Detail::inverse(m, [&det](P d) -> P
+      {
+        det = d;
+        return select(d == P(0), P(0), P(1) / d);
+      });
+      LaneTranspose<P, T>::store(result, dst);
+      if (singular)
+      {
+        const unsigned int mask = bits(det == P(0));
+        for (unsigned int k = 0; k < P::width; k++)
+          singular[k] = ((mask >> k) & 1u) != 0;
+      }
+    }
+    
+    template <typename P, typename T>
+    inline void determinantLanes(const Mat4<T>* src, T* dst)
+    {
+      determinant(LaneTranspose<P, T>::load(src)).store(dst);
+    }
+  }
+  
+  // Inverts count matrices, Pack<T>::width at a time with one matrix per SIMD lane. A matrix with a zero
+  // determinant is inverted to the zero matrix and, if singular is given, flagged in singular[i].
+  // dst may be src.
+  template <typename T>
+  inline void inverseBatch(const Mat4<T>* src, Mat4<T>* dst, std::size_t count, bool* singular = nullptr)
+  {
+    const unsigned int width = Detail::Pack<T>::width;
+    const std::size_t body = count - count % width;
+    std::size_t i = 0;
+    for (; i < body; i += width)
+      Detail::inverseLanes<Detail::Pack<T>>(src + i, dst + i, singular ? singular + i : nullptr);
+    for (; i < count; i++)
+      Detail::inverseLanes<Detail::Pack<T, 1>>(src + i, dst + i, singular ? singular + i : nullptr);
+  }
+  
+  template <typename T>
+  inline void determinantBatch(const Mat4<T>* src, T* dst, std::size_t count)
+  {
+    const unsigned int width = Detail::Pack<T>::width;
+    const std::size_t body = count - count % width;
+    std::size_t i = 0;
+    for (; i < body; i += width)
+      Detail::determinantLanes<Detail::Pack<T>>(src + i, dst + i);
+    for (; i < count; i++)
+      Detail::determinantLanes<Detail::Pack<T, 1>>(src + i, dst + i);
+  }
+  
+  // dst[i] = a[i] * b[i]. dst may be a or b.
+  template <typename T>
+  inline void multiplyBatch(const Mat4<T>* a, const Mat4<T>* b, Mat4<T>* dst, std::size_t count)
+  {
+    for (std::size_t i = 0; i < count; i++)
+      dst[i] = a[i] * b[i];
+  }
+  
+  // dst[i] = normalMatrix(src[i]).
+  template <typename T, NormalForm F = NormalForm::InverseTranspose>
+  inline void normalMatrixBatch(const Mat4<T>* src, Mat3<T>* dst, std::size_t count)
+  {
+    for (std::size_t i = 0; i < count; i++)
+      dst[i] = normalMatrix<T, F>(src[i]);
+  }
+  
+  template <typename T, NormalForm F = NormalForm::InverseTranspose>
+  inline void normalMatrixBatch(const Affine<T>* src, Mat3<T>* dst, std::size_t count)
+  {
+    for (std::size_t i = 0; i < count; i++)
+      dst[i] = normalMatrix<T, F>(src[i]);
+  }
+  
+  /* Aligned storage */
+  // Vec3A, Vec4A and Mat4A hold the components of Vec3, Vec4 and Mat4 aligned to 4 * sizeof(T) bytes (16 for
+  // float, 32 for double), with Vec3A padded to four components, so that every vector and matrix column is one
+  // aligned register load or store. They convert implicitly to and from the unaligned types. Keep arrays of them in
+  // an AlignedVector, or another container using AlignedAllocator, so that heap storage is aligned too.
+  
+  // Allocator aligning every allocation to Alignment bytes, and to at least alignof(T), which operator new does
+  // not honour for over-aligned types before C++17.
+  template <typename T, std::size_t Alignment = alignof(T)>
+  struct AlignedAllocator
+  {
+    static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two");
+    
+    using value_type = T;
+    
+    template <typename U>
+    struct rebind
+    {
+      using other = AlignedAllocator<U, Alignment>;
+    };
+    
+    AlignedAllocator() = default;
+    
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&)
+    {
+    }
+    
+    inline T* allocate(std::size_t n)
+    {
+      if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+        throw std::bad_alloc();
+      const std::size_t alignment = Alignment > alignof(T) ? Alignment : alignof(T);
+      return static_cast<T*>(Detail::alignedAlloc(n * sizeof(T), alignment > alignof(void*) ? alignment : alignof(void*)));
+    }
+    
+    inline void deallocate(T* p, std::size_t)
+    {
+      Detail::alignedFree(p);
+    }
+  };
+  
+  template <typename T, typename U, std::size_t Alignment>
+  inline bool operator==(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&)
+  {
+    return true;
+  }
+  
+  template <typename T, typename U, std::size_t Alignment>
+  inline bool operator!=(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&)
+  {
+    return false;
+  }
+  
+  template <typename T>
+  using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+  
+  template <typename T>
+  struct alignas(4 * sizeof(T)) Vec4A
+  {
+    T x, y, z, w;
+    
+    constexpr explicit Vec4A(T t = 0) : x(t), y(t), z(t), w(t)
+    {
+    }
+    
+    constexpr Vec4A(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w)
+    {
+    }
+    
+    constexpr Vec4A(const Vec4<T>& v) : x(v.x), y(v.y), z(v.z), w(v.w)
+    {
+    }
+    
+    constexpr operator Vec4<T>() const
+    {
+      return Vec4<T>(x, y, z, w);
+    }
+    
+    inline T& operator[](unsigned int i)
+    {
+      return ((&x)[i]);
+    }
+    
+    inline const T& operator[](unsigned int i) const
+    {
+      return ((&x)[i]);
+    }
+  };
+  
+  // pad is not part of the value: construction sets it to zero, the arithmetic operators carry whatever their
+  // fourth lane computes, and dot, mag and the conversion to Vec3 ignore it.
+  template <typename T>
+  struct alignas(4 * sizeof(T)) Vec3A
+  {
+    T x, y, z, pad;
+    
+    constexpr explicit Vec3A(T t = 0) : x(t), y(t), z(t), pad(0)
+    {
+    }
+    
+    constexpr Vec3A(T _x, T _y, T _z) : x(_x), y(_y), z(_z), pad(0)
+    {
+    }
+    
+    constexpr Vec3A(const Vec3<T>& v) : x(v.x), y(v.y), z(v.z), pad(0)
+    {
+    }
+    
+    constexpr operator Vec3<T>() const
+    {
+      return Vec3<T>(x, y, z);
+    }
+    
+    inline T& operator[](unsigned int i)
+    {
+      return ((&x)[i]);
+    }
+    
+    inline const T& operator[](unsigned int i) const
+    {
+      return ((&x)[i]);
+    }
+  };
+  
+  template <typename T>
+  struct alignas(4 * sizeof(T)) Mat4A
+  {
+    static const unsigned short size = 4;
+    T d[4][4];
+    
+    constexpr explicit Mat4A(T t = 1)
+      : d{{t, 0, 0, 0},
+          {0, t, 0, 0},
+          {0, 0, t, 0},
+          {0, 0, 0, t}}
+    {
+    }
+    
+    constexpr Mat4A(const Mat4<T>& m)
+      : d{{m.d[0][0], m.d[0][1], m.d[0][2], m.d[0][3]},
+          {m.d[1][0], m.d[1][1], m.d[1][2], m.d[1][3]},
+          {m.d[2][0], m.d[2][1], m.d[2][2], m.d[2][3]},
+          {m.d[3][0], m.d[3][1], m.d[3][2], m.d[3][3]}}
+    {
+    }
+    
+    inline operator Mat4<T>() const
+    {
+      Mat4<T> m;
+      std::copy(d[0], d[0] + 16, m.d[0]);
+      return m;
+    }
+    
+    inline Vec4A<T>& operator[](unsigned int col)
+    {
+      return *reinterpret_cast<Vec4A<T>*>(d[col]);
+    }
+    
+    inline const Vec4A<T>& operator[](unsigned int col) const
+    {
+      return *reinterpret_cast<const Vec4A<T>*>(d[col]);
+    }
+    
+    inline T& operator()(unsigned int row, unsigned int col)
+    {
+      return d[col][row];
+    }
+    
+    inline const T& operator()(unsigned int row, unsigned int col) const
+    {
+      return d[col][row];
+    }
+  };
+  
+  namespace Detail
+  {
+    // Non-temporal store of p to memory aligned to its width, bypassing the caches; a plain store without SIMD.
+    template <typename T, unsigned int W>
+    inline void storeNonTemporal(const Pack<T, W>& p, T* dst)
+    {
+      p.store(dst);
+    }
+    
+#if defined(NEON_SIMD_SSE2)
+    inline void storeNonTemporal(const Pack<float, 4>& p, float* dst)
+    {
+      _mm_stream_ps(dst, p.v);
+    }
+    
+    inline void storeNonTemporal(const Pack<double, 2>& p, double* dst)
+    {
+      _mm_stream_pd(dst, p.v);
+    }
+#endif
+#if defined(NEON_SIMD_AVX)
+    inline void storeNonTemporal(const Pack<double, 4>& p, double* dst)
+    {
+      _mm256_stream_pd(dst, p.v);
+    }
+#endif
+    
+    // Orders non-temporal stores before the stores that follow, such as a flag telling another thread that the
+    // data is ready.
+    inline void storeFence()
+    {
+#if defined(NEON_SIMD_SSE2)
+      _mm_sfence();
+#endif
+    }
+    
+    // The four lanes of an aligned vector or matrix column in the widest packs that fit them: one Pack<float, 4>
+    // or Pack<double, 4>, two Pack<double, 2> under plain SSE2, or four scalars without SIMD.
+    template <typename T>
+    struct Quad
+    {
+      static const unsigned int width = PackWidth<T>::value < 4 ? PackWidth<T>::value : 4;
+      static const unsigned int parts = 4 / width;
+      using P = Pack<T, width>;
+      P p[parts];
+      
+      static inline Quad load(const T* src)
+      {
+        Quad q;
+        for (unsigned int i = 0; i < parts; i++)
+          q.p[i] = P::load(src + i * width);
+        return q;
+      }
+      
+      static inline Quad splat(T t)
+      {
+        Quad q;
+        for (unsigned int i = 0; i < parts; i++)
+          q.p[i] = P(t);
+        return q;
+      }
+      
+      inline void store(T* dst) const
+      {
+        for (unsigned int i = 0; i < parts; i++)
+          p[i].store(dst + i * width);
+      }
+      
+      // dst must be aligned to width * sizeof(T).
+      inline void storeNonTemporal(T* dst) const
+      {
+        for (unsigned int i = 0; i < parts; i++)
+          Detail::storeNonTemporal(p[i], dst + i * width);
+      }
+      
+      friend inline Quad operator+(const Quad& a, const Quad& b)
+      {
+        Quad q;
+        for (unsigned int i = 0; i < parts; i++)
+          q.p[i] = a.p[i] + b.p[i];
+        return q;
+      }
+      
+      friend inline Quad operator-(const Quad& a, const Quad& b)
+      {
+        Quad q;
+        for (unsigned int i = 0; i < parts; i++)
+          q.p[i] = a.p[i] - b.p[i];
+        return q;
+      }
+      
+      friend inline Quad operator*(const Quad& a, const Quad& b)
+      {
+        Quad q;
+        for (unsigned int i = 0; i < parts; i++)
+          q.p[i] = a.p[i] * b.p[i];
+        return q;
+      }
+      
+      friend inline Quad operator/(const Quad& a, const Quad& b)
+      {
+        Quad q;
+        for (unsigned int i = 0; i < parts; i++)
+          q.p[i] = a.p[i] / b.p[i];
+        return q;
+      }
+      
+      friend inline Quad operator-(const Quad& a)
+      {
+        Quad q;
+        for (unsigned int i = 0; i < parts; i++)
+          q.p[i] = -a.p[i];
+        return q;
+      }
+      
+      friend inline Quad madd(const Quad& a, const Quad& b, const Quad& c)
+      {
+        Quad q;
+        for (unsigned int i = 0; i < parts; i++)
+          q.p[i] = madd(a.p[i], b.p[i], c.p[i]);
+        return q;
+      }
+    };
+  }
+  
+  template <typename T>
+  inline Vec4A<T> operator+(const Vec4A<T>& a, const Vec4A<T>& b)
+  {
+    Vec4A<T> r;
+    (Detail::Quad<T>::load(&a.x) + Detail::Quad<T>::load(&b.x)).store(&r.x);
+    return r;
+  }
+  
+  template <typename T>
+  inline Vec4A<T> operator-(const Vec4A<T>& a, const Vec4A<T>& b)
+  {
+    Vec4A<T> r;
+    (Detail::Quad<T>::load(&a.x) - Detail::Quad<T>::load(&b.x)).store(&r.x);
+    return r;
+  }
+  
+  template <typename T>
+  inline Vec4A<T> operator*(const Vec4A<T>& a, const Vec4A<T>& b)
+  {
+    Vec4A<T> r;
+    (Detail::Quad<T>::load(&a.x) * Detail::Quad<T>::load(&b.x)).store(&r.x);
+    return r;
+  }
+  
+  template <typename T>
+  inline Vec4A<T> operator-(const Vec4A<T>& a)
+  {
+    Vec4A<T> r;
+    (-Detail::Quad<T>::load(&a.x)).store(&r.x);
+    return r;
+  }
+  
+  template <typename T>
+  inline Vec4A<T> operator*(const Vec4A<T>& a, T t)
+  {
+    Vec4A<T> r;
+    (Detail::Quad<T>::load(&a.x) * Detail::Quad<T>::splat(t)).store(&r.x);
+    return r;
+  }
+  
+  template <typename T>
+  inline Vec4A<T> operator*(T t, const Vec4A<T>& a)
+  {
+    return a * t;
+  }
+  
+  template <typename T>
+  inline Vec4A<T> operator/(const Vec4A<T>& a, T t)
+  {
+    Vec4A<T> r;
+    (Detail::Quad<T>::load(&a.x) / Detail::Quad<T>::splat(t)).store(&r.x);
+    return r;
+  }
+  
+  template <typename T>
+  inline Vec3A<T> operator+(const Vec3A<T>& a, const Vec3A<T>& b)
+  {
+    Vec3A<T> r;
+    (Detail::Quad<T>::load(&a.x) + Detail::Quad<T>::load(&b.x)).store(&r.x);
+    return r;
+  }
+  
+  template <typename T>
+  inline Vec3A<T> operator-(const Vec3A<T>& a, const Vec3A<T>& b)
+  {
+    Vec3A<T> r;
+    (Detail::Quad<T>::load(&a.x) - Detail::Quad<T>::load(&b.x)).store(&r.x);
+    return r;
+  }
+  
+  template <typename T>
+  inline Vec3A<T> operator*(const Vec3A<T>& a, const Vec3A<T>& b)
+  {
+    Vec3A<T> r;
+    (Detail::Quad<T>::load(&a.x) * Detail::Quad<T>::load(&b.x)).store(&r.x);
+    return r;
+  }
+  
+  template <typename T>
+  inline Vec3A<T> operator-(const Vec3A<T>& a)
+  {
+    Vec3A<T> r;
+    (-Detail::Quad<T>::load(&a.x)).store(&r.x);
+    return r;
+  }
+  
+  template <typename T>
+  inline Vec3A<T> operator*(const Vec3A<T>& a, T t)
+  {
+    Vec3A<T> r;
+    (Detail::Quad<T>::load(&a.x) * Detail::Quad<T>::splat(t)).store(&r.x);
+    return r;
+  }
+  
+  template <typename T>
+  inline Vec3A<T> operator*(T t, const Vec3A<T>& a)
+  {
+    return a * t;
+  }
+  
+  template <typename T>
+  inline Vec3A<T> operator/(const Vec3A<T>& a, T t)
+  {
+    Vec3A<T> r;
+    (Detail::Quad<T>::load(&a.x) / Detail::Quad<T>::splat(t)).store(&r.x);
+    return r;
+  }
+  
+  template <typename T>
+  inline T dot(const Vec4A<T>& a, const Vec4A<T>& b)
+  {
+    Vec4A<T> p;
+    (Detail::Quad<T>::load(&a.x) * Detail::Quad<T>::load(&b.x)).store(&p.x);
+    return (p.x + p.y) + (p.z + p.w);
+  }
+  
+  template <typename T>
+  inline T dot(const Vec3A<T>& a, const Vec3A<T>& b)
+  {
+    Vec3A<T> p;
+    (Detail::Quad<T>::load(&a.x) * Detail::Quad<T>::load(&b.x)).store(&p.x);
+    return p.x + p.y + p.z;
+  }
+  
+  template <typename T>
+  inline Vec3A<T> cross(const Vec3A<T>& a, const Vec3A<T>& b)
+  {
+    return Vec3A<T>(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+  }
+  
+  template <typename T>
+  inline T mag(const Vec4A<T>& v)
+  {
+    return std::sqrt(dot(v, v));
+  }
+  
+  template <typename T>
+  inline T mag(const Vec3A<T>& v)
+  {
+    return std::sqrt(dot(v, v));
+  }
+  
+  template <typename T>
+  inline Vec4A<T> normalize(const Vec4A<T>& v)
+  {
+    return v / mag(v);
+  }
+  
+  template <typename T>
+  inline Vec3A<T> normalize(const Vec3A<T>& v)
+  {
+    return v / mag(v);
+  }
+  
+  template <typename T>
+  inline Vec4A<T> operator*(const Mat4A<T>& m, const Vec4A<T>& v)
+  {
+    using Q = Detail::Quad<T>;
+    Q r = Q::load(m.d[0]) * Q::splat(v.x);
+    r = madd(Q::load(m.d[1]), Q::splat(v.y), r);
+    r = madd(Q::load(m.d[2]), Q::splat(v.z), r);
+    r = madd(Q::load(m.d[3]), Q::splat(v.w), r);
+    Vec4A<T> out;
+    r.store(&out.x);
+    return out;
+  }
+  
+  template <typename T>
+  inline Mat4A<T> operator*(const Mat4A<T>& a, const Mat4A<T>& b)
+  {
+    Mat4A<T> r;
+    Detail::mat4Mul(a.d, b.d, r.d);
+    return r;
+  }
+  
+  namespace Detail
+  {
+    // Broadcast-multiply-add of the columns of m by each source vector, one aligned Quad per vector. Point and
+    // Vector transform Vec3A with lane 3 of the columns cleared, so the padding of dst stays zero; a Vec4A uses
+    // all four columns.
+    template <TransformKind K, typename T, typename V>
+    inline void transformAligned(const Mat4<T>& m, const V* src, V* dst, std::size_t count)
+    {
+      using Q = Quad<T>;
+      Mat4A<T> ma(m);
+      const bool vec4 = std::is_same<V, Vec4A<T>>::value;
+      if (!vec4)
+        ma.d[0][3] = ma.d[1][3] = ma.d[2][3] = ma.d[3][3] = 0;
+      const Q c0 = Q::load(ma.d[0]);
+      const Q c1 = Q::load(ma.d[1]);
+      const Q c2 = Q::load(ma.d[2]);
+      const Q c3 = Q::load(ma.d[3]);
+      for (std::size_t i = 0; i < count; i++)
+      {
+        const T* v = &src[i].x;
+        Q r = c0 * Q::splat(v[0]);
+        r = madd(c1, Q::splat(v[1]), r);
+        r = madd(c2, Q::splat(v[2]), r);
+        if (vec4)
+          r = madd(c3, Q::splat(v[3]), r);
+        else if (K == TransformKind::Point)
+          r = r + c3;
+        r.store(&dst[i].x);
+      }
+    }
+  }
+  
+  // Transforms count points (w = 1) by m. dst may be src.
+  template <typename T>
+  inline void transformPoints(const Mat4<T>& m, const Vec3A<T>* src, Vec3A<T>* dst, std::size_t count)
+  {
+    Detail::transformAligned<Detail::TransformKind::Point>(m, src, dst, count);
+  }
+  
+  template <typename T>
+  inline void transformPoints(const Mat4<T>& m, Vec3A<T>* points, std::size_t count)
+  {
+    transformPoints(m, points, points, count);
+  }
+  
+  // Transforms count directions (w = 0) by m, ignoring translation. dst may be src.
+  template <typename T>
+  inline void transformVectors(const Mat4<T>& m, const Vec3A<T>* src, Vec3A<T>* dst, std::size_t count)
+  {
+    Detail::transformAligned<Detail::TransformKind::Vector>(m, src, dst, count);
+  }
+  
+  template <typename T>
+  inline void transformVectors(const Mat4<T>& m, Vec3A<T>* vectors, std::size_t count)
+  {
+    transformVectors(m, vectors, vectors, count);
+  }
+  
+  // dst[i] = m * src[i]. dst may be src.
+  template <typename T>
+  inline void transform(const Mat4<T>& m, const Vec4A<T>* src, Vec4A<T>* dst, std::size_t count)
+  {
+    Detail::transformAligned<Detail::TransformKind::Point>(m, src, dst, count);
+  }
+  
+  template <typename T>
+  inline void transform(const Mat4<T>& m, Vec4A<T>* v, std::size_t count)
+  {
+    transform(m, v, v, count);
+  }
+  
+  /* Batched matrix composition */
+  
+  // How a batch operation writes its output. NonTemporal streams it past the caches, for output that is not read
+  // again soon, such as per-instance matrices on their way to a GPU buffer, and fences once at the end. It falls
+  // back to Cached stores when the output is not aligned to the register width: 16 bytes, or 32 for double
+  // under AVX.
+  enum class StoreMode
+  {
+    Cached,
+    NonTemporal
+  };
+  
+  namespace Detail
+  {
+    // a * b for one a and many b, with the columns of a kept in registers. out may be b.
+    template <typename T>
+    struct MatrixChain
+    {
+      Quad<T> a[4];
+      
+      explicit MatrixChain(const Mat4<T>& m)
+      {
+        for (unsigned int k = 0; k < 4; k++)
+          a[k] = Quad<T>::load(m.d[k]);
+      }
+      
+      template <bool Stream>
+      static inline void put(const Quad<T>& q, T* dst)
+      {
+        if (Stream)
+          q.storeNonTemporal(dst);
+        else
+          q.store(dst);
+      }
+      
+      inline Quad<T> linear(const T* v) const
+      {
+        Quad<T> r = a[0] * Quad<T>::splat(v[0]);
+        r = madd(a[1], Quad<T>::splat(v[1]), r);
+        return madd(a[2], Quad<T>::splat(v[2]), r);
+      }
+      
+      template <bool Stream>
+      inline void apply(const Mat4<T>& b, Mat4<T>& out) const
+      {
+        for (unsigned int j = 0; j < 4; j++)
+          put<Stream>(madd(a[3], Quad<T>::splat(b.d[j][3]), linear(b.d[j])), out.d[j]);
+      }
+      
+      // The implicit last row (0, 0, 0, 1) of b adds column 3 of a to the translation only.
+      template <bool Stream>
+      inline void apply(const Affine<T>& b, Mat4<T>& out) const
+      {
+        for (unsigned int j = 0; j < 3; j++)
+          put<Stream>(linear(b.d[j]), out.d[j]);
+        put<Stream>(linear(b.d[3]) + a[3], out.d[3]);
+      }
+    };
+    
+    template <typename T, bool Stream, typename M>
+    inline void composeArray(const MatrixChain<T>& chain, const M* b, Mat4<T>* dst, Mat3<T>* normals, std::size_t count)
+    {
+      for (std::size_t i = 0; i < count; i++)
+      {
+        if (normals)
+          normals[i] = normalMatrix(b[i]);
+        chain.template apply<Stream>(b[i], dst[i]);
+      }
+      if (Stream)
+        storeFence();
+    }
+    
+    template <typename T, StoreMode S, typename M>
+    inline void composeArray(const Mat4<T>& a, const M* b, Mat4<T>* dst, Mat3<T>* normals, std::size_t count)
+    {
+      const MatrixChain<T> chain(a);
+      if (S == StoreMode::NonTemporal && reinterpret_cast<std::uintptr_t>(dst) % (Quad<T>::width * sizeof(T)) == 0)
+        composeArray<T, true>(chain, b, dst, normals, count);
+      else
+        composeArray<T, false>(chain, b, dst, normals, count);
+    }
+  }
+  
+  // dst[i] = a * b[i], with a loaded once: for instance a view-projection matrix against every model matrix.
+  // dst may be b.
+  template <typename T, StoreMode S = StoreMode::Cached>
+  inline void multiplyBatch(const Mat4<T>& a, const Mat4<T>* b, Mat4<T>* dst, std::size_t count)
+  {
+    Detail::composeArray<T, S>(a, b, dst, static_cast<Mat3<T>*>(nullptr), count);
+  }
+  
+  template <typename T, StoreMode S = StoreMode::Cached>
+  inline void multiplyBatch(const Mat4<T>& a, const Affine<T>* b, Mat4<T>* dst, std::size_t count)
+  {
+    Detail::composeArray<T, S>(a, b, dst, static_cast<Mat3<T>*>(nullptr), count);
+  }
+  
+  // mvps[i] = projection * view * models[i], with projection * view computed once. If normals is not null,
+  // normals[i] also gets the normal matrix of models[i], the inverse transpose of its upper 3x3, which takes
+  // normals to world space; it is not defined for a singular model. mvps may be models.
+  template <typename T, StoreMode S = StoreMode::Cached>
+  inline void modelViewProjectionBatch(const Mat4<T>& projection, const Mat4<T>& view, const Mat4<T>* models, Mat4<T>* mvps,
+                                       std::size_t count, Mat3<T>* normals = nullptr)
+  {
+    Detail::composeArray<T, S>(projection * view, models, mvps, normals, count);
+  }
+  
+  template <typename T, StoreMode S = StoreMode::Cached>
+  inline void modelViewProjectionBatch(const Mat4<T>& projection, const Mat4<T>& view, const Affine<T>* models, Mat4<T>* mvps,
+                                       std::size_t count, Mat3<T>* normals = nullptr)
+  {
+    Detail::composeArray<T, S>(projection * view, models, mvps, normals, count);
+  }
+  
+  /* Keyframe animation */
+  // Decomposed affine transform: scales, then rotates, then translates.
+  template <typename T>
+  struct Trs
+  {
+    Vec3<T> translation;
+    Quat<T> rotation;
+    Vec3<T> scale;
+    
+    constexpr Trs() : translation(0), rotation(), scale(1)
+    {
+    }
+    
+    constexpr Trs(const Vec3<T>& _translation, const Quat<T>& _rotation, const Vec3<T>& _scale)
+      : translation(_translation), rotation(_rotation), scale(_scale)
+    {
+    }
+  };
+  
+  // m is assumed to be affine without shear. A reflection is folded into a negative x scale.
+  template <typename T>
+  inline Trs<T> decompose(const Mat4<T>& m)
+  {
+    const Vec3<T> c0{m.d[0][0], m.d[0][1], m.d[0][2]};
+    const Vec3<T> c1{m.d[1][0], m.d[1][1], m.d[1][2]};
+    const Vec3<T> c2{m.d[2][0], m.d[2][1], m.d[2][2]};
+    const T flip = tripleProduct(c0, c1, c2) < 0 ? T(-1) : T(1);
+    const Vec3<T> scale{mag(c0) * flip, mag(c1), mag(c2)};
+    const Mat3<T> rotation{Vec3<T>(c0 / scale.x), Vec3<T>(c1 / scale.y), Vec3<T>(c2 / scale.z)};
+    return Trs<T>{Vec3<T>{m.d[3][0], m.d[3][1], m.d[3][2]}, makeQuat(rotation), scale};
+  }
+  
+  // trs.rotation is assumed to be normalized.
+  template <typename T>
+  inline Mat4<T> makeTransform4D(const Trs<T>& trs)
+  {
+    Mat4<T> result = makeRotation4D(trs.rotation);
+    for (unsigned int i = 0; i < 3; i++)
+    {
+      result.d[0][i] *= trs.scale.x;
+      result.d[1][i] *= trs.scale.y;
+      result.d[2][i] *= trs.scale.z;
+    }
+    result.d[3][0] = trs.translation.x;
+    result.d[3][1] = trs.translation.y;
+    result.d[3][2] = trs.translation.z;
+    return result;
+  }
+  
+  // Interpolates translation and scale linearly and the rotation with slerp, or with nlerp for Precision::Fast.
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Trs<T> lerp(const Trs<T>& a, const Trs<T>& b, T t)
+  {
+    return Trs<T>{lerp(a.translation, b.translation, t),
+                  Pr == Precision::Exact ? slerp(a.rotation, b.rotation, t) : nlerp(a.rotation, b.rotation, t),
+                  lerp(a.scale, b.scale, t)};
+  }
+  
+  // Interpolates two affine transforms through their decompositions, which keeps rotations rigid where lerping the
+  // entries would shrink and shear them.
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Mat4<T> interpolate(const Mat4<T>& a, const Mat4<T>& b, T t)
+  {
+    return makeTransform4D(lerp<T, Pr>(decompose(a), decompose(b), t));
+  }
+  
+  namespace Detail
+  {
+    // Keyframe values seen as flat arrays of scalars.
+    template <typename V>
+    struct KeyTraits
+    {
+      using Scalar = V;
+      static const unsigned int size = 1;
+      static const bool rotation = false;
+    };
+    
+    template <typename T, unsigned int N>
+    struct KeyTraits<Vec<T, N>>
+    {
+      using Scalar = T;
+      static const unsigned int size = N;
+      static const bool rotation = false;
+    };
+    
+    template <typename T>
+    struct KeyTraits<Quat<T>>
+    {
+      using Scalar = T;
+      static const unsigned int size = 4;
+      static const bool rotation = true;
+    };
+    
+    // Index of the first key of the segment around time among count keys, starting from the cached key. Forward
+    // playback stays on or steps to the next segment in constant time; longer jumps, and going back, search.
+    template <typename T>
+    inline std::size_t seekKey(const T* times, std::size_t count, T time, std::size_t key)
+    {
+      const std::size_t last = count > 1 ? count - 2 : 0;
+      key = std::min(key, last);
+      if (time < times[key])
+      {
+        const std::size_t upper = static_cast<std::size_t>(std::upper_bound(times, times + key, time) - times);
+        return upper > 0 ? upper - 1 : 0;
+      }
+      if (key < last && time >= times[key + 1])
+      {
+        key++;
+        if (key < last && time >= times[key + 1])
+          key = static_cast<std::size_t>(std::upper_bound(times + key + 1, times + last + 1, time) - times) - 1;
+      }
+      return key;
+    }
+    
+    // Blends of N-component keys a and b by w.
+    struct LerpKeys
+    {
+      template <unsigned int N, typename P>
+      static inline void run(const P* a, const P* b, P w, P* r)
+      {
+        for (unsigned int c = 0; c < N; c++)
+          r[c] = madd(b[c] - a[c], w, a[c]);
+      }
+    };
+    
+    struct NlerpKeys
+    {
+      template <unsigned int N, typename P>
+      static inline void run(const P* a, const P* b, P w, P* r)
+      {
+        P cosTheta(0);
+        for (unsigned int c = 0; c < N; c++)
+          cosTheta = madd(a[c], b[c], cosTheta);
+        // Along the shorter arc.
+        const P wb = select(cosTheta < P(0), -w, w);
+        const P wa = P(1) - w;
+        P mag2(0);
+        for (unsigned int c = 0; c < N; c++)
+        {
+          r[c] = madd(b[c], wb, a[c] * wa);
+          mag2 = madd(r[c], r[c], mag2);
+        }
+        const P magInv = P(1) / sqrt(mag2);
+        for (unsigned int c = 0; c < N; c++)
+          r[c] *= magInv;
+      }
+    };
+    
+    // One lane at a time, through slerp().
+    struct SlerpKeys
+    {
+      template <unsigned int N, typename P>
+      static inline void run(const P* a, const P* b, P w, P* r)
+      {
+        using T = typename P::Scalar;
+        static_assert(N == 4, "slerp needs quaternion keys");
+        T lanes[3][4][P::width];
+        T weights[P::width];
+        for (unsigned int c = 0; c < 4; c++)
+        {
+          a[c].store(lanes[0][c]);
+          b[c].store(lanes[1][c]);
+        }
+        w.store(weights);
+        for (unsigned int l = 0; l < P::width; l++)
+        {
+          const Quat<T> q = slerp(Quat<T>{lanes[0][0][l], lanes[0][1][l], lanes[0][2][l], lanes[0][3][l]},
+                                  Quat<T>{lanes[1][0][l], lanes[1][1][l], lanes[1][2][l], lanes[1][3][l]}, weights[l]);
+          lanes[2][0][l] = q.x;
+          lanes[2][1][l] = q.y;
+          lanes[2][2][l] = q.z;
+          lanes[2][3][l] = q.w;
+        }
+        for (unsigned int c = 0; c < 4; c++)
+          r[c] = P::load(lanes[2][c]);
+      }
+    };
+    
+    template <typename V, Precision Pr>
+    using KeyBlend = typename std::conditional<!KeyTraits<V>::rotation, LerpKeys,
+      typename std::conditional<Pr == Precision::Exact, SlerpKeys, NlerpKeys>::type>::type;
+    
+    // Writes the lanes of N-component values to consecutive values at out.
+    template <unsigned int N, typename P>
+    struct KeyScatter
+    {
+      using T = typename P::Scalar;
+      
+      static inline void run(const P* r, T* out)
+      {
+        if (N == 1)
+        {
+          r[0].store(out);
+          return;
+        }
+        T lanes[N][P::width];
+        for (unsigned int c = 0; c < N; c++)
+          r[c].store(lanes[c]);
+        for (unsigned int l = 0; l < P::width; l++)
+          for (unsigned int c = 0; c < N; c++)
+            out[l * N + c] = lanes[c][l];
+      }
+    };
+    
+#if defined(NEON_SIMD_SSE2)
+    template <>
+    struct KeyScatter<3, Pack<float, 4>>
+    {
+      static inline void run(const Pack<float, 4>* r, float* out)
+      {
+        aosStore(reinterpret_cast<Vec3<float>*>(out), Vec3<Pack<float, 4>>{r[0], r[1], r[2]});
+      }
+    };
+    
+    template <>
+    struct KeyScatter<4, Pack<float, 4>>
+    {
+      static inline void run(const Pack<float, 4>* r, float* out)
+      {
+        __m128 r0 = r[0].v;
+        __m128 r1 = r[1].v;
+        __m128 r2 = r[2].v;
+        __m128 r3 = r[3].v;
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(out, r0);
+        _mm_storeu_ps(out + 4, r1);
+        _mm_storeu_ps(out + 8, r2);
+        _mm_storeu_ps(out + 12, r3);
+      }
+    };
+    
+    template <>
+    struct KeyScatter<3, Pack<double, 2>>
+    {
+      static inline void run(const Pack<double, 2>* r, double* out)
+      {
+        aosStore(reinterpret_cast<Vec3<double>*>(out), Vec3<Pack<double, 2>>{r[0], r[1], r[2]});
+      }
+    };
+    
+    template <>
+    struct KeyScatter<4, Pack<double, 2>>
+    {
+      static inline void run(const Pack<double, 2>* r, double* out)
+      {
+        _mm_storeu_pd(out, _mm_unpacklo_pd(r[0].v, r[1].v));
+        _mm_storeu_pd(out + 2, _mm_unpacklo_pd(r[2].v, r[3].v));
+        _mm_storeu_pd(out + 4, _mm_unpackhi_pd(r[0].v, r[1].v));
+        _mm_storeu_pd(out + 6, _mm_unpackhi_pd(r[2].v, r[3].v));
+      }
+    };
+#endif
+    
+#if defined(NEON_SIMD_AVX)
+    // One 128-bit half after the other.
+    template <unsigned int N>
+    struct KeyScatter<N, Pack<float, 8>>
+    {
+      static inline void run(const Pack<float, 8>* r, float* out)
+      {
+        Pack<float, 4> lo[N];
+        Pack<float, 4> hi[N];
+        for (unsigned int c = 0; c < N; c++)
+        {
+          lo[c] = Pack<float, 4>(_mm256_castps256_ps128(r[c].v));
+          hi[c] = Pack<float, 4>(_mm256_extractf128_ps(r[c].v, 1));
+        }
+        KeyScatter<N, Pack<float, 4>>::run(lo, out);
+        KeyScatter<N, Pack<float, 4>>::run(hi, out + 4 * N);
+      }
+    };
+    
+    template <unsigned int N>
+    struct KeyScatter<N, Pack<double, 4>>
+    {
+      static inline void run(const Pack<double, 4>* r, double* out)
+      {
+        Pack<double, 2> lo[N];
+        Pack<double, 2> hi[N];
+        for (unsigned int c = 0; c < N; c++)
+        {
+          lo[c] = Pack<double, 2>(_mm256_castpd256_pd128(r[c].v));
+          hi[c] = Pack<double, 2>(_mm256_extractf128_pd(r[c].v, 1));
+        }
+        KeyScatter<N, Pack<double, 2>>::run(lo, out);
+        KeyScatter<N, Pack<double, 2>>::run(hi, out + 2 * N);
+      }
+    };
+#endif
+    
+    // Refills the stale tracks among [i, i + width), then interpolates all of them on packs.
+    template <typename Sampler, Precision Pr>
+    struct SampleKernel
+    {
+      using V = typename Sampler::Value;
+      using T = typename Sampler::Scalar;
+      static const unsigned int components = KeyTraits<V>::size;
+      
+      Sampler& s;
+      T time;
+      V* out;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        const P pt(time);
+        const typename P::Mask stale = (pt < P::load(&s.lower[i])) | (pt >= P::load(&s.upper[i]));
+        if (any(stale))
+        {
+          const unsigned int mask = bits(stale);
+          for (unsigned int l = 0; l < P::width; l++)
+          {
+            if (mask & (1u << l))
+              s.refill(i + l, time);
+          }
+        }
+        // Clamped to the segment; a single key, or two at the same time, weighs by which side of it time is.
+        const P t0 = P::load(&s.times[i]);
+        const P dt = P::load(&s.times[s.count + i]) - t0;
+        const P w = select(dt > P(0), min(max((pt - t0) / dt, P(0)), P(1)), select(pt < t0, P(0), P(1)));
+        P a[components];
+        P b[components];
+        P r[components];
+        for (unsigned int c = 0; c < components; c++)
+        {
+          a[c] = P::load(&s.values[c * s.count + i]);
+          b[c] = P::load(&s.values[(components + c) * s.count + i]);
+        }
+        KeyBlend<V, Pr>::template run<components>(a, b, w, r);
+        KeyScatter<components, P>::run(r, reinterpret_cast<T*>(out + i));
+      }
+    };
+  }
+  
+  // Keyframe tracks of one value type: a scalar, Vec2/3/4 or Quat. All tracks share three flat arrays, offsets,
+  // times and values, with the keys of track k at [offsets[k], offsets[k + 1]) and times ascending within a track.
+  // Sample them with a KeyframeSampler.
+  template <typename V, typename T = typename Detail::KeyTraits<V>::Scalar>
+  struct KeyframeTracks
+  {
+    KeyframeTracks() : offsets(1, 0)
+    {
+    }
+    
+    inline std::size_t size() const
+    {
+      return offsets.size() - 1;
+    }
+    
+    void reserve(std::size_t tracks, std::size_t keys)
+    {
+      offsets.reserve(tracks + 1);
+      times.reserve(keys);
+      values.reserve(keys);
+    }
+    
+    // Returns the index of the new track, which must have at least one key.
+    std::size_t add(const T* keyTimes, const V* keyValues, std::size_t count)
+    {
+      assert(count > 0);
+      times.insert(times.end(), keyTimes, keyTimes + count);
+      values.insert(values.end(), keyValues, keyValues + count);
+      offsets.push_back(times.size());
+      return size() - 1;
+    }
+    
+    inline std::size_t keyCount(std::size_t track) const
+    {
+      return offsets[track + 1] - offsets[track];
+    }
+    
+    inline const T& time(std::size_t track, std::size_t key) const
+    {
+      return times[offsets[track] + key];
+    }
+    
+    inline const V& value(std::size_t track, std::size_t key) const
+    {
+      return values[offsets[track] + key];
+    }
+    
+  private:
+    std::vector<std::size_t> offsets;
+    std::vector<T> times;
+    std::vector<V> values;
+  };
+  
+  // Playback state for a set of KeyframeTracks, which must outlive it and not change while it is in use. For each
+  // track it caches the current key and, in SoA arrays, the times and values of the two keys around it, so sampling
+  // mostly streams through those arrays Pack<T>::width tracks at a time; a track only seeks, and refills its cache,
+  // once time leaves its cached segment. Playing forward a frame at a time that is rare and costs O(1); other jumps
+  // search. All storage is allocated up front.
+  template <typename V, typename T = typename Detail::KeyTraits<V>::Scalar>
+  struct KeyframeSampler
+  {
+    explicit KeyframeSampler(const KeyframeTracks<V, T>& _tracks)
+      : tracks(_tracks),
+        count(_tracks.size()),
+        keys(count, 0),
+        lower(count, std::numeric_limits<T>::infinity()),
+        upper(count, -std::numeric_limits<T>::infinity()),
+        times(2 * count),
+        values(2 * Detail::KeyTraits<V>::size * count)
+    {
+    }
+    
+    // Writes every track's value at time to out, interpolating between the keys around it and holding the first
+    // and last values outside them. Values lerp; rotations slerp, or nlerp for Precision::Fast, along the shorter
+    // arc.
+    template <Precision Pr = Precision::Exact>
+    void sample(T time, V* out)
+    {
+      Detail::forEachPack<T>(count, Detail::SampleKernel<KeyframeSampler, Pr>{*this, time, out});
+    }
+    
+    using Value = V;
+    using Scalar = T;
+    
+  private:
+    template <typename Sampler, Precision Pr>
+    friend struct Detail::SampleKernel;
+    
+    static const unsigned int components = Detail::KeyTraits<V>::size;
+    
+    // Seeks track k and copies the keys around time into the cache. Its segment extends to infinity past the first
+    // and last keys, where the value is held.
+    void refill(std::size_t k, T time)
+    {
+      const std::size_t keyCount = tracks.keyCount(k);
+      const std::size_t last = keyCount > 1 ? keyCount - 2 : 0;
+      const std::size_t key = Detail::seekKey(&tracks.time(k, 0), keyCount, time, keys[k]);
+      const std::size_t next = keyCount > 1 ? key + 1 : key;
+      keys[k] = key;
+      lower[k] = key == 0 ? -std::numeric_limits<T>::infinity() : tracks.time(k, key);
+      upper[k] = key == last ? std::numeric_limits<T>::infinity() : tracks.time(k, next);
+      times[k] = tracks.time(k, key);
+      times[count + k] = tracks.time(k, next);
+      const T* a = reinterpret_cast<const T*>(&tracks.value(k, key));
+      const T* b = reinterpret_cast<const T*>(&tracks.value(k, next));
+      for (unsigned int c = 0; c < components; c++)
+      {
+        values[c * count + k] = a[c];
+        values[(components + c) * count + k] = b[c];
+      }
+    }
+    
+    const KeyframeTracks<V, T>& tracks;
+    std::size_t count;
+    std::vector<std::size_t> keys;
+    std::vector<T> lower;
+    std::vector<T> upper;
+    std::vector<T> times;
+    std::vector<T> values;
+  };
+  
+  /* Common transformations */
+  
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Mat2<T> makeRotation2D(const T angle)
+  {
+    T s;
+    T c;
+    sinCos<T, Pr>(angle, s, c);
+    return Mat2<T>{c, -s, s, c};
+  }
+  
+  // This is yaw(y-axis) * pitch(x-axis) * roll(z-axis).
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Mat3<T> makeRotation3D(T yaw, T pitch, T roll)
+  {
+    T sy;
+    T cy;
+    T sp;
+    T cp;
+    T sr;
+    T cr;
+    sinCos<T, Pr>(yaw, sy, cy);
+    sinCos<T, Pr>(pitch, sp, cp);
+    sinCos<T, Pr>(roll, sr, cr);
+    const T v1x = cy * cr + sy * sp * sr;
+    const T v1y = cp * sr;
+    const T v1z = -sy * cr + cy * sp * sr;
+    const T v2x = -cy * sr + sy * sp * cr;
+    const T v2y = cp * cr;
+    const T v2z = sy * sr + cy * sp * cr;
+    const T v3x = sy * cp;
+    const T v3y = -sp;
+    const T v3z = cy * cp;
+    return Mat3<T>{v1x, v2x, v3x,
+                   v1y, v2y, v3y,
+                   v1z, v2z, v3z};
+  }
+  
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Mat3<T> makeRotation3DX(T angle)
+  {
+    T s;
+    T c;
+    sinCos<T, Pr>(angle, s, c);
+    return Mat3<T>{1, 0, 0,
+                   0, c, -s,
+                   0, s, c};
+  }
+  
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Mat3<T> makeRotation3DY(T angle)
+  {
+    T s;
+    T c;
+    sinCos<T, Pr>(angle, s, c);
+    return Mat3<T>{c,  0, s,
+                   0,  1, 0,
+                   -s, 0, c};
+  }
+  
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Mat3<T> makeRotation3DZ(T angle)
+  {
+    T s;
+    T c;
+    sinCos<T, Pr>(angle, s, c);
+    return Mat3<T>{c, -s, 0,
+                   s, c,  0,
+                   0, 0,  1};
+  }
+  
+  // Axis is assumed to be normalized.
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Mat3<T> makeRotation3D(const Vec3<T>& axis, T angle)
+  {
+    // https://en.wikipedia.org/wiki/Rotation_matrix#Rotation_matrix_from_axis_and_angle
+    T s;
+    T c;
+    sinCos<T, Pr>(angle, s, c);
+    const T oneMinCos = 1 - c;
+    const T xx = axis.x * axis.x;
+    const T yy = axis.y * axis.y;
+    const T zz = axis.z * axis.z;
+    const T xy1c = axis.x * axis.y * oneMinCos;
+    const T xz1c = axis.x * axis.z * oneMinCos;
+    const T yz1c = axis.y * axis.z * oneMinCos;
+    const T xs = axis.x * s;
+    const T ys = axis.y * s;
+    const T zs = axis.z * s;
+    const T v1x = c + xx * oneMinCos;
+    const T v2x = xy1c - zs;
+    const T v3x = xz1c + ys;
+    const T v1y = xy1c + zs;
+    const T v2y = c + yy * oneMinCos;
+    const T v3y = yz1c - xs;
+    const T v1z = xz1c - ys;
+    const T v2z = yz1c + xs;
+    const T v3z = c + zz * oneMinCos;
+    return Mat3<T>{v1x, v2x, v3x,
+                   v1y, v2y, v3y,
+                   v1z, v2z, v3z};
+  }
+  
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Mat4<T> makeRotation4D(T yaw, T pitch, T roll)
+  {
+    Mat4<T> result{makeRotation3D<T, Pr>(yaw, pitch, roll)};
+    result.d[3][3] = 1;
+    return result;
+  }
+  
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Mat4<T> makeRotation4DX(T angle)
+  {
+    Mat4<T> result{makeRotation3DX<T, Pr>(angle)};
+    result.d[3][3] = 1;
+    return result;
+  }
+  
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Mat4<T> makeRotation4DY(T angle)
+  {
+    Mat4<T> result{makeRotation3DY<T, Pr>(angle)};
+    result.d[3][3] = 1;
+    return result;
+  }
+  
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Mat4<T> makeRotation4DZ(T angle)
+  {
+    Mat4<T> result{makeRotation3DZ<T, Pr>(angle)};
+    result.d[3][3] = 1;
+    return result;
+  }
+  
+  template <typename T, Precision Pr = Precision::Exact>
+  inline Mat4<T> makeRotation4D(const Vec3<T>& axis, T angle)
+  {
+    Mat4<T> result{makeRotation3D<T, Pr>(axis, angle)};
+    result.d[3][3] = 1;
+    return result;
+  }
+  
+  template <typename T>
+  constexpr Mat2<T> makeScale2D(const Vec2<T>& s)
+  {
+    return Mat2<T>{s.x, 0,
+                   0,   s.y};
+  }
+  
+  template <typename T>
+  constexpr Mat3<T> makeScale3D(const Vec3<T>& s)
+  {
+    return Mat3<T>{s.x, 0,   0,
+                   0,   s.y, 0,
+                   0,   0,   s.z};
+  }
+  
+  template <typename T>
+  constexpr Mat4<T> makeScale4D(const Vec3<T>& s)
+  {
+    return Mat4<T>{s.x, 0, 0,   0,
+                   0, s.y, 0,   0,
+                   0, 0,   s.z, 0,
+                   0, 0,   0,   1};
+  }
+
+  template <typename T>
+  constexpr Mat4<T> makeTranslation(const Vec3<T>& t)
+  {
+    return Mat4<T>{1, 0, 0,  t.x,
+                   0, 1, 0,  t.y,
+                   0, 0, 1,  t.z,
+                   0, 0, 0,  1};
+  }
+  
+  template<typename T = float>
+  inline Mat4<T> makeLookAt(const Vec3<T>& origin, const Vec3<T>& lookAt, const Vec3<T>& worldUp)
+  {
+    const Vec3<T> w = normalize(Vec3<T>(lookAt - origin));
+    const Vec3<T> u = normalize(Neon::cross(w, worldUp));
+    const Vec3<T> v = cross(u, w);
+    return Mat4<T>{u.x,  u.y,  u.z,  -Neon::dot(origin, u),
+                   v.x,  v.y,  v.z,  -Neon::dot(origin, v),
+                   -w.x, -w.y, -w.z, Neon::dot(origin, w),
+                   0,    0,    0,    1.0};
+  }
+  
+  // LHC-to-RHC and vice versa.
+  template<typename T = float>
+  constexpr Mat4<T> makeInverseZ()
+  {
+    return Mat4<T>{1, 0, 0,  0,
+                   0, 1, 0,  0,
+                   0, 0, -1, 0,
+                   0, 0, 0,  1};
+  }
+  
+  enum class NdcDepth
+  {
+    NegativeOneToOne,
+    ZeroToOne
+  };
+  
+  namespace Detail
+  {
+    template <typename T, NdcDepth D>
+    NEON_CONSTEXPR14 typename std::enable_if<D == NdcDepth::ZeroToOne, Mat4<T>>::type
+    makeFrustum(T near, T far, T left, T right, T top, T bottom)
+    {
+      const T rlInv = 1 / (right - left);
+      const T n2 = 2 * near;
+      const T tbInv = 1 / (top - bottom);
+      const T nfInv = 1 / (near - far);
+      return Mat4<T>{n2 * rlInv, 0,          (right + left) * rlInv, 0,
+                     0,          n2 * tbInv, (top + bottom) * tbInv, 0,
+                     0,          0,          far * nfInv,            far * near * nfInv,
+                     0,          0,          -1,                     0};
+    }
+    
+    template <typename T, NdcDepth D>
+    NEON_CONSTEXPR14 typename std::enable_if<D == NdcDepth::NegativeOneToOne, Mat4<T>>::type
+    makeFrustum(T near, T far, T left, T right, T top, T bottom)
+    {
+      const T rlInv = 1 / (right - left);
+      const T n2 = 2 * near;
+      const T tbInv = 1 / (top - bottom);
+      const T nfInv = 1 / (near - far);
+      return Mat4<T>{n2 * rlInv, 0,          (right + left) * rlInv, 0,
+                     0,          n2 * tbInv, (top + bottom) * tbInv, 0,
+                     0,          0,          (far + near) * nfInv,   2 * far * near * nfInv,
+                     0,          0,          -1,                     0};
+    }
+    
+    template <typename T, NdcDepth D>
+    NEON_CONSTEXPR14 typename std::enable_if<D == NdcDepth::ZeroToOne, Mat4<T>>::type
+    makeOrthographic(T near, T far, T left, T right, T top, T bottom)
+    {
+      const T rlInv = 1 / (right - left);
+      const T tbInv = 1 / (top - bottom);
+      const T nfInv = 1 / (near - far);
+      return Mat4<T> {2 * rlInv, 0,         0,           -(left + right) * rlInv,
+                      0,         2 * tbInv, 0,           -(bottom + top) * tbInv,
+                      0,         0,         nfInv,       near * nfInv,
+                      0,         0,         0,           1};
+    }
+    
+    template <typename T, NdcDepth D>
+    NEON_CONSTEXPR14 typename std::enable_if<D == NdcDepth::NegativeOneToOne, Mat4<T>>::type
+    makeOrthographic(T near, T far, T left, T right, T top, T bottom)
+    {
+      const T rlInv = 1 / (right - left);
+      const T tbInv = 1 / (top - bottom);
+      const T nfInv = 1 / (near - far);
+      return Mat4<T> {2 * rlInv, 0,         0,           -(left + right) * rlInv,
+                      0,         2 * tbInv, 0,           -(bottom + top) * tbInv,
+                      0,         0,         2 * nfInv,   (near + far) * nfInv,
+                      0,         0,         0,           1};
+    }
+    
+    template <typename T, NdcDepth D, Precision Pr>
+    inline typename std::enable_if<D == NdcDepth::ZeroToOne, Mat4<T>>::type
+    makePerspective(T fovy, T aspect, T near, T far)
+    {
+      T s;
+      T c;
+      sinCos<T, Pr>(fovy / 2, s, c);
+      const T tnInv = c / s;
+      const T nfInv = 1 / (near - far);
+      T a = far * nfInv;
+      T b = far * near * nfInv;
+      return Mat4<T>{tnInv / aspect, 0,      0,           0,
+                     0,              tnInv,  0,           0,
+                     0,              0,      a,           b,
+                     0,              0,      -1,          0};
+    }
+    
+    template <typename T, NdcDepth D, Precision Pr>
+    inline typename std::enable_if<D == NdcDepth::NegativeOneToOne, Mat4<T>>::type
+    makePerspective(T fovy, T aspect, T near, T far)
     {
-      return d[col][row];
+      T s;
+      T c;
+      sinCos<T, Pr>(fovy / 2, s, c);
+      const T tnInv = c / s;
+      const T nfInv = 1 / (near - far);
+      T a = (far + near) * nfInv;
+      T b = 2 * far * near * nfInv;
+      return Mat4<T>{tnInv / aspect, 0,      0,           0,
+                     0,              tnInv,  0,           0,
+                     0,              0,      a,           b,
+                     0,              0,      -1,          0};
+    }
+  }
+  
+  template <typename T = float, NdcDepth D = NdcDepth::ZeroToOne>
+  NEON_CONSTEXPR14 Mat4<T> makeFrustum(T near, T far, T left, T right, T top, T bottom)
+  {
+    return Detail::makeFrustum<T, D>(near, far, left, right, top, bottom);
+  }
+  
+  template <typename T = float, NdcDepth D = NdcDepth::ZeroToOne>
+  NEON_CONSTEXPR14 Mat4<T> makeOrthographic(T near, T far, T left, T right, T top, T bottom)
+  {
+    return Detail::makeOrthographic<T, D>(near, far, left, right, top, bottom);
+  }
+  
+  template <typename T, NdcDepth D = NdcDepth::ZeroToOne, Precision Pr = Precision::Exact>
+  inline Mat4<T> makePerspective(T fovy, T aspect, T near, T far)
+  {
+    return Detail::makePerspective<T, D, Pr>(fovy, aspect, near, far);
+  }
+  
+  /* Frustum */
+  
+  namespace Detail
+  {
+    // sign * (row r of m) + w * (row 3 of m), scaled so that its xyz part has unit length.
+    template <typename T>
+    inline Vec4<T> extractPlane(const Mat4<T>& m, unsigned int r, T sign, T w)
+    {
+      const T x = sign * m.d[0][r] + w * m.d[0][3];
+      const T y = sign * m.d[1][r] + w * m.d[1][3];
+      const T z = sign * m.d[2][r] + w * m.d[2][3];
+      const T d = sign * m.d[3][r] + w * m.d[3][3];
+      const T lengthInv = 1 / std::sqrt(x * x + y * y + z * z);
+      return Vec4<T>{x * lengthInv, y * lengthInv, z * lengthInv, d * lengthInv};
     }
+  }
+  
+  // The six planes bounding the volume that a (view-)projection matrix maps to the clip volume. Each plane is
+  // stored as (normal, distance) with a unit normal pointing inwards, so p is on the inner side of a plane
+  // when dot(normal, p) + distance >= 0.
+  template <typename T>
+  struct Frustum
+  {
+    enum Side
+    {
+      Left,
+      Right,
+      Bottom,
+      Top,
+      Near,
+      Far,
+      SideCount
+    };
     
-    inline const T& operator()(unsigned int row, unsigned int col) const
+    Vec4<T> planes[SideCount];
+    
+    Frustum() = default;
+    
+    // Gribb-Hartmann extraction from the rows of m. depth must be the convention m was made with: the near plane
+    // is z_clip >= -w_clip for NegativeOneToOne and z_clip >= 0 for ZeroToOne.
+    explicit Frustum(const Mat4<T>& m, NdcDepth depth = NdcDepth::ZeroToOne)
     {
-      return d[col][row];
+      planes[Left] = Detail::extractPlane<T>(m, 0, 1, 1);
+      planes[Right] = Detail::extractPlane<T>(m, 0, -1, 1);
+      planes[Bottom] = Detail::extractPlane<T>(m, 1, 1, 1);
+      planes[Top] = Detail::extractPlane<T>(m, 1, -1, 1);
+      planes[Near] = Detail::extractPlane<T>(m, 2, 1, depth == NdcDepth::ZeroToOne ? T(0) : T(1));
+      planes[Far] = Detail::extractPlane<T>(m, 2, -1, 1);
     }
     
-    friend inline Mat2<T> operator+(const Mat2<T>& lhs, const Mat2<T>& rhs)
+    // Signed distance from p to plane side, positive on the inner side.
+    inline T distance(Side side, const Vec3<T>& p) const
     {
-      return Mat2<T>(lhs[0] + rhs[0], lhs[1] + rhs[1]);
+      const Vec4<T>& n = planes[side];
+      return n.x * p.x + n.y * p.y + n.z * p.z + n.w;
     }
     
-    inline Mat2<T>& operator+=(const Mat2<T>& m)
+    inline bool contains(const Vec3<T>& p) const
     {
-      d[0][0] += m.d[0][0]; d[1][0] += m.d[1][0];
-      d[0][1] += m.d[0][1]; d[1][1] += m.d[1][1];
-      return *this;
+      for (unsigned int k = 0; k < SideCount; k++)
+        if (distance(static_cast<Side>(k), p) < 0)
+          return false;
+      return true;
     }
     
-    inline Mat2<T> operator-() const
+    // Conservative: a sphere is rejected only when it lies entirely outside one plane.
+    inline bool intersectsSphere(const Vec3<T>& center, T radius) const
     {
-      return Mat2<T>(-d[0][0], -d[1][0],
-                     -d[0][1], -d[1][1]);
+      for (unsigned int k = 0; k < SideCount; k++)
+        if (distance(static_cast<Side>(k), center) < -radius)
+          return false;
+      return true;
     }
     
-    friend inline Mat2<T> operator-(const Mat2<T>& lhs, const Mat2<T>& rhs)
+    // Conservative like intersectsSphere; tests the corner of the box furthest along each plane normal.
+    inline bool intersectsAabb(const Vec3<T>& boxMin, const Vec3<T>& boxMax) const
     {
-      return Mat2<T>(lhs[0] - rhs[0], lhs[1] - rhs[1]);
+      for (unsigned int k = 0; k < SideCount; k++)
+      {
+        const Vec4<T>& n = planes[k];
+        const Vec3<T> corner{n.x >= 0 ? boxMax.x : boxMin.x,
+                             n.y >= 0 ? boxMax.y : boxMin.y,
+                             n.z >= 0 ? boxMax.z : boxMin.z};
+        if (distance(static_cast<Side>(k), corner) < 0)
+          return false;
+      }
+      return true;
+    }
+  };
+  
+  namespace Detail
+  {
+    // Writes the P::width visibility bits of elements [i, i + P::width). i must be a multiple of P::width (see
+    // forEachPack), so the bits of one pack never straddle two words.
+    template <typename P>
+    inline void storeBits(std::uint32_t* words, std::size_t i, typename P::Mask m)
+    {
+      const unsigned int shift = static_cast<unsigned int>(i % 32);
+      const std::uint32_t lanes = ((1u << P::width) - 1u) << shift;
+      std::uint32_t& word = words[i / 32];
+      word = (word & ~lanes) | (static_cast<std::uint32_t>(bits(m)) << shift);
     }
     
-    inline Mat2<T>& operator-=(const Mat2<T>& m)
+    template <typename P, typename T>
+    inline P planeDistance(const Vec4<T>& plane, const Vec3<P>& p)
     {
-      d[0][0] -= m.d[0][0]; d[1][0] -= m.d[1][0];
-      d[0][1] -= m.d[0][1]; d[1][1] -= m.d[1][1];
-      return *this;
+      return madd(P(plane.x), p.x, madd(P(plane.y), p.y, madd(P(plane.z), p.z, P(plane.w))));
     }
     
-    inline Mat2<T> operator*(const T t) const
+    template <typename T>
+    struct CullSpheresKernel
+    {
+      const Frustum<T>& frustum;
+      const Vec3Stream<T>& centers;
+      const T* radii;
+      std::uint32_t* visible;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        const Vec3<P> c = streamLoad<P>(centers, i);
+        P nearest = planeDistance(frustum.planes[0], c);
+        for (unsigned int k = 1; k < Frustum<T>::SideCount; k++)
+          nearest = min(nearest, planeDistance(frustum.planes[k], c));
+        storeBits<P>(visible, i, nearest >= -P::load(radii + i));
+      }
+    };
+    
+    // Uses the center/half-extent form of the furthest-corner test, which needs no per-lane selects:
+    // the corner's distance is dot(n, center) + dot(abs(n), extent) + w.
+    template <typename T>
+    struct CullAabbsKernel
+    {
+      const Frustum<T>& frustum;
+      const Vec3Stream<T>& mins;
+      const Vec3Stream<T>& maxs;
+      std::uint32_t* visible;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        const Vec3<P> lo = streamLoad<P>(mins, i);
+        const Vec3<P> hi = streamLoad<P>(maxs, i);
+        const P half(static_cast<T>(0.5));
+        const Vec3<P> c{(hi.x + lo.x) * half, (hi.y + lo.y) * half, (hi.z + lo.z) * half};
+        const Vec3<P> e{(hi.x - lo.x) * half, (hi.y - lo.y) * half, (hi.z - lo.z) * half};
+        P nearest = boxDistance(frustum.planes[0], c, e);
+        for (unsigned int k = 1; k < Frustum<T>::SideCount; k++)
+          nearest = min(nearest, boxDistance(frustum.planes[k], c, e));
+        storeBits<P>(visible, i, nearest >= P(0));
+      }
+      
+      template <typename P>
+      static inline P boxDistance(const Vec4<T>& n, const Vec3<P>& c, const Vec3<P>& e)
+      {
+        return madd(P(std::abs(n.x)), e.x, madd(P(std::abs(n.y)), e.y, madd(P(std::abs(n.z)), e.z, planeDistance(n, c))));
+      }
+    };
+  }
+  
+  // Batched frustum culling. Bit i % 32 of visible[i / 32] is set when element i intersects the frustum and
+  // cleared otherwise; visible must hold (size() + 31) / 32 words and bits past size() are left untouched.
+  // Elements are tested Pack<T>::width at a time against all six planes, with the same conservative tests as
+  // Frustum::intersectsSphere and Frustum::intersectsAabb.
+  
+  template <typename T>
+  inline void cullSpheres(const Frustum<T>& frustum, const Vec3Stream<T>& centers, const T* radii, std::uint32_t* visible)
+  {
+    Detail::forEachPack<T>(centers.size(), Detail::CullSpheresKernel<T>{frustum, centers, radii, visible});
+  }
+  
+  // mins and maxs hold the corners of each box and must have equal size.
+  template <typename T>
+  inline void cullAabbs(const Frustum<T>& frustum, const Vec3Stream<T>& mins, const Vec3Stream<T>& maxs, std::uint32_t* visible)
+  {
+    Detail::forEachPack<T>(mins.size(), Detail::CullAabbsKernel<T>{frustum, mins, maxs, visible});
+  }
+  
+  /* Rays */
+  // Ray origin + t * direction. direction need not be normalized; hit distances t are in units of its length.
+  template <typename T>
+  struct Ray
+  {
+    Vec3<T> origin;
+    Vec3<T> direction;
+    
+    Ray() = default;
+    
+    Ray(const Vec3<T>& _origin, const Vec3<T>& _direction) : origin(_origin), direction(_direction)
     {
-      return Mat2<T>(d[0][0] * t, d[1][0] * t,
-                     d[0][1] * t, d[1][1] * t);
     }
     
-    friend inline Mat2<T> operator*(const T t, const Mat2<T>& m)
+    inline Vec3<T> at(T t) const
     {
-      return m * t;
+      return origin + direction * t;
+    }
+  };
+  
+  // A ray hit on triangle v0 v1 v2 at ray.at(t), which is the point (1 - u - v) * v0 + u * v1 + v * v2.
+  template <typename T>
+  struct TriangleHit
+  {
+    T t, u, v;
+  };
+  
+  namespace Detail
+  {
+    // Moller-Trumbore, counting both faces. Only hits at t > 0 pass. When the ray lies in the plane of the
+    // triangle, or the triangle is degenerate, the determinant is zero and its infinite or NaN reciprocal fails
+    // the barycentric tests.
+    template <typename P>
+    inline typename P::Mask triangleHit(const Vec3<P>& o, const Vec3<P>& d, const Vec3<P>& v0, const Vec3<P>& v1,
+                                        const Vec3<P>& v2, P& t, P& u, P& v)
+    {
+      const Vec3<P> e1 = v1 - v0;
+      const Vec3<P> e2 = v2 - v0;
+      const Vec3<P> p = cross(d, e2);
+      const P detInv = P(1) / dot(e1, p);
+      const Vec3<P> s = o - v0;
+      const Vec3<P> q = cross(s, e1);
+      u = dot(s, p) * detInv;
+      v = dot(d, q) * detInv;
+      t = dot(e2, q) * detInv;
+      return (u >= P(0)) & (v >= P(0)) & (u + v <= P(1)) & (t > P(0));
+    }
+    
+    // Slab test with dInv = 1 / direction. tNear is the entry distance clamped to 0, so an origin inside the box
+    // enters at 0, and the box is hit when tNear is at most both the exit distance and tMax. An origin lying
+    // exactly on a slab plane parallel to the ray may go either way.
+    template <typename P>
+    inline typename P::Mask slabHit(const Vec3<P>& o, const Vec3<P>& dInv, const Vec3<P>& boxMin, const Vec3<P>& boxMax,
+                                    P tMax, P& tNear)
+    {
+      const P tx0 = (boxMin.x - o.x) * dInv.x;
+      const P tx1 = (boxMax.x - o.x) * dInv.x;
+      const P ty0 = (boxMin.y - o.y) * dInv.y;
+      const P ty1 = (boxMax.y - o.y) * dInv.y;
+      const P tz0 = (boxMin.z - o.z) * dInv.z;
+      const P tz1 = (boxMax.z - o.z) * dInv.z;
+      tNear = max(max(min(tx0, tx1), min(ty0, ty1)), max(min(tz0, tz1), P(0)));
+      const P tFar = min(min(max(tx0, tx1), max(ty0, ty1)), min(max(tz0, tz1), tMax));
+      return tNear <= tFar;
+    }
+    
+    template <typename P>
+    inline Vec3<P> reciprocal(const Vec3<P>& v)
+    {
+      return Vec3<P>{P(1) / v.x, P(1) / v.y, P(1) / v.z};
+    }
+    
+    template <typename T>
+    struct RayTrianglesKernel
+    {
+      const Ray<T>& ray;
+      const Vec3Stream<T>& v0;
+      const Vec3Stream<T>& v1;
+      const Vec3Stream<T>& v2;
+      T* t;
+      T* u;
+      T* v;
+      std::uint32_t* hits;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        P pt, pu, pv;
+        const typename P::Mask m = triangleHit(broadcast<P>(ray.origin), broadcast<P>(ray.direction), streamLoad<P>(v0, i),
+                                               streamLoad<P>(v1, i), streamLoad<P>(v2, i), pt, pu, pv);
+        select(m, pt, P(std::numeric_limits<T>::infinity())).store(t + i);
+        pu.store(u + i);
+        pv.store(v + i);
+        storeBits<P>(hits, i, m);
+      }
+    };
+    
+    // Keeps the nearest hit so far in hit and index; lanes are only unpacked when one of them beats it.
+    template <typename T>
+    struct ClosestTriangleKernel
+    {
+      const Ray<T>& ray;
+      const Vec3Stream<T>& v0;
+      const Vec3Stream<T>& v1;
+      const Vec3Stream<T>& v2;
+      TriangleHit<T>& hit;
+      std::size_t& index;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        P pt, pu, pv;
+        const typename P::Mask m = triangleHit(broadcast<P>(ray.origin), broadcast<P>(ray.direction), streamLoad<P>(v0, i),
+                                               streamLoad<P>(v1, i), streamLoad<P>(v2, i), pt, pu, pv);
+        const typename P::Mask closer = m & (pt < P(hit.t));
+        if (!any(closer))
+          return;
+        T ts[P::width], us[P::width], vs[P::width];
+        pt.store(ts);
+        pu.store(us);
+        pv.store(vs);
+        const unsigned int lanes = bits(closer);
+        for (unsigned int l = 0; l < P::width; l++)
+        {
+          if (((lanes >> l) & 1u) && ts[l] < hit.t)
+          {
+            hit = TriangleHit<T>{ts[l], us[l], vs[l]};
+            index = i + l;
+          }
+        }
+      }
+    };
+    
+    template <typename T>
+    struct RaysTriangleKernel
+    {
+      const Vec3Stream<T>& origins;
+      const Vec3Stream<T>& directions;
+      const Vec3<T>& v0;
+      const Vec3<T>& v1;
+      const Vec3<T>& v2;
+      T* t;
+      T* u;
+      T* v;
+      std::uint32_t* hits;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        P pt, pu, pv;
+        const typename P::Mask m = triangleHit(streamLoad<P>(origins, i), streamLoad<P>(directions, i), broadcast<P>(v0),
+                                               broadcast<P>(v1), broadcast<P>(v2), pt, pu, pv);
+        select(m, pt, P(std::numeric_limits<T>::infinity())).store(t + i);
+        pu.store(u + i);
+        pv.store(v + i);
+        storeBits<P>(hits, i, m);
+      }
+    };
+    
+    template <typename T>
+    struct RayAabbsKernel
+    {
+      const Ray<T>& ray;
+      const Vec3<T>& dInv;
+      const Vec3Stream<T>& mins;
+      const Vec3Stream<T>& maxs;
+      T* tNear;
+      std::uint32_t* hits;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        P entry;
+        const typename P::Mask m = slabHit(broadcast<P>(ray.origin), broadcast<P>(dInv), streamLoad<P>(mins, i),
+                                           streamLoad<P>(maxs, i), P(std::numeric_limits<T>::infinity()), entry);
+        select(m, entry, P(std::numeric_limits<T>::infinity())).store(tNear + i);
+        storeBits<P>(hits, i, m);
+      }
+    };
+    
+    template <typename T>
+    struct RaysAabbKernel
+    {
+      const Vec3Stream<T>& origins;
+      const Vec3Stream<T>& directions;
+      const Vec3<T>& boxMin;
+      const Vec3<T>& boxMax;
+      T* tNear;
+      std::uint32_t* hits;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        P entry;
+        const typename P::Mask m = slabHit(streamLoad<P>(origins, i), reciprocal(streamLoad<P>(directions, i)), broadcast<P>(boxMin),
+                                           broadcast<P>(boxMax), P(std::numeric_limits<T>::infinity()), entry);
+        select(m, entry, P(std::numeric_limits<T>::infinity())).store(tNear + i);
+        storeBits<P>(hits, i, m);
+      }
+    };
+  }
+  
+  // Fills hit and returns true when ray hits triangle v0 v1 v2 at some t > 0, from either side.
+  template <typename T>
+  inline bool intersectTriangle(const Ray<T>& ray, const Vec3<T>& v0, const Vec3<T>& v1, const Vec3<T>& v2, TriangleHit<T>& hit)
+  {
+    using P = Detail::Pack<T, 1>;
+    P t, u, v;
+    const bool m = Detail::triangleHit(Detail::broadcast<P>(ray.origin), Detail::broadcast<P>(ray.direction), Detail::broadcast<P>(v0),
+                                       Detail::broadcast<P>(v1), Detail::broadcast<P>(v2), t, u, v);
+    if (m)
+      hit = TriangleHit<T>{t.v, u.v, v.v};
+    return m;
+  }
+  
+  // Returns true when ray enters the box [boxMin, boxMax] at some t >= 0, which goes to tNear; an origin inside
+  // the box enters at 0.
+  template <typename T>
+  inline bool intersectAabb(const Ray<T>& ray, const Vec3<T>& boxMin, const Vec3<T>& boxMax, T& tNear)
+  {
+    using P = Detail::Pack<T, 1>;
+    P entry;
+    const bool m = Detail::slabHit(Detail::broadcast<P>(ray.origin), Detail::reciprocal(Detail::broadcast<P>(ray.direction)), Detail::broadcast<P>(boxMin),
+                                   Detail::broadcast<P>(boxMax), P(std::numeric_limits<T>::infinity()), entry);
+    if (m)
+      tNear = entry.v;
+    return m;
+  }
+  
+  // Batched ray intersection, Pack<T>::width triangles, boxes or rays at a time. Triangle i is
+  // (v0[i], v1[i], v2[i]), box i is [mins[i], maxs[i]] and ray i is (origins[i], directions[i]); the streams of
+  // one call must have equal size. Results follow intersectTriangle and intersectAabb: t, u, v and tNear are
+  // arrays of size() elements, with t and tNear set to infinity on a miss, and bit i % 32 of hits[i / 32] is set
+  // for a hit and cleared otherwise. hits must hold (size() + 31) / 32 words and bits past size() are left
+  // untouched.
+  
+  // One ray against every triangle.
+  template <typename T>
+  inline void intersectTriangles(const Ray<T>& ray, const Vec3Stream<T>& v0, const Vec3Stream<T>& v1, const Vec3Stream<T>& v2,
+                                 T* t, T* u, T* v, std::uint32_t* hits)
+  {
+    Detail::forEachPack<T>(v0.size(), Detail::RayTrianglesKernel<T>{ray, v0, v1, v2, t, u, v, hits});
+  }
+  
+  // Nearest hit of ray among the triangles that is closer than tMax. Returns its index and fills hit, or returns
+  // v0.size() and leaves hit alone when there is none.
+  template <typename T>
+  inline std::size_t intersectClosest(const Ray<T>& ray, const Vec3Stream<T>& v0, const Vec3Stream<T>& v1, const Vec3Stream<T>& v2,
+                                      TriangleHit<T>& hit, T tMax = std::numeric_limits<T>::infinity())
+  {
+    TriangleHit<T> nearest{tMax, 0, 0};
+    std::size_t index = v0.size();
+    Detail::forEachPack<T>(v0.size(), Detail::ClosestTriangleKernel<T>{ray, v0, v1, v2, nearest, index});
+    if (index != v0.size())
+      hit = nearest;
+    return index;
+  }
+  
+  // Every ray against one triangle.
+  template <typename T>
+  inline void intersectTriangle(const Vec3Stream<T>& origins, const Vec3Stream<T>& directions, const Vec3<T>& v0, const Vec3<T>& v1,
+                                const Vec3<T>& v2, T* t, T* u, T* v, std::uint32_t* hits)
+  {
+    Detail::forEachPack<T>(origins.size(), Detail::RaysTriangleKernel<T>{origins, directions, v0, v1, v2, t, u, v, hits});
+  }
+  
+  // One ray against every box.
+  template <typename T>
+  inline void intersectAabbs(const Ray<T>& ray, const Vec3Stream<T>& mins, const Vec3Stream<T>& maxs, T* tNear, std::uint32_t* hits)
+  {
+    const Vec3<T> dInv{1 / ray.direction.x, 1 / ray.direction.y, 1 / ray.direction.z};
+    Detail::forEachPack<T>(mins.size(), Detail::RayAabbsKernel<T>{ray, dInv, mins, maxs, tNear, hits});
+  }
+  
+  // Every ray against one box.
+  template <typename T>
+  inline void intersectAabb(const Vec3Stream<T>& origins, const Vec3Stream<T>& directions, const Vec3<T>& boxMin, const Vec3<T>& boxMax,
+                            T* tNear, std::uint32_t* hits)
+  {
+    Detail::forEachPack<T>(origins.size(), Detail::RaysAabbKernel<T>{origins, directions, boxMin, boxMax, tNear, hits});
+  }
+  
+  /* Bounding volume hierarchy */
+  
+#if defined(NEON_PARALLEL)
+  struct Executor;
+#endif
+  
+  namespace Detail
+  {
+    // Leaves hold at most kBvhMaxLeafSize triangles. Splits below kBvhSahDepth fall back from binned SAH to the
+    // centroid median, which bounds the depth of the tree, and so the traversal stack, by kBvhMaxDepth.
+    const unsigned int kBvhBins = 16;
+    const unsigned int kBvhMaxLeafSize = 8;
+    const unsigned int kBvhSahDepth = 32;
+    const unsigned int kBvhMaxDepth = 64;
+    
+    template <typename T>
+    struct BvhNode
+    {
+      Vec3<T> boxMin;
+      // First triangle of a leaf, or the left child of an inner node; the right child is first + 1.
+      std::uint32_t first;
+      Vec3<T> boxMax;
+      // Triangles in a leaf, 0 for an inner node.
+      std::uint32_t count;
+    };
+    
+    template <typename T>
+    inline void growBox(Vec3<T>& boxMin, Vec3<T>& boxMax, const Vec3<T>& lo, const Vec3<T>& hi)
+    {
+      boxMin = Vec3<T>{std::min(boxMin.x, lo.x), std::min(boxMin.y, lo.y), std::min(boxMin.z, lo.z)};
+      boxMax = Vec3<T>{std::max(boxMax.x, hi.x), std::max(boxMax.y, hi.y), std::max(boxMax.z, hi.z)};
+    }
+    
+    // Half the surface area, which is all the SAH needs.
+    template <typename T>
+    inline T halfArea(const Vec3<T>& boxMin, const Vec3<T>& boxMax)
+    {
+      const Vec3<T> d = boxMax - boxMin;
+      return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+    
+    // Splits ranges of order, the triangle indices in leaf order, using the bounds and centroids of the triangles.
+    template <typename T>
+    struct BvhBuilder
+    {
+      std::vector<Vec3<T>> mins;
+      std::vector<Vec3<T>> maxs;
+      std::vector<Vec3<T>> centroids;
+      std::uint32_t* order;
+      
+      // Sets the bounds of node to those of the triangles order[begin, end). Returns false to make node their leaf,
+      // or partitions them into [begin, mid) and [mid, end) and returns true.
+      bool split(BvhNode<T>& node, std::uint32_t begin, std::uint32_t end, unsigned int depth, std::uint32_t& mid) const
+      {
+        Vec3<T> boxMin = mins[order[begin]];
+        Vec3<T> boxMax = maxs[order[begin]];
+        Vec3<T> centroidMin = centroids[order[begin]];
+        Vec3<T> centroidMax = centroidMin;
+        for (std::uint32_t i = begin + 1; i < end; i++)
+        {
+          const std::uint32_t p = order[i];
+          growBox(boxMin, boxMax, mins[p], maxs[p]);
+          growBox(centroidMin, centroidMax, centroids[p], centroids[p]);
+        }
+        node = BvhNode<T>{boxMin, begin, boxMax, end - begin};
+        
+        const std::uint32_t count = end - begin;
+        if (count == 1)
+          return false;
+        const Vec3<T> extent = centroidMax - centroidMin;
+        const unsigned int axis = extent.x >= extent.y ? (extent.x >= extent.z ? 0 : 2) : (extent.y >= extent.z ? 1 : 2);
+        if (!(extent[axis] > 0))
+        {
+          // Coincident centroids give the binning nothing to go on.
+          if (count <= kBvhMaxLeafSize)
+            return false;
+          mid = begin + count / 2;
+          return true;
+        }
+        if (depth >= kBvhSahDepth)
+        {
+          mid = begin + count / 2;
+          const std::vector<Vec3<T>>& c = centroids;
+          std::nth_element(order + begin, order + mid, order + end,
+                           [&c, axis](std::uint32_t a, std::uint32_t b) { return c[a][axis] < c[b][axis]; });
+          return true;
+        }
+        
+        const T origin = centroidMin[axis];
+        const T scale = static_cast<T>(kBvhBins) / extent[axis];
+        const std::vector<Vec3<T>>& c = centroids;
+        auto binOf = [&c, axis, origin, scale](std::uint32_t p)
+        {
+          return std::min(kBvhBins - 1, static_cast<unsigned int>((c[p][axis] - origin) * scale));
+        };
+        
+        const T inf = std::numeric_limits<T>::infinity();
+        Vec3<T> binMin[kBvhBins];
+        Vec3<T> binMax[kBvhBins];
+        std::uint32_t binCount[kBvhBins] = {};
+        for (unsigned int b = 0; b < kBvhBins; b++)
+        {
+          binMin[b] = Vec3<T>(inf);
+          binMax[b] = Vec3<T>(-inf);
+        }
+        for (std::uint32_t i = begin; i < end; i++)
+        {
+          const std::uint32_t p = order[i];
+          const unsigned int b = binOf(p);
+          growBox(binMin[b], binMax[b], mins[p], maxs[p]);
+          binCount[b]++;
+        }
+        
+        // Sweep from the right for the areas and counts right of every split plane, then from the left to cost them.
+        T rightArea[kBvhBins - 1];
+        std::uint32_t rightCount[kBvhBins - 1];
+        Vec3<T> accMin(inf);
+        Vec3<T> accMax(-inf);
+        std::uint32_t accCount = 0;
+        for (unsigned int b = kBvhBins - 1; b > 0; b--)
+        {
+          growBox(accMin, accMax, binMin[b], binMax[b]);
+          accCount += binCount[b];
+          rightArea[b - 1] = accCount ? halfArea(accMin, accMax) : T(0);
+          rightCount[b - 1] = accCount;
+        }
+        accMin = Vec3<T>(inf);
+        accMax = Vec3<T>(-inf);
+        accCount = 0;
+        T bestCost = inf;
+        unsigned int bestBin = 0;
+        for (unsigned int b = 0; b < kBvhBins - 1; b++)
+        {
+          growBox(accMin, accMax, binMin[b], binMax[b]);
+          accCount += binCount[b];
+          if (!accCount || !rightCount[b])
+            continue;
+          const T cost = static_cast<T>(accCount) * halfArea(accMin, accMax) + static_cast<T>(rightCount[b]) * rightArea[b];
+          if (cost < bestCost)
+          {
+            bestCost = cost;
+            bestBin = b;
+          }
+        }
+        
+        // Unit costs for a traversal step and a triangle test, relative to the area of node.
+        const T area = halfArea(boxMin, boxMax);
+        if (count <= kBvhMaxLeafSize && area + bestCost >= static_cast<T>(count) * area)
+          return false;
+        mid = static_cast<std::uint32_t>(std::partition(order + begin, order + end,
+                                                         [&binOf, bestBin](std::uint32_t p) { return binOf(p) <= bestBin; }) - order);
+        return true;
+      }
+      
+      // Builds the subtree of nodes[index] over order[begin, end), appending its descendants to nodes.
+      void build(std::vector<BvhNode<T>>& nodes, std::uint32_t index, std::uint32_t begin, std::uint32_t end, unsigned int depth) const
+      {
+        std::uint32_t mid = 0;
+        if (!split(nodes[index], begin, end, depth, mid))
+          return;
+        const std::uint32_t children = static_cast<std::uint32_t>(nodes.size());
+        nodes[index].first = children;
+        nodes[index].count = 0;
+        nodes.resize(children + 2);
+        build(nodes, children, begin, mid, depth + 1);
+        build(nodes, children + 1, mid, end, depth + 1);
+      }
+    };
+    
+    template <typename T>
+    struct AnyTriangleKernel
+    {
+      const Ray<T>& ray;
+      const Vec3Stream<T>& v0;
+      const Vec3Stream<T>& v1;
+      const Vec3Stream<T>& v2;
+      T tMax;
+      bool& found;
+      
+      template <typename P>
+      inline void run(std::size_t i) const
+      {
+        P pt, pu, pv;
+        const typename P::Mask m = triangleHit(broadcast<P>(ray.origin), broadcast<P>(ray.direction), streamLoad<P>(v0, i),
+                                               streamLoad<P>(v1, i), streamLoad<P>(v2, i), pt, pu, pv);
+        if (any(m & (pt < P(tMax))))
+          found = true;
+      }
+    };
+  }
+  
+  // Binary bounding volume hierarchy over a triangle soup, for closest-hit and any-hit ray queries. Triangle i is
+  // (v0[i], v1[i], v2[i]) as in intersectTriangles. build() splits the triangles with a binned SAH (16 bins
+  // along the widest axis of their centroids) into leaves of up to 8, and keeps a copy of them in leaf order so
+  // that a leaf is tested Pack<T>::width triangles at a time. The nodes live in one array, 32 bytes each for
+  // float, with the two children of a node side by side. Traversal visits the nearer child first and skips boxes
+  // beyond the closest hit so far.
+  template <typename T>
+  struct Bvh
+  {
+    Bvh() = default;
+    
+    Bvh(const Vec3Stream<T>& v0, const Vec3Stream<T>& v1, const Vec3Stream<T>& v2)
+    {
+      build(v0, v1, v2);
     }
     
-    inline Mat2<T>& operator*=(const T t)
+    void build(const Vec3Stream<T>& v0, const Vec3Stream<T>& v1, const Vec3Stream<T>& v2)
     {
-      d[0][0] *= t; d[1][0] *= t;
-      d[0][1] *= t; d[1][1] *= t;
-      return *this;
+      Detail::BvhBuilder<T> builder;
+      if (!prepare(v0, v1, v2, builder))
+        return;
+      builder.build(nodes, 0, 0, static_cast<std::uint32_t>(order.size()), 0);
+      refit(v0, v1, v2);
     }
     
-    inline Vec2<T> operator*(const Vec2<T>& v) const
+#if defined(NEON_PARALLEL)
+    // Splits the top of the tree on the calling thread and builds the subtrees below it on executor. The tree is
+    // the one the serial build makes, with its nodes in another order, so queries return the same hits.
+    void build(Executor& executor, const Vec3Stream<T>& v0, const Vec3Stream<T>& v1, const Vec3Stream<T>& v2);
+#endif
+    
+    // Updates the boxes after the vertices moved, keeping the tree. v0, v1 and v2 must hold as many triangles as
+    // the build did. Queries stay exact; they only slow down as the triangles drift away from the build layout.
+    void refit(const Vec3Stream<T>& v0, const Vec3Stream<T>& v1, const Vec3Stream<T>& v2)
     {
-      return Vec2<T>(d[0][0] * v.x + d[1][0] * v.y,
-                     d[0][1] * v.x + d[1][1] * v.y);
+      const std::size_t count = order.size();
+      triangles[0].resize(count);
+      triangles[1].resize(count);
+      triangles[2].resize(count);
+      for (std::size_t k = 0; k < count; k++)
+      {
+        triangles[0].set(k, v0[order[k]]);
+        triangles[1].set(k, v1[order[k]]);
+        triangles[2].set(k, v2[order[k]]);
+      }
+      // Children always come after their parent.
+      for (std::size_t k = nodes.size(); k-- > 0;)
+      {
+        Detail::BvhNode<T>& node = nodes[k];
+        if (node.count)
+        {
+          node.boxMin = node.boxMax = triangles[0][node.first];
+          for (std::uint32_t i = node.first; i < node.first + node.count; i++)
+          {
+            for (unsigned int c = 0; c < 3; c++)
+            {
+              const Vec3<T> p = triangles[c][i];
+              Detail::growBox(node.boxMin, node.boxMax, p, p);
+            }
+          }
+        }
+        else
+        {
+          node.boxMin = nodes[node.first].boxMin;
+          node.boxMax = nodes[node.first].boxMax;
+          Detail::growBox(node.boxMin, node.boxMax, nodes[node.first + 1].boxMin, nodes[node.first + 1].boxMax);
+        }
+      }
     }
     
-    friend inline Mat2<T> operator*(const Mat2<T>& lhs, const Mat2<T>& rhs)
+    // Nearest hit of ray closer than tMax. Returns the index of its triangle and fills hit, or returns
+    // triangleCount() and leaves hit alone when there is none.
+    std::size_t closestHit(const Ray<T>& ray, TriangleHit<T>& hit, T tMax = std::numeric_limits<T>::infinity()) const
     {
-      const T v1x = lhs.d[0][0] * rhs.d[0][0] + lhs.d[1][0] * rhs.d[0][1];
-      const T v2x = lhs.d[0][0] * rhs.d[1][0] + lhs.d[1][0] * rhs.d[1][1];
-      const T v1y = lhs.d[0][1] * rhs.d[0][0] + lhs.d[1][1] * rhs.d[0][1];
-      const T v2y = lhs.d[0][1] * rhs.d[1][0] + lhs.d[1][1] * rhs.d[1][1];
-      return Mat2<T>(v1x, v2x,
-                     v1y, v2y);
+      TriangleHit<T> nearest{tMax, 0, 0};
+      std::size_t index = order.size();
+      traverse(ray, nearest.t, [&](const Detail::BvhNode<T>& leaf)
+      {
+        Detail::forEachPack<T>(leaf.first, leaf.first + leaf.count,
+                               Detail::ClosestTriangleKernel<T>{ray, triangles[0], triangles[1], triangles[2], nearest, index});
+        return false;
+      });
+      if (index == order.size())
+        return index;
+      hit = nearest;
+      return order[index];
     }
     
-    inline Mat2<T> operator/(const T t) const
+    // Whether ray hits any triangle closer than tMax; stops at the first leaf with a hit.
+    bool anyHit(const Ray<T>& ray, T tMax = std::numeric_limits<T>::infinity()) const
     {
-      const T d = 1 / t;
-      return *this * d;
+      bool found = false;
+      traverse(ray, tMax, [&](const Detail::BvhNode<T>& leaf)
+      {
+        Detail::forEachPack<T>(leaf.first, leaf.first + leaf.count,
+                               Detail::AnyTriangleKernel<T>{ray, triangles[0], triangles[1], triangles[2], tMax, found});
+        return found;
+      });
+      return found;
     }
     
-    friend inline Mat2<T> operator/(const T t, const Mat2<T>& m)
+    inline std::size_t triangleCount() const
     {
-      return m * t;
+      return order.size();
     }
     
-    inline Mat2<T>& operator/=(const T t)
+    inline std::size_t nodeCount() const
     {
-      const T d = 1 / t;
-      return *this *= d;
+      return nodes.size();
     }
     
-    inline T* data()
+  private:
+    // Sets up order and builder and leaves the root for the build, or clears the tree when there are no triangles.
+    bool prepare(const Vec3Stream<T>& v0, const Vec3Stream<T>& v1, const Vec3Stream<T>& v2, Detail::BvhBuilder<T>& builder)
     {
-      return d[0];
+      const std::size_t count = v0.size();
+      nodes.clear();
+      order.resize(count);
+      if (!count)
+        return false;
+      builder.mins.resize(count);
+      builder.maxs.resize(count);
+      builder.centroids.resize(count);
+      for (std::size_t i = 0; i < count; i++)
+      {
+        Vec3<T> boxMin = v0[i];
+        Vec3<T> boxMax = boxMin;
+        Detail::growBox(boxMin, boxMax, v1[i], v1[i]);
+        Detail::growBox(boxMin, boxMax, v2[i], v2[i]);
+        builder.mins[i] = boxMin;
+        builder.maxs[i] = boxMax;
+        builder.centroids[i] = Vec3<T>((boxMin + boxMax) * static_cast<T>(0.5));
+        order[i] = static_cast<std::uint32_t>(i);
+      }
+      builder.order = order.data();
+      nodes.reserve(2 * count);
+      nodes.resize(1);
+      return true;
+    }
+    
+    // Calls leaf(node) for the leaves whose boxes ray enters before tMax, nearer children first, until it returns
+    // true. tMax is read again at every node, so leaf can shrink it.
+    template <typename Leaf>
+    void traverse(const Ray<T>& ray, const T& tMax, const Leaf& leaf) const
+    {
+      using P = Detail::Pack<T, 1>;
+      if (nodes.empty())
+        return;
+      const Vec3<P> o = Detail::broadcast<P>(ray.origin);
+      const Vec3<P> dInv = Detail::reciprocal(Detail::broadcast<P>(ray.direction));
+      std::uint32_t stack[Detail::kBvhMaxDepth];
+      T stackEntry[Detail::kBvhMaxDepth];
+      unsigned int top = 0;
+      P entry;
+      if (!Detail::slabHit(o, dInv, Detail::broadcast<P>(nodes[0].boxMin), Detail::broadcast<P>(nodes[0].boxMax), P(tMax), entry))
+        return;
+      std::uint32_t current = 0;
+      for (;;)
+      {
+        const Detail::BvhNode<T>& node = nodes[current];
+        if (node.count)
+        {
+          if (leaf(node))
+            return;
+        }
+        else
+        {
+          const Detail::BvhNode<T>& a = nodes[node.first];
+          const Detail::BvhNode<T>& b = nodes[node.first + 1];
+          P entryA, entryB;
+          const bool hitA = Detail::slabHit(o, dInv, Detail::broadcast<P>(a.boxMin), Detail::broadcast<P>(a.boxMax), P(tMax), entryA);
+          const bool hitB = Detail::slabHit(o, dInv, Detail::broadcast<P>(b.boxMin), Detail::broadcast<P>(b.boxMax), P(tMax), entryB);
+          if (hitA && hitB)
+          {
+            const bool aFirst = entryA.v <= entryB.v;
+            stack[top] = aFirst ? node.first + 1 : node.first;
+            stackEntry[top++] = aFirst ? entryB.v : entryA.v;
+            current = aFirst ? node.first : node.first + 1;
+            continue;
+          }
+          if (hitA || hitB)
+          {
+            current = hitA ? node.first : node.first + 1;
+            continue;
+          }
+        }
+        // Pop the next subtree that still starts before the nearest hit.
+        do
+        {
+          if (!top)
+            return;
+          current = stack[--top];
+        }
+        while (stackEntry[top] > tMax);
+      }
+    }
+    
+    std::vector<Detail::BvhNode<T>> nodes;
+    // order[k] is the index of the k-th triangle in leaf order.
+    std::vector<std::uint32_t> order;
+    Vec3Stream<T> triangles[3];
+  };
+  
+  /* Half and BFloat16 */
+  
+  namespace Detail
+  {
+    inline std::uint32_t floatBits(float f)
+    {
+      std::uint32_t u;
+      std::memcpy(&u, &f, sizeof(u));
+      return u;
+    }
+    
+    inline float bitsFloat(std::uint32_t u)
+    {
+      float f;
+      std::memcpy(&f, &u, sizeof(f));
+      return f;
+    }
+    
+    // Round to nearest even. NaNs stay NaNs with the quiet bit set and the top of their payload kept, as F16C does.
+    // https://gist.github.com/rygorous/2156668
+    inline std::uint16_t floatToHalf(float f)
+    {
+      std::uint32_t u = floatBits(f);
+      const std::uint32_t sign = (u >> 16) & 0x8000u;
+      u &= 0x7fffffffu;
+      std::uint32_t h;
+      if (u >= 0x47800000u)
+      {
+        // 2^16 and above, infinity or NaN.
+        h = u > 0x7f800000u ? 0x7e00u | ((u >> 13) & 0x3ffu) : 0x7c00u;
+      }
+      else if (u < 0x38800000u)
+      {
+        // Below 2^-14 the result is subnormal: adding 0.5 lines the float ulp up with the half ulp of 2^-24.
+        h = floatBits(bitsFloat(u) + 0.5f) - 0x3f000000u;
+      }
+      else
+      {
+        // Rebias the exponent and round; a carry out of the mantissa correctly bumps the exponent.
+        h = (u + 0xc8000fffu + ((u >> 13) & 1u)) >> 13;
+      }
+      return static_cast<std::uint16_t>(sign | h);
+    }
+    
+    inline float halfToFloat(std::uint16_t h)
+    {
+      const std::uint32_t exponent = h & 0x7c00u;
+      std::uint32_t u = static_cast<std::uint32_t>(h & 0x7fffu) << 13;
+      float f;
+      if (exponent == 0x7c00u)
+        f = bitsFloat(u + 0x70000000u);
+      else if (exponent == 0)
+        f = bitsFloat(u + 0x38800000u) - bitsFloat(0x38800000u);
+      else
+        f = bitsFloat(u + 0x38000000u);
+      return (h & 0x8000u) ? -f : f;
+    }
+    
+    inline std::uint16_t floatToBFloat16(float f)
+    {
+      const std::uint32_t u = floatBits(f);
+      if ((u & 0x7fffffffu) > 0x7f800000u)
+        return static_cast<std::uint16_t>((u >> 16) | 0x40u);
+      return static_cast<std::uint16_t>((u + 0x7fffu + ((u >> 16) & 1u)) >> 16);
+    }
+    
+    inline float bfloat16ToFloat(std::uint16_t b)
+    {
+      return bitsFloat(static_cast<std::uint32_t>(b) << 16);
+    }
+  }
+  
+  // IEEE 754 binary16 storage: 1 sign, 5 exponent and 10 mantissa bits, finite up to 65504. Converts implicitly to
+  // and from float, rounding to nearest even, so Vec4<Half> and friends keep data at half the size while arithmetic
+  // on them is carried out in float and rounded back on assignment.
+  struct Half
+  {
+    std::uint16_t bits;
+    
+    Half() = default;
+    
+    Half(float f) : bits(Detail::floatToHalf(f))
+    {
+    }
+    
+    inline operator float() const
+    {
+      return Detail::halfToFloat(bits);
+    }
+    
+    static inline Half fromBits(std::uint16_t b)
+    {
+      Half h;
+      h.bits = b;
+      return h;
+    }
+  };
+  
+  // The upper half of a float: float's range with an 8-bit mantissa. Same conversions and rounding as Half.
+  struct BFloat16
+  {
+    std::uint16_t bits;
+    
+    BFloat16() = default;
+    
+    BFloat16(float f) : bits(Detail::floatToBFloat16(f))
+    {
+    }
+    
+    inline operator float() const
+    {
+      return Detail::bfloat16ToFloat(bits);
+    }
+    
+    static inline BFloat16 fromBits(std::uint16_t b)
+    {
+      BFloat16 h;
+      h.bits = b;
+      return h;
     }
   };
   
-  /* Mat3 */
-  template <typename T>
-  struct Mat3
+  // Bulk conversions of count scalars, with the same results as the scalar conversions. Half converts eight at a time
+  // with F16C and BFloat16 eight at a time with SSE2; the rest, and the tails, go one at a time.
+  
+  inline void convert(const float* src, Half* dst, std::size_t count)
+  {
+    std::size_t i = 0;
+#if defined(NEON_SIMD_F16C)
+    for (const std::size_t body = count - count % 8; i < body; i += 8)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+    for (; i < count; i++)
+      dst[i] = Half(src[i]);
+  }
+  
+  inline void convert(const Half* src, float* dst, std::size_t count)
+  {
+    std::size_t i = 0;
+#if defined(NEON_SIMD_F16C)
+    for (const std::size_t body = count - count % 8; i < body; i += 8)
+      _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+#endif
+    for (; i < count; i++)
+      dst[i] = src[i];
+  }
+  
+#if defined(NEON_SIMD_SSE2)
+  namespace Detail
+  {
+    // Four floats rounded to bfloat16, in the low half of each 32-bit lane and sign extended for _mm_packs_epi32.
+    inline __m128i floatToBFloat16(__m128 f)
+    {
+      const __m128i u = _mm_castps_si128(f);
+      const __m128i odd = _mm_and_si128(_mm_srli_epi32(u, 16), _mm_set1_epi32(1));
+      const __m128i rounded = _mm_add_epi32(u, _mm_add_epi32(_mm_set1_epi32(0x7fff), odd));
+      const __m128i nan = _mm_castps_si128(_mm_cmpunord_ps(f, f));
+      const __m128i quiet = _mm_or_si128(u, _mm_set1_epi32(0x400000));
+      return _mm_srai_epi32(_mm_or_si128(_mm_and_si128(nan, quiet), _mm_andnot_si128(nan, rounded)), 16);
+    }
+  }
+#endif
+  
+  inline void convert(const float* src, BFloat16* dst, std::size_t count)
+  {
+    std::size_t i = 0;
+#if defined(NEON_SIMD_SSE2)
+    for (const std::size_t body = count - count % 8; i < body; i += 8)
+    {
+      const __m128i lo = Detail::floatToBFloat16(_mm_loadu_ps(src + i));
+      const __m128i hi = Detail::floatToBFloat16(_mm_loadu_ps(src + i + 4));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+    }
+#endif
+    for (; i < count; i++)
+      dst[i] = BFloat16(src[i]);
+  }
+  
+  inline void convert(const BFloat16* src, float* dst, std::size_t count)
+  {
+    std::size_t i = 0;
+#if defined(NEON_SIMD_SSE2)
+    for (const std::size_t body = count - count % 8; i < body; i += 8)
+    {
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      const __m128i zero = _mm_setzero_si128();
+      _mm_storeu_ps(dst + i, _mm_castsi128_ps(_mm_unpacklo_epi16(zero, b)));
+      _mm_storeu_ps(dst + i + 4, _mm_castsi128_ps(_mm_unpackhi_epi16(zero, b)));
+    }
+#endif
+    for (; i < count; i++)
+      dst[i] = src[i];
+  }
+  
+  // Converts count vectors, e.g. Vec4h to Vec4f, through the scalar overloads above.
+  template <typename From, typename To, unsigned int N>
+  inline void convert(const Vec<From, N>* src, Vec<To, N>* dst, std::size_t count)
   {
-    static const unsigned short size = 3;
-    T d[3][3];
-    
-    explicit Mat3(T t = 1)
+    convert(reinterpret_cast<const From*>(src), reinterpret_cast<To*>(dst), count * N);
+  }
+  
+  /* Unit vector encoding */
+  
+  namespace Detail
+  {
+    template <typename P>
+    inline P signNotZero(P v)
     {
-      d[0][0] = t; d[0][1] = 0; d[0][2] = 0;
-      d[1][0] = 0; d[1][1] = t; d[1][2] = 0;
-      d[2][0] = 0; d[2][1] = 0; d[2][2] = t;
+      return select(v < P(0), P(-1), P(1));
     }
     
-    Mat3(const Vec3<T>& col1, const Vec3<T>& col2, const Vec3<T>& col3)
+    // Octahedral projection of a unit vector onto [-1, 1]^2; the lower hemisphere is folded over the diagonals.
+    // http://jcgt.org/published/0003/02/01/
+    template <typename P>
+    inline Vec3<P> octEncode(const Vec3<P>& n)
     {
-      d[0][0] = col1.x; d[0][1] = col1.y; d[0][2] = col1.z;
-      d[1][0] = col2.x; d[1][1] = col2.y; d[1][2] = col2.z;
-      d[2][0] = col3.x; d[2][1] = col3.y; d[2][2] = col3.z;
+      const P l1Inv = P(1) / (abs(n.x) + abs(n.y) + abs(n.z));
+      const P x = n.x * l1Inv;
+      const P y = n.y * l1Inv;
+      const auto lower = n.z < P(0);
+      return Vec3<P>{select(lower, (P(1) - abs(y)) * signNotZero(x), x),
+                     select(lower, (P(1) - abs(x)) * signNotZero(y), y),
+                     P(0)};
     }
     
-    Mat3(T col1x, T col2x, T col3x,
-         T col1y, T col2y, T col3y,
-         T col1z, T col2z, T col3z)
+    // Inverse of octEncode, renormalized so the quantized input still gives a unit vector.
+    template <typename P>
+    inline Vec3<P> octDecode(const Vec3<P>& p)
     {
-      d[0][0] = col1x; d[0][1] = col1y; d[0][2] = col1z;
-      d[1][0] = col2x; d[1][1] = col2y; d[1][2] = col2z;
-      d[2][0] = col3x; d[2][1] = col3y; d[2][2] = col3z;
+      const P z = P(1) - abs(p.x) - abs(p.y);
+      const P t = max(-z, P(0));
+      const P x = p.x + select(p.x >= P(0), -t, t);
+      const P y = p.y + select(p.y >= P(0), -t, t);
+      const P magInv = P(1) / sqrt(madd(x, x, madd(y, y, z * z)));
+      return Vec3<P>{x * magInv, y * magInv, z * magInv};
     }
     
-    Mat3(const Mat3<T>& other)
+    template <typename P>
+    inline Vec3<P> snormEncode(const Vec3<P>& n)
     {
-      d[0][0] = other.d[0][0]; d[1][0] = other.d[1][0]; d[2][0] = other.d[2][0];
-      d[0][1] = other.d[0][1]; d[1][1] = other.d[1][1]; d[2][1] = other.d[2][1];
-      d[0][2] = other.d[0][2]; d[1][2] = other.d[1][2]; d[2][2] = other.d[2][2];
+      return n;
     }
     
-    Mat3(const Mat2<T>& other)
+    template <typename P>
+    inline Vec3<P> snormDecode(const Vec3<P>& q)
     {
-      d[0][0] = other.d[0][0]; d[1][0] = other.d[1][0]; d[2][0] = 0;
-      d[0][1] = other.d[0][1]; d[1][1] = other.d[1][1]; d[2][1] = 0;
-      d[0][2] = 0;             d[1][2] = 0;             d[2][2] = 0;
+      const P magInv = P(1) / sqrt(madd(q.x, q.x, madd(q.y, q.y, q.z * q.z)));
+      return Vec3<P>{q.x * magInv, q.y * magInv, q.z * magInv};
     }
     
-    Mat3<T>& operator=(const Mat3<T>& other)
+    // Components signed normalized integers of B bits each, packed from the least significant bit up. Oct formats
+    // keep the two octahedral coordinates, Snorm formats x, y and z.
+    template <typename B, unsigned int Bits, unsigned int Components>
+    struct UnitFormat
     {
-      if (this != &other)
+      using Packed = B;
+      static const unsigned int components = Components;
+      static const unsigned int bits = Bits;
+      static const std::uint32_t mask = (1u << Bits) - 1u;
+      static const std::int32_t scale = (1 << (Bits - 1)) - 1;
+      
+      template <typename P>
+      static inline Vec3<P> encode(const Vec3<P>& n)
       {
-        d[0][0] = other.d[0][0]; d[1][0] = other.d[1][0]; d[2][0] = other.d[2][0];
-        d[0][1] = other.d[0][1]; d[1][1] = other.d[1][1]; d[2][1] = other.d[2][1];
-        d[0][2] = other.d[0][2]; d[1][2] = other.d[1][2]; d[2][2] = other.d[2][2];
+        return Components == 2 ? octEncode(n) : snormEncode(n);
       }
-      return *this;
-    }
+      
+      template <typename P>
+      static inline Vec3<P> decode(const Vec3<P>& q)
+      {
+        return Components == 2 ? octDecode(q) : snormDecode(q);
+      }
+      
+      // Rounds to nearest even, like the SIMD conversions.
+      template <typename T>
+      static inline Packed quantize(const T* q)
+      {
+        std::uint32_t packed = 0;
+        for (unsigned int k = 0; k < Components; k++)
+        {
+          const std::uint32_t c = static_cast<std::uint32_t>(std::lrint(q[k] * T(scale)));
+          packed |= (c & mask) << (k * Bits);
+        }
+        return static_cast<Packed>(packed);
+      }
+      
+      template <typename T>
+      static inline void dequantize(Packed packed, T* q)
+      {
+        const std::uint32_t sign = 1u << (Bits - 1);
+        for (unsigned int k = 0; k < Components; k++)
+        {
+          const std::uint32_t c = (static_cast<std::uint32_t>(packed) >> (k * Bits)) & mask;
+          q[k] = T(static_cast<std::int32_t>(c ^ sign) - static_cast<std::int32_t>(sign)) / T(scale);
+        }
+      }
+    };
     
-    inline Vec3<T>& operator[](unsigned int col)
+    using Oct32Format = UnitFormat<std::uint32_t, 16, 2>;
+    using Oct16Format = UnitFormat<std::uint16_t, 8, 2>;
+    using Snorm1010102Format = UnitFormat<std::uint32_t, 10, 3>;
+    
+    // Quantizes, or dequantizes, a pack of encoded vectors one lane at a time.
+    template <typename Format, typename P>
+    struct UnitLanes
     {
-      return *reinterpret_cast<Vec3<T>*>(d[col]);
-    }
+      using T = typename P::Scalar;
+      using Packed = typename Format::Packed;
+      
+      static inline void store(const Vec3<P>& q, Packed* dst)
+      {
+        T lanes[3][P::width];
+        q.x.store(lanes[0]);
+        q.y.store(lanes[1]);
+        q.z.store(lanes[2]);
+        for (unsigned int l = 0; l < P::width; l++)
+        {
+          const T c[3] = {lanes[0][l], lanes[1][l], lanes[2][l]};
+          dst[l] = Format::quantize(c);
+        }
+      }
+      
+      static inline Vec3<P> load(const Packed* src)
+      {
+        T lanes[3][P::width];
+        for (unsigned int l = 0; l < P::width; l++)
+        {
+          T c[3] = {T(0), T(0), T(0)};
+          Format::dequantize(src[l], c);
+          lanes[0][l] = c[0];
+          lanes[1][l] = c[1];
+          lanes[2][l] = c[2];
+        }
+        return Vec3<P>{P::load(lanes[0]), P::load(lanes[1]), P::load(lanes[2])};
+      }
+    };
     
-    inline const Vec3<T>& operator[](unsigned int col) const
+#if defined(NEON_SIMD_SSE2)
+    // Packs and unpacks 32-bit integer lanes; fields are sign extended back with a shift pair.
+    template <typename Format>
+    struct UnitFields
     {
-      return *reinterpret_cast<const Vec3<T>*>(d[col]);
-    }
+      static inline __m128i pack(const __m128i* q)
+      {
+        const __m128i mask = _mm_set1_epi32(static_cast<int>(Format::mask));
+        __m128i packed = _mm_setzero_si128();
+        for (unsigned int k = 0; k < Format::components; k++)
+        {
+          const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(k * Format::bits));
+          packed = _mm_or_si128(packed, _mm_sll_epi32(_mm_and_si128(q[k], mask), shift));
+        }
+        return packed;
+      }
+      
+      static inline __m128i unpack(__m128i packed, unsigned int k)
+      {
+        const __m128i left = _mm_cvtsi32_si128(static_cast<int>(32 - (k + 1) * Format::bits));
+        const __m128i right = _mm_cvtsi32_si128(static_cast<int>(32 - Format::bits));
+        return _mm_sra_epi32(_mm_sll_epi32(packed, left), right);
+      }
+      
+      // The low halves sign extended so _mm_packs_epi32 keeps their bits.
+      static inline __m128i narrow(__m128i packed)
+      {
+        const __m128i low = _mm_srai_epi32(_mm_slli_epi32(packed, 16), 16);
+        return _mm_packs_epi32(low, low);
+      }
+    };
     
-    inline T& operator()(unsigned int row, unsigned int col)
+    // _mm_cvtps_epi32 and _mm_cvtpd_epi32 round to nearest even, like the scalar path.
+    template <typename Format>
+    struct UnitLanes<Format, Pack<float, 4>>
     {
-      return d[col][row];
-    }
+      using Packed = typename Format::Packed;
+      
+      static inline void store(const Vec3<Pack<float, 4>>& q, Packed* dst)
+      {
+        const __m128 scale = _mm_set1_ps(float(Format::scale));
+        const __m128i fields[3] = {_mm_cvtps_epi32(_mm_mul_ps(q.x.v, scale)),
+                                   _mm_cvtps_epi32(_mm_mul_ps(q.y.v, scale)),
+                                   _mm_cvtps_epi32(_mm_mul_ps(q.z.v, scale))};
+        const __m128i packed = UnitFields<Format>::pack(fields);
+        if (sizeof(Packed) == 4)
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), packed);
+        else
+          _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), UnitFields<Format>::narrow(packed));
+      }
+      
+      static inline Vec3<Pack<float, 4>> load(const Packed* src)
+      {
+        const __m128i packed = sizeof(Packed) == 4
+          ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(src))
+          : _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)), _mm_setzero_si128());
+        const __m128 scale = _mm_set1_ps(float(Format::scale));
+        __m128 c[3] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()};
+        for (unsigned int k = 0; k < Format::components; k++)
+          c[k] = _mm_div_ps(_mm_cvtepi32_ps(UnitFields<Format>::unpack(packed, k)), scale);
+        return Vec3<Pack<float, 4>>{Pack<float, 4>(c[0]), Pack<float, 4>(c[1]), Pack<float, 4>(c[2])};
+      }
+    };
     
-    inline const T& operator()(unsigned int row, unsigned int col) const
+    template <typename Format>
+    struct UnitLanes<Format, Pack<double, 2>>
     {
-      return d[col][row];
-    }
+      using Packed = typename Format::Packed;
+      
+      static inline void store(const Vec3<Pack<double, 2>>& q, Packed* dst)
+      {
+        const __m128d scale = _mm_set1_pd(double(Format::scale));
+        const __m128i fields[3] = {_mm_cvtpd_epi32(_mm_mul_pd(q.x.v, scale)),
+                                   _mm_cvtpd_epi32(_mm_mul_pd(q.y.v, scale)),
+                                   _mm_cvtpd_epi32(_mm_mul_pd(q.z.v, scale))};
+        const __m128i packed = UnitFields<Format>::pack(fields);
+        if (sizeof(Packed) == 4)
+        {
+          _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), packed);
+        }
+        else
+        {
+          const std::int32_t pair = _mm_cvtsi128_si32(UnitFields<Format>::narrow(packed));
+          std::memcpy(dst, &pair, sizeof(pair));
+        }
+      }
+      
+      static inline Vec3<Pack<double, 2>> load(const Packed* src)
+      {
+        __m128i packed;
+        if (sizeof(Packed) == 4)
+        {
+          packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+        }
+        else
+        {
+          std::int32_t pair;
+          std::memcpy(&pair, src, sizeof(pair));
+          packed = _mm_unpacklo_epi16(_mm_cvtsi32_si128(pair), _mm_setzero_si128());
+        }
+        const __m128d scale = _mm_set1_pd(double(Format::scale));
+        __m128d c[3] = {_mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd()};
+        for (unsigned int k = 0; k < Format::components; k++)
+          c[k] = _mm_div_pd(_mm_cvtepi32_pd(UnitFields<Format>::unpack(packed, k)), scale);
+        return Vec3<Pack<double, 2>>{Pack<double, 2>(c[0]), Pack<double, 2>(c[1]), Pack<double, 2>(c[2])};
+      }
+    };
+#endif
     
-    friend inline Mat3<T> operator+(const Mat3<T>& lhs, const Mat3<T>& rhs)
+    template <typename Format, typename T>
+    inline typename Format::Packed encodeUnit(const Vec3<T>& n)
     {
-      return Mat3<T>(lhs[0] + rhs[0], lhs[1] + rhs[1], lhs[2] + rhs[2]);
+      typename Format::Packed packed;
+      UnitLanes<Format, Pack<T, 1>>::store(Format::encode(aosLoad<T>(&n)), &packed);
+      return packed;
     }
     
-    inline Mat3<T>& operator+=(const Mat3<T>& m)
+    template <typename Format, typename T>
+    inline Vec3<T> decodeUnit(typename Format::Packed packed)
     {
-      d[0][0] += m.d[0][0]; d[1][0] += m.d[1][0]; d[2][0] += m.d[2][0];
-      d[0][1] += m.d[0][1]; d[1][1] += m.d[1][1]; d[2][1] += m.d[2][1];
-      d[0][2] += m.d[0][2]; d[1][2] += m.d[1][2]; d[2][2] += m.d[2][2];
-      return *this;
+      Vec3<T> result;
+      aosStore(&result, Format::decode(UnitLanes<Format, Pack<T, 1>>::load(&packed)));
+      return result;
     }
     
-    inline Mat3<T> operator-() const
+    template <typename Format, typename T>
+    inline void encodeUnitArray(const Vec3<T>* src, typename Format::Packed* dst, std::size_t count)
     {
-      return Mat3<T>(-d[0][0], -d[1][0], -d[2][0],
-                     -d[0][1], -d[1][1], -d[2][1],
-                     -d[0][2], -d[1][2], -d[2][2]);
+      using P = Pack<T, AosPackWidth<T>::value>;
+      const std::size_t body = count - count % P::width;
+      std::size_t i = 0;
+      for (; i < body; i += P::width)
+        UnitLanes<Format, P>::store(Format::encode(aosLoad(src + i)), dst + i);
+      for (; i < count; i++)
+        dst[i] = encodeUnit<Format>(src[i]);
     }
     
-    friend inline Mat3<T> operator-(const Mat3<T>& lhs, const Mat3<T>& rhs)
+    template <typename Format, typename T>
+    inline void decodeUnitArray(const typename Format::Packed* src, Vec3<T>* dst, std::size_t count)
     {
-      return Mat3<T>(lhs[0] - rhs[0], lhs[1] - rhs[1], lhs[2] - rhs[2]);
+      using P = Pack<T, AosPackWidth<T>::value>;
+      const std::size_t body = count - count % P::width;
+      std::size_t i = 0;
+      for (; i < body; i += P::width)
+        aosStore(dst + i, Format::decode(UnitLanes<Format, P>::load(src + i)));
+      for (; i < count; i++)
+        dst[i] = decodeUnit<Format, T>(src[i]);
     }
+  }
+  
+  // Compact encodings of unit vectors such as normals and directions. Encoding expects a unit vector, decoding always
+  // returns one. The angles quoted are the largest measured between a unit vector and its decoded encoding. The array
+  // overloads encode to the same bits as the scalar ones and convert four floats or two doubles at a time with SSE2.
+  
+  // Octahedral mapping quantized to two 16-bit snorms, x in the low half: within 0.004 degrees.
+  template <typename T>
+  inline std::uint32_t encodeOct32(const Vec3<T>& n)
+  {
+    return Detail::encodeUnit<Detail::Oct32Format>(n);
+  }
+  
+  template <typename T = float>
+  inline Vec3<T> decodeOct32(std::uint32_t packed)
+  {
+    return Detail::decodeUnit<Detail::Oct32Format, T>(packed);
+  }
+  
+  template <typename T>
+  inline void encodeOct32(const Vec3<T>* src, std::uint32_t* dst, std::size_t count)
+  {
+    Detail::encodeUnitArray<Detail::Oct32Format>(src, dst, count);
+  }
+  
+  template <typename T>
+  inline void decodeOct32(const std::uint32_t* src, Vec3<T>* dst, std::size_t count)
+  {
+    Detail::decodeUnitArray<Detail::Oct32Format>(src, dst, count);
+  }
+  
+  // Octahedral mapping quantized to two 8-bit snorms, x in the low byte: within 0.96 degrees.
+  template <typename T>
+  inline std::uint16_t encodeOct16(const Vec3<T>& n)
+  {
+    return Detail::encodeUnit<Detail::Oct16Format>(n);
+  }
+  
+  template <typename T = float>
+  inline Vec3<T> decodeOct16(std::uint16_t packed)
+  {
+    return Detail::decodeUnit<Detail::Oct16Format, T>(packed);
+  }
+  
+  template <typename T>
+  inline void encodeOct16(const Vec3<T>* src, std::uint16_t* dst, std::size_t count)
+  {
+    Detail::encodeUnitArray<Detail::Oct16Format>(src, dst, count);
+  }
+  
+  template <typename T>
+  inline void decodeOct16(const std::uint16_t* src, Vec3<T>* dst, std::size_t count)
+  {
+    Detail::decodeUnitArray<Detail::Oct16Format>(src, dst, count);
+  }
+  
+  // x, y and z as 10-bit snorms from the low bits up, the layout of GL_INT_2_10_10_10_REV, with the top two bits left
+  // zero for the caller, e.g. for a tangent's handedness: within 0.1 degrees.
+  template <typename T>
+  inline std::uint32_t encodeSnorm1010102(const Vec3<T>& n)
+  {
+    return Detail::encodeUnit<Detail::Snorm1010102Format>(n);
+  }
+  
+  template <typename T = float>
+  inline Vec3<T> decodeSnorm1010102(std::uint32_t packed)
+  {
+    return Detail::decodeUnit<Detail::Snorm1010102Format, T>(packed);
+  }
+  
+  template <typename T>
+  inline void encodeSnorm1010102(const Vec3<T>* src, std::uint32_t* dst, std::size_t count)
+  {
+    Detail::encodeUnitArray<Detail::Snorm1010102Format>(src, dst, count);
+  }
+  
+  template <typename T>
+  inline void decodeSnorm1010102(const std::uint32_t* src, Vec3<T>* dst, std::size_t count)
+  {
+    Detail::decodeUnitArray<Detail::Snorm1010102Format>(src, dst, count);
+  }
+  
+  /* GPU buffer layouts */
+  
+  // Member layouts of GLSL uniform and storage blocks. Std140 rounds the stride of arrays, and of the columns of
+  // matrices, up to the size of a vec4; Std430 keeps the natural alignment of the element. A vec3 aligns like a
+  // vec4 in both.
+  enum class BufferLayout
+  {
+    Std140,
+    Std430
+  };
+  
+  namespace Detail
+  {
+    // Scalar type and column-major shape of a type that can be placed in a buffer.
+    template <typename Type>
+    struct BufferShape;
+    
+    template <>
+    struct BufferShape<float>
+    {
+      using Scalar = float;
+      static const unsigned int columns = 1;
+      static const unsigned int rows = 1;
+    };
+    
+    template <>
+    struct BufferShape<double>
+    {
+      using Scalar = double;
+      static const unsigned int columns = 1;
+      static const unsigned int rows = 1;
+    };
+    
+    template <typename T, unsigned int N>
+    struct BufferShape<Vec<T, N>>
+    {
+      using Scalar = T;
+      static const unsigned int columns = 1;
+      static const unsigned int rows = N;
+    };
+    
+    template <typename T, unsigned int R, unsigned int C>
+    struct BufferShape<Mat<T, R, C>>
+    {
+      using Scalar = T;
+      static const unsigned int columns = C;
+      static const unsigned int rows = R;
+    };
+    
+    constexpr std::size_t roundUp(std::size_t x, std::size_t multiple)
+    {
+      return (x + multiple - 1) / multiple * multiple;
+    }
+    
+    // Sizes and alignments in scalars, so that double uses the same rules at twice the bytes. A matrix is laid out
+    // as an array of its column vectors. The one rule in bytes is std140 rounding array and column strides up to
+    // 16, the size of a vec4: four floats but only two doubles.
+    template <typename Type, BufferLayout L>
+    struct BufferLayoutOf
+    {
+      using Shape = BufferShape<Type>;
+      using Scalar = typename Shape::Scalar;
+      static const unsigned int columns = Shape::columns;
+      static const unsigned int rows = Shape::rows;
+      static const unsigned int vec4Scalars = static_cast<unsigned int>(16 / sizeof(Scalar));
+      static const unsigned int vectorAlignment = rows == 3 ? 4 : rows;
+      static const unsigned int std140Alignment = vectorAlignment > vec4Scalars ? vectorAlignment : vec4Scalars;
+      static const unsigned int columnStride = columns == 1 ? rows : (L == BufferLayout::Std140 ? std140Alignment : vectorAlignment);
+      static const unsigned int alignment = columns == 1 ? vectorAlignment : columnStride;
+      static const unsigned int size = columns == 1 ? rows : columns * columnStride;
+      static const unsigned int arrayAlignment = L == BufferLayout::Std140 && alignment < vec4Scalars ? vec4Scalars : alignment;
+      static const unsigned int arrayStride = static_cast<unsigned int>(roundUp(size, arrayAlignment));
+    };
+    
+    // Copies the Rows scalars at src to dst and zeroes dst up to Span scalars.
+    template <typename T, unsigned int Rows, unsigned int Span>
+    struct PaddedColumn
+    {
+      static inline void store(const T* src, T* dst)
+      {
+        for (unsigned int r = 0; r < Span; r++)
+          dst[r] = r < Rows ? src[r] : T(0);
+      }
+    };
     
-    inline Mat3<T>& operator-=(const Mat3<T>& m)
+#if defined(NEON_SIMD_SSE2)
+    // One 16-byte store per column, padding included: write-combined mapped memory then only sees whole
+    // 16-byte writes.
+    template <unsigned int Rows>
+    struct PaddedColumn<float, Rows, 4>
     {
-      d[0][0] -= m.d[0][0]; d[1][0] -= m.d[1][0]; d[2][0] -= m.d[2][0];
-      d[0][1] -= m.d[0][1]; d[1][1] -= m.d[1][1]; d[2][1] -= m.d[2][1];
-      d[0][2] -= m.d[0][2]; d[1][2] -= m.d[1][2]; d[2][2] -= m.d[2][2];
-      return *this;
-    }
+      static inline void store(const float* src, float* dst)
+      {
+        _mm_storeu_ps(dst, _mm_setr_ps(src[0], Rows > 1 ? src[1] : 0.0f, Rows > 2 ? src[2] : 0.0f, Rows > 3 ? src[3] : 0.0f));
+      }
+    };
     
-    inline Mat3<T> operator*(const T t) const
+    template <>
+    struct PaddedColumn<float, 4, 4>
     {
-      return Mat3<T>(d[0][0] * t, d[1][0] * t, d[2][0] * t,
-                     d[0][1] * t, d[1][1] * t, d[2][1] * t,
-                     d[0][2] * t, d[1][2] * t, d[2][2] * t);
-    }
+      static inline void store(const float* src, float* dst)
+      {
+        _mm_storeu_ps(dst, _mm_loadu_ps(src));
+      }
+    };
+#endif
     
-    friend inline Mat3<T> operator*(const T t, const Mat3<T>& m)
+    // Writes v as Layout places it, followed by zeros up to Span scalars.
+    template <typename Layout, unsigned int Span, typename Type>
+    inline void bufferStore(const Type& v, typename Layout::Scalar* dst)
     {
-      return m * t;
+      using T = typename Layout::Scalar;
+      const T* src = reinterpret_cast<const T*>(&v);
+      for (unsigned int c = 0; c + 1 < Layout::columns; c++)
+        PaddedColumn<T, Layout::rows, Layout::columnStride>::store(src + c * Layout::rows, dst + c * Layout::columnStride);
+      const unsigned int last = Layout::columns - 1;
+      PaddedColumn<T, Layout::rows, Span - last * Layout::columnStride>::store(src + last * Layout::rows, dst + last * Layout::columnStride);
     }
     
-    inline Mat3<T>& operator*=(const T t)
+    template <typename Layout, typename Type>
+    inline Type bufferLoad(const typename Layout::Scalar* src)
     {
-      d[0][0] *= t; d[1][0] *= t; d[2][0] *= t;
-      d[0][1] *= t; d[1][1] *= t; d[2][1] *= t;
-      d[0][2] *= t; d[1][2] *= t; d[2][2] *= t;
-      return *this;
+      using T = typename Layout::Scalar;
+      Type result;
+      T* dst = reinterpret_cast<T*>(&result);
+      for (unsigned int c = 0; c < Layout::columns; c++)
+        for (unsigned int r = 0; r < Layout::rows; r++)
+          dst[c * Layout::rows + r] = src[c * Layout::columnStride + r];
+      return result;
     }
+  }
+  
+  // One block member of type Type at memory, typically inside a mapped uniform or storage buffer. memory must sit at
+  // a multiple of alignment() bytes from the start of the block. store() writes size() bytes and leaves the padding
+  // after the member, where the layout may place the next one, untouched.
+  template <typename Type, BufferLayout L>
+  struct BufferView
+  {
+    using Layout = Detail::BufferLayoutOf<Type, L>;
+    using Scalar = typename Layout::Scalar;
     
-    inline Vec3<T> operator*(const Vec3<T>& v) const
+    explicit BufferView(void* memory) : ptr(static_cast<Scalar*>(memory))
     {
-      return Vec3<T>(d[0][0] * v.x + d[1][0] * v.y + d[2][0] * v.z,
-                     d[0][1] * v.x + d[1][1] * v.y + d[2][1] * v.z,
-                     d[0][2] * v.x + d[1][2] * v.y + d[2][2] * v.z);
     }
     
-    friend inline Mat3<T> operator*(const Mat3<T>& lhs, const Mat3<T>& rhs)
+    static constexpr std::size_t size()
     {
-      const T v1x = lhs.d[0][0] * rhs.d[0][0] + lhs.d[1][0] * rhs.d[0][1] + lhs.d[2][0] * rhs.d[0][2];
-      const T v2x = lhs.d[0][0] * rhs.d[1][0] + lhs.d[1][0] * rhs.d[1][1] + lhs.d[2][0] * rhs.d[1][2];
-      const T v3x = lhs.d[0][0] * rhs.d[2][0] + lhs.d[1][0] * rhs.d[2][1] + lhs.d[2][0] * rhs.d[2][2];
-      const T v1y = lhs.d[0][1] * rhs.d[0][0] + lhs.d[1][1] * rhs.d[0][1] + lhs.d[2][1] * rhs.d[0][2];
-      const T v2y = lhs.d[0][1] * rhs.d[1][0] + lhs.d[1][1] * rhs.d[1][1] + lhs.d[2][1] * rhs.d[1][2];
-      const T v3y = lhs.d[0][1] * rhs.d[2][0] + lhs.d[1][1] * rhs.d[2][1] + lhs.d[2][1] * rhs.d[2][2];
-      const T v1z = lhs.d[0][2] * rhs.d[0][0] + lhs.d[1][2] * rhs.d[0][1] + lhs.d[2][2] * rhs.d[0][2];
-      const T v2z = lhs.d[0][2] * rhs.d[1][0] + lhs.d[1][2] * rhs.d[1][1] + lhs.d[2][2] * rhs.d[1][2];
-      const T v3z = lhs.d[0][2] * rhs.d[2][0] + lhs.d[1][2] * rhs.d[2][1] + lhs.d[2][2] * rhs.d[2][2];
-      return Mat3<T>{v1x, v2x, v3x,
-                     v1y, v2y, v3y,
-                     v1z, v2z, v3z};
+      return Layout::size * sizeof(Scalar);
     }
     
-    inline Mat3<T> operator/(const T t) const
+    static constexpr std::size_t alignment()
     {
-      const T d = 1 / t;
-      return *this * d;
+      return Layout::alignment * sizeof(Scalar);
     }
     
-    friend inline Mat3<T> operator/(const T t, const Mat3<T>& m)
+    inline void store(const Type& v)
     {
-      return m * t;
+      Detail::bufferStore<Layout, Layout::size>(v, ptr);
     }
     
-    inline Mat3<T>& operator/=(const T t)
+    inline Type load() const
     {
-      const T d = 1 / t;
-      return *this *= d;
+      return Detail::bufferLoad<Layout, Type>(ptr);
     }
     
-    inline T* data()
+    inline void* data() const
     {
-      return d[0];
+      return ptr;
     }
+    
+  private:
+    Scalar* ptr;
   };
   
-  /* Mat4 */
-  template <typename T>
-  struct Mat4
+  // Array of count elements of type Type at memory, with the element stride of the layout. Every element owns its
+  // whole stride, so stores also zero the padding and each element is written with full-width stores.
+  template <typename Type, BufferLayout L>
+  struct BufferArray
   {
-    static const unsigned short size = 4;
-    T d[4][4];
+    using Layout = Detail::BufferLayoutOf<Type, L>;
+    using Scalar = typename Layout::Scalar;
     
-    explicit Mat4(T t = 1)
+    BufferArray(void* memory, std::size_t count) : ptr(static_cast<Scalar*>(memory)), elements(count)
     {
-      d[0][0] = t; d[0][1] = 0; d[0][2] = 0; d[0][3] = 0;
-      d[1][0] = 0; d[1][1] = t; d[1][2] = 0; d[1][3] = 0;
-      d[2][0] = 0; d[2][1] = 0; d[2][2] = t; d[2][3] = 0;
-      d[3][0] = 0; d[3][1] = 0; d[3][2] = 0; d[3][3] = t;
     }
     
-    Mat4(const Vec4<T>& col1, const Vec4<T>& col2, const Vec4<T>& col3, const Vec4<T>& col4)
+    static constexpr std::size_t stride()
     {
-      d[0][0] = col1.x; d[0][1] = col1.y; d[0][2] = col1.z; d[0][3] = col1.w;
-      d[1][0] = col2.x; d[1][1] = col2.y; d[1][2] = col2.z; d[1][3] = col2.w;
-      d[2][0] = col3.x; d[2][1] = col3.y; d[2][2] = col3.z; d[2][3] = col3.w;
-      d[3][0] = col4.x; d[3][1] = col4.y; d[3][2] = col4.z; d[3][3] = col4.w;
+      return Layout::arrayStride * sizeof(Scalar);
     }
     
-    Mat4(T col1x, T col2x, T col3x, T col4x,
-         T col1y, T col2y, T col3y, T col4y,
-         T col1z, T col2z, T col3z, T col4z,
-         T col1w, T col2w, T col3w, T col4w)
+    static constexpr std::size_t alignment()
     {
-      d[0][0] = col1x; d[0][1] = col1y; d[0][2] = col1z; d[0][3] = col1w;
-      d[1][0] = col2x; d[1][1] = col2y; d[1][2] = col2z; d[1][3] = col2w;
-      d[2][0] = col3x; d[2][1] = col3y; d[2][2] = col3z; d[2][3] = col3w;
-      d[3][0] = col4x; d[3][1] = col4y; d[3][2] = col4z; d[3][3] = col4w;
+      return Layout::arrayAlignment * sizeof(Scalar);
     }
     
-    Mat4(const Mat4<T>& other)
+    inline std::size_t size() const
     {
-      d[0][0] = other.d[0][0]; d[1][0] = other.d[1][0]; d[2][0] = other.d[2][0]; d[3][0] = other.d[3][0];
-      d[0][1] = other.d[0][1]; d[1][1] = other.d[1][1]; d[2][1] = other.d[2][1]; d[3][1] = other.d[3][1];
-      d[0][2] = other.d[0][2]; d[1][2] = other.d[1][2]; d[2][2] = other.d[2][2]; d[3][2] = other.d[3][2];
-      d[0][3] = other.d[0][3]; d[1][3] = other.d[1][3]; d[2][3] = other.d[2][3]; d[3][3] = other.d[3][3];
+      return elements;
     }
     
-    Mat4(const Mat2<T>& other)
+    inline std::size_t sizeBytes() const
     {
-      d[0][0] = other.d[0][0]; d[1][0] = other.d[1][0]; d[2][0] = 0; d[3][0] = 0;
-      d[0][1] = other.d[0][1]; d[1][1] = other.d[1][1]; d[2][1] = 0; d[3][1] = 0;
-      d[0][2] = 0;             d[1][2] = 0;             d[2][2] = 0; d[3][2] = 0;
-      d[0][3] = 0;             d[1][3] = 0;             d[2][3] = 0; d[3][3] = 0;
+      return elements * stride();
     }
     
-    Mat4(const Mat3<T>& other)
+    inline void store(std::size_t i, const Type& v)
     {
-      d[0][0] = other.d[0][0]; d[1][0] = other.d[1][0]; d[2][0] = other.d[2][0]; d[3][0] = 0;
-      d[0][1] = other.d[0][1]; d[1][1] = other.d[1][1]; d[2][1] = other.d[2][1]; d[3][1] = 0;
-      d[0][2] = other.d[2][2]; d[1][2] = other.d[1][2]; d[2][2] = other.d[2][2]; d[3][2] = 0;
-      d[0][3] = 0;             d[1][3] = 0;             d[2][3] = 0;             d[3][3] = 0;
+      Detail::bufferStore<Layout, Layout::arrayStride>(v, ptr + i * Layout::arrayStride);
     }
     
-    Mat4<T>& operator=(const Mat4<T>& other)
+    inline Type load(std::size_t i) const
     {
-      if (this != &other)
-      {
-        d[0][0] = other.d[0][0]; d[1][0] = other.d[1][0]; d[2][0] = other.d[2][0]; d[3][0] = other.d[3][0];
-        d[0][1] = other.d[0][1]; d[1][1] = other.d[1][1]; d[2][1] = other.d[2][1]; d[3][1] = other.d[3][1];
-        d[0][2] = other.d[0][2]; d[1][2] = other.d[1][2]; d[2][2] = other.d[2][2]; d[3][2] = other.d[3][2];
-        d[0][3] = other.d[0][3]; d[1][3] = other.d[1][3]; d[2][3] = other.d[2][3]; d[3][3] = other.d[3][3];
-      }
-      return *this;
+      return Detail::bufferLoad<Layout, Type>(ptr + i * Layout::arrayStride);
     }
     
-    inline Vec4<T>& operator[](unsigned int col)
+    // Packs n elements from src into [first, first + n).
+    void store(const Type* src, std::size_t n, std::size_t first = 0)
     {
-      return *reinterpret_cast<Vec4<T>*>(d[col]);
+      Scalar* dst = ptr + first * Layout::arrayStride;
+      for (std::size_t i = 0; i < n; i++, dst += Layout::arrayStride)
+        Detail::bufferStore<Layout, Layout::arrayStride>(src[i], dst);
     }
     
-    inline const Vec4<T>& operator[](unsigned int col) const
+    // Unpacks n elements from [first, first + n) into dst.
+    void load(Type* dst, std::size_t n, std::size_t first = 0) const
     {
-      return *reinterpret_cast<const Vec4<T>*>(d[col]);
+      const Scalar* src = ptr + first * Layout::arrayStride;
+      for (std::size_t i = 0; i < n; i++, src += Layout::arrayStride)
+        dst[i] = Detail::bufferLoad<Layout, Type>(src);
     }
     
-    inline T& operator()(unsigned int row, unsigned int col)
+    inline void* data() const
     {
-      return d[col][row];
+      return ptr;
     }
     
-    inline const T& operator()(unsigned int row, unsigned int col) const
+  private:
+    Scalar* ptr;
+    std::size_t elements;
+  };
+  
+  // Type stored with the padding of one array element of the layout, so that sizeof(Padded) is the array stride and
+  // an array or std::vector of Padded matches the buffer byte for byte: uploading it is a single memcpy, and a
+  // BufferArray can point straight at it.
+  template <typename Type, BufferLayout L>
+  struct Padded
+  {
+    using Layout = Detail::BufferLayoutOf<Type, L>;
+    using Scalar = typename Layout::Scalar;
+    
+    alignas(Layout::arrayAlignment * sizeof(Scalar)) Scalar d[Layout::arrayStride];
+    
+    Padded() : d()
     {
-      return d[col][row];
     }
     
-    friend inline Mat4<T> operator+(const Mat4<T>& lhs, const Mat4<T>& rhs)
+    Padded(const Type& v)
     {
-      return Mat4<T>{lhs[0] + rhs[0], lhs[1] + rhs[1], lhs[2] + rhs[2], lhs[3] + rhs[3]};
+      Detail::bufferStore<Layout, Layout::arrayStride>(v, d);
     }
     
-    inline Mat4<T>& operator+=(const Mat4<T>& m)
+    inline Padded& operator=(const Type& v)
     {
-      d[0][0] += m.d[0][0]; d[1][0] += m.d[1][0]; d[2][0] += m.d[2][0]; d[3][0] += m.d[3][0];
-      d[0][1] += m.d[0][1]; d[1][1] += m.d[1][1]; d[2][1] += m.d[2][1]; d[3][1] += m.d[3][1];
-      d[0][2] += m.d[0][2]; d[1][2] += m.d[1][2]; d[2][2] += m.d[2][2]; d[3][2] += m.d[3][2];
-      d[0][3] += m.d[0][3]; d[1][3] += m.d[1][3]; d[2][3] += m.d[2][3]; d[3][3] += m.d[3][3];
+      Detail::bufferStore<Layout, Layout::arrayStride>(v, d);
       return *this;
     }
     
-    inline Mat4<T> operator-() const
+    inline operator Type() const
     {
-      return Mat4<T>{-d[0][0], -d[1][0], -d[2][0], -d[3][0],
-                     -d[0][1], -d[1][1], -d[2][1], -d[3][1],
-                     -d[0][2], -d[1][2], -d[2][2], -d[3][2],
-                     -d[0][3], -d[1][3], -d[2][3], -d[3][3]};
+      return Detail::bufferLoad<Layout, Type>(d);
     }
-    
-    friend inline Mat4<T> operator-(const Mat4<T>& lhs, const Mat4<T>& rhs)
+  };
+  
+  template <typename Type> using Std140View = BufferView<Type, BufferLayout::Std140>;
+  template <typename Type> using Std430View = BufferView<Type, BufferLayout::Std430>;
+  template <typename Type> using Std140Array = BufferArray<Type, BufferLayout::Std140>;
+  template <typename Type> using Std430Array = BufferArray<Type, BufferLayout::Std430>;
+  template <typename Type> using Std140Padded = Padded<Type, BufferLayout::Std140>;
+  template <typename Type> using Std430Padded = Padded<Type, BufferLayout::Std430>;
+  
+#if defined(NEON_PARALLEL)
+  /* Parallel execution */
+  
+  // Runs independent tasks, possibly concurrently: run() calls task(i) once for every i in [0, count) and returns
+  // when all calls have finished. If a task throws, run() rethrows its exception once no task is running; tasks
+  // that have not started by then may be skipped. Implement this to route the parallel batch overloads below into
+  // another scheduler.
+  struct Executor
+  {
+    virtual ~Executor()
     {
-      return Mat4<T>{lhs[0] - rhs[0], lhs[1] - rhs[1], lhs[2] - rhs[2], lhs[3] - rhs[3]};
     }
     
-    inline Mat4<T>& operator-=(const Mat4<T>& m)
+    virtual void run(std::size_t count, const std::function<void(std::size_t)>& task) = 0;
+  };
+  
+  // Runs every task on the calling thread, in order.
+  struct SerialExecutor : Executor
+  {
+    void run(std::size_t count, const std::function<void(std::size_t)>& task) override
     {
-      d[0][0] -= m.d[0][0]; d[1][0] -= m.d[1][0]; d[2][0] -= m.d[2][0]; d[3][0] -= m.d[3][0];
-      d[0][1] -= m.d[0][1]; d[1][1] -= m.d[1][1]; d[2][1] -= m.d[2][1]; d[3][1] -= m.d[3][1];
-      d[0][2] -= m.d[0][2]; d[1][2] -= m.d[1][2]; d[2][2] -= m.d[2][2]; d[3][2] -= m.d[3][2];
-      d[0][3] -= m.d[0][3]; d[1][3] -= m.d[1][3]; d[2][3] -= m.d[2][3]; d[3][3] -= m.d[3][3];
-      return *this;
+      for (std::size_t i = 0; i < count; i++)
+        task(i);
     }
-    
-    inline Mat4<T> operator*(const T t) const
+  };
+  
+  namespace Detail
+  {
+    // The ThreadPool whose tasks the calling thread is running, if any.
+    inline const void*& currentPool()
     {
-      return Mat4<T>{d[0][0] * t, d[1][0] * t, d[2][0] * t, d[3][0] * t,
-                     d[0][1] * t, d[1][1] * t, d[2][1] * t, d[3][1] * t,
-                     d[0][2] * t, d[1][2] * t, d[2][2] * t, d[3][2] * t,
-                     d[0][3] * t, d[1][3] * t, d[2][3] * t, d[3][3] * t};
+      static thread_local const void* pool = nullptr;
+      return pool;
+    }
+  }
+  
+  // Fixed set of worker threads plus the thread calling run(), which works alongside them. run() deals [0, count)
+  // into one contiguous range per participant; each takes tasks from the front of its own range and, once that is
+  // empty, steals from the back of the others, so uneven tasks even out without a shared queue. A task that calls
+  // run() on any ThreadPool, this one or another, runs the nested tasks inline: waiting on a second pool whose
+  // tasks in turn wait on the first could otherwise deadlock. Concurrent run() calls from different threads are
+  // serialized.
+  struct ThreadPool : Executor
+  {
+    // threads counts the calling thread; 0 uses std::thread::hardware_concurrency().
+    explicit ThreadPool(unsigned int threads = 0)
+    {
+      if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+      rangeCount = threads;
+      ranges.reset(new Range[threads]);
+      workers.reserve(threads - 1);
+      for (unsigned int t = 1; t < threads; t++)
+        workers.emplace_back([this, t]() { work(t); });
     }
     
-    friend inline Mat4<T> operator*(const T t, const Mat4<T>& m)
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    ~ThreadPool()
     {
-      return m * t;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      wake.notify_all();
+      for (std::thread& worker : workers)
+        worker.join();
     }
     
-    inline Mat4<T>& operator*=(const T t)
+    inline unsigned int size() const
     {
-      d[0][0] *= t; d[1][0] *= t; d[2][0] *= t; d[3][0] *= t;
-      d[0][1] *= t; d[1][1] *= t; d[2][1] *= t; d[3][1] *= t;
-      d[0][2] *= t; d[1][2] *= t; d[2][2] *= t; d[3][2] *= t;
-      d[0][3] *= t; d[1][3] *= t; d[2][3] *= t; d[3][3] *= t;
-      return *this;
+      return rangeCount;
     }
     
-    inline Vec4<T> operator*(const Vec4<T>& v) const
+    void run(std::size_t count, const std::function<void(std::size_t)>& task) override
     {
-      return Vec4<T>{d[0][0] * v.x + d[1][0] * v.y + d[2][0] * v.z + d[3][0] * v.w,
-                     d[0][1] * v.x + d[1][1] * v.y + d[2][1] * v.z + d[3][1] * v.w,
-                     d[0][2] * v.x + d[1][2] * v.y + d[2][2] * v.z + d[3][2] * v.w,
-                     d[0][3] * v.x + d[1][3] * v.y + d[2][3] * v.z + d[3][3] * v.w};
+      if (count == 0)
+        return;
+      if (Detail::currentPool() || rangeCount == 1)
+      {
+        for (std::size_t i = 0; i < count; i++)
+          task(i);
+        return;
+      }
+      
+      std::lock_guard<std::mutex> runLock(runMutex);
+      for (unsigned int r = 0; r < rangeCount; r++)
+      {
+        std::lock_guard<std::mutex> lock(ranges[r].mutex);
+        ranges[r].begin = count * r / rangeCount;
+        ranges[r].end = count * (r + 1) / rangeCount;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = &task;
+        error = nullptr;
+        cancelled = false;
+        busy = rangeCount - 1;
+        generation++;
+      }
+      wake.notify_all();
+      
+      Detail::currentPool() = this;
+      participate(0);
+      Detail::currentPool() = nullptr;
+      
+      std::exception_ptr thrown;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return busy == 0; });
+        current = nullptr;
+        std::swap(thrown, error);
+      }
+      if (thrown)
+        std::rethrow_exception(thrown);
     }
     
-    friend inline Mat4<T> operator*(const Mat4<T>& lhs, const Mat4<T>& rhs)
+  private:
+    struct Range
     {
-      const T v1x = lhs.d[0][0] * rhs.d[0][0] + lhs.d[1][0] * rhs.d[0][1] + lhs.d[2][0] * rhs.d[0][2] + lhs.d[3][0] * rhs.d[0][3];
-      const T v2x = lhs.d[0][0] * rhs.d[1][0] + lhs.d[1][0] * rhs.d[1][1] + lhs.d[2][0] * rhs.d[1][2] + lhs.d[3][0] * rhs.d[1][3];
-      const T v3x = lhs.d[0][0] * rhs.d[2][0] + lhs.d[1][0] * rhs.d[2][1] + lhs.d[2][0] * rhs.d[2][2] + lhs.d[3][0] * rhs.d[2][3];
-      const T v4x = lhs.d[0][0] * rhs.d[3][0] + lhs.d[1][0] * rhs.d[3][1] + lhs.d[2][0] * rhs.d[3][2] + lhs.d[3][0] * rhs.d[3][3];
-      const T v1y = lhs.d[0][1] * rhs.d[0][0] + lhs.d[1][1] * rhs.d[0][1] + lhs.d[2][1] * rhs.d[0][2] + lhs.d[3][1] * rhs.d[0][3];
-      const T v2y = lhs.d[0][1] * rhs.d[1][0] + lhs.d[1][1] * rhs.d[1][1] + lhs.d[2][1] * rhs.d[1][2] + lhs.d[3][1] * rhs.d[1][3];
-      const T v3y = lhs.d[0][1] * rhs.d[2][0] + lhs.d[1][1] * rhs.d[2][1] + lhs.d[2][1] * rhs.d[2][2] + lhs.d[3][1] * rhs.d[2][3];
-      const T v4y = lhs.d[0][1] * rhs.d[3][0] + lhs.d[1][1] * rhs.d[3][1] + lhs.d[2][1] * rhs.d[3][2] + lhs.d[3][1] * rhs.d[3][3];
-      const T v1z = lhs.d[0][2] * rhs.d[0][0] + lhs.d[1][2] * rhs.d[0][1] + lhs.d[2][2] * rhs.d[0][2] + lhs.d[3][2] * rhs.d[0][3];
-      const T v2z = lhs.d[0][2] * rhs.d[1][0] + lhs.d[1][2] * rhs.d[1][1] + lhs.d[2][2] * rhs.d[1][2] + lhs.d[3][2] * rhs.d[1][3];
-      const T v3z = lhs.d[0][2] * rhs.d[2][0] + lhs.d[1][2] * rhs.d[2][1] + lhs.d[2][2] * rhs.d[2][2] + lhs.d[3][2] * rhs.d[2][3];
-      const T v4z = lhs.d[0][2] * rhs.d[3][0] + lhs.d[1][2] * rhs.d[3][1] + lhs.d[2][2] * rhs.d[3][2] + lhs.d[3][2] * rhs.d[3][3];
-      const T v1w = lhs.d[0][3] * rhs.d[0][0] + lhs.d[1][3] * rhs.d[0][1] + lhs.d[2][3] * rhs.d[0][2] + lhs.d[3][3] * rhs.d[0][3];
-      const T v2w = lhs.d[0][3] * rhs.d[1][0] + lhs.d[1][3] * rhs.d[1][1] + lhs.d[2][3] * rhs.d[1][2] + lhs.d[3][3] * rhs.d[1][3];
-      const T v3w = lhs.d[0][3] * rhs.d[2][0] + lhs.d[1][3] * rhs.d[2][1] + lhs.d[2][3] * rhs.d[2][2] + lhs.d[3][3] * rhs.d[2][3];
-      const T v4w = lhs.d[0][3] * rhs.d[3][0] + lhs.d[1][3] * rhs.d[3][1] + lhs.d[2][3] * rhs.d[3][2] + lhs.d[3][3] * rhs.d[3][3];
-      return Mat4<T>{v1x, v2x, v3x, v4x,
-                     v1y, v2y, v3y, v4y,
-                     v1z, v2z, v3z, v4z,
-                     v1w, v2w, v3w, v4w};
-    }
-    
-    inline Mat4<T> operator/(const T t) const
+      std::mutex mutex;
+      std::size_t begin = 0;
+      std::size_t end = 0;
+    };
+    
+    void work(unsigned int self)
     {
-      const T d = 1 / t;
-      return *this * d;
+      Detail::currentPool() = this;
+      std::size_t seen = 0;
+      for (;;)
+      {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          wake.wait(lock, [this, seen]() { return stopping || generation != seen; });
+          if (stopping)
+            return;
+          seen = generation;
+        }
+        participate(self);
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (--busy == 0)
+            done.notify_one();
+        }
+      }
     }
     
-    friend inline Mat4<T> operator/(const T t, const Mat4<T>& m)
+    void participate(unsigned int self)
     {
-      return m * t;
+      std::size_t i;
+      while (!cancelled.load(std::memory_order_relaxed) && next(self, i))
+      {
+        try
+        {
+          (*current)(i);
+        }
+        catch (...)
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (!error)
+            error = std::current_exception();
+          cancelled = true;
+        }
+      }
     }
     
-    inline Mat4<T>& operator/=(const T t)
+    bool next(unsigned int self, std::size_t& i)
     {
-      const T d = 1 / t;
-      return *this *= d;
+      {
+        Range& own = ranges[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.begin < own.end)
+        {
+          i = own.begin++;
+          return true;
+        }
+      }
+      for (unsigned int k = 1; k < rangeCount; k++)
+      {
+        Range& victim = ranges[(self + k) % rangeCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.begin < victim.end)
+        {
+          i = --victim.end;
+          return true;
+        }
+      }
+      return false;
+    }
+    
+    unsigned int rangeCount;
+    std::unique_ptr<Range[]> ranges;
+    std::vector<std::thread> workers;
+    std::mutex runMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(std::size_t)>* current = nullptr;
+    std::exception_ptr error;
+    std::atomic<bool> cancelled{false};
+    std::size_t generation = 0;
+    unsigned int busy = 0;
+    bool stopping = false;
+  };
+  
+  namespace Detail
+  {
+    // Parallel batch operations hand the executor chunks of about kParallelChunkBytes of input, sized to stay in
+    // the L1 cache. Chunks are a multiple of kParallelChunkAlign elements, so every chunk but the last covers whole
+    // packs and the results match the serial overloads bit for bit.
+    const std::size_t kParallelChunkBytes = 16 * 1024;
+    const std::size_t kParallelChunkAlign = 64;
+    
+    // Calls f(begin, end) over [0, count) in chunks of Element, through the executor when there is more than one.
+    template <typename Element, typename F>
+    inline void forEachChunk(Executor& executor, std::size_t count, const F& f)
+    {
+      const std::size_t chunk = std::max(kParallelChunkAlign, kParallelChunkBytes / sizeof(Element) / kParallelChunkAlign * kParallelChunkAlign);
+      const std::size_t chunks = (count + chunk - 1) / chunk;
+      if (chunks <= 1)
+      {
+        f(std::size_t(0), count);
+        return;
+      }
+      executor.run(chunks, [&f, chunk, count](std::size_t c)
+      {
+        const std::size_t begin = c * chunk;
+        f(begin, std::min(count, begin + chunk));
+      });
+    }
+    
+    template <typename T, typename Kernel>
+    inline void forEachPack(Executor& executor, std::size_t count, const Kernel& k)
+    {
+      forEachChunk<T>(executor, count, [&k](std::size_t begin, std::size_t end) { forEachPack<T>(begin, end, k); });
     }
     
-    inline T* data()
+    template <TransformKind K, typename T>
+    inline void transformArray(Executor& executor, const Mat4<T>& m, const Vec3<T>* src, Vec3<T>* dst, std::size_t count)
     {
-      return d[0];
+      forEachChunk<Vec3<T>>(executor, count, [&m, src, dst](std::size_t begin, std::size_t end)
+      {
+        transformArray<K>(m, src + begin, dst + begin, end - begin);
+      });
     }
-  };
+  }
   
-  /* Common matrix operations */
+  // Parallel overloads of the batch operations. Each splits its input into chunks (see
+  // Detail::kParallelChunkBytes), runs them on executor and returns when all are done. Every chunk writes its own
+  // slice of the output and the results are identical to the serial overloads, whatever the executor.
   
   template <typename T>
-  inline T determinant(const Mat2<T>& m)
+  inline void transformPoints(Executor& executor, const Mat4<T>& m, const Vec3<T>* src, Vec3<T>* dst, std::size_t count)
   {
-    return m.d[0][0] * m.d[1][1] - m.d[1][0] * m.d[0][1];
+    Detail::transformArray<Detail::TransformKind::Point>(executor, m, src, dst, count);
   }
   
   template <typename T>
-  inline Mat2<T> inverse(const Mat2<T>& m)
+  inline void transformVectors(Executor& executor, const Mat4<T>& m, const Vec3<T>* src, Vec3<T>* dst, std::size_t count)
   {
-    const T di = 1 / determinant(m);
-    return Mat2<T>{di * m.d[1][1], -di * m.d[1][0], -di * m.d[0][1], di * m.d[0][0]};
+    Detail::transformArray<Detail::TransformKind::Vector>(executor, m, src, dst, count);
   }
   
   template <typename T>
-  inline T determinant(const Mat3<T>& m)
+  inline void transformPointsProjective(Executor& executor, const Mat4<T>& m, const Vec3<T>* src, Vec3<T>* dst, std::size_t count)
   {
-    const T x = m.d[0][0] * (m.d[1][1] * m.d[2][2] - m.d[2][1] * m.d[1][2]);
-    const T y = m.d[1][0] * (m.d[0][1] * m.d[2][2] - m.d[2][1] * m.d[0][2]);
-    const T z = m.d[2][0] * (m.d[0][1] * m.d[1][2] - m.d[1][1] * m.d[0][2]);
-    return x - y + z;
+    Detail::transformArray<Detail::TransformKind::PointProjective>(executor, m, src, dst, count);
   }
   
   template <typename T>
-  inline Mat3<T> inverse(const Mat3<T>& m)
+  inline void transform(Executor& executor, const Mat4<T>& m, const Vec4<T>* src, Vec4<T>* dst, std::size_t count)
   {
-    // https://en.wikipedia.org/wiki/Invertible_matrix#Inversion_of_3_%C3%97_3_matrices
-    const Vec3<T>& v0 = m[0];
-    const Vec3<T>& v1 = m[1];
-    const Vec3<T>& v2 = m[2];
-    Vec3<T> a = cross(v1, v2);
-    Vec3<T> b = cross(v2, v0);
-    Vec3<T> c = cross(v0, v1);
-    const T detInv = 1 / dot(v0, a);
-    a = a * detInv;
-    b = b * detInv;
-    c = c * detInv;
-    return transpose(Mat3<T>(a, b, c));
+    Detail::forEachChunk<Vec4<T>>(executor, count, [&m, src, dst](std::size_t begin, std::size_t end)
+    {
+      transform(m, src + begin, dst + begin, end - begin);
+    });
   }
   
   template <typename T>
-  inline T determinant(const Mat4<T>& m)
+  inline void transformPoints(Executor& executor, const Mat4<T>& m, const Vec3A<T>* src, Vec3A<T>* dst, std::size_t count)
   {
-    const Vec3<T> v1 = reinterpret_cast<const Vec3<T>&>(m[0]);
-    const Vec3<T> v2 = reinterpret_cast<const Vec3<T>&>(m[1]);
-    const Vec3<T> v3 = reinterpret_cast<const Vec3<T>&>(m[2]);
-    const Vec3<T> v4 = reinterpret_cast<const Vec3<T>&>(m[3]);
-    const T x = m.d[0][3];
-    const T y = m.d[1][3];
-    const T z = m.d[2][3];
-    const T w = m.d[3][3];
-    const Vec3<T> s = cross(v1, v2);
-    const Vec3<T> t = cross(v3, v4);
-    const Vec3<T> u = v1 * y - v2 * x;
-    const Vec3<T> v = v3 * w - v4 * z;
-    return dot(s, v) + dot(t, u);
+    Detail::forEachChunk<Vec3A<T>>(executor, count, [&m, src, dst](std::size_t begin, std::size_t end)
+    {
+      transformPoints(m, src + begin, dst + begin, end - begin);
+    });
   }
   
   template <typename T>
-  inline Mat4<T> inverse(const Mat4<T>& m)
+  inline void transformVectors(Executor& executor, const Mat4<T>& m, const Vec3A<T>* src, Vec3A<T>* dst, std::size_t count)
   {
-    const Vec3<T> a = reinterpret_cast<const Vec3<T>&>(m[0]);
-    const Vec3<T> b = reinterpret_cast<const Vec3<T>&>(m[1]);
-    const Vec3<T> c = reinterpret_cast<const Vec3<T>&>(m[2]);
-    const Vec3<T> d = reinterpret_cast<const Vec3<T>&>(m[3]);
-    const T x = m.d[0][3];
-    const T y = m.d[1][3];
-    const T z = m.d[2][3];
-    const T w = m.d[3][3];
-    Vec3<T> s = cross(a, b);
-    Vec3<T> t = cross(c, d);
-    Vec3<T> u = a * y - b * x;
-    Vec3<T> v = c * w - d * z;
-    const T detInv = 1 / (dot(s, v) + dot(t, u));
-    s *= detInv;
-    t *= detInv;
-    u *= detInv;
-    v *= detInv;
-    const Vec3<T> r0 = cross(b, v) + t * y;
-    const Vec3<T> r1 = cross(v, a) - t * x;
-    const Vec3<T> r2 = cross(d, u) + s * w;
-    const Vec3<T> r3 = cross(u, c) - s * z;
-    return Mat4<T>{r0.x, r0.y, r0.z, -dot(b, t),
-                   r1.x, r1.y, r1.z, dot(a, t),
-                   r2.x, r2.y, r2.z, -dot(d, s),
-                   r3.x, r3.y, r3.z, dot(c, s)};
-  }
-  
-  template <typename M>
-  inline M& transpose(M& m)
-  {
-    for (unsigned int i = 0; i < M::size; i++)
-      for (unsigned int j = i + 1; j < M::size; j++)
-        std::swap(m.d[j][i], m.d[i][j]);
-    return m;
-  }
-  
-  template <typename M>
-  inline M transpose(const M& m)
-  {
-    M mt(m);
-    transpose(mt);
-    return mt;
+    Detail::forEachChunk<Vec3A<T>>(executor, count, [&m, src, dst](std::size_t begin, std::size_t end)
+    {
+      transformVectors(m, src + begin, dst + begin, end - begin);
+    });
   }
   
-  /* Common transformations */
-  
   template <typename T>
-  inline Mat2<T> makeRotation2D(const T angle)
+  inline void transform(Executor& executor, const Mat4<T>& m, const Vec4A<T>* src, Vec4A<T>* dst, std::size_t count)
   {
-    const T s = std::sin(angle);
-    const T c = std::cos(angle);
-    return Mat2<T>{c, -s, s, c};
+    Detail::forEachChunk<Vec4A<T>>(executor, count, [&m, src, dst](std::size_t begin, std::size_t end)
+    {
+      transform(m, src + begin, dst + begin, end - begin);
+    });
   }
   
-  // This is yaw(y-axis) * pitch(x-axis) * roll(z-axis).
   template <typename T>
-  inline Mat3<T> makeRotation3D(T yaw, T pitch, T roll)
+  inline void transformPoints(Executor& executor, const Mat4<T>& m, const Vec3Stream<T>& src, Vec3Stream<T>& dst)
   {
-    const T sy = std::sin(yaw);
-    const T cy = std::cos(yaw);
-    const T sp = std::sin(pitch);
-    const T cp = std::cos(pitch);
-    const T sr = std::sin(roll);
-    const T cr = std::cos(roll);
-    const T v1x = cy * cr + sy * sp * sr;
-    const T v1y = cp * sr;
-    const T v1z = -sy * cr + cy * sp * sr;
-    const T v2x = -cy * sr + sy * sp * cr;
-    const T v2y = cp * cr;
-    const T v2z = sy * sr + cy * sp * cr;
-    const T v3x = sy * cp;
-    const T v3y = -sp;
-    const T v3z = cy * cp;
-    return Mat3<T>{v1x, v2x, v3x,
-                   v1y, v2y, v3y,
-                   v1z, v2z, v3z};
+    dst.resize(src.size());
+    Detail::forEachPack<T>(executor, src.size(), Detail::TransformStreamKernel<Detail::TransformKind::Point, T>{m, src, dst});
   }
   
   template <typename T>
-  inline Mat3<T> makeRotation3DX(T angle)
+  inline void transformVectors(Executor& executor, const Mat4<T>& m, const Vec3Stream<T>& src, Vec3Stream<T>& dst)
   {
-    const T s = std::sin(angle);
-    const T c = std::cos(angle);
-    return Mat3<T>{1, 0, 0,
-                   0, c, -s,
-                   0, s, c};
+    dst.resize(src.size());
+    Detail::forEachPack<T>(executor, src.size(), Detail::TransformStreamKernel<Detail::TransformKind::Vector, T>{m, src, dst});
   }
   
   template <typename T>
-  inline Mat3<T> makeRotation3DY(T angle)
+  inline void transformPointsProjective(Executor& executor, const Mat4<T>& m, const Vec3Stream<T>& src, Vec3Stream<T>& dst)
   {
-    const T s = std::sin(angle);
-    const T c = std::cos(angle);
-    return Mat3<T>{c,  0, s,
-                   0,  1, 0,
-                   -s, 0, c};
+    dst.resize(src.size());
+    Detail::forEachPack<T>(executor, src.size(), Detail::TransformStreamKernel<Detail::TransformKind::PointProjective, T>{m, src, dst});
   }
   
   template <typename T>
-  inline Mat3<T> makeRotation3DZ(T angle)
+  inline void transform(Executor& executor, const Mat4<T>& m, const Vec4Stream<T>& src, Vec4Stream<T>& dst)
   {
-    const T s = std::sin(angle);
-    const T c = std::cos(angle);
-    return Mat3<T>{c, -s, 0,
-                   s, c,  0,
-                   0, 0,  1};
+    dst.resize(src.size());
+    Detail::forEachPack<T>(executor, src.size(), Detail::TransformStream4Kernel<T>{m, src, dst});
   }
   
-  // Axis is assumed to be normalized.
   template <typename T>
-  inline Mat3<T> makeRotation3D(const Vec3<T>& axis, T angle)
+  inline void normalize(Executor& executor, const Vec3Stream<T>& a, Vec3Stream<T>& out)
   {
-    // https://en.wikipedia.org/wiki/Rotation_matrix#Rotation_matrix_from_axis_and_angle
-    const T s = std::sin(angle);
-    const T c = std::cos(angle);
-    const T oneMinCos = 1 - c;
-    const T xx = axis.x * axis.x;
-    const T yy = axis.y * axis.y;
-    const T zz = axis.z * axis.z;
-    const T xy1c = axis.x * axis.y * oneMinCos;
-    const T xz1c = axis.x * axis.z * oneMinCos;
-    const T yz1c = axis.y * axis.z * oneMinCos;
-    const T xs = axis.x * s;
-    const T ys = axis.y * s;
-    const T zs = axis.z * s;
-    const T v1x = c + xx * oneMinCos;
-    const T v2x = xy1c - zs;
-    const T v3x = xz1c + ys;
-    const T v1y = xy1c + zs;
-    const T v2y = c + yy * oneMinCos;
-    const T v3y = yz1c - xs;
-    const T v1z = xz1c - ys;
-    const T v2z = yz1c + xs;
-    const T v3z = c + zz * oneMinCos;
-    return Mat3<T>{v1x, v2x, v3x,
-                   v1y, v2y, v3y,
-                   v1z, v2z, v3z};
+    out.resize(a.size());
+    Detail::forEachPack<T>(executor, a.size(), Detail::NormalizeKernel<Vec3Stream<T>>{a, out});
   }
   
   template <typename T>
-  inline Mat4<T> makeRotation4D(T yaw, T pitch, T roll)
+  inline void normalize(Executor& executor, const Vec4Stream<T>& a, Vec4Stream<T>& out)
   {
-    Mat4<T> result{makeRotation3D(yaw, pitch, roll)};
-    result.d[3][3] = 1;
-    return result;
+    out.resize(a.size());
+    Detail::forEachPack<T>(executor, a.size(), Detail::NormalizeKernel<Vec4Stream<T>>{a, out});
   }
   
   template <typename T>
-  inline Mat4<T> makeRotation4DX(T angle)
+  inline void inverseBatch(Executor& executor, const Mat4<T>* src, Mat4<T>* dst, std::size_t count, bool* singular = nullptr)
   {
-    Mat4<T> result{makeRotation3DX(angle)};
-    result.d[3][3] = 1;
-    return result;
+    Detail::forEachChunk<Mat4<T>>(executor, count, [src, dst, singular](std::size_t begin, std::size_t end)
+    {
+      inverseBatch(src + begin, dst + begin, end - begin, singular ? singular + begin : nullptr);
+    });
   }
   
   template <typename T>
-  inline Mat4<T> makeRotation4DY(T angle)
+  inline void determinantBatch(Executor& executor, const Mat4<T>* src, T* dst, std::size_t count)
   {
-    Mat4<T> result{makeRotation3DY(angle)};
-    result.d[3][3] = 1;
-    return result;
+    Detail::forEachChunk<Mat4<T>>(executor, count, [src, dst](std::size_t begin, std::size_t end)
+    {
+      determinantBatch(src + begin, dst + begin, end - begin);
+    });
   }
   
   template <typename T>
-  inline Mat4<T> makeRotation4DZ(T angle)
+  inline void multiplyBatch(Executor& executor, const Mat4<T>* a, const Mat4<T>* b, Mat4<T>* dst, std::size_t count)
   {
-    Mat4<T> result{makeRotation3DZ(angle)};
-    result.d[3][3] = 1;
-    return result;
+    Detail::forEachChunk<Mat4<T>>(executor, count, [a, b, dst](std::size_t begin, std::size_t end)
+    {
+      multiplyBatch(a + begin, b + begin, dst + begin, end - begin);
+    });
   }
   
-  template<typename T>
-  inline Mat4<T> makeRotation4D(const Vec3<T>& axis, T angle)
+  template <typename T, NormalForm F = NormalForm::InverseTranspose>
+  inline void normalMatrixBatch(Executor& executor, const Mat4<T>* src, Mat3<T>* dst, std::size_t count)
   {
-    Mat4<T> result{makeRotation3D(axis, angle)};
-    result.d[3][3] = 1;
-    return result;
+    Detail::forEachChunk<Mat4<T>>(executor, count, [src, dst](std::size_t begin, std::size_t end)
+    {
+      normalMatrixBatch<T, F>(src + begin, dst + begin, end - begin);
+    });
   }
   
-  template <typename T>
-  inline Mat2<T> makeScale2D(const Vec2<T>& s)
+  template <typename T, NormalForm F = NormalForm::InverseTranspose>
+  inline void normalMatrixBatch(Executor& executor, const Affine<T>* src, Mat3<T>* dst, std::size_t count)
   {
-    return Mat2<T>{s.x, 0,
-                   0,   s.y};
+    Detail::forEachChunk<Affine<T>>(executor, count, [src, dst](std::size_t begin, std::size_t end)
+    {
+      normalMatrixBatch<T, F>(src + begin, dst + begin, end - begin);
+    });
   }
   
-  template <typename T>
-  inline Mat3<T> makeScale3D(const Vec3<T>& s)
+  template <typename T, StoreMode S = StoreMode::Cached>
+  inline void multiplyBatch(Executor& executor, const Mat4<T>& a, const Mat4<T>* b, Mat4<T>* dst, std::size_t count)
   {
-    return Mat3<T>{s.x, 0,   0,
-                   0,   s.y, 0,
-                   0,   0,   s.z};
+    Detail::forEachChunk<Mat4<T>>(executor, count, [&a, b, dst](std::size_t begin, std::size_t end)
+    {
+      multiplyBatch<T, S>(a, b + begin, dst + begin, end - begin);
+    });
   }
   
-  template <typename T>
-  inline Mat4<T> makeScale4D(const Vec3<T>& s)
+  template <typename T, StoreMode S = StoreMode::Cached>
+  inline void multiplyBatch(Executor& executor, const Mat4<T>& a, const Affine<T>* b, Mat4<T>* dst, std::size_t count)
   {
-    return Mat3<T>{s.x, 0, 0,   0,
-                   0, s.y, 0,   0,
-                   0, 0,   s.z, 0,
-                   0, 0,   0,   1};
-  }
-
-  template <typename T>
-  inline void makeTranslation(const Vec3<T>& t)
-  {
-    return Mat4<T>{1, 0, 0,  t.x,
-                   0, 1, 0,  t.y,
-                   0, 0, 1,  t.z,
-                   0, 0, 0,  1};
+    Detail::forEachChunk<Affine<T>>(executor, count, [&a, b, dst](std::size_t begin, std::size_t end)
+    {
+      multiplyBatch<T, S>(a, b + begin, dst + begin, end - begin);
+    });
   }
   
-  template<typename T = float>
-  inline Mat4<T> makeLookAt(const Vec3<T>& origin, const Vec3<T>& lookAt, const Vec3<T>& worldUp)
+  template <typename T, StoreMode S = StoreMode::Cached>
+  inline void modelViewProjectionBatch(Executor& executor, const Mat4<T>& projection, const Mat4<T>& view, const Mat4<T>* models,
+                                       Mat4<T>* mvps, std::size_t count, Mat3<T>* normals = nullptr)
   {
-    const Vec3<T> w = normalize(lookAt - origin);
-    const Vec3<T> u = normalize(Neon::cross(w, worldUp));
-    const Vec3<T> v = cross(u, w);
-    return Mat4<T>{u.x,  u.y,  u.z,  -Neon::dot(origin, u),
-                   v.x,  v.y,  v.z,  -Neon::dot(origin, v),
-                   -w.x, -w.y, -w.z, Neon::dot(origin, w),
-                   0,    0,    0,    1.0};
+    const Mat4<T> viewProjection = projection * view;
+    Detail::forEachChunk<Mat4<T>>(executor, count, [&viewProjection, models, mvps, normals](std::size_t begin, std::size_t end)
+    {
+      Detail::composeArray<T, S>(viewProjection, models + begin, mvps + begin, normals ? normals + begin : nullptr, end - begin);
+    });
   }
   
-  // LHC-to-RHC and vice versa.
-  template<typename T = float>
-  inline Mat4<T> makeInverseZ()
+  template <typename T, StoreMode S = StoreMode::Cached>
+  inline void modelViewProjectionBatch(Executor& executor, const Mat4<T>& projection, const Mat4<T>& view, const Affine<T>* models,
+                                       Mat4<T>* mvps, std::size_t count, Mat3<T>* normals = nullptr)
   {
-    return Mat4<T>{1, 0, 0,  0,
-                   0, 1, 0,  0,
-                   0, 0, -1, 0,
-                   0, 0, 0,  1};
+    const Mat4<T> viewProjection = projection * view;
+    Detail::forEachChunk<Affine<T>>(executor, count, [&viewProjection, models, mvps, normals](std::size_t begin, std::size_t end)
+    {
+      Detail::composeArray<T, S>(viewProjection, models + begin, mvps + begin, normals ? normals + begin : nullptr, end - begin);
+    });
   }
   
-  enum class NdcDepth
+  namespace Detail
   {
-    NegativeOneToOne,
-    ZeroToOne
-  };
+    // Ranges of at most this many triangles, or 1/64 of the total if that is more, are built as one task.
+    const std::uint32_t kBvhTaskSize = 4096;
+  }
   
-  namespace Detail
+  template <typename T>
+  void Bvh<T>::build(Executor& executor, const Vec3Stream<T>& v0, const Vec3Stream<T>& v1, const Vec3Stream<T>& v2)
   {
-    template <typename T, NdcDepth D>
-    inline typename std::enable_if<D == NdcDepth::ZeroToOne, Mat4<T>>::type
-    makeFrustum(T near, T far, T left, T right, T top, T bottom)
-    {
-      const T rlInv = 1 / (right - left);
-      const T n2 = 2 * near;
-      const T tbInv = 1 / (top - bottom);
-      const T nfInv = 1 / (near - far);
-      return Mat4<T>{n2 * rlInv, 0,          (right + left) * rlInv, 0,
-                     0,          n2 * tbInv, (top + bottom) * tbInv, 0,
-                     0,          0,          far * nfInv,            far * near * nfInv,
-                     0,          0,          -1,                     0};
-    }
-    
-    template <typename T, NdcDepth D>
-    inline typename std::enable_if<D == NdcDepth::NegativeOneToOne, Mat4<T>>::type
-    makeFrustum(T near, T far, T left, T right, T top, T bottom)
-    {
-      const T rlInv = 1 / (right - left);
-      const T n2 = 2 * near;
-      const T tbInv = 1 / (top - bottom);
-      const T nfInv = 1 / (near - far);
-      return Mat4<T>{n2 * rlInv, 0,          (right + left) * rlInv, 0,
-                     0,          n2 * tbInv, (top + bottom) * tbInv, 0,
-                     0,          0,          (far + near) * nfInv,   2 * far * near * nfInv,
-                     0,          0,          -1,                     0};
-    }
-    
-    template <typename T, NdcDepth D>
-    inline typename std::enable_if<D == NdcDepth::ZeroToOne, Mat4<T>>::type
-    makeOrthographic(T near, T far, T left, T right, T top, T bottom)
-    {
-      const T rlInv = 1 / (right - left);
-      const T tbInv = 1 / (top - bottom);
-      const T nfInv = 1 / (near - far);
-      return Mat4<T> {2 * rlInv, 0,         0,           -(left + right) * rlInv,
-                      0,         2 * tbInv, 0,           -(bottom + top) * tbInv,
-                      0,         0,         nfInv,       near * nfInv,
-                      0,         0,         0,           1};
-    }
-    
-    template <typename T, NdcDepth D>
-    inline typename std::enable_if<D == NdcDepth::NegativeOneToOne, Mat4<T>>::type
-    makeOrthographic(T near, T far, T left, T right, T top, T bottom)
-    {
-      const T rlInv = 1 / (right - left);
-      const T tbInv = 1 / (top - bottom);
-      const T nfInv = 1 / (near - far);
-      return Mat4<T> {2 * rlInv, 0,         0,           -(left + right) * rlInv,
-                      0,         2 * tbInv, 0,           -(bottom + top) * tbInv,
-                      0,         0,         2 * nfInv,   (near + far) * nfInv,
-                      0,         0,         0,           1};
+    struct Task
+    {
+      std::uint32_t node;
+      std::uint32_t begin;
+      std::uint32_t end;
+      unsigned int depth;
+    };
+    
+    Detail::BvhBuilder<T> builder;
+    if (!prepare(v0, v1, v2, builder))
+      return;
+    const std::uint32_t count = static_cast<std::uint32_t>(order.size());
+    const std::uint32_t grain = std::max(count / 64, Detail::kBvhTaskSize);
+    std::vector<Task> pending(1, Task{0, 0, count, 0});
+    std::vector<Task> tasks;
+    while (!pending.empty())
+    {
+      const Task t = pending.back();
+      pending.pop_back();
+      std::uint32_t mid = 0;
+      if (t.end - t.begin <= grain)
+        tasks.push_back(t);
+      else if (builder.split(nodes[t.node], t.begin, t.end, t.depth, mid))
+      {
+        const std::uint32_t children = static_cast<std::uint32_t>(nodes.size());
+        nodes[t.node].first = children;
+        nodes[t.node].count = 0;
+        nodes.resize(children + 2);
+        pending.push_back(Task{children, t.begin, mid, t.depth + 1});
+        pending.push_back(Task{children + 1, mid, t.end, t.depth + 1});
+      }
     }
     
-    template <typename T, NdcDepth D>
-    inline typename std::enable_if<D == NdcDepth::ZeroToOne, Mat4<T>>::type
-    makePerspective(T fovy, T aspect, T near, T far)
+    // Each subtree is built with its root at 0 and then moved into place: the root into its slot, the rest to the
+    // end of nodes, with the child links of inner nodes shifted to match.
+    std::vector<std::vector<Detail::BvhNode<T>>> subtrees(tasks.size());
+    executor.run(tasks.size(), [&](std::size_t i)
     {
-      const T halfFovy = fovy / 2;
-      const T tnInv = 1 / std::tan(halfFovy);
-      const T nfInv = 1 / (near - far);
-      T a = (far + near) * nfInv;
-      T b = 2 * far * near * nfInv;
-      return Mat4<T>{tnInv / aspect, 0,      0,           0,
-                     0,              tnInv,  0,           0,
-                     0,              0,      a,           b,
-                     0,              0,      -1,          0};
-    }
-    
-    template <typename T, NdcDepth D>
-    inline typename std::enable_if<D == NdcDepth::NegativeOneToOne, Mat4<T>>::type
-    makePerspective(T fovy, T aspect, T near, T far)
+      subtrees[i].resize(1);
+      builder.build(subtrees[i], 0, tasks[i].begin, tasks[i].end, tasks[i].depth);
+    });
+    for (std::size_t i = 0; i < tasks.size(); i++)
     {
-      const T halfFovy = fovy / 2;
-      const T tnInv = 1 / std::tan(halfFovy);
-      const T nfInv = 1 / (near - far);
-      T a = far * nfInv;
-      T b = far * near * nfInv;
-      return Mat4<T>{tnInv / aspect, 0,      0,           0,
-                     0,              tnInv,  0,           0,
-                     0,              0,      a,           b,
-                     0,              0,      -1,          0};
+      const std::uint32_t shift = static_cast<std::uint32_t>(nodes.size()) - 1;
+      const std::vector<Detail::BvhNode<T>>& subtree = subtrees[i];
+      for (std::size_t k = 0; k < subtree.size(); k++)
+      {
+        Detail::BvhNode<T> node = subtree[k];
+        if (!node.count)
+          node.first += shift;
+        if (k)
+          nodes.push_back(node);
+        else
+          nodes[tasks[i].node] = node;
+      }
     }
+    refit(v0, v1, v2);
   }
-  
-  template <typename T = float, NdcDepth D = NdcDepth::ZeroToOne>
-  inline Mat4<T> makeFrustum(T near, T far, T left, T right, T top, T bottom)
-  {
-    return Detail::makeFrustum<T, D>(near, far, left, right, top, bottom);
-  }
-  
-  template <typename T = float, NdcDepth D = NdcDepth::ZeroToOne>
-  inline Mat4<T> makeOrthographic(T near, T far, T left, T right, T top, T bottom)
-  {
-    return Detail::makeOrthographic<T, D>(near, far, left, right, top, bottom);
-  }
-  
-  template <typename T, NdcDepth D = NdcDepth::ZeroToOne>
-  inline Mat4<T> makePerspective(T fovy, T aspect, T near, T far)
-  {
-    return Detail::makePerspective<T, D>(fovy, aspect, near, far);
-  }
+#endif
   
   using Vec2f = Vec2<float>;
   using Vec3f = Vec3<float>;
@@ -1575,10 +9016,38 @@ namespace Neon
   using Vec2d = Vec2<double>;
   using Vec3d = Vec3<double>;
   using Vec4d = Vec4<double>;
+  using Vec2h = Vec2<Half>;
+  using Vec3h = Vec3<Half>;
+  using Vec4h = Vec4<Half>;
+  using Vec2bf = Vec2<BFloat16>;
+  using Vec3bf = Vec3<BFloat16>;
+  using Vec4bf = Vec4<BFloat16>;
   using Mat2f = Mat2<float>;
   using Mat3f = Mat3<float>;
   using Mat4f = Mat4<float>;
   using Mat2d = Mat2<double>;
   using Mat3d = Mat3<double>;
   using Mat4d = Mat4<double>;
+  using Vec3Af = Vec3A<float>;
+  using Vec4Af = Vec4A<float>;
+  using Mat4Af = Mat4A<float>;
+  using Vec3Ad = Vec3A<double>;
+  using Vec4Ad = Vec4A<double>;
+  using Mat4Ad = Mat4A<double>;
+  using Affinef = Affine<float>;
+  using Affined = Affine<double>;
+  using Quatf = Quat<float>;
+  using Quatd = Quat<double>;
+  using DualQuatf = DualQuat<float>;
+  using DualQuatd = DualQuat<double>;
+  using Trsf = Trs<float>;
+  using Trsd = Trs<double>;
+  using Rayf = Ray<float>;
+  using Rayd = Ray<double>;
+  using Bvhf = Bvh<float>;
+  using Bvhd = Bvh<double>;
+  using TransformHierarchyf = TransformHierarchy<float>;
+  using TransformHierarchyd = TransformHierarchy<double>;
+  using Frustumf = Frustum<float>;
+  using Frustumd = Frustum<double>;
 }  // namespace Neon
@@ -0,0 +1,665 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) Fouad Valadbeigi (akoylasar@gmail.com)
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+// Usage: Neon.Bench [--filter <substring>] [--min-time <ms>] [--json <file>]
+// Every benchmark runs over kCount inputs per call, except the ".large" ones; the reported figures are per element.
+
+#include "Neon.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+
+using namespace Neon;
+
+namespace
+{
+  const std::size_t kCount = 1024;
+  const unsigned int kSamples = 5;
+
+  template <typename T>
+  inline void doNotOptimize(const T& value)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    __asm__ __volatile__("" : : "r,m"(value) : "memory");
+#else
+    const volatile char sink = *reinterpret_cast<const volatile char*>(&value);
+    (void)sink;
+#endif
+  }
+
+  // Retired user-space instructions, when the kernel exposes perf events.
+  class InstructionCounter
+  {
+  public:
+    InstructionCounter() : fd(-1)
+    {
+#if defined(__linux__)
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+
+    ~InstructionCounter()
+    {
+#if defined(__linux__)
+      if (fd >= 0)
+        close(fd);
+#endif
+    }
+
+    InstructionCounter(const InstructionCounter&) = delete;
+    InstructionCounter& operator=(const InstructionCounter&) = delete;
+
+    bool available() const
+    {
+      return fd >= 0;
+    }
+
+    void start()
+    {
+#if defined(__linux__)
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    long long stop()
+    {
+      long long count = 0;
+#if defined(__linux__)
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count)))
+        count = 0;
+#endif
+      return count;
+    }
+
+  private:
+    int fd;
+  };
+
+  struct Result
+  {
+    std::string name;
+    const char* type;
+    const char* form;
+    double nsPerOp;
+    double opsPerSecond;
+    double instructionsPerOp;  // Negative when not measured.
+  };
+
+  class Bench
+  {
+  public:
+    Bench(const std::string& filter, double minTimeMs) : filter(filter), minTimeNs(minTimeMs * 1e6)
+    {
+    }
+
+    // f processes kCount elements per call.
+    template <typename F>
+    void run(const std::string& name, const char* type, const char* form, F f)
+    {
+      run(name, type, form, kCount, f);
+    }
+    
+    // f processes count elements per call.
+    template <typename F>
+    void run(const std::string& name, const char* type, const char* form, std::size_t count, F f)
+    {
+      const std::string label = name + "<" + type + ">" + (std::strcmp(form, "single") == 0 ? "" : std::string(" [") + form + "]");
+      if (!filter.empty() && label.find(filter) == std::string::npos)
+        return;
+
+      // Grow the call count until one sample takes a tenth of the time budget, then spread the budget over the samples.
+      f();
+      std::size_t calls = 1;
+      double ns = time(f, calls);
+      while (ns < minTimeNs / 10 && calls < (std::size_t(1) << 30))
+      {
+        calls *= 2;
+        ns = time(f, calls);
+      }
+      calls = std::max<std::size_t>(1, static_cast<std::size_t>(static_cast<double>(calls) * (minTimeNs / kSamples) / std::max(ns, 1.0)));
+      double best = time(f, calls);
+      for (unsigned int i = 1; i < kSamples; i++)
+        best = std::min(best, time(f, calls));
+
+      const double ops = static_cast<double>(calls) * static_cast<double>(count);
+      Result r{name, type, form, best / ops, ops / (best * 1e-9), -1};
+      if (counter.available())
+      {
+        counter.start();
+        for (std::size_t i = 0; i < calls; i++)
+          f();
+        r.instructionsPerOp = static_cast<double>(counter.stop()) / ops;
+      }
+      results.push_back(r);
+
+      if (r.instructionsPerOp >= 0)
+        std::printf("%-44s %10.3f ns/op %12.3f Mop/s %9.2f inst/op\n", label.c_str(), r.nsPerOp, r.opsPerSecond * 1e-6, r.instructionsPerOp);
+      else
+        std::printf("%-44s %10.3f ns/op %12.3f Mop/s %9s inst/op\n", label.c_str(), r.nsPerOp, r.opsPerSecond * 1e-6, "n/a");
+      std::fflush(stdout);
+    }
+
+    bool writeJson(const char* path) const
+    {
+      FILE* file = std::fopen(path, "w");
+      if (!file)
+        return false;
+      std::fprintf(file, "{\n  \"simd\": \"%s\",\n  \"count\": %u,\n  \"results\": [\n", simdName(), static_cast<unsigned int>(kCount));
+      for (std::size_t i = 0; i < results.size(); i++)
+      {
+        const Result& r = results[i];
+        std::fprintf(file, "    {\"name\": \"%s\", \"type\": \"%s\", \"form\": \"%s\", \"ns_per_op\": %.4f, \"ops_per_sec\": %.1f, ",
+                     r.name.c_str(), r.type, r.form, r.nsPerOp, r.opsPerSecond);
+        if (r.instructionsPerOp >= 0)
+          std::fprintf(file, "\"instructions_per_op\": %.3f}", r.instructionsPerOp);
+        else
+          std::fprintf(file, "\"instructions_per_op\": null}");
+        std::fprintf(file, "%s\n", i + 1 < results.size() ? "," : "");
+      }
+      std::fprintf(file, "  ]\n}\n");
+      return std::fclose(file) == 0;
+    }
+
+    static const char* simdName()
+    {
+#if defined(NEON_SIMD_FMA)
+      return "avx+fma";
+#elif defined(NEON_SIMD_AVX)
+      return "avx";
+#elif defined(NEON_SIMD_SSE41)
+      return "sse4.1";
+#elif defined(NEON_SIMD_SSE2)
+      return "sse2";
+#else
+      return "scalar";
+#endif
+    }
+
+  private:
+    template <typename F>
+    static double time(F& f, std::size_t calls)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      for (std::size_t i = 0; i < calls; i++)
+        f();
+      const auto end = std::chrono::steady_clock::now();
+      return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    std::string filter;
+    double minTimeNs;
+    InstructionCounter counter;
+    std::vector<Result> results;
+  };
+
+  // Deterministic inputs in [-1, 1).
+  class Random
+  {
+  public:
+    explicit Random(unsigned int seed) : state(seed)
+    {
+    }
+
+    template <typename T>
+    T next()
+    {
+      state = state * 1664525u + 1013904223u;
+      return static_cast<T>(state >> 8) / static_cast<T>(1 << 23) - 1;
+    }
+
+  private:
+    unsigned int state;
+  };
+
+  template <typename T>
+  struct Inputs
+  {
+    std::vector<T> s;
+    std::vector<Vec2<T>> v2a, v2b;
+    std::vector<Vec3<T>> v3a, v3b;
+    std::vector<Vec4<T>> v4a, v4b;
+    std::vector<Mat2<T>> m2a, m2b;
+    std::vector<Mat3<T>> m3a, m3b;
+    std::vector<Mat4<T>> m4a, m4b;
+    std::vector<Affine<T>> aa, ab;
+    std::vector<Quat<T>> qa, qb;
+
+    explicit Inputs(Random& r) : s(kCount), v2a(kCount), v2b(kCount), v3a(kCount), v3b(kCount), v4a(kCount), v4b(kCount),
+                                 m2a(kCount), m2b(kCount), m3a(kCount), m3b(kCount), m4a(kCount), m4b(kCount),
+                                 aa(kCount), ab(kCount), qa(kCount), qb(kCount)
+    {
+      for (std::size_t i = 0; i < kCount; i++)
+      {
+        s[i] = r.next<T>();
+        v2a[i] = Vec2<T>{r.next<T>(), r.next<T>()};
+        v2b[i] = Vec2<T>{r.next<T>(), r.next<T>()};
+        v3a[i] = Vec3<T>{r.next<T>(), r.next<T>(), r.next<T>() + 2};
+        v3b[i] = Vec3<T>{r.next<T>(), r.next<T>() + 2, r.next<T>()};
+        v4a[i] = Vec4<T>{v3a[i], 1};
+        v4b[i] = Vec4<T>{v3b[i], r.next<T>()};
+        // Diagonally dominant, so every matrix is invertible.
+        m2a[i] = Mat2<T>(4) + Mat2<T>{v2a[i], v2b[i]};
+        m2b[i] = Mat2<T>(4) + Mat2<T>{v2b[i], v2a[i]};
+        m3a[i] = Mat3<T>(4) + Mat3<T>{v3a[i], v3b[i], v3a[i]};
+        m3b[i] = Mat3<T>(4) + Mat3<T>{v3b[i], v3a[i], v3b[i]};
+        m4a[i] = makeTranslation(v3a[i]) * makeRotation4D(normalize(v3b[i]), s[i]) * makeScale4D(Vec3<T>(Vec3<T>(2) + v3a[i] * T(0.5)));
+        m4b[i] = Mat4<T>(8) + Mat4<T>{v4a[i], v4b[i], v4a[i], v4b[i]};
+        aa[i] = Affine<T>{m4a[i]};
+        ab[i] = Affine<T>{makeRotation3D(normalize(v3a[i]), s[i]), v3b[i]};
+        qa[i] = makeQuat(normalize(v3a[i]), s[i]);
+        qb[i] = makeQuat(normalize(v3b[i]), -s[i]);
+      }
+    }
+  };
+
+  // Applies op to every element and stores the results.
+  template <typename In, typename InAlloc, typename Out, typename OutAlloc, typename Op>
+  inline void map(const std::vector<In, InAlloc>& in, std::vector<Out, OutAlloc>& out, Op op)
+  {
+    for (std::size_t i = 0; i < kCount; i++)
+      out[i] = op(in[i], i);
+    doNotOptimize(out[0]);
+  }
+
+  template <typename T>
+  void benchAll(Bench& b, const char* type)
+  {
+    Random random(12345);
+    const Inputs<T> in(random);
+    std::vector<T> outS(kCount);
+    std::vector<Vec2<T>> outV2(kCount);
+    std::vector<Vec3<T>> outV3(kCount);
+    std::vector<Vec4<T>> outV4(kCount);
+    std::vector<Mat2<T>> outM2(kCount);
+    std::vector<Mat3<T>> outM3(kCount);
+    std::vector<Mat4<T>> outM4(kCount);
+    std::vector<Affine<T>> outA(kCount);
+    std::vector<Quat<T>> outQ(kCount);
+    const T eta = T(0.75);
+    const Vec3<T> axis = normalize(Vec3<T>{1, 2, 3});
+    const Mat4<T> m = in.m4a[0];
+
+    const char* single = "single";
+    const char* batch = "batch";
+
+    /* Vectors */
+    b.run("Vec2.dot", type, single, [&]() { map(in.v2a, outS, [&](const Vec2<T>& v, std::size_t i) { return dot(v, in.v2b[i]); }); });
+    b.run("Vec2.normalize", type, single, [&]() { map(in.v2a, outV2, [&](const Vec2<T>& v, std::size_t) { return normalize(v); }); });
+    b.run("Vec3.add", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t i) { return Vec3<T>(v + in.v3b[i]); }); });
+    b.run("Vec3.sub", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t i) { return Vec3<T>(v - in.v3b[i]); }); });
+    b.run("Vec3.scale", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t i) { return Vec3<T>(v * in.s[i]); }); });
+    b.run("Vec3.mul", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t i) { return Vec3<T>(v * in.v3b[i]); }); });
+    b.run("Vec3.dot", type, single, [&]() { map(in.v3a, outS, [&](const Vec3<T>& v, std::size_t i) { return dot(v, in.v3b[i]); }); });
+    b.run("Vec3.cross", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t i) { return cross(v, in.v3b[i]); }); });
+    b.run("Vec3.mag", type, single, [&]() { map(in.v3a, outS, [&](const Vec3<T>& v, std::size_t) { return mag(v); }); });
+    b.run("Vec3.distance", type, single, [&]() { map(in.v3a, outS, [&](const Vec3<T>& v, std::size_t i) { return distance(v, in.v3b[i]); }); });
+    b.run("Vec3.normalize", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t) { return normalize(v); }); });
+    b.run("Vec3.normalizeFast", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t) { return normalizeFast(v); }); });
+    b.run("Vec3.normalizeFast.safe", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t) { return normalizeFast(v, axis); }); });
+    b.run("Vec3.project", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t i) { return project(v, in.v3b[i]); }); });
+    b.run("Vec3.reflect", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t) { return reflect(v, axis); }); });
+    b.run("Vec3.refract", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t) { return refract(v, axis, eta); }); });
+    b.run("Vec3.rotate", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t i) { return rotate(v, axis, in.s[i]); }); });
+    b.run("Vec4.add", type, single, [&]() { map(in.v4a, outV4, [&](const Vec4<T>& v, std::size_t i) { return Vec4<T>(v + in.v4b[i]); }); });
+    b.run("Vec4.dot", type, single, [&]() { map(in.v4a, outS, [&](const Vec4<T>& v, std::size_t i) { return dot(v, in.v4b[i]); }); });
+    b.run("Vec4.normalize", type, single, [&]() { map(in.v4a, outV4, [&](const Vec4<T>& v, std::size_t) { return normalize(v); }); });
+
+    /* Vector streams */
+    const Vec3Stream<T> sa(in.v3a.data(), kCount);
+    const Vec3Stream<T> sb(in.v3b.data(), kCount);
+    const Vec4Stream<T> s4a(in.v4a.data(), kCount);
+    const Vec4Stream<T> s4b(in.v4b.data(), kCount);
+    Vec3Stream<T> so(kCount);
+    Vec4Stream<T> s4o(kCount);
+    b.run("Vec3.add", type, batch, [&]() { so = sa; so += sb; doNotOptimize(so.x()[0]); });
+    b.run("Vec3.dot", type, batch, [&]() { dot(sa, sb, outS.data()); doNotOptimize(outS[0]); });
+    b.run("Vec3.cross", type, batch, [&]() { cross(sa, sb, so); doNotOptimize(so.x()[0]); });
+    b.run("Vec3.mag", type, batch, [&]() { mag(sa, outS.data()); doNotOptimize(outS[0]); });
+    b.run("Vec3.distance", type, batch, [&]() { distance(sa, sb, outS.data()); doNotOptimize(outS[0]); });
+    b.run("Vec3.normalize", type, batch, [&]() { normalize(sa, so); doNotOptimize(so.x()[0]); });
+    b.run("Vec3.normalizeFast", type, batch, [&]() { normalizeFast(sa, so); doNotOptimize(so.x()[0]); });
+    b.run("Vec3.normalizeFast.safe", type, batch, [&]() { normalizeFast(sa, axis, so); doNotOptimize(so.x()[0]); });
+    b.run("Vec3.project", type, batch, [&]() { project(sa, sb, so); doNotOptimize(so.x()[0]); });
+    b.run("Vec3.reflect", type, batch, [&]() { reflect(sa, sb, so); doNotOptimize(so.x()[0]); });
+    b.run("Vec3.rotate", type, batch, [&]() { rotate(sa, axis, T(0.5), so); doNotOptimize(so.x()[0]); });
+    b.run("Vec4.dot", type, batch, [&]() { dot(s4a, s4b, outS.data()); doNotOptimize(outS[0]); });
+    b.run("Vec4.normalize", type, batch, [&]() { normalize(s4a, s4o); doNotOptimize(s4o.x()[0]); });
+
+    /* Matrices */
+    b.run("Mat2.mul", type, single, [&]() { map(in.m2a, outM2, [&](const Mat2<T>& a, std::size_t i) { return a * in.m2b[i]; }); });
+    b.run("Mat3.mul", type, single, [&]() { map(in.m3a, outM3, [&](const Mat3<T>& a, std::size_t i) { return a * in.m3b[i]; }); });
+    b.run("Mat4.mul", type, single, [&]() { map(in.m4a, outM4, [&](const Mat4<T>& a, std::size_t i) { return a * in.m4b[i]; }); });
+    b.run("Mat4.add", type, single, [&]() { map(in.m4a, outM4, [&](const Mat4<T>& a, std::size_t i) { return Mat4<T>(a + in.m4b[i]); }); });
+    b.run("Mat4.scale", type, single, [&]() { map(in.m4a, outM4, [&](const Mat4<T>& a, std::size_t i) { return Mat4<T>(a * in.s[i]); }); });
+    b.run("Mat2.mulVec", type, single, [&]() { map(in.v2a, outV2, [&](const Vec2<T>& v, std::size_t i) { return in.m2a[i] * v; }); });
+    b.run("Mat3.mulVec", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t i) { return in.m3a[i] * v; }); });
+    b.run("Mat4.mulVec", type, single, [&]() { map(in.v4a, outV4, [&](const Vec4<T>& v, std::size_t i) { return in.m4a[i] * v; }); });
+    b.run("Mat2.determinant", type, single, [&]() { map(in.m2a, outS, [&](const Mat2<T>& a, std::size_t) { return determinant(a); }); });
+    b.run("Mat3.determinant", type, single, [&]() { map(in.m3a, outS, [&](const Mat3<T>& a, std::size_t) { return determinant(a); }); });
+    b.run("Mat4.determinant", type, single, [&]() { map(in.m4a, outS, [&](const Mat4<T>& a, std::size_t) { return determinant(a); }); });
+    b.run("Mat2.inverse", type, single, [&]() { map(in.m2a, outM2, [&](const Mat2<T>& a, std::size_t) { return inverse(a); }); });
+    b.run("Mat3.inverse", type, single, [&]() { map(in.m3a, outM3, [&](const Mat3<T>& a, std::size_t) { return inverse(a); }); });
+    b.run("Mat4.inverse", type, single, [&]() { map(in.m4a, outM4, [&](const Mat4<T>& a, std::size_t) { return inverse(a); }); });
+    b.run("Mat2.transpose", type, single, [&]() { map(in.m2a, outM2, [&](const Mat2<T>& a, std::size_t) { return transpose(a); }); });
+    b.run("Mat3.transpose", type, single, [&]() { map(in.m3a, outM3, [&](const Mat3<T>& a, std::size_t) { return transpose(a); }); });
+    b.run("Mat4.transpose", type, single, [&]() { map(in.m4a, outM4, [&](const Mat4<T>& a, std::size_t) { return transpose(a); }); });
+    b.run("Mat4.determinant", type, batch, [&]() { determinantBatch(in.m4a.data(), outS.data(), kCount); doNotOptimize(outS[0]); });
+    b.run("Mat4.inverse", type, batch, [&]() { inverseBatch(in.m4a.data(), outM4.data(), kCount); doNotOptimize(outM4[0]); });
+    b.run("Mat4.normalMatrix.inverseTranspose", type, single, [&]() { map(in.m4a, outM3, [&](const Mat4<T>& a, std::size_t) { return transpose(inverse(Mat3<T>(a))); }); });
+    b.run("Mat4.normalMatrix", type, single, [&]() { map(in.m4a, outM3, [&](const Mat4<T>& a, std::size_t) { return normalMatrix(a); }); });
+    b.run("Mat4.normalMatrix", type, batch, [&]() { normalMatrixBatch(in.m4a.data(), outM3.data(), kCount); doNotOptimize(outM3[0]); });
+    b.run("Mat4.normalMatrixCofactor", type, batch, [&]() { normalMatrixBatch<T, NormalForm::Cofactor>(in.m4a.data(), outM3.data(), kCount); doNotOptimize(outM3[0]); });
+
+    /* Transforms */
+    b.run("Mat4.transformPoint", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t) { return Vec3<T>(m * Vec4<T>{v, 1}); }); });
+    b.run("Mat4.transformPoint", type, batch, [&]() { transformPoints(m, in.v3a.data(), outV3.data(), kCount); doNotOptimize(outV3[0]); });
+    b.run("Mat4.transformVector", type, batch, [&]() { transformVectors(m, in.v3a.data(), outV3.data(), kCount); doNotOptimize(outV3[0]); });
+    b.run("Mat4.transformPointProjective", type, batch, [&]() { transformPointsProjective(m, in.v3a.data(), outV3.data(), kCount); doNotOptimize(outV3[0]); });
+    b.run("Mat4.mulVec", type, batch, [&]() { transform(m, in.v4a.data(), outV4.data(), kCount); doNotOptimize(outV4[0]); });
+    b.run("Vec3Stream.transformPoint", type, batch, [&]() { transformPoints(m, sa, so); doNotOptimize(so.x()[0]); });
+    const AlignedVector<Vec3A<T>> v3A(in.v3a.begin(), in.v3a.end());
+    const AlignedVector<Vec4A<T>> v4A(in.v4a.begin(), in.v4a.end());
+    const AlignedVector<Mat4A<T>> m4A(in.m4a.begin(), in.m4a.end());
+    const AlignedVector<Mat4A<T>> m4B(in.m4b.begin(), in.m4b.end());
+    AlignedVector<Vec3A<T>> outV3A(kCount);
+    AlignedVector<Vec4A<T>> outV4A(kCount);
+    AlignedVector<Mat4A<T>> outM4A(kCount);
+    b.run("Mat4A.mul", type, single, [&]() { map(m4A, outM4A, [&](const Mat4A<T>& a, std::size_t i) { return a * m4B[i]; }); });
+    b.run("Mat4A.mulVec", type, single, [&]() { map(v4A, outV4A, [&](const Vec4A<T>& v, std::size_t i) { return m4A[i] * v; }); });
+    b.run("Mat4A.transformPoint", type, batch, [&]() { transformPoints(m, v3A.data(), outV3A.data(), kCount); doNotOptimize(outV3A[0]); });
+    b.run("Mat4A.transformVector", type, batch, [&]() { transformVectors(m, v3A.data(), outV3A.data(), kCount); doNotOptimize(outV3A[0]); });
+    b.run("Mat4A.mulVec", type, batch, [&]() { transform(m, v4A.data(), outV4A.data(), kCount); doNotOptimize(outV4A[0]); });
+    const Mat4<T> projection = in.m4b[0];
+    std::vector<Mat4<T>, AlignedAllocator<Mat4<T>, 64>> mvps(kCount);
+    b.run("Mat4.mvp", type, single, [&]() { map(in.m4a, outM4, [&](const Mat4<T>& a, std::size_t) { return projection * m * a; }); });
+    b.run("Mat4.mvp", type, batch, [&]() { modelViewProjectionBatch(projection, m, in.m4a.data(), mvps.data(), kCount); doNotOptimize(mvps[0]); });
+    b.run("Mat4.mvpNonTemporal", type, batch, [&]() { modelViewProjectionBatch<T, StoreMode::NonTemporal>(projection, m, in.m4a.data(), mvps.data(), kCount); doNotOptimize(mvps[0]); });
+    b.run("Mat4.mvpNormal", type, batch, [&]() { modelViewProjectionBatch(projection, m, in.m4a.data(), mvps.data(), kCount, outM3.data()); doNotOptimize(outM3[0]); });
+    std::vector<Std140Padded<Mat3<T>>> gpuM3(kCount);
+    std::vector<Std430Padded<Vec3<T>>> gpuV3(kCount);
+    std::vector<Vec4<Half>> halves(kCount);
+    std::vector<Vec4<BFloat16>> bfloats(kCount);
+    std::vector<Vec4<float>> floats(kCount);
+    for (std::size_t i = 0; i < kCount; i++)
+      floats[i] = Vec4<float>{static_cast<float>(in.v4a[i].x), static_cast<float>(in.v4a[i].y), static_cast<float>(in.v4a[i].z), static_cast<float>(in.v4a[i].w)};
+    b.run("Vec4h.fromFloat", type, batch, [&]() { convert(floats.data(), halves.data(), kCount); doNotOptimize(halves[0]); });
+    b.run("Vec4h.toFloat", type, batch, [&]() { convert(halves.data(), floats.data(), kCount); doNotOptimize(floats[0]); });
+    b.run("Vec4bf.fromFloat", type, batch, [&]() { convert(floats.data(), bfloats.data(), kCount); doNotOptimize(bfloats[0]); });
+    b.run("Vec4bf.toFloat", type, batch, [&]() { convert(bfloats.data(), floats.data(), kCount); doNotOptimize(floats[0]); });
+    std::vector<Vec3<T>> units(kCount);
+    std::vector<std::uint32_t> packed32(kCount);
+    std::vector<std::uint16_t> packed16(kCount);
+    for (std::size_t i = 0; i < kCount; i++)
+      units[i] = normalize(in.v3a[i]);
+    b.run("Vec3.encodeOct32", type, single, [&]() { for (std::size_t i = 0; i < kCount; i++) packed32[i] = encodeOct32(units[i]); doNotOptimize(packed32[0]); });
+    b.run("Vec3.decodeOct32", type, single, [&]() { map(packed32, outV3, [&](std::uint32_t p, std::size_t) { return decodeOct32<T>(p); }); });
+    b.run("Vec3.encodeOct32", type, batch, [&]() { encodeOct32(units.data(), packed32.data(), kCount); doNotOptimize(packed32[0]); });
+    b.run("Vec3.decodeOct32", type, batch, [&]() { decodeOct32(packed32.data(), outV3.data(), kCount); doNotOptimize(outV3[0]); });
+    b.run("Vec3.encodeOct16", type, batch, [&]() { encodeOct16(units.data(), packed16.data(), kCount); doNotOptimize(packed16[0]); });
+    b.run("Vec3.decodeOct16", type, batch, [&]() { decodeOct16(packed16.data(), outV3.data(), kCount); doNotOptimize(outV3[0]); });
+    b.run("Vec3.encodeSnorm1010102", type, batch, [&]() { encodeSnorm1010102(units.data(), packed32.data(), kCount); doNotOptimize(packed32[0]); });
+    b.run("Vec3.decodeSnorm1010102", type, batch, [&]() { decodeSnorm1010102(packed32.data(), outV3.data(), kCount); doNotOptimize(outV3[0]); });
+    b.run("Std140Array.store.Mat3", type, batch, [&]() { Std140Array<Mat3<T>>(gpuM3.data(), kCount).store(in.m3a.data(), kCount); doNotOptimize(gpuM3[0]); });
+    b.run("Std430Array.store.Vec3", type, batch, [&]() { Std430Array<Vec3<T>>(gpuV3.data(), kCount).store(in.v3a.data(), kCount); doNotOptimize(gpuV3[0]); });
+    b.run("Affine.mul", type, single, [&]() { map(in.aa, outA, [&](const Affine<T>& a, std::size_t i) { return a * in.ab[i]; }); });
+    b.run("Affine.inverse", type, single, [&]() { map(in.aa, outA, [&](const Affine<T>& a, std::size_t) { return inverse(a); }); });
+    b.run("Affine.inverseRigid", type, single, [&]() { map(in.ab, outA, [&](const Affine<T>& a, std::size_t) { return inverseRigid(a); }); });
+    TransformHierarchy<T> hierarchy;
+    hierarchy.reserve(kCount);
+    for (std::size_t i = 0; i < kCount; i++)
+      hierarchy.add(in.ab[i], i == 0 ? TransformHierarchy<T>::kNoParent : (i - 1) / 4);
+    b.run("TransformHierarchy.update.all", type, batch, [&]() { for (std::size_t i = 0; i < kCount; i++) hierarchy.setLocal(i, in.ab[i]); hierarchy.update(); doNotOptimize(hierarchy.world(kCount - 1)); });
+    b.run("TransformHierarchy.update.5%", type, batch, [&]() { for (std::size_t i = 19; i < kCount; i += 20) hierarchy.setLocal(i, in.ab[i]); hierarchy.update(); doNotOptimize(hierarchy.world(kCount - 1)); });
+    b.run("Quat.mul", type, single, [&]() { map(in.qa, outQ, [&](const Quat<T>& q, std::size_t i) { return q * in.qb[i]; }); });
+    b.run("Quat.rotate", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t i) { return rotate(in.qa[i], v); }); });
+    b.run("Quat.slerp", type, single, [&]() { map(in.qa, outQ, [&](const Quat<T>& q, std::size_t i) { return slerp(q, in.qb[i], T(0.3)); }); });
+    b.run("Quat.nlerp", type, single, [&]() { map(in.qa, outQ, [&](const Quat<T>& q, std::size_t i) { return nlerp(q, in.qb[i], T(0.3)); }); });
+    // kCount tracks of 16 keys played forward in 1/60 steps, with the clock wrapping around.
+    KeyframeTracks<Vec3<T>> translationTracks;
+    KeyframeTracks<Quat<T>> rotationTracks;
+    translationTracks.reserve(kCount, 16 * kCount);
+    rotationTracks.reserve(kCount, 16 * kCount);
+    for (std::size_t i = 0; i < kCount; i++)
+    {
+      T keyTimes[16];
+      Vec3<T> keyTranslations[16];
+      Quat<T> keyRotations[16];
+      for (std::size_t j = 0; j < 16; j++)
+      {
+        keyTimes[j] = T(0.25) * T(j) + in.s[i] * T(0.01);
+        keyTranslations[j] = in.v3a[(i + j) % kCount];
+        keyRotations[j] = in.qa[(i + j) % kCount];
+      }
+      translationTracks.add(keyTimes, keyTranslations, 16);
+      rotationTracks.add(keyTimes, keyRotations, 16);
+    }
+    KeyframeSampler<Vec3<T>> translationSampler(translationTracks);
+    KeyframeSampler<Quat<T>> rotationSampler(rotationTracks);
+    T clock = 0;
+    const auto tick = [&]() { clock = clock > T(4) ? T(0) : clock + T(1) / 60; return clock; };
+    b.run("KeyframeSampler.sample.Vec3", type, batch, [&]() { translationSampler.sample(tick(), outV3.data()); doNotOptimize(outV3[0]); });
+    b.run("KeyframeSampler.sample.slerp", type, batch, [&]() { rotationSampler.sample(tick(), outQ.data()); doNotOptimize(outQ[0]); });
+    b.run("KeyframeSampler.sample.nlerp", type, batch, [&]() { rotationSampler.template sample<Precision::Fast>(tick(), outQ.data()); doNotOptimize(outQ[0]); });
+
+    // Four bones per vertex out of 64, as in a typical skinned mesh.
+    std::vector<DualQuat<T>> bones(64);
+    for (std::size_t i = 0; i < bones.size(); i++)
+      bones[i] = makeDualQuat(in.qa[i], in.v3a[i]);
+    std::vector<std::uint32_t> boneIndices(4 * kCount);
+    std::vector<Vec4<T>> boneWeights(kCount);
+    for (std::size_t i = 0; i < kCount; i++)
+    {
+      for (std::size_t k = 0; k < 4; k++)
+        boneIndices[4 * i + k] = static_cast<std::uint32_t>((i * 7 + k * 13) % bones.size());
+      const Vec4<T> w{T(1), std::abs(in.s[i]), T(0.5), T(0.25)};
+      boneWeights[i] = w / (w.x + w.y + w.z + w.w);
+    }
+    const Vec4Stream<T> weightStream(boneWeights.data(), kCount);
+    std::vector<DualQuat<T>> outDQ(kCount);
+    b.run("DualQuat.mul", type, single, [&]() { map(in.qa, outDQ, [&](const Quat<T>&, std::size_t i) { return bones[i % 64] * bones[(i + 1) % 64]; }); });
+    b.run("DualQuat.transformPoint", type, single, [&]() { map(in.v3a, outV3, [&](const Vec3<T>& v, std::size_t i) { return transformPoint(bones[i % 64], v); }); });
+    b.run("DualQuat.skin", type, batch, [&]() { skin(bones.data(), sa, weightStream, boneIndices.data(), so); doNotOptimize(so.x()[0]); });
+
+    /* Trigonometry */
+    std::vector<T> outC(kCount);
+    b.run("sinCos", type, single, [&]() { map(in.s, outS, [&](T s, std::size_t i) { T c; sinCos(s, outC[i], c); return c; }); });
+    b.run("sinCos.fast", type, single, [&]() { map(in.s, outS, [&](T s, std::size_t i) { T c; sinCos<T, Precision::Fast>(s, outC[i], c); return c; }); });
+    b.run("sinCos.fast", type, batch, [&]() { sinCos<T, Precision::Fast>(in.s.data(), outS.data(), outC.data(), kCount); doNotOptimize(outS[0]); });
+
+    /* Culling */
+    const Frustum<T> frustum(makePerspective<T>(T(1), T(1.5), T(0.1), T(100)) * makeLookAt(Vec3<T>{0, 0, 5}, Vec3<T>(0), Vec3<T>{0, 1, 0}));
+    std::vector<Vec3<T>> corners(kCount);
+    for (std::size_t i = 0; i < kCount; i++)
+      corners[i] = Vec3<T>(in.v3a[i] + Vec3<T>(T(0.5)));
+    const Vec3Stream<T> boxMax(corners.data(), kCount);
+    const std::vector<T> radii(kCount, T(0.25));
+    std::vector<std::uint32_t> visible((kCount + 31) / 32);
+    std::vector<unsigned char> outB(kCount);
+    b.run("Frustum.sphere", type, single, [&]() { map(in.v3a, outB, [&](const Vec3<T>& c, std::size_t i) { return static_cast<unsigned char>(frustum.intersectsSphere(c, radii[i])); }); });
+    b.run("Frustum.aabb", type, single, [&]() { map(in.v3a, outB, [&](const Vec3<T>& lo, std::size_t i) { return static_cast<unsigned char>(frustum.intersectsAabb(lo, corners[i])); }); });
+    b.run("Frustum.sphere", type, batch, [&]() { cullSpheres(frustum, sa, radii.data(), visible.data()); doNotOptimize(visible[0]); });
+    b.run("Frustum.aabb", type, batch, [&]() { cullAabbs(frustum, sa, boxMax, visible.data()); doNotOptimize(visible[0]); });
+
+    /* Rays */
+    std::vector<Vec3<T>> triV1(kCount), triV2(kCount), rayDirs(kCount);
+    for (std::size_t i = 0; i < kCount; i++)
+    {
+      triV1[i] = Vec3<T>(in.v3a[i] + Vec3<T>{T(0.5), 0, T(0.1)});
+      triV2[i] = Vec3<T>(in.v3a[i] + Vec3<T>{0, T(0.5), T(-0.1)});
+      rayDirs[i] = Vec3<T>(in.v3b[i] - in.v3a[i]);
+    }
+    const Vec3Stream<T> v1s(triV1.data(), kCount);
+    const Vec3Stream<T> v2s(triV2.data(), kCount);
+    const Vec3Stream<T> dirs(rayDirs.data(), kCount);
+    const Ray<T> ray{Vec3<T>{0, 0, -5}, Vec3<T>{T(0.01), T(0.02), 1}};
+    std::vector<T> outU(kCount), outV(kCount);
+    b.run("Ray.triangle", type, single, [&]() { map(in.v3a, outB, [&](const Vec3<T>& a, std::size_t i) { TriangleHit<T> h; return static_cast<unsigned char>(intersectTriangle(ray, a, triV1[i], triV2[i], h)); }); });
+    b.run("Ray.triangle", type, batch, [&]() { intersectTriangles(ray, sa, v1s, v2s, outS.data(), outU.data(), outV.data(), visible.data()); doNotOptimize(visible[0]); });
+    b.run("Ray.closest", type, batch, [&]() { TriangleHit<T> h; doNotOptimize(intersectClosest(ray, sa, v1s, v2s, h)); });
+    b.run("Ray.packet.triangle", type, batch, [&]() { intersectTriangle(sa, dirs, in.v3b[0], triV1[0], triV2[0], outS.data(), outU.data(), outV.data(), visible.data()); doNotOptimize(visible[0]); });
+    b.run("Ray.aabb", type, single, [&]() { map(in.v3a, outB, [&](const Vec3<T>& lo, std::size_t i) { T t; return static_cast<unsigned char>(intersectAabb(ray, lo, corners[i], t)); }); });
+    b.run("Ray.aabb", type, batch, [&]() { intersectAabbs(ray, sa, boxMax, outS.data(), visible.data()); doNotOptimize(visible[0]); });
+    b.run("Ray.packet.aabb", type, batch, [&]() { intersectAabb(sa, dirs, in.v3b[0], corners[0], outS.data(), visible.data()); doNotOptimize(visible[0]); });
+    const Bvh<T> bvh(sa, v1s, v2s);
+    std::vector<Ray<T>> rays(kCount);
+    for (std::size_t i = 0; i < kCount; i++)
+      rays[i] = Ray<T>{Vec3<T>{0, 0, -5}, Vec3<T>(in.v3a[i] - Vec3<T>{0, 0, -5})};
+    b.run("Bvh.build", type, batch, [&]() { Bvh<T> built(sa, v1s, v2s); doNotOptimize(built.nodeCount()); });
+    Bvh<T> refitted = bvh;
+    b.run("Bvh.refit", type, batch, [&]() { refitted.refit(sa, v1s, v2s); doNotOptimize(refitted.nodeCount()); });
+    b.run("Bvh.closestHit", type, single, [&]() { map(rays, outB, [&](const Ray<T>& r, std::size_t) { TriangleHit<T> h; return static_cast<unsigned char>(bvh.closestHit(r, h) & 1); }); });
+    b.run("Bvh.anyHit", type, single, [&]() { map(rays, outB, [&](const Ray<T>& r, std::size_t) { return static_cast<unsigned char>(bvh.anyHit(r)); }); });
+
+    /* Factories */
+    b.run("makeRotation2D", type, single, [&]() { map(in.s, outM2, [&](T s, std::size_t) { return makeRotation2D(s); }); });
+    b.run("makeRotation3D.yawPitchRoll", type, single, [&]() { map(in.v3a, outM3, [&](const Vec3<T>& v, std::size_t) { return makeRotation3D(v.x, v.y, v.z); }); });
+    b.run("makeRotation3D.yawPitchRoll.fast", type, single, [&]() { map(in.v3a, outM3, [&](const Vec3<T>& v, std::size_t) { return makeRotation3D<T, Precision::Fast>(v.x, v.y, v.z); }); });
+    b.run("makeRotation3D.axisAngle", type, single, [&]() { map(in.s, outM3, [&](T s, std::size_t) { return makeRotation3D(axis, s); }); });
+    b.run("makeRotation3DX", type, single, [&]() { map(in.s, outM3, [&](T s, std::size_t) { return makeRotation3DX(s); }); });
+    b.run("makeRotation3DY", type, single, [&]() { map(in.s, outM3, [&](T s, std::size_t) { return makeRotation3DY(s); }); });
+    b.run("makeRotation3DZ", type, single, [&]() { map(in.s, outM3, [&](T s, std::size_t) { return makeRotation3DZ(s); }); });
+    b.run("makeRotation4D.yawPitchRoll", type, single, [&]() { map(in.v3a, outM4, [&](const Vec3<T>& v, std::size_t) { return makeRotation4D(v.x, v.y, v.z); }); });
+    b.run("makeRotation4D.axisAngle", type, single, [&]() { map(in.s, outM4, [&](T s, std::size_t) { return makeRotation4D(axis, s); }); });
+    b.run("makeRotation4DX", type, single, [&]() { map(in.s, outM4, [&](T s, std::size_t) { return makeRotation4DX(s); }); });
+    b.run("makeScale2D", type, single, [&]() { map(in.v2a, outM2, [&](const Vec2<T>& v, std::size_t) { return makeScale2D(v); }); });
+    b.run("makeScale3D", type, single, [&]() { map(in.v3a, outM3, [&](const Vec3<T>& v, std::size_t) { return makeScale3D(v); }); });
+    b.run("makeScale4D", type, single, [&]() { map(in.v3a, outM4, [&](const Vec3<T>& v, std::size_t) { return makeScale4D(v); }); });
+    b.run("makeTranslation", type, single, [&]() { map(in.v3a, outM4, [&](const Vec3<T>& v, std::size_t) { return makeTranslation(v); }); });
+    b.run("makeLookAt", type, single, [&]() { map(in.v3a, outM4, [&](const Vec3<T>& v, std::size_t i) { return makeLookAt(v, in.v3b[i], Vec3<T>{0, 1, 0}); }); });
+    b.run("makeInverseZ", type, single, [&]() { map(in.s, outM4, [&](T, std::size_t) { return makeInverseZ<T>(); }); });
+    b.run("makeFrustum", type, single, [&]() { map(in.s, outM4, [&](T s, std::size_t) { return makeFrustum<T>(T(0.1), T(100), -1 - s, 1 + s, 1, -1); }); });
+    b.run("makeOrthographic", type, single, [&]() { map(in.s, outM4, [&](T s, std::size_t) { return makeOrthographic<T>(T(0.1), T(100), -1 - s, 1 + s, 1, -1); }); });
+    b.run("makePerspective", type, single, [&]() { map(in.s, outM4, [&](T s, std::size_t) { return makePerspective<T>(T(1) + s * T(0.1), T(1.5), T(0.1), T(100)); }); });
+    b.run("makePerspective.fast", type, single, [&]() { map(in.s, outM4, [&](T s, std::size_t) { return makePerspective<T, NdcDepth::ZeroToOne, Precision::Fast>(T(1) + s * T(0.1), T(1.5), T(0.1), T(100)); }); });
+    b.run("makeQuat.axisAngle", type, single, [&]() { map(in.s, outQ, [&](T s, std::size_t) { return makeQuat(axis, s); }); });
+    b.run("makeQuat.matrix", type, single, [&]() { map(in.m4a, outQ, [&](const Mat4<T>& a, std::size_t) { return makeQuat(a); }); });
+  }
+}
+
+#if defined(NEON_PARALLEL)
+  // Serial against ThreadPool over spans too large for one cache, the case the parallel overloads are for.
+  template <typename T>
+  void benchParallel(Bench& b, const char* type, ThreadPool& pool)
+  {
+    const std::size_t count = std::size_t(1) << 20;
+    const std::size_t matrices = std::size_t(1) << 16;
+    Random random(54321);
+    std::vector<Vec3<T>> points(count);
+    std::vector<Vec3<T>> outV3(count);
+    for (Vec3<T>& p : points)
+      p = Vec3<T>{random.next<T>(), random.next<T>(), random.next<T>() + 2};
+    const Vec3Stream<T> stream(points.data(), count);
+    Vec3Stream<T> outStream(count);
+    std::vector<Mat4<T>> ma(matrices);
+    std::vector<Mat4<T>> mb(matrices);
+    std::vector<Mat4<T>> outM4(matrices);
+    for (std::size_t i = 0; i < matrices; i++)
+    {
+      ma[i] = makeTranslation(points[i]) * makeRotation4D(normalize(points[i + 1]), random.next<T>()) * Mat4<T>(2);
+      mb[i] = Mat4<T>(8) + Mat4<T>{Vec4<T>{points[i + 2], 1}, Vec4<T>{points[i + 3], 0}, Vec4<T>{points[i + 4], 0}, Vec4<T>{points[i + 5], 1}};
+    }
+    const Mat4<T> m = ma[0];
+    
+    const char* batch = "batch";
+    const char* parallel = "parallel";
+    
+    b.run("Mat4.transformPoint.large", type, batch, count, [&]() { transformPoints(m, points.data(), outV3.data(), count); doNotOptimize(outV3[0]); });
+    b.run("Mat4.transformPoint.large", type, parallel, count, [&]() { transformPoints(pool, m, points.data(), outV3.data(), count); doNotOptimize(outV3[0]); });
+    b.run("Vec3.normalize.large", type, batch, count, [&]() { normalize(stream, outStream); doNotOptimize(outStream.x()[0]); });
+    b.run("Vec3.normalize.large", type, parallel, count, [&]() { normalize(pool, stream, outStream); doNotOptimize(outStream.x()[0]); });
+    b.run("Mat4.inverse.large", type, batch, matrices, [&]() { inverseBatch(ma.data(), outM4.data(), matrices); doNotOptimize(outM4[0]); });
+    b.run("Mat4.inverse.large", type, parallel, matrices, [&]() { inverseBatch(pool, ma.data(), outM4.data(), matrices); doNotOptimize(outM4[0]); });
+    b.run("Mat4.mul.large", type, batch, matrices, [&]() { multiplyBatch(ma.data(), mb.data(), outM4.data(), matrices); doNotOptimize(outM4[0]); });
+    b.run("Mat4.mul.large", type, parallel, matrices, [&]() { multiplyBatch(pool, ma.data(), mb.data(), outM4.data(), matrices); doNotOptimize(outM4[0]); });
+    std::vector<Mat4<T>, AlignedAllocator<Mat4<T>, 64>> mvps(matrices);
+    b.run("Mat4.mvp.large", type, batch, matrices, [&]() { modelViewProjectionBatch(mb[0], m, ma.data(), mvps.data(), matrices); doNotOptimize(mvps[0]); });
+    b.run("Mat4.mvpNonTemporal.large", type, batch, matrices, [&]() { modelViewProjectionBatch<T, StoreMode::NonTemporal>(mb[0], m, ma.data(), mvps.data(), matrices); doNotOptimize(mvps[0]); });
+    b.run("Mat4.mvpNonTemporal.large", type, parallel, matrices, [&]() { modelViewProjectionBatch<T, StoreMode::NonTemporal>(pool, mb[0], m, ma.data(), mvps.data(), matrices); doNotOptimize(mvps[0]); });
+    const Vec3Stream<T> triV1(points.data() + 1, count - 2);
+    const Vec3Stream<T> triV2(points.data() + 2, count - 2);
+    const Vec3Stream<T> triV0(points.data(), count - 2);
+    b.run("Bvh.build.large", type, batch, count - 2, [&]() { Bvh<T> bvh(triV0, triV1, triV2); doNotOptimize(bvh.nodeCount()); });
+    b.run("Bvh.build.large", type, parallel, count - 2, [&]() { Bvh<T> bvh; bvh.build(pool, triV0, triV1, triV2); doNotOptimize(bvh.nodeCount()); });
+  }
+#endif
+
+int main(int argc, char** argv)
+{
+  std::string filter;
+  double minTimeMs = 50;
+  const char* jsonPath = nullptr;
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+      filter = argv[++i];
+    else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+      minTimeMs = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+      jsonPath = argv[++i];
+    else
+    {
+      std::fprintf(stderr, "usage: %s [--filter <substring>] [--min-time <ms>] [--json <file>]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  Bench bench(filter, minTimeMs);
+  std::printf("SIMD: %s, %u elements per call\n", Bench::simdName(), static_cast<unsigned int>(kCount));
+  benchAll<float>(bench, "float");
+  benchAll<double>(bench, "double");
+#if defined(NEON_PARALLEL)
+  ThreadPool pool;
+  std::printf("Parallel: %u threads\n", pool.size());
+  benchParallel<float>(bench, "float", pool);
+  benchParallel<double>(bench, "double", pool);
+#endif
+
+  if (jsonPath && !bench.writeJson(jsonPath))
+  {
+    std::fprintf(stderr, "could not write %s\n", jsonPath);
+    return 1;
+  }
+  return 0;
+}
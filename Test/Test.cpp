@@ -25,6 +25,11 @@
 #include "Neon.hpp"
 
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
 
 #include "utest.h"
 
@@ -33,6 +38,7 @@
 #if (defined(__GNUC__) || defined(__clang__))
   #pragma GCC diagnostic push
   #pragma GCC diagnostic ignored "-Wunused-parameter"
+  #pragma GCC diagnostic ignored "-Wconversion"
 #endif
 
 #define DEFINE_FIXTURE(FixtureName)\
@@ -608,6 +614,1710 @@ UTEST_F(VecfTest, rotate)
   ASSERT_NEARLY_EQ_V3F(result, expected);
 }
 
+UTEST_F(VecfTest, normalizeFast)
+{
+  const Vec3f v{3, -4, 12};
+  const Vec3f exact = normalize(v);
+  const Vec3f estimate = normalizeFast<float, 0>(v);
+  const Vec3f refined = normalizeFast(v);
+  ASSERT_LT(std::abs(mag(estimate) - 1), 1e-3f);
+  ASSERT_NEARLY_EQ_V3F(refined, exact);
+  ASSERT_LT(std::abs(rsqrt<double, 2>(2.0) - 1 / std::sqrt(2.0)), 1e-12);
+  
+  const Vec2f v2 = normalizeFast(Vec2f{0, -2});
+  const Vec2f expected2{0, -1};
+  ASSERT_NEARLY_EQ_V2F(v2, expected2);
+  const Vec4f v4 = normalizeFast(Vec4f{1, 1, 1, 1});
+  const Vec4f expected4{0.5f, 0.5f, 0.5f, 0.5f};
+  ASSERT_NEARLY_EQ_V4F(v4, expected4);
+  
+  // Zero length gives the fallback instead of NaN.
+  const Vec3f fallback{0, 0, 1};
+  const Vec3f safe = normalizeFast(Vec3f{0}, fallback);
+  ASSERT_EQ_V3F(safe, fallback);
+  const Vec3f safeNonZero = normalizeFast(v, fallback);
+  ASSERT_NEARLY_EQ_V3F(safeNonZero, exact);
+  
+  // Doubles outside float range: squared lengths below FLT_MIN and above FLT_MAX, and one that underflows.
+  const Vec3d unitX{1, 0, 0};
+  const Vec3d fallbackD{0, 0, 1};
+  const Vec3d tiny = normalizeFast(Vec3d{1e-25, 0, 0});
+  const Vec3d tinySafe = normalizeFast(Vec3d{1e-25, 0, 0}, fallbackD);
+  const Vec3d huge = normalizeFast(Vec3d{1e25, 0, 0});
+  const Vec3d hugeSafe = normalizeFast(Vec3d{0, 0, -1e25}, unitX);
+  const Vec3d hugeExpected{0, 0, -1};
+  const Vec3d underflow = normalizeFast(Vec3d{1e-170, 0, 0}, fallbackD);
+  ASSERT_NEARLY_EQ_V3F(tiny, unitX);
+  ASSERT_NEARLY_EQ_V3F(tinySafe, unitX);
+  ASSERT_NEARLY_EQ_V3F(huge, unitX);
+  ASSERT_NEARLY_EQ_V3F(hugeSafe, hugeExpected);
+  ASSERT_EQ_V3F(underflow, fallbackD);
+}
+
+UTEST_F(VecfTest, chainedArithmetic)
+{
+  const Vec3f a{1, 2, 3};
+  const Vec3f b{4, 5, 6};
+  const Vec3f c{0.5f, 0.25f, 2};
+#if defined(NEON_EXPR_TEMPLATES)
+  static_assert(!std::is_same<decltype(a * 2.0f + b), Vec3f>::value, "expected a lazy expression");
+#endif
+  {
+    const Vec3f result = (a * 2.0f + b - c) / 2.0f;
+    const Vec3f expected{2.75f, 4.375f, 5};
+    ASSERT_NEARLY_EQ_V3F(result, expected);
+  }
+  {
+    const Vec4f result = -Vec4f{a, 1} * Vec4f{c, 2} + 3.0f * Vec4f{b, 1};
+    const Vec4f expected{11.5f, 14.5f, 12, 1};
+    ASSERT_NEARLY_EQ_V4F(result, expected);
+  }
+  {
+    // Assigning into an operand of the chain.
+    Vec3f v = a;
+    v = v * c + v;
+    const Vec3f expected{1.5f, 2.5f, 9};
+    ASSERT_NEARLY_EQ_V3F(v, expected);
+  }
+  {
+    const Vec2f result = Vec2f{a.x, a.y} * Vec2f{b.x, b.y} - Vec2f{c.x, c.y};
+    const Vec2f expected{3.5f, 9.75f};
+    ASSERT_NEARLY_EQ_V2F(result, expected);
+  }
+}
+
+DEFINE_FIXTURE(StreamTest)
+
+// Deterministic, non-degenerate inputs; 19 elements exercise both the SIMD body and the scalar tail.
+static Vec3f streamInput3(unsigned int i, float seed)
+{
+  const float f = static_cast<float>(i) + seed;
+  return Vec3f{std::sin(f) + 1.5f, std::cos(f * 0.7f), 0.3f * f - 2.0f};
+}
+
+static Vec4f streamInput4(unsigned int i, float seed)
+{
+  return Vec4f{streamInput3(i, seed), 0.25f * static_cast<float>(i) + seed};
+}
+
+UTEST_F(StreamTest, gatherScatter)
+{
+  Vec3f aos[19];
+  for (unsigned int i = 0; i < 19; i++)
+    aos[i] = streamInput3(i, 0.1f);
+  const Vec3Stream<float> s(aos, 19);
+  ASSERT_EQ(19u, s.size());
+  ASSERT_EQ(0u, reinterpret_cast<std::size_t>(s.x()) % 32);
+  ASSERT_EQ(0u, reinterpret_cast<std::size_t>(s.z()) % 32);
+  Vec3f back[19];
+  s.scatter(back);
+  for (unsigned int i = 0; i < 19; i++)
+  {
+    ASSERT_EQ_V3F(aos[i], back[i]);
+    ASSERT_EQ_V3F(aos[i], s[i]);
+  }
+  
+  Vec4Stream<double> s4(3);
+  s4.set(2, Vec4d{1, 2, 3, 4});
+  s4.resize(40);
+  ASSERT_EQ_V4F(s4[2], Vec4d(1, 2, 3, 4));
+  ASSERT_EQ_V4F(s4[39], Vec4d(0));
+}
+
+UTEST_F(StreamTest, arithmetic)
+{
+  Vec3Stream<float> a(19);
+  Vec3Stream<float> b(19);
+  for (unsigned int i = 0; i < 19; i++)
+  {
+    a.set(i, streamInput3(i, 0.1f));
+    b.set(i, streamInput3(i, 0.9f));
+  }
+  Vec3Stream<float> c(a);
+  c += b;
+  c *= 2.0f;
+  c -= a;
+  c *= b;
+  for (unsigned int i = 0; i < 19; i++)
+  {
+    const Vec3f expected = ((a[i] + b[i]) * 2.0f - a[i]) * b[i];
+    ASSERT_NEARLY_EQ_V3F(c[i], expected);
+  }
+}
+
+UTEST_F(StreamTest, vec3Operations)
+{
+  Vec3Stream<float> a(19);
+  Vec3Stream<float> b(19);
+  for (unsigned int i = 0; i < 19; i++)
+  {
+    a.set(i, streamInput3(i, 0.1f));
+    b.set(i, normalize(streamInput3(i, 0.9f)));
+  }
+  float dots[19];
+  float mags[19];
+  float distances[19];
+  dot(a, b, dots);
+  mag(a, mags);
+  distance(a, b, distances);
+  Vec3Stream<float> crossed;
+  Vec3Stream<float> normalized;
+  Vec3Stream<float> projected;
+  Vec3Stream<float> reflected;
+  Vec3Stream<float> refracted;
+  Vec3Stream<float> rotated;
+  cross(a, b, crossed);
+  normalize(a, normalized);
+  project(a, b, projected);
+  reflect(a, b, reflected);
+  refract(normalized, b, 0.9f, refracted);
+  const Vec3f axis{0, 0, 1};
+  rotate(a, axis, 0.7f, rotated);
+  for (unsigned int i = 0; i < 19; i++)
+  {
+    ASSERT_NEARLY_EQ_F(dots[i], dot(a[i], b[i]));
+    ASSERT_NEARLY_EQ_F(mags[i], mag(a[i]));
+    ASSERT_NEARLY_EQ_F(distances[i], distance(a[i], b[i]));
+    ASSERT_NEARLY_EQ_V3F(crossed[i], cross(a[i], b[i]));
+    ASSERT_NEARLY_EQ_V3F(normalized[i], normalize(a[i]));
+    ASSERT_NEARLY_EQ_V3F(projected[i], project(a[i], b[i]));
+    ASSERT_NEARLY_EQ_V3F(reflected[i], reflect(a[i], b[i]));
+    ASSERT_NEARLY_EQ_V3F(refracted[i], refract(normalize(a[i]), b[i], 0.9f));
+    ASSERT_NEARLY_EQ_V3F(rotated[i], rotate(a[i], axis, 0.7f));
+  }
+  
+  // In place.
+  normalize(a, a);
+  for (unsigned int i = 0; i < 19; i++)
+  {
+    ASSERT_NEARLY_EQ_V3F(a[i], normalized[i]);
+  }
+}
+
+UTEST_F(StreamTest, vec4Operations)
+{
+  Vec4Stream<double> a(19);
+  Vec4Stream<double> b(19);
+  for (unsigned int i = 0; i < 19; i++)
+  {
+    const Vec4f fa = streamInput4(i, 0.1f);
+    const Vec4f fb = streamInput4(i, 0.9f);
+    a.set(i, Vec4d{fa.x, fa.y, fa.z, fa.w});
+    b.set(i, Vec4d{fb.x, fb.y, fb.z, fb.w});
+  }
+  double dots[19];
+  double mags[19];
+  dot(a, b, dots);
+  mag(a, mags);
+  Vec4Stream<double> normalized;
+  normalize(a, normalized);
+  for (unsigned int i = 0; i < 19; i++)
+  {
+    ASSERT_NEARLY_EQ_F(dots[i], dot(a[i], b[i]));
+    ASSERT_NEARLY_EQ_F(mags[i], mag(a[i]));
+    ASSERT_NEARLY_EQ_V4F(normalized[i], normalize(a[i]));
+  }
+}
+
+UTEST_F(StreamTest, normalizeFast)
+{
+  Vec3Stream<float> a(19);
+  Vec4Stream<double> b(19);
+  for (unsigned int i = 0; i < 19; i++)
+  {
+    // Every fifth vector is zero.
+    const Vec4f f = i % 5 == 0 ? Vec4f{0} : streamInput4(i, 0.1f);
+    a.set(i, Vec3f{f.x, f.y, f.z});
+    b.set(i, Vec4d{f.x, f.y, f.z, f.w});
+  }
+  const Vec3f fallback{0, 1, 0};
+  const Vec4d fallback4{1, 0, 0, 0};
+  Vec3Stream<float> fast;
+  Vec3Stream<float> safe;
+  Vec4Stream<double> safe4;
+  normalizeFast(a, fast);
+  normalizeFast(a, fallback, safe);
+  normalizeFast<double, 2>(b, fallback4, safe4);
+  for (unsigned int i = 0; i < 19; i++)
+  {
+    const Vec3f safeResult = safe[i];
+    const Vec4d safeResult4 = safe4[i];
+    if (i % 5 == 0)
+    {
+      ASSERT_EQ_V3F(safeResult, fallback);
+      ASSERT_EQ_V4F(safeResult4, fallback4);
+    }
+    else
+    {
+      const Vec3f expected = normalize(a[i]);
+      const Vec3f fastResult = fast[i];
+      const Vec4d expected4 = normalize(b[i]);
+      ASSERT_NEARLY_EQ_V3F(fastResult, expected);
+      ASSERT_NEARLY_EQ_V3F(safeResult, expected);
+      ASSERT_NEARLY_EQ_V4F(safeResult4, expected4);
+    }
+  }
+  
+  // Double lengths outside float range, mixed with ordinary ones in the same packs.
+  const double scales[] = {1e-25, 1, 1e25, 1e-170, 1e150, 1};
+  const auto inputD = [](unsigned int i)
+  {
+    const Vec3f f = streamInput3(i, 0.3f);
+    return Vec3d{f.x, f.y, f.z};
+  };
+  Vec3Stream<double> d(18);
+  for (unsigned int i = 0; i < 18; i++)
+    d.set(i, inputD(i) * scales[i % 6]);
+  const Vec3d fallbackD{0, 0, 1};
+  Vec3Stream<double> fastD;
+  Vec3Stream<double> safeD;
+  normalizeFast(d, fastD);
+  normalizeFast(d, fallbackD, safeD);
+  for (unsigned int i = 0; i < 18; i++)
+  {
+    const Vec3d safeResult = safeD[i];
+    if (i % 6 == 3)
+    {
+      ASSERT_EQ_V3F(safeResult, fallbackD);
+    }
+    else
+    {
+      const Vec3d expected = normalize(inputD(i));
+      const Vec3d fastResult = fastD[i];
+      ASSERT_NEARLY_EQ_V3F(fastResult, expected);
+      ASSERT_NEARLY_EQ_V3F(safeResult, expected);
+    }
+  }
+}
+
+DEFINE_FIXTURE(AffineTest)
+
+UTEST_F(AffineTest, conversions)
+{
+  const Mat4f m = makeTranslation(Vec3f{1, 2, 3}) * makeRotation4D(0.3f, -0.2f, 0.5f) * makeScale4D(Vec3f{2, 3, 4});
+  const Affinef a{m};
+  const Mat4f back{a};
+  ASSERT_EQ_M4F(m, back);
+  ASSERT_EQ_V3F(a.translation(), Vec3f(1, 2, 3));
+  const Mat3f linear = a.linear();
+  ASSERT_EQ(m(1, 2), linear(1, 2));
+  ASSERT_EQ(m(2, 3), a(2, 3));
+}
+
+UTEST_F(AffineTest, multiply)
+{
+  const Mat4f m1 = makeTranslation(Vec3f{1, 2, 3}) * makeRotation4D(0.3f, -0.2f, 0.5f) * makeScale4D(Vec3f{2, 3, 4});
+  const Mat4f m2 = makeTranslation(Vec3f{-4, 0.5f, 2}) * makeRotation4D(Vec3f{0, 0, 1}, 1.2f);
+  const Affinef a1{m1};
+  const Affinef a2{m2};
+  const Mat4f expected = m1 * m2;
+  const Mat4f result{a1 * a2};
+  ASSERT_NEARLY_EQ_M4F(result, expected);
+  
+  Affinef a3 = a1;
+  a3 = a3 * a3;
+  const Mat4f expectedSquare = m1 * m1;
+  ASSERT_NEARLY_EQ_M4F(Mat4f{a3}, expectedSquare);
+  
+  const Vec3f p{0.5f, -1, 2};
+  const Vec4f expectedPoint = m1 * Vec4f{p, 1};
+  const Vec4f expectedVector = m1 * Vec4f{p, 0};
+  const Vec3f point = transformPoint(a1, p);
+  const Vec3f vector = transformVector(a1, p);
+  const Vec4f point4 = a1 * Vec4f{p, 1};
+  ASSERT_NEARLY_EQ_V3F(point, expectedPoint);
+  ASSERT_NEARLY_EQ_V3F(vector, expectedVector);
+  ASSERT_NEARLY_EQ_V4F(point4, expectedPoint);
+}
+
+UTEST_F(AffineTest, inverse)
+{
+  const Mat4f m = makeTranslation(Vec3f{1, 2, 3}) * makeRotation4D(0.3f, -0.2f, 0.5f) * makeScale4D(Vec3f{2, 3, 4});
+  const Affinef a{m};
+  const Mat4f expected = inverse(m);
+  ASSERT_NEARLY_EQ_M4F(Mat4f{inverse(a)}, expected);
+  ASSERT_NEARLY_EQ_F(determinant(a), determinant(m));
+  
+  const Affinef rigid{makeRotation3D(0.3f, -0.2f, 0.5f), Vec3f{1, 2, 3}};
+  const Mat4f expectedRigid = inverse(Mat4f{rigid});
+  ASSERT_NEARLY_EQ_M4F(Mat4f{inverseRigid(rigid)}, expectedRigid);
+  ASSERT_NEARLY_EQ_M4F(Mat4f{rigid * inverseRigid(rigid)}, Mat4f{1});
+}
+
+UTEST_F(AffineTest, hierarchy)
+{
+  const Affinef rootLocal{makeTranslation(Vec3f{1, 0, 0}) * makeRotation4DY(0.5f)};
+  const Affinef childLocal{makeTranslation(Vec3f{0, 2, 0}) * makeScale4D(Vec3f{2, 2, 2})};
+  const Affinef leafLocal{makeRotation4DZ(-0.25f)};
+  TransformHierarchyf h(true);
+  const std::size_t root = h.add(rootLocal);
+  const std::size_t child = h.add(childLocal, root);
+  const std::size_t leaf = h.add(leafLocal, child);
+  const std::size_t other = h.add(Affinef{makeTranslation(Vec3f{0, 0, 5})});
+  ASSERT_EQ(h.size(), 4u);
+  ASSERT_EQ(h.parent(leaf), child);
+  ASSERT_EQ(h.parent(other), TransformHierarchyf::kNoParent);
+  h.update();
+  
+  ASSERT_NEARLY_EQ_M4F(Mat4f{h.world(leaf)}, Mat4f{rootLocal * childLocal * leafLocal});
+  ASSERT_NEARLY_EQ_M4F(Mat4f{h.world(leaf) * h.worldInverse(leaf)}, Mat4f(1));
+  for (std::size_t i = 0; i < h.size(); i++)
+    ASSERT_FALSE(h.isDirty(i));
+  
+  // Moving the child updates its subtree and leaves the rest alone.
+  const Affinef rootWorld = h.world(root);
+  const Affinef otherWorld = h.world(other);
+  const Affinef movedChild{makeTranslation(Vec3f{0, -1, 3})};
+  h.setLocal(child, movedChild);
+  ASSERT_TRUE(h.isDirty(child));
+  ASSERT_FALSE(h.isDirty(leaf));
+  h.update();
+  ASSERT_EQ_M4F(Mat4f{h.world(root)}, Mat4f{rootWorld});
+  ASSERT_EQ_M4F(Mat4f{h.world(other)}, Mat4f{otherWorld});
+  ASSERT_NEARLY_EQ_M4F(Mat4f{h.world(child)}, Mat4f{rootLocal * movedChild});
+  ASSERT_NEARLY_EQ_M4F(Mat4f{h.world(leaf)}, Mat4f{rootLocal * movedChild * leafLocal});
+  ASSERT_NEARLY_EQ_M4F(Mat4f{h.worldInverse(leaf) * h.world(leaf)}, Mat4f(1));
+}
+
+DEFINE_FIXTURE(QuatTest)
+
+UTEST_F(QuatTest, makers)
+{
+  const Mat3f expectedYpr = makeRotation3D(0.3f, -1.2f, 2.5f);
+  const Mat3f ypr = makeRotation3D(makeQuat(0.3f, -1.2f, 2.5f));
+  ASSERT_NEARLY_EQ_M3F(ypr, expectedYpr);
+  
+  const Vec3f axis = normalize(Vec3f{1, -2, 0.5f});
+  const Mat3f expectedAxisAngle = makeRotation3D(axis, 0.8f);
+  const Mat3f axisAngle = makeRotation3D(makeQuat(axis, 0.8f));
+  ASSERT_NEARLY_EQ_M3F(axisAngle, expectedAxisAngle);
+  
+  const Mat4f expected4 = makeRotation4D(axis, 0.8f);
+  const Mat4f result4 = makeRotation4D(makeQuat(axis, 0.8f));
+  ASSERT_NEARLY_EQ_M4F(result4, expected4);
+}
+
+UTEST_F(QuatTest, fromMatrix)
+{
+  // Angles near pi exercise each branch of the conversion.
+  const Vec3f axes[4] = {Vec3f{0, 0, 1}, Vec3f{1, 0, 0}, Vec3f{0, 1, 0}, normalize(Vec3f{1, 1, -1})};
+  const float angles[3] = {0.4f, 3.0f, -2.9f};
+  for (unsigned int i = 0; i < 4; i++)
+  {
+    for (unsigned int j = 0; j < 3; j++)
+    {
+      const Mat3f m = makeRotation3D(axes[i], angles[j]);
+      const Mat3f result = makeRotation3D(makeQuat(m));
+      ASSERT_NEARLY_EQ_M3F(result, m);
+      const Mat3f result4 = makeRotation3D(makeQuat(Mat4f{m}));
+      ASSERT_NEARLY_EQ_M3F(result4, m);
+    }
+  }
+}
+
+UTEST_F(QuatTest, composeAndRotate)
+{
+  const Quatf q1 = makeQuat(0.3f, -1.2f, 2.5f);
+  const Quatf q2 = makeQuat(normalize(Vec3f{1, -2, 0.5f}), 0.8f);
+  const Mat3f expected = makeRotation3D(q1) * makeRotation3D(q2);
+  const Mat3f result = makeRotation3D(q1 * q2);
+  ASSERT_NEARLY_EQ_M3F(result, expected);
+  
+  const Vec3f v{0.5f, 2, -1};
+  const Vec3f expectedV = makeRotation3D(q1) * v;
+  const Vec3f rotated = rotate(q1, v);
+  const Vec3f rotatedOp = q1 * v;
+  ASSERT_NEARLY_EQ_V3F(rotated, expectedV);
+  ASSERT_NEARLY_EQ_V3F(rotatedOp, expectedV);
+  
+  const Quatf identity = q1 * inverse(q1);
+  ASSERT_NEARLY_EQ_F(identity.w, 1.0f);
+  ASSERT_NEARLY_EQ_V3F(identity.vec(), Vec3f(0));
+}
+
+UTEST_F(QuatTest, interpolation)
+{
+  const Vec3f axis{0, 1, 0};
+  const Quatf q1 = makeQuat(axis, 0.2f);
+  const Quatf q2 = makeQuat(axis, 1.4f);
+  const Quatf half = slerp(q1, q2, 0.5f);
+  const Quatf expected = makeQuat(axis, 0.8f);
+  ASSERT_NEARLY_EQ_V4F(half, expected);
+  const Quatf start = slerp(q1, q2, 0.0f);
+  const Quatf end = slerp(q1, q2, 1.0f);
+  ASSERT_NEARLY_EQ_V4F(start, q1);
+  ASSERT_NEARLY_EQ_V4F(end, q2);
+  
+  // Both take the shorter arc when the inputs are in opposite hemispheres.
+  const Quatf slerpFlipped = slerp(q1, -q2, 0.5f);
+  const Quatf nlerpFlipped = nlerp(q1, -q2, 0.5f);
+  ASSERT_NEARLY_EQ_F(std::abs(dot(slerpFlipped, expected)), 1.0f);
+  ASSERT_NEARLY_EQ_F(std::abs(dot(nlerpFlipped, expected)), 1.0f);
+  ASSERT_NEARLY_EQ_F(mag(nlerp(q1, q2, 0.3f)), 1.0f);
+}
+
+UTEST_F(QuatTest, dualQuat)
+{
+  const Quatf q1 = makeQuat(0.3f, -1.2f, 2.5f);
+  const Quatf q2 = makeQuat(normalize(Vec3f{1, -2, 0.5f}), 0.8f);
+  const Vec3f t1{1, -0.5f, 2};
+  const Vec3f t2{-0.25f, 0.75f, 0.5f};
+  const DualQuatf a = makeDualQuat(q1, t1);
+  const DualQuatf b = makeDualQuat(q2, t2);
+  const Mat4f ma = makeTranslation(t1) * makeRotation4D(q1);
+  const Mat4f mb = makeTranslation(t2) * makeRotation4D(q2);
+  const Mat4f toMatrix = makeTransform4D(a);
+  ASSERT_NEARLY_EQ_M4F(toMatrix, ma);
+  const Vec3f ta = translation(a);
+  ASSERT_NEARLY_EQ_V3F(ta, t1);
+  const DualQuatf fromMatrix = makeDualQuat(ma);
+  ASSERT_NEARLY_EQ_V4F(fromMatrix.real, a.real);
+  ASSERT_NEARLY_EQ_V4F(fromMatrix.dual, a.dual);
+  
+  // Composition matches the matrix product, including the order.
+  const Mat4f composed = makeTransform4D(a * b);
+  const Mat4f expected = ma * mb;
+  ASSERT_NEARLY_EQ_M4F(composed, expected);
+  
+  const Vec3f p{0.5f, 2, -1};
+  const Vec3f expectedP{ma * Vec4f{p, 1}};
+  const Vec3f expectedV{ma * Vec4f{p, 0}};
+  const Vec3f resultP = transformPoint(a, p);
+  const Vec3f resultV = transformVector(a, p);
+  ASSERT_NEARLY_EQ_V3F(resultP, expectedP);
+  ASSERT_NEARLY_EQ_V3F(resultV, expectedV);
+  
+  const DualQuatf identity = inverse(a) * a;
+  ASSERT_NEARLY_EQ_V4F(identity.real, Quatf());
+  ASSERT_NEARLY_EQ_V4F(identity.dual, Quatf(0, 0, 0, 0));
+  const DualQuatf unitInverse = conjugate(a);
+  const DualQuatf generalInverse = inverse(a);
+  ASSERT_NEARLY_EQ_V4F(unitInverse.real, generalInverse.real);
+  ASSERT_NEARLY_EQ_V4F(unitInverse.dual, generalInverse.dual);
+  const DualQuatf renormalized = normalize(a * 3.0f);
+  ASSERT_NEARLY_EQ_V4F(renormalized.real, a.real);
+  ASSERT_NEARLY_EQ_V4F(renormalized.dual, a.dual);
+  
+  // Blending takes the shorter path even when a bone is stored with the opposite sign.
+  const DualQuatf bones[2] = {a, -makeDualQuat(makeQuat(Vec3f{0, 0, 1}, 0.4f) * q1, t1)};
+  const float weights[2] = {0.5f, 0.5f};
+  const DualQuatf half = blend(bones, weights, 2);
+  const DualQuatf expectedHalf = makeDualQuat(makeQuat(Vec3f{0, 0, 1}, 0.2f) * q1, t1);
+  ASSERT_NEARLY_EQ_V4F(half.real, expectedHalf.real);
+  ASSERT_NEARLY_EQ_V4F(half.dual, expectedHalf.dual);
+}
+
+UTEST_F(QuatTest, skinning)
+{
+  DualQuatf bones[5];
+  for (unsigned int b = 0; b < 5; b++)
+  {
+    const float f = static_cast<float>(b);
+    bones[b] = makeDualQuat(makeQuat(normalize(Vec3f{1, f, -0.5f}), 0.7f * f - 1), Vec3f{0.2f * f, -0.1f * f, 0.3f});
+  }
+  bones[3] = -bones[3];
+  
+  const unsigned int count = 19;
+  Vec3Stream<float> positions(count);
+  Vec3Stream<float> normals(count);
+  Vec4Stream<float> weights(count);
+  std::uint32_t indices[4 * count];
+  for (unsigned int i = 0; i < count; i++)
+  {
+    positions.set(i, streamInput3(i, 0.2f) * 0.5f);
+    normals.set(i, normalize(streamInput3(i, 1.1f)));
+    const Vec4f w{1, static_cast<float>(i % 3), 0.5f, static_cast<float>(i % 2)};
+    weights.set(i, w / (w.x + w.y + w.z + w.w));
+    for (unsigned int k = 0; k < 4; k++)
+      indices[4 * i + k] = (i + 2 * k) % 5;
+  }
+  Vec3Stream<float> outPositions;
+  Vec3Stream<float> outNormals;
+  Vec3Stream<float> positionsOnly;
+  skin(bones, positions, normals, weights, indices, outPositions, outNormals);
+  skin(bones, positions, weights, indices, positionsOnly);
+  ASSERT_EQ(count, outPositions.size());
+  for (unsigned int i = 0; i < count; i++)
+  {
+    const DualQuatf vertexBones[4] = {bones[indices[4 * i]], bones[indices[4 * i + 1]], bones[indices[4 * i + 2]], bones[indices[4 * i + 3]]};
+    const Vec4f w = weights[i];
+    const float vertexWeights[4] = {w.x, w.y, w.z, w.w};
+    const DualQuatf dq = blend(vertexBones, vertexWeights, 4);
+    const Vec3f expectedP = transformPoint(dq, positions[i]);
+    const Vec3f expectedN = transformVector(dq, normals[i]);
+    ASSERT_NEARLY_EQ_V3F(outPositions[i], expectedP);
+    ASSERT_NEARLY_EQ_V3F(outNormals[i], expectedN);
+    ASSERT_NEARLY_EQ_V3F(positionsOnly[i], expectedP);
+  }
+}
+
+DEFINE_FIXTURE(AnimationTest)
+
+UTEST_F(AnimationTest, trs)
+{
+  const Vec3f v = lerp(Vec3f{1, 2, 3}, Vec3f{3, 0, 4}, 0.25f);
+  ASSERT_EQ_V3F(v, Vec3f(1.5f, 1.5f, 3.25f));
+  const Vec2f v2 = lerp(Vec2f{1, 2}, Vec2f{3, 0}, 0.5f);
+  ASSERT_EQ_V2F(v2, Vec2f(2, 1));
+  const Vec4f v4 = lerp(Vec4f{0, 0, 0, 1}, Vec4f{4, 0, 8, 1}, 0.75f);
+  ASSERT_EQ_V4F(v4, Vec4f(3, 0, 6, 1));
+  
+  // Decomposition round trips, a reflection included.
+  const Trsf a{Vec3f{1, -2, 0.5f}, makeQuat(normalize(Vec3f{1, 2, -1}), 0.6f), Vec3f{2, 0.5f, 1.5f}};
+  const Trsf b{Vec3f{-1, 0, 3}, makeQuat(normalize(Vec3f{0, 1, 1}), 2.1f), Vec3f{-1, 1, 0.25f}};
+  const Mat4f ma = makeTransform4D(a);
+  const Mat4f mb = makeTransform4D(b);
+  const Mat4f expectedA = makeTranslation(a.translation) * makeRotation4D(a.rotation) * makeScale4D(a.scale);
+  ASSERT_NEARLY_EQ_M4F(ma, expectedA);
+  const Mat4f roundTrip = makeTransform4D(decompose(ma));
+  ASSERT_NEARLY_EQ_M4F(roundTrip, ma);
+  const Mat4f reflected = makeTransform4D(decompose(mb));
+  ASSERT_NEARLY_EQ_M4F(reflected, mb);
+  
+  const Mat4f start = interpolate(ma, mb, 0.0f);
+  const Mat4f end = interpolate(ma, mb, 1.0f);
+  ASSERT_NEARLY_EQ_M4F(start, ma);
+  ASSERT_NEARLY_EQ_M4F(end, mb);
+  
+  // Halfway the rotation stays rigid: the scale comes out of the columns exactly.
+  const Trsf half = lerp(a, Trsf{b.translation, b.rotation, a.scale}, 0.5f);
+  const Trsf halfFast = lerp<float, Precision::Fast>(a, Trsf{b.translation, b.rotation, a.scale}, 0.5f);
+  const Mat4f halfMatrix = interpolate(ma, makeTransform4D(Trsf{b.translation, b.rotation, a.scale}), 0.5f);
+  ASSERT_NEARLY_EQ_V4F(half.rotation, slerp(a.rotation, b.rotation, 0.5f));
+  ASSERT_NEARLY_EQ_V4F(halfFast.rotation, nlerp(a.rotation, b.rotation, 0.5f));
+  ASSERT_NEARLY_EQ_V3F(half.translation, Vec3f(0, -1, 1.75f));
+  ASSERT_NEARLY_EQ_F(mag(Vec3f{halfMatrix.d[0][0], halfMatrix.d[0][1], halfMatrix.d[0][2]}), 2.0f);
+  ASSERT_NEARLY_EQ_F(mag(Vec3f{halfMatrix.d[1][0], halfMatrix.d[1][1], halfMatrix.d[1][2]}), 0.5f);
+}
+
+namespace
+{
+  // Linear search and scalar interpolation, to check the sampler against.
+  template <typename V, typename Blend>
+  V sampleReference(const KeyframeTracks<V>& tracks, std::size_t k, float time, Blend blend)
+  {
+    const std::size_t count = tracks.keyCount(k);
+    if (count == 1 || time <= tracks.time(k, 0))
+      return tracks.value(k, 0);
+    if (time >= tracks.time(k, count - 1))
+      return tracks.value(k, count - 1);
+    std::size_t key = 0;
+    while (tracks.time(k, key + 1) <= time)
+      key++;
+    const float t = (time - tracks.time(k, key)) / (tracks.time(k, key + 1) - tracks.time(k, key));
+    return blend(tracks.value(k, key), tracks.value(k, key + 1), t);
+  }
+}
+
+UTEST_F(AnimationTest, sampler)
+{
+  // Tracks with 1 to 6 keys at uneven times, more tracks than a pack is wide.
+  const unsigned int trackCount = 11;
+  KeyframeTracks<Vec3f> translations;
+  KeyframeTracks<Quatf> rotations;
+  KeyframeTracks<float> weights;
+  translations.reserve(trackCount, 64);
+  for (unsigned int k = 0; k < trackCount; k++)
+  {
+    const unsigned int count = 1 + k % 6;
+    float times[6];
+    Vec3f positions[6];
+    Quatf quats[6];
+    float scalars[6];
+    for (unsigned int j = 0; j < count; j++)
+    {
+      const float f = static_cast<float>(j + k);
+      times[j] = 0.1f * static_cast<float>(k % 3) + 0.5f * static_cast<float>(j) + 0.05f * static_cast<float>(j * j);
+      positions[j] = streamInput3(j + 3 * k, 0.4f);
+      // Every other key flips sign, so the shorter arc matters.
+      quats[j] = makeQuat(normalize(Vec3f{1, f, -0.5f}), 0.3f * f) * (j % 2 ? -1.0f : 1.0f);
+      scalars[j] = std::sin(f);
+    }
+    ASSERT_EQ(k, translations.add(times, positions, count));
+    rotations.add(times, quats, count);
+    weights.add(times, scalars, count);
+  }
+  ASSERT_EQ(trackCount, translations.size());
+  
+  KeyframeSampler<Vec3f> translationSampler(translations);
+  KeyframeSampler<Quatf> rotationSampler(rotations);
+  KeyframeSampler<Quatf> fastSampler(rotations);
+  KeyframeSampler<float> weightSampler(weights);
+  Vec3f outTranslations[trackCount];
+  Quatf outRotations[trackCount];
+  Quatf outFast[trackCount];
+  float outWeights[trackCount];
+  // Forward playback in small and large steps, out of range on both ends and a jump back.
+  const float times[] = {-1, 0, 0.05f, 0.1f, 0.33f, 0.5f, 0.6f, 1.2f, 1.25f, 3.5f, 4.5f, 0.7f, 0.2f, 2.0f};
+  for (float time : times)
+  {
+    translationSampler.sample(time, outTranslations);
+    rotationSampler.sample(time, outRotations);
+    fastSampler.sample<Precision::Fast>(time, outFast);
+    weightSampler.sample(time, outWeights);
+    for (unsigned int k = 0; k < trackCount; k++)
+    {
+      const Vec3f expectedT = sampleReference(translations, k, time, [](const Vec3f& a, const Vec3f& b, float t) { return lerp(a, b, t); });
+      const Quatf expectedR = sampleReference(rotations, k, time, [](const Quatf& a, const Quatf& b, float t) { return slerp(a, b, t); });
+      const Quatf expectedF = sampleReference(rotations, k, time, [](const Quatf& a, const Quatf& b, float t) { return nlerp(a, b, t); });
+      const float expectedW = sampleReference(weights, k, time, [](float a, float b, float t) { return a + (b - a) * t; });
+      ASSERT_NEARLY_EQ_V3F(outTranslations[k], expectedT);
+      // Past the last key the shorter arc may end on the negated key, the same rotation.
+      ASSERT_NEARLY_EQ_F(std::abs(dot(outRotations[k], expectedR)), 1.0f);
+      ASSERT_NEARLY_EQ_F(std::abs(dot(outFast[k], expectedF)), 1.0f);
+      ASSERT_NEARLY_EQ_F(outWeights[k], expectedW);
+    }
+  }
+}
+
+DEFINE_FIXTURE(BatchTransformTest)
+
+static Mat4f batchTestMatrix()
+{
+  return Mat4f{0.8f, -0.6f, 0.0f, 3.0f,
+               0.6f, 0.8f,  0.0f, -2.0f,
+               0.0f, 0.0f,  2.0f, 0.5f,
+               0.1f, 0.0f,  0.2f, 1.0f};
+}
+
+UTEST_F(BatchTransformTest, points)
+{
+  const Mat4f m = batchTestMatrix();
+  Vec3f src[11];
+  for (unsigned int i = 0; i < 11; i++)
+    src[i] = streamInput3(i, 0.3f);
+  Vec3f points[11];
+  Vec3f vectors[11];
+  Vec3f projected[11];
+  transformPoints(m, src, points, 11);
+  transformVectors(m, src, vectors, 11);
+  transformPointsProjective(m, src, projected, 11);
+  for (unsigned int i = 0; i < 11; i++)
+  {
+    const Vec4f p = m * Vec4f{src[i], 1};
+    const Vec3f expectedPoint{p};
+    const Vec3f expectedVector{m * Vec4f{src[i], 0}};
+    const Vec3f expectedProjected = expectedPoint / p.w;
+    ASSERT_NEARLY_EQ_V3F(points[i], expectedPoint);
+    ASSERT_NEARLY_EQ_V3F(vectors[i], expectedVector);
+    ASSERT_NEARLY_EQ_V3F(projected[i], expectedProjected);
+  }
+  
+  transformPoints(m, src, 11);
+  for (unsigned int i = 0; i < 11; i++)
+  {
+    ASSERT_NEARLY_EQ_V3F(src[i], points[i]);
+  }
+}
+
+UTEST_F(BatchTransformTest, pointsDouble)
+{
+  const Mat4d m{2, 0, 0, 1,
+                0, 3, 0, 2,
+                0, 0, 4, 3,
+                0, 0, 0, 1};
+  Vec3d points[5];
+  for (unsigned int i = 0; i < 5; i++)
+    points[i] = Vec3d{static_cast<double>(i), 1, -1};
+  transformPoints(m, points, 5);
+  for (unsigned int i = 0; i < 5; i++)
+  {
+    const Vec3d expected{2.0 * i + 1, 5, -1};
+    ASSERT_EQ_V3F(points[i], expected);
+  }
+}
+
+UTEST_F(BatchTransformTest, vec4)
+{
+  const Mat4f m = batchTestMatrix();
+  Vec4f v[7];
+  Vec4f expected[7];
+  for (unsigned int i = 0; i < 7; i++)
+  {
+    v[i] = streamInput4(i, 0.2f);
+    expected[i] = m * v[i];
+  }
+  transform(m, v, 7);
+  for (unsigned int i = 0; i < 7; i++)
+  {
+    ASSERT_NEARLY_EQ_V4F(v[i], expected[i]);
+  }
+}
+
+UTEST_F(BatchTransformTest, streams)
+{
+  const Mat4f m = batchTestMatrix();
+  Vec3Stream<float> src(19);
+  Vec4Stream<float> src4(19);
+  for (unsigned int i = 0; i < 19; i++)
+  {
+    src.set(i, streamInput3(i, 0.5f));
+    src4.set(i, streamInput4(i, 0.5f));
+  }
+  Vec3Stream<float> points;
+  Vec3Stream<float> vectors;
+  Vec3Stream<float> projected;
+  Vec4Stream<float> transformed;
+  transformPoints(m, src, points);
+  transformVectors(m, src, vectors);
+  transformPointsProjective(m, src, projected);
+  transform(m, src4, transformed);
+  for (unsigned int i = 0; i < 19; i++)
+  {
+    const Vec4f p = m * Vec4f{src[i], 1};
+    const Vec3f expectedPoint{p};
+    const Vec3f expectedVector{m * Vec4f{src[i], 0}};
+    const Vec3f expectedProjected = expectedPoint / p.w;
+    ASSERT_NEARLY_EQ_V3F(points[i], expectedPoint);
+    ASSERT_NEARLY_EQ_V3F(vectors[i], expectedVector);
+    ASSERT_NEARLY_EQ_V3F(projected[i], expectedProjected);
+    const Vec4f expectedTransformed = m * src4[i];
+    ASSERT_NEARLY_EQ_V4F(transformed[i], expectedTransformed);
+  }
+}
+
+#if defined(NEON_PARALLEL)
+// Counts run() calls and forwards them to a SerialExecutor.
+struct CountingExecutor : Executor
+{
+  void run(std::size_t count, const std::function<void(std::size_t)>& task) override
+  {
+    calls++;
+    tasks += count;
+    SerialExecutor().run(count, task);
+  }
+  
+  unsigned int calls = 0;
+  std::size_t tasks = 0;
+};
+
+UTEST_F(BatchTransformTest, parallel)
+{
+  ThreadPool pool(4);
+  ASSERT_EQ(4u, pool.size());
+  const Mat4f m = batchTestMatrix();
+  
+  const unsigned int count = 20011;
+  std::vector<Vec3f> src(count);
+  for (unsigned int i = 0; i < count; i++)
+    src[i] = streamInput3(i, 0.7f);
+  std::vector<Vec3f> serial(count);
+  std::vector<Vec3f> parallel(count);
+  transformPoints(m, src.data(), serial.data(), count);
+  transformPoints(pool, m, src.data(), parallel.data(), count);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    ASSERT_EQ_V3F(parallel[i], serial[i]);
+  }
+  transformPointsProjective(m, src.data(), serial.data(), count);
+  transformPointsProjective(pool, m, src.data(), parallel.data(), count);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    ASSERT_EQ_V3F(parallel[i], serial[i]);
+  }
+  
+  const Vec3Stream<float> stream(src.data(), count);
+  Vec3Stream<float> serialStream;
+  Vec3Stream<float> parallelStream;
+  normalize(stream, serialStream);
+  normalize(pool, stream, parallelStream);
+  ASSERT_EQ(serialStream.size(), parallelStream.size());
+  for (unsigned int i = 0; i < count; i++)
+  {
+    ASSERT_EQ_V3F(parallelStream[i], serialStream[i]);
+  }
+  
+  const unsigned int matrices = 1001;
+  std::vector<Mat4f> a(matrices);
+  std::vector<Mat4f> b(matrices);
+  for (unsigned int i = 0; i < matrices; i++)
+  {
+    const float f = static_cast<float>(i);
+    a[i] = makeRotation4D(0.01f * f, 0.2f, -0.03f * f) * Mat4f{1 + 0.001f * f};
+    a[i].d[3][0] = f;
+    b[i] = makeTranslation(streamInput3(i, 0.1f));
+  }
+  a[300] = Mat4f{0};
+  std::vector<Mat4f> serialM(matrices);
+  std::vector<Mat4f> parallelM(matrices);
+  bool serialSingular[matrices];
+  bool parallelSingular[matrices];
+  inverseBatch(a.data(), serialM.data(), matrices, serialSingular);
+  inverseBatch(pool, a.data(), parallelM.data(), matrices, parallelSingular);
+  for (unsigned int i = 0; i < matrices; i++)
+  {
+    ASSERT_EQ_M4F(parallelM[i], serialM[i]);
+    ASSERT_EQ(serialSingular[i], parallelSingular[i]);
+  }
+  ASSERT_TRUE(parallelSingular[300]);
+  multiplyBatch(a.data(), b.data(), serialM.data(), matrices);
+  multiplyBatch(pool, a.data(), b.data(), parallelM.data(), matrices);
+  for (unsigned int i = 0; i < matrices; i++)
+  {
+    const Mat4f expected = a[i] * b[i];
+    ASSERT_EQ_M4F(serialM[i], expected);
+    ASSERT_EQ_M4F(parallelM[i], serialM[i]);
+  }
+  
+  // Small spans skip the executor; larger ones reach it in chunks.
+  CountingExecutor counting;
+  transformPoints(counting, m, src.data(), parallel.data(), 100);
+  ASSERT_EQ(0u, counting.calls);
+  std::vector<float> determinants(matrices);
+  determinantBatch(counting, a.data(), determinants.data(), matrices);
+  ASSERT_EQ(1u, counting.calls);
+  ASSERT_LT(1u, counting.tasks);
+}
+
+UTEST_F(BatchTransformTest, threadPool)
+{
+  ThreadPool pool(3);
+  unsigned char hits[64] = {};
+  pool.run(8, [&](std::size_t i)
+  {
+    pool.run(8, [&](std::size_t j) { hits[i * 8 + j]++; });
+  });
+  for (unsigned int i = 0; i < 64; i++)
+    ASSERT_EQ(1, hits[i]);
+  
+  // Nesting across pools, back into the first, runs inline instead of waiting on each other's workers.
+  ThreadPool other(2);
+  pool.run(8, [&](std::size_t i)
+  {
+    other.run(4, [&](std::size_t j)
+    {
+      pool.run(2, [&](std::size_t k) { hits[i * 8 + j * 2 + k]++; });
+    });
+  });
+  for (unsigned int i = 0; i < 64; i++)
+    ASSERT_EQ(2, hits[i]);
+  
+  bool caught = false;
+  try
+  {
+    pool.run(1000, [](std::size_t i)
+    {
+      if (i == 123)
+        throw 123;
+    });
+  }
+  catch (int e)
+  {
+    caught = e == 123;
+  }
+  ASSERT_TRUE(caught);
+  
+  // The pool is still usable after a task threw.
+  pool.run(64, [&](std::size_t i) { hits[i]++; });
+  for (unsigned int i = 0; i < 64; i++)
+    ASSERT_EQ(3, hits[i]);
+}
+#endif
+
+DEFINE_FIXTURE(AlignedTest)
+
+static bool isAligned(const void* p, std::size_t alignment)
+{
+  return reinterpret_cast<std::uintptr_t>(p) % alignment == 0;
+}
+
+UTEST_F(AlignedTest, storage)
+{
+  ASSERT_EQ(16u, sizeof(Vec3Af));
+  ASSERT_EQ(16u, alignof(Vec3Af));
+  ASSERT_EQ(16u, alignof(Vec4Af));
+  ASSERT_EQ(64u, sizeof(Mat4Af));
+  ASSERT_EQ(16u, alignof(Mat4Af));
+  ASSERT_EQ(32u, sizeof(Vec3Ad));
+  ASSERT_EQ(32u, alignof(Vec4Ad));
+  ASSERT_EQ(32u, alignof(Mat4Ad));
+  
+  const Vec3Af a = Vec3f{1.0f, 2.0f, 3.0f};
+  ASSERT_EQ(0.0f, a.pad);
+  const Vec3f b = a;
+  ASSERT_EQ_V3F(b, Vec3f(1.0f, 2.0f, 3.0f));
+  const Vec4f c = Vec4Af{Vec4f{1.0f, 2.0f, 3.0f, 4.0f}};
+  ASSERT_EQ_V4F(c, Vec4f(1.0f, 2.0f, 3.0f, 4.0f));
+  
+  const Mat4f m = batchTestMatrix();
+  const Mat4Af ma = m;
+  ASSERT_EQ(0, std::memcmp(ma.d, m.d, sizeof(m.d)));
+  ASSERT_EQ(m(0, 3), ma(0, 3));
+  ASSERT_EQ_V4F(Vec4f(ma[2]), m[2]);
+  const Mat4f back = ma;
+  ASSERT_EQ(0, std::memcmp(back.d, m.d, sizeof(m.d)));
+  
+  for (std::size_t n = 1; n < 40; n += 7)
+  {
+    AlignedVector<Vec3Af> v3(n);
+    AlignedVector<Mat4Ad> m4(n);
+    std::vector<float, AlignedAllocator<float, 64>> floats(n);
+    ASSERT_TRUE(isAligned(v3.data(), 16));
+    ASSERT_TRUE(isAligned(m4.data(), 32));
+    ASSERT_TRUE(isAligned(floats.data(), 64));
+    ASSERT_TRUE(isAligned(&m4[n - 1][3], 32));
+  }
+}
+
+UTEST_F(AlignedTest, operations)
+{
+  const Vec3f a3{1.0f, -2.0f, 0.5f};
+  const Vec3f b3{0.25f, 3.0f, -4.0f};
+  const Vec3Af a = a3;
+  const Vec3Af b = b3;
+  ASSERT_EQ_V3F(Vec3f(a + b), Vec3f(a3 + b3));
+  ASSERT_EQ_V3F(Vec3f(a - b), Vec3f(a3 - b3));
+  ASSERT_EQ_V3F(Vec3f(-a), Vec3f(-a3));
+  ASSERT_EQ_V3F(Vec3f(a * 2.0f), Vec3f(a3 * 2.0f));
+  ASSERT_EQ_V3F(Vec3f(2.0f * a), Vec3f(2.0f * a3));
+  ASSERT_EQ_V3F(Vec3f(a / 4.0f), Vec3f(a3 / 4.0f));
+  ASSERT_EQ_V3F(Vec3f(cross(a, b)), cross(a3, b3));
+  ASSERT_EQ(dot(a3, b3), dot(a, b));
+  ASSERT_NEARLY_EQ_V3F(Vec3f(normalize(a)), normalize(a3));
+  ASSERT_EQ(0.0f, (a + b).pad);
+  
+  const Vec4f a4{1.0f, -2.0f, 0.5f, 3.0f};
+  const Vec4f b4{0.25f, 3.0f, -4.0f, -1.0f};
+  const Vec4Af c = a4;
+  const Vec4Af d = b4;
+  ASSERT_EQ_V4F(Vec4f(c - d), Vec4f(a4 - b4));
+  ASSERT_EQ_V4F(Vec4f(c * d), Vec4f(a4 * b4));
+  ASSERT_NEARLY_EQ_F(dot(a4, b4), dot(c, d));
+  ASSERT_NEARLY_EQ_F(mag(a4), mag(c));
+  
+  const Mat4f m = batchTestMatrix();
+  const Mat4f n = transpose(m);
+  const Vec4f mv = m * a4;
+  const Mat4f mn = m * n;
+  ASSERT_NEARLY_EQ_V4F(Vec4f(Mat4Af(m) * c), mv);
+  ASSERT_NEARLY_EQ_M4F(Mat4f(Mat4Af(m) * Mat4Af(n)), mn);
+}
+
+UTEST_F(AlignedTest, transforms)
+{
+  const Mat4f m = batchTestMatrix();
+  AlignedVector<Vec3Af> src(11);
+  AlignedVector<Vec4Af> src4(11);
+  for (unsigned int i = 0; i < 11; i++)
+  {
+    src[i] = streamInput3(i, 0.3f);
+    src4[i] = streamInput4(i, 0.2f);
+  }
+  AlignedVector<Vec3Af> points(11);
+  AlignedVector<Vec3Af> vectors(11);
+  AlignedVector<Vec4Af> v4(11);
+  transformPoints(m, src.data(), points.data(), 11);
+  transformVectors(m, src.data(), vectors.data(), 11);
+  transform(m, src4.data(), v4.data(), 11);
+  for (unsigned int i = 0; i < 11; i++)
+  {
+    const Vec3f s = src[i];
+    const Vec3f expectedPoint{m * Vec4f{s, 1}};
+    const Vec3f expectedVector{m * Vec4f{s, 0}};
+    const Vec4f expected4 = m * Vec4f(src4[i]);
+    ASSERT_NEARLY_EQ_V3F(Vec3f(points[i]), expectedPoint);
+    ASSERT_NEARLY_EQ_V3F(Vec3f(vectors[i]), expectedVector);
+    ASSERT_NEARLY_EQ_V4F(Vec4f(v4[i]), expected4);
+    ASSERT_EQ(0.0f, points[i].pad);
+    ASSERT_EQ(0.0f, vectors[i].pad);
+  }
+  
+  transformPoints(m, src.data(), 11);
+  for (unsigned int i = 0; i < 11; i++)
+  {
+    ASSERT_EQ_V3F(Vec3f(src[i]), Vec3f(points[i]));
+  }
+  
+  const Mat4d md{2, 0, 0, 1,
+                 0, 3, 0, 2,
+                 0, 0, 4, 3,
+                 0, 0, 0, 1};
+  AlignedVector<Vec3Ad> pd(5);
+  for (unsigned int i = 0; i < 5; i++)
+    pd[i] = Vec3Ad{static_cast<double>(i), 1, -1};
+  transformPoints(md, pd.data(), 5);
+  for (unsigned int i = 0; i < 5; i++)
+  {
+    ASSERT_EQ_V3F(Vec3d(pd[i]), Vec3d(2.0 * i + 1, 5, -1));
+    ASSERT_EQ(0.0, pd[i].pad);
+  }
+}
+
+DEFINE_FIXTURE(CompositionTest)
+
+static Mat4f compositionModel(unsigned int i)
+{
+  const float f = static_cast<float>(i);
+  const Vec3f scale{0.5f + 0.01f * f, 1.5f - 0.005f * f, 1.0f + 0.02f * f};
+  return makeTranslation(streamInput3(i, 0.01f)) * makeRotation4D(0.1f * f, -0.05f * f, 0.2f) * makeScale4D(scale);
+}
+
+UTEST_F(CompositionTest, modelViewProjection)
+{
+  const Mat4f projection = makePerspective(1.0f, 1.5f, 0.1f, 10.0f);
+  const Mat4f view = makeLookAt(Vec3f{0.5f, 1.0f, 3.0f}, Vec3f{0.0f, 0.0f, 0.0f}, Vec3f{0.0f, 1.0f, 0.0f});
+  const unsigned int count = 75;
+  std::vector<Mat4f> models(count);
+  std::vector<Affinef> affines(count);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    models[i] = compositionModel(i);
+    affines[i] = Affinef{models[i]};
+  }
+  
+  // Streamed to aligned storage, and falling back to ordinary stores one float past it.
+  std::vector<Mat4f, AlignedAllocator<Mat4f, 64>> streamed(count + 1);
+  std::vector<Mat4f> cached(count);
+  std::vector<Mat3f> normals(count);
+  Mat4f* shifted = reinterpret_cast<Mat4f*>(&streamed[0].d[0][1]);
+  modelViewProjectionBatch(projection, view, models.data(), cached.data(), count, normals.data());
+  for (unsigned int i = 0; i < count; i++)
+  {
+    const Mat4f expected = projection * view * models[i];
+    const Mat3f linear{Vec3f{models[i][0]}, Vec3f{models[i][1]}, Vec3f{models[i][2]}};
+    const Mat3f expectedNormal = transpose(inverse(linear));
+    ASSERT_NEARLY_EQ_M4F(cached[i], expected);
+    ASSERT_NEARLY_EQ_M3F(normals[i], expectedNormal);
+  }
+  modelViewProjectionBatch<float, StoreMode::NonTemporal>(projection, view, affines.data(), streamed.data(), count);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    ASSERT_NEARLY_EQ_M4F(streamed[i], cached[i]);
+  }
+  modelViewProjectionBatch<float, StoreMode::NonTemporal>(projection, view, models.data(), shifted, count);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    ASSERT_NEARLY_EQ_M4F(shifted[i], cached[i]);
+  }
+  
+  // In place, and with the view-projection given up front.
+  const Mat4f viewProjection = projection * view;
+  multiplyBatch<float, StoreMode::NonTemporal>(viewProjection, affines.data(), streamed.data(), count);
+  multiplyBatch(viewProjection, models.data(), models.data(), count);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    ASSERT_NEARLY_EQ_M4F(streamed[i], cached[i]);
+    ASSERT_NEARLY_EQ_M4F(models[i], cached[i]);
+  }
+  
+  const Mat4d modelD = makeTranslation(Vec3d{1, 2, 3}) * makeScale4D(Vec3d{2, 4, 0.5});
+  const Mat4d viewD = makeTranslation(Vec3d{0, 0, -5});
+  std::vector<Mat4d, AlignedAllocator<Mat4d, 64>> mvpD(3);
+  Mat3d normalD[3];
+  const Mat4d modelsD[3] = {modelD, modelD, modelD};
+  modelViewProjectionBatch<double, StoreMode::NonTemporal>(Mat4d{1}, viewD, modelsD, mvpD.data(), 3, normalD);
+  const Mat4d expectedD = viewD * modelD;
+  const Mat3d expectedNormalD = makeScale3D(Vec3d{0.5, 0.25, 2});
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    ASSERT_EQ_M4F(mvpD[i], expectedD);
+    ASSERT_EQ_M3F(normalD[i], expectedNormalD);
+  }
+  
+#if defined(NEON_PARALLEL)
+  ThreadPool pool(3);
+  const unsigned int large = 1000;
+  std::vector<Mat4f> manyModels(large);
+  std::vector<Mat4f, AlignedAllocator<Mat4f, 64>> serial(large);
+  std::vector<Mat4f, AlignedAllocator<Mat4f, 64>> parallel(large);
+  std::vector<Mat3f> serialNormals(large);
+  std::vector<Mat3f> parallelNormals(large);
+  for (unsigned int i = 0; i < large; i++)
+    manyModels[i] = compositionModel(i % 100);
+  modelViewProjectionBatch<float, StoreMode::NonTemporal>(projection, view, manyModels.data(), serial.data(), large, serialNormals.data());
+  modelViewProjectionBatch<float, StoreMode::NonTemporal>(pool, projection, view, manyModels.data(), parallel.data(), large, parallelNormals.data());
+  for (unsigned int i = 0; i < large; i++)
+  {
+    ASSERT_NEARLY_EQ_M4F(parallel[i], serial[i]);
+    ASSERT_NEARLY_EQ_M3F(parallelNormals[i], serialNormals[i]);
+  }
+  multiplyBatch(pool, viewProjection, manyModels.data(), parallel.data(), large);
+  for (unsigned int i = 0; i < large; i++)
+  {
+    ASSERT_NEARLY_EQ_M4F(parallel[i], serial[i]);
+  }
+#endif
+}
+
+DEFINE_FIXTURE(RayTest)
+
+UTEST_F(RayTest, scalar)
+{
+  const Vec3f v0{0.0f, 0.0f, 0.0f};
+  const Vec3f v1{1.0f, 0.0f, 0.0f};
+  const Vec3f v2{0.0f, 1.0f, 0.0f};
+  TriangleHit<float> hit{0.0f, 0.0f, 0.0f};
+  ASSERT_TRUE(intersectTriangle(Rayf{Vec3f{0.25f, 0.5f, 2.0f}, Vec3f{0.0f, 0.0f, -2.0f}}, v0, v1, v2, hit));
+  ASSERT_NEARLY_EQ_F(hit.t, 1.0f);
+  ASSERT_NEARLY_EQ_F(hit.u, 0.25f);
+  ASSERT_NEARLY_EQ_F(hit.v, 0.5f);
+  // Back faces count too.
+  ASSERT_TRUE(intersectTriangle(Rayf{Vec3f{0.25f, 0.5f, -1.0f}, Vec3f{0.0f, 0.0f, 1.0f}}, v0, v1, v2, hit));
+  ASSERT_NEARLY_EQ_F(hit.t, 1.0f);
+  const Vec3f point = Rayf{Vec3f{0.25f, 0.5f, -1.0f}, Vec3f{0.0f, 0.0f, 1.0f}}.at(hit.t);
+  ASSERT_NEARLY_EQ_V3F(point, Vec3f(0.25f, 0.5f, 0.0f));
+  // Outside the triangle, behind the origin and parallel to the plane.
+  ASSERT_FALSE(intersectTriangle(Rayf{Vec3f{0.75f, 0.5f, 1.0f}, Vec3f{0.0f, 0.0f, -1.0f}}, v0, v1, v2, hit));
+  ASSERT_FALSE(intersectTriangle(Rayf{Vec3f{0.25f, 0.25f, 1.0f}, Vec3f{0.0f, 0.0f, 1.0f}}, v0, v1, v2, hit));
+  ASSERT_FALSE(intersectTriangle(Rayf{Vec3f{-1.0f, 0.25f, 0.0f}, Vec3f{1.0f, 0.0f, 0.0f}}, v0, v1, v2, hit));
+  ASSERT_FALSE(intersectTriangle(Rayf{Vec3f{0.0f, 0.0f, 1.0f}, Vec3f{0.0f, 0.0f, -1.0f}}, v0, v0, v2, hit));
+  
+  const Vec3f boxMin{0.0f, 0.0f, 0.0f};
+  const Vec3f boxMax{1.0f, 1.0f, 1.0f};
+  float tNear = -1.0f;
+  ASSERT_TRUE(intersectAabb(Rayf{Vec3f{-2.0f, 0.5f, 0.5f}, Vec3f{1.0f, 0.0f, 0.0f}}, boxMin, boxMax, tNear));
+  ASSERT_EQ(2.0f, tNear);
+  ASSERT_TRUE(intersectAabb(Rayf{Vec3f{0.5f, 0.5f, 0.5f}, Vec3f{0.3f, -1.0f, 0.2f}}, boxMin, boxMax, tNear));
+  ASSERT_EQ(0.0f, tNear);
+  ASSERT_TRUE(intersectAabb(Rayf{Vec3f{2.0f, 3.0f, 0.5f}, Vec3f{-1.0f, -1.5f, 0.0f}}, boxMin, boxMax, tNear));
+  ASSERT_NEARLY_EQ_F(tNear, 4.0f / 3.0f);
+  ASSERT_FALSE(intersectAabb(Rayf{Vec3f{-2.0f, 1.5f, 0.5f}, Vec3f{1.0f, 0.0f, 0.0f}}, boxMin, boxMax, tNear));
+  ASSERT_FALSE(intersectAabb(Rayf{Vec3f{2.0f, 0.5f, 0.5f}, Vec3f{1.0f, 0.0f, 0.0f}}, boxMin, boxMax, tNear));
+  ASSERT_FALSE(intersectAabb(Rayf{Vec3f{-2.0f, -1.0f, 0.5f}, Vec3f{1.0f, 2.0f, 0.0f}}, boxMin, boxMax, tNear));
+}
+
+static bool hitBit(const std::uint32_t* hits, std::size_t i)
+{
+  return ((hits[i / 32] >> (i % 32)) & 1u) != 0;
+}
+
+UTEST_F(RayTest, batched)
+{
+  const unsigned int count = 43;
+  std::vector<Vec3f> a(count), b(count), c(count), o(count), d(count), lo(count), hi(count);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    const Vec3f center{std::sin(1.7f * static_cast<float>(i)), std::cos(1.3f * static_cast<float>(i)), 0.2f * static_cast<float>(i)};
+    a[i] = center + Vec3f{-0.6f, -0.5f, 0.1f};
+    b[i] = center + Vec3f{0.7f, -0.4f, -0.1f};
+    c[i] = center + Vec3f{0.0f, 0.8f, 0.0f};
+    lo[i] = center - Vec3f{0.5f, 0.4f, 0.3f};
+    hi[i] = center + Vec3f{0.4f, 0.5f, 0.3f};
+    o[i] = streamInput3(i, 0.3f) - Vec3f{1.5f, 0.0f, 0.0f};
+  }
+  // Rays aimed around triangle and box 3.
+  const unsigned int k = 3;
+  const Vec3f target = (a[k] + b[k] + c[k]) / 3.0f;
+  for (unsigned int i = 0; i < count; i++)
+    d[i] = target + Vec3f{0.6f * std::sin(static_cast<float>(i)), 0.6f * std::cos(static_cast<float>(i)), 0.0f} - o[i];
+  const Vec3Stream<float> v0(a.data(), count), v1(b.data(), count), v2(c.data(), count);
+  const Vec3Stream<float> mins(lo.data(), count), maxs(hi.data(), count);
+  const Vec3Stream<float> origins(o.data(), count), directions(d.data(), count);
+  const Rayf ray{Vec3f{0.1f, 0.2f, -2.0f}, Vec3f{0.05f, -0.02f, 1.0f}};
+  
+  std::vector<float> t(count), u(count), v(count);
+  std::uint32_t hits[2] = {~0u, ~0u};
+  unsigned int triangleHits = 0;
+  intersectTriangles(ray, v0, v1, v2, t.data(), u.data(), v.data(), hits);
+  TriangleHit<float> closest{std::numeric_limits<float>::infinity(), 0.0f, 0.0f};
+  std::size_t closestIndex = count;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    TriangleHit<float> hit{0.0f, 0.0f, 0.0f};
+    const bool expected = intersectTriangle(ray, a[i], b[i], c[i], hit);
+    ASSERT_EQ(expected, hitBit(hits, i));
+    if (expected)
+    {
+      ASSERT_NEARLY_EQ_F(t[i], hit.t);
+      ASSERT_NEARLY_EQ_F(u[i], hit.u);
+      ASSERT_NEARLY_EQ_F(v[i], hit.v);
+      if (hit.t < closest.t)
+      {
+        closest = hit;
+        closestIndex = i;
+      }
+      triangleHits++;
+    }
+    else
+      ASSERT_EQ(std::numeric_limits<float>::infinity(), t[i]);
+  }
+  ASSERT_GT(triangleHits, 2u);
+  ASSERT_EQ(hits[1] >> (count - 32), ~0u >> (count - 32));
+  
+  TriangleHit<float> nearest{0.0f, 0.0f, 0.0f};
+  ASSERT_EQ(closestIndex, intersectClosest(ray, v0, v1, v2, nearest));
+  ASSERT_EQ(closest.t, nearest.t);
+  ASSERT_EQ(closest.u, nearest.u);
+  ASSERT_EQ(count, intersectClosest(ray, v0, v1, v2, nearest, closest.t));
+  
+  std::vector<float> tNear(count);
+  unsigned int boxHits = 0;
+  intersectAabbs(ray, mins, maxs, tNear.data(), hits);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    float expectedNear = 0.0f;
+    const bool expected = intersectAabb(ray, lo[i], hi[i], expectedNear);
+    ASSERT_EQ(expected, hitBit(hits, i));
+    ASSERT_EQ(expected ? expectedNear : std::numeric_limits<float>::infinity(), tNear[i]);
+    boxHits += expected ? 1 : 0;
+  }
+  ASSERT_GT(boxHits, 2u);
+  
+  std::uint32_t boxBits[2] = {0, 0};
+  intersectTriangle(origins, directions, a[k], b[k], c[k], t.data(), u.data(), v.data(), hits);
+  intersectAabb(origins, directions, lo[k], hi[k], tNear.data(), boxBits);
+  triangleHits = boxHits = 0;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    TriangleHit<float> hit{0.0f, 0.0f, 0.0f};
+    const bool triangle = intersectTriangle(Rayf{o[i], d[i]}, a[k], b[k], c[k], hit);
+    ASSERT_EQ(triangle, hitBit(hits, i));
+    if (triangle)
+    {
+      ASSERT_NEARLY_EQ_F(t[i], hit.t);
+      ASSERT_NEARLY_EQ_F(u[i], hit.u);
+      ASSERT_NEARLY_EQ_F(v[i], hit.v);
+    }
+    float expectedNear = 0.0f;
+    const bool box = intersectAabb(Rayf{o[i], d[i]}, lo[k], hi[k], expectedNear);
+    ASSERT_EQ(box, hitBit(boxBits, i));
+    ASSERT_EQ(box ? expectedNear : std::numeric_limits<float>::infinity(), tNear[i]);
+    triangleHits += triangle ? 1 : 0;
+    boxHits += box ? 1 : 0;
+  }
+  ASSERT_GT(triangleHits, 2u);
+  ASSERT_GT(boxHits, triangleHits);
+}
+
+DEFINE_FIXTURE(BvhTest)
+
+// Small triangles scattered through a box, plus a large ground quad.
+static void bvhTestScene(unsigned int count, std::vector<Vec3f>& a, std::vector<Vec3f>& b, std::vector<Vec3f>& c)
+{
+  a.clear();
+  b.clear();
+  c.clear();
+  for (unsigned int i = 0; i < count; i++)
+  {
+    const float f = static_cast<float>(i);
+    const Vec3f p{4.0f * std::sin(0.37f * f), 4.0f * std::cos(1.13f * f), 4.0f * std::sin(0.71f * f + 1.0f)};
+    a.push_back(p);
+    b.push_back(p + Vec3f{0.3f, 0.05f * std::cos(f), 0.1f});
+    c.push_back(p + Vec3f{-0.05f, 0.25f, 0.3f * std::sin(f)});
+  }
+  a.push_back(Vec3f{-10.0f, -5.0f, -10.0f});
+  b.push_back(Vec3f{10.0f, -5.0f, -10.0f});
+  c.push_back(Vec3f{10.0f, -5.0f, 10.0f});
+}
+
+static Rayf bvhTestRay(unsigned int i)
+{
+  const float f = static_cast<float>(i);
+  const Vec3f origin{6.0f * std::cos(0.5f * f), 3.0f * std::sin(0.3f * f), -8.0f};
+  const Vec3f target{2.0f * std::sin(1.7f * f), 2.0f * std::cos(0.9f * f) - 1.0f, 2.0f * std::sin(f)};
+  return Rayf{origin, target - origin};
+}
+
+UTEST_F(BvhTest, queries)
+{
+  std::vector<Vec3f> a, b, c;
+  bvhTestScene(1500, a, b, c);
+  Vec3Stream<float> v0(a.data(), a.size()), v1(b.data(), b.size()), v2(c.data(), c.size());
+  Bvhf bvh(v0, v1, v2);
+  ASSERT_EQ(a.size(), bvh.triangleCount());
+  ASSERT_GT(bvh.nodeCount(), 2 * a.size() / 8);
+  
+  unsigned int hits = 0;
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (unsigned int i = 0; i < 300; i++)
+    {
+      const Rayf ray = bvhTestRay(i);
+      TriangleHit<float> expected{0.0f, 0.0f, 0.0f};
+      TriangleHit<float> hit{0.0f, 0.0f, 0.0f};
+      const std::size_t expectedIndex = intersectClosest(ray, v0, v1, v2, expected);
+      const std::size_t index = bvh.closestHit(ray, hit);
+      ASSERT_EQ(expectedIndex, index);
+      ASSERT_EQ(expectedIndex != a.size(), bvh.anyHit(ray));
+      if (index != a.size())
+      {
+        ASSERT_EQ(expected.t, hit.t);
+        ASSERT_EQ(expected.u, hit.u);
+        ASSERT_EQ(expected.v, hit.v);
+        ASSERT_FALSE(bvh.anyHit(ray, hit.t));
+        ASSERT_EQ(a.size(), bvh.closestHit(ray, hit, hit.t));
+        hits++;
+      }
+    }
+    
+    // Move the scattered triangles and refit.
+    for (std::size_t i = 0; i + 1 < a.size(); i++)
+    {
+      const Vec3f offset{0.5f * std::sin(static_cast<float>(i)), 0.3f, -0.2f};
+      v0.set(i, a[i] + offset);
+      v1.set(i, b[i] + offset);
+      v2.set(i, c[i] + offset);
+    }
+    bvh.refit(v0, v1, v2);
+  }
+  ASSERT_GT(hits, 150u);
+  
+  Bvhf empty;
+  TriangleHit<float> hit{0.0f, 0.0f, 0.0f};
+  ASSERT_EQ(0u, empty.closestHit(bvhTestRay(0), hit));
+  ASSERT_FALSE(empty.anyHit(bvhTestRay(0)));
+  
+  // Coincident triangles still split into bounded leaves.
+  const std::vector<Vec3f> same(100, Vec3f{1.0f, 2.0f, 3.0f});
+  const Vec3Stream<float> s0(same.data(), same.size());
+  const std::vector<Vec3f> other(100, Vec3f{2.0f, 2.0f, 3.0f});
+  const Vec3Stream<float> s1(other.data(), other.size());
+  const std::vector<Vec3f> third(100, Vec3f{1.0f, 3.0f, 3.0f});
+  const Vec3Stream<float> s2(third.data(), third.size());
+  const Bvhf stacked(s0, s1, s2);
+  const std::size_t index = stacked.closestHit(Rayf{Vec3f{1.25f, 2.25f, 0.0f}, Vec3f{0.0f, 0.0f, 1.0f}}, hit);
+  ASSERT_LT(index, 100u);
+  ASSERT_EQ(3.0f, hit.t);
+  
+  // A strip of triangles, each 16 times further along x than the last. That leaves one triangle per level for
+  // binned SAH to peel off, 150 levels deep, so only the median splits below kBvhSahDepth keep the tree within
+  // the traversal stack. Doubles keep the coordinates in range.
+  const unsigned int stripCount = 150;
+  std::vector<Vec3d> sa(stripCount), sb(stripCount), sc(stripCount);
+  double x = 1;
+  for (unsigned int i = 0; i < stripCount; i++, x *= 16)
+  {
+    sa[i] = Vec3d{x, 0, 0};
+    sb[i] = Vec3d{1.3 * x, 0, 0};
+    sc[i] = Vec3d{x, 1, 0.5};
+  }
+  const Vec3Stream<double> t0(sa.data(), stripCount), t1(sb.data(), stripCount), t2(sc.data(), stripCount);
+  const Bvhd strip(t0, t1, t2);
+  TriangleHit<double> stripHit{0, 0, 0};
+  for (unsigned int i = 0; i < stripCount; i++)
+  {
+    const Rayd ray{Vec3d{1.05 * sa[i].x, 0.05, 1}, Vec3d{0, 0, -1}};
+    ASSERT_EQ(i, strip.closestHit(ray, stripHit));
+    ASSERT_NEARLY_EQ_F(stripHit.t, 0.975);
+    ASSERT_TRUE(strip.anyHit(ray));
+  }
+  // Along the strip, parallel to every triangle but through every box, traversal goes as deep as the tree.
+  const Rayd along{Vec3d{0, 0.25, 0.25}, Vec3d{1, 0, 0}};
+  ASSERT_EQ(stripCount, strip.closestHit(along, stripHit));
+  ASSERT_FALSE(strip.anyHit(along));
+}
+
+#if defined(NEON_PARALLEL)
+UTEST_F(BvhTest, parallelBuild)
+{
+  std::vector<Vec3f> a, b, c;
+  bvhTestScene(30000, a, b, c);
+  const Vec3Stream<float> v0(a.data(), a.size()), v1(b.data(), b.size()), v2(c.data(), c.size());
+  ThreadPool pool(4);
+  const Bvhf serial(v0, v1, v2);
+  Bvhf parallel;
+  parallel.build(pool, v0, v1, v2);
+  ASSERT_EQ(serial.nodeCount(), parallel.nodeCount());
+  for (unsigned int i = 0; i < 200; i++)
+  {
+    const Rayf ray = bvhTestRay(i);
+    TriangleHit<float> expected{0.0f, 0.0f, 0.0f};
+    TriangleHit<float> hit{0.0f, 0.0f, 0.0f};
+    ASSERT_EQ(serial.closestHit(ray, expected), parallel.closestHit(ray, hit));
+    ASSERT_EQ(expected.t, hit.t);
+  }
+}
+#endif
+
+DEFINE_FIXTURE(BufferLayoutTest)
+
+UTEST_F(BufferLayoutTest, sizes)
+{
+  ASSERT_EQ(48u, Std140View<Mat3f>::size());
+  ASSERT_EQ(16u, Std140View<Mat3f>::alignment());
+  ASSERT_EQ(12u, Std430View<Vec3f>::size());
+  ASSERT_EQ(16u, Std430View<Vec3f>::alignment());
+  ASSERT_EQ(8u, Std140View<Vec2f>::alignment());
+  ASSERT_EQ(16u, Std140Array<float>::stride());
+  ASSERT_EQ(4u, Std430Array<float>::stride());
+  ASSERT_EQ(16u, Std140Array<Vec2f>::stride());
+  ASSERT_EQ(8u, Std430Array<Vec2f>::stride());
+  ASSERT_EQ(16u, Std430Array<Vec3f>::stride());
+  ASSERT_EQ(32u, Std140Array<Mat2f>::stride());
+  ASSERT_EQ(16u, Std430Array<Mat2f>::stride());
+  ASSERT_EQ(64u, Std430Array<Mat4f>::stride());
+  ASSERT_EQ(96u, Std430Array<Mat3d>::stride());
+  ASSERT_EQ(32u, Std430Array<Vec3d>::alignment());
+  ASSERT_EQ(48u, sizeof(Std140Padded<Mat3f>));
+  ASSERT_EQ(16u, sizeof(Std430Padded<Vec3f>));
+  ASSERT_EQ(16u, alignof(Std430Padded<Vec3f>));
+  ASSERT_EQ(4u, sizeof(Std430Padded<float>));
+  ASSERT_EQ(16u, sizeof(Std140Padded<float>));
+  
+  // std140 rounds strides to 16 bytes, two doubles, not to four scalars.
+  ASSERT_EQ(16u, Std140Array<double>::stride());
+  ASSERT_EQ(16u, Std140Array<Vec2d>::stride());
+  ASSERT_EQ(32u, Std140Array<Vec3d>::stride());
+  ASSERT_EQ(32u, Std140Array<Vec4d>::stride());
+  ASSERT_EQ(32u, Std140View<Mat2d>::size());
+  ASSERT_EQ(16u, Std140View<Mat2d>::alignment());
+  ASSERT_EQ(32u, Std140Array<Mat2d>::stride());
+  ASSERT_EQ(96u, Std140View<Mat3d>::size());
+  ASSERT_EQ(32u, Std140View<Mat3d>::alignment());
+  ASSERT_EQ(128u, Std140Array<Mat4d>::stride());
+  ASSERT_EQ(16u, sizeof(Std140Padded<double>));
+  ASSERT_EQ(32u, sizeof(Std140Padded<Mat2d>));
+}
+
+UTEST_F(BufferLayoutTest, views)
+{
+  // layout(std140) uniform Block { mat3 m; vec3 v; float f; }: v at byte 48 and f at byte 60.
+  float block[16];
+  for (unsigned int i = 0; i < 16; i++)
+    block[i] = -1;
+  const Mat3f m{1, 2, 3,
+                4, 5, 6,
+                7, 8, 9};
+  Std140View<float>(block + 15).store(10);
+  Std140View<Mat3f>(block).store(m);
+  Std140View<Vec3f>(block + 12).store(Vec3f{11, 12, 13});
+  const float expected[16] = {1, 4, 7, 0, 2, 5, 8, 0, 3, 6, 9, 0, 11, 12, 13, 10};
+  for (unsigned int i = 0; i < 16; i++)
+    ASSERT_EQ(expected[i], block[i]);
+  const Mat3f loaded = Std140View<Mat3f>(block).load();
+  ASSERT_EQ_M3F(loaded, m);
+  const Vec3f loadedV = Std430View<Vec3f>(block + 12).load();
+  ASSERT_EQ_V3F(loadedV, (Vec3f{11, 12, 13}));
+  
+  // layout(std140) uniform Block { dmat2 m; double a[2]; }: tightly packed columns, a at byte 32 and a[1] at 48.
+  double blockD[8];
+  for (unsigned int i = 0; i < 8; i++)
+    blockD[i] = -1;
+  Std140View<Mat2d>(blockD).store(Mat2d{1, 2, 3, 4});
+  Std140Array<double> arrayD(blockD + 4, 2);
+  arrayD.store(0, 5.0);
+  arrayD.store(1, 6.0);
+  const double expectedD[8] = {1, 3, 2, 4, 5, 0, 6, 0};
+  for (unsigned int i = 0; i < 8; i++)
+    ASSERT_EQ(expectedD[i], blockD[i]);
+  const Mat2d loadedD = Std140View<Mat2d>(blockD).load();
+  ASSERT_EQ_M2F(loadedD, (Mat2d{1, 2, 3, 4}));
+}
+
+UTEST_F(BufferLayoutTest, arrays)
+{
+  Vec3f src[5];
+  for (unsigned int i = 0; i < 5; i++)
+    src[i] = streamInput3(i, 0.1f);
+  float buffer[20];
+  for (unsigned int i = 0; i < 20; i++)
+    buffer[i] = -1;
+  Std430Array<Vec3f> array(buffer, 5);
+  ASSERT_EQ(80u, array.sizeBytes());
+  array.store(src, 4, 1);
+  array.store(0, src[4]);
+  for (unsigned int i = 0; i < 5; i++)
+  {
+    const Vec3f& v = i == 0 ? src[4] : src[i - 1];
+    ASSERT_EQ(v.x, buffer[4 * i]);
+    ASSERT_EQ(v.y, buffer[4 * i + 1]);
+    ASSERT_EQ(v.z, buffer[4 * i + 2]);
+    ASSERT_EQ(0, buffer[4 * i + 3]);
+    const Vec3f loaded = array.load(i);
+    ASSERT_EQ_V3F(loaded, v);
+  }
+  Vec3f unpacked[4];
+  array.load(unpacked, 4, 1);
+  for (unsigned int i = 0; i < 4; i++)
+  {
+    ASSERT_EQ_V3F(unpacked[i], src[i]);
+  }
+  
+  // Padded storage already has the buffer layout.
+  std::vector<Std140Padded<Mat3f>> padded(3);
+  Mat3f matrices[3];
+  float packed[36];
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    matrices[i] = makeRotation3D(src[i], 0.5f) * static_cast<float>(i + 1);
+    padded[i] = matrices[i];
+  }
+  Std140Array<Mat3f>(packed, 3).store(matrices, 3);
+  ASSERT_EQ(0, std::memcmp(packed, padded.data(), sizeof(packed)));
+  const Mat3f back = padded[2];
+  ASSERT_EQ_M3F(back, matrices[2]);
+}
+
+DEFINE_FIXTURE(HalfTest)
+
+UTEST_F(HalfTest, scalar)
+{
+  ASSERT_EQ(0x3c00, Half(1.0f).bits);
+  ASSERT_EQ(0xc000, Half(-2.0f).bits);
+  ASSERT_EQ(0x7bff, Half(65504.0f).bits);
+  ASSERT_EQ(0x7c00, Half(65520.0f).bits);
+  ASSERT_EQ(0x7c00, Half(std::numeric_limits<float>::infinity()).bits);
+  ASSERT_EQ(0x0001, Half(std::ldexp(1.0f, -24)).bits);
+  // Ties round to even, for normal and subnormal results alike.
+  ASSERT_EQ(0x0000, Half(std::ldexp(1.0f, -25)).bits);
+  ASSERT_EQ(0x0002, Half(std::ldexp(3.0f, -25)).bits);
+  ASSERT_EQ(0x3c00, Half(1 + std::ldexp(1.0f, -11)).bits);
+  ASSERT_EQ(0x3c02, Half(1 + std::ldexp(3.0f, -11)).bits);
+  ASSERT_TRUE(std::isnan(static_cast<float>(Half(std::numeric_limits<float>::quiet_NaN()))));
+  
+  // Every non-NaN half survives the round trip through float.
+  for (unsigned int b = 0; b < 0x10000; b++)
+  {
+    const Half h = Half::fromBits(static_cast<std::uint16_t>(b));
+    if ((b & 0x7c00) == 0x7c00 && (b & 0x3ff) != 0)
+      continue;
+    ASSERT_EQ(b, Half(static_cast<float>(h)).bits);
+  }
+  
+  ASSERT_EQ(0x3f80, BFloat16(1.0f).bits);
+  ASSERT_EQ(0x3f80, BFloat16(1 + std::ldexp(1.0f, -8)).bits);
+  ASSERT_EQ(0x3f82, BFloat16(1 + std::ldexp(3.0f, -8)).bits);
+  ASSERT_EQ(-3.0f, static_cast<float>(BFloat16(-3.0f)));
+  ASSERT_TRUE(std::isnan(static_cast<float>(BFloat16(std::numeric_limits<float>::quiet_NaN()))));
+}
+
+UTEST_F(HalfTest, vectors)
+{
+  ASSERT_EQ(8u, sizeof(Vec4h));
+  ASSERT_EQ(6u, sizeof(Vec3bf));
+  const Vec4h a{1, 2.5f, -3, 0.25f};
+  const Vec4h sum = a + a;
+  const Vec4f expected{2, 5, -6, 0.5f};
+  ASSERT_EQ_V4F(sum, expected);
+  ASSERT_EQ(6.0f, dot(Vec3h{1, 2, 3}, Vec3h{0.5f, 0.5f, 1.5f}));
+  
+  // The bulk conversions match the scalar ones bit for bit, specials and subnormals included.
+  const unsigned int count = 37;
+  Vec4f src[count];
+  for (unsigned int i = 0; i < count; i++)
+  {
+    const float f = static_cast<float>(i);
+    src[i] = Vec4f{std::ldexp(1 + f / 64, static_cast<int>(i) - 28), -f * 1000.1f, 1 / (f - 18), f / 3};
+  }
+  src[5].y = std::numeric_limits<float>::infinity();
+  src[6].z = std::numeric_limits<float>::quiet_NaN();
+  src[7].w = 1 + std::ldexp(1.0f, -11);
+  src[8].y = 70000;
+  Vec4h halves[count];
+  Vec4bf bfloats[count];
+  Vec4f fromHalves[count];
+  Vec4f fromBFloats[count];
+  convert(src, halves, count);
+  convert(src, bfloats, count);
+  convert(halves, fromHalves, count);
+  convert(bfloats, fromBFloats, count);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    for (unsigned int k = 0; k < 4; k++)
+    {
+      if (std::isnan(src[i][k]))
+      {
+        ASSERT_TRUE(std::isnan(fromHalves[i][k]));
+        ASSERT_TRUE(std::isnan(fromBFloats[i][k]));
+        continue;
+      }
+      ASSERT_EQ(Half(src[i][k]).bits, halves[i][k].bits);
+      ASSERT_EQ(BFloat16(src[i][k]).bits, bfloats[i][k].bits);
+      ASSERT_EQ(static_cast<float>(halves[i][k]), fromHalves[i][k]);
+      ASSERT_EQ(static_cast<float>(bfloats[i][k]), fromBFloats[i][k]);
+    }
+  }
+}
+
+DEFINE_FIXTURE(UnitVectorTest)
+
+namespace
+{
+  // Evenly spread unit vectors: a Fibonacci lattice on the sphere.
+  Vec3d spherePoint(unsigned int i, unsigned int count)
+  {
+    const double z = 1 - (2 * i + 1) / static_cast<double>(count);
+    const double r = std::sqrt(1 - z * z);
+    const double phi = i * 2.39996322972865332;
+    return Vec3d{r * std::cos(phi), r * std::sin(phi), z};
+  }
+  
+  double angleDegrees(const Vec3d& a, const Vec3d& b)
+  {
+    return std::atan2(mag(cross(a, b)), dot(a, b)) * 180 / 3.14159265358979323846;
+  }
+}
+
+UTEST_F(UnitVectorTest, encode)
+{
+  ASSERT_EQ(0u, encodeOct32(Vec3f{0, 0, 1}));
+  ASSERT_EQ(0x7fffu, encodeOct32(Vec3f{1, 0, 0}));
+  ASSERT_EQ(0x7f7fu, encodeOct16(Vec3f{0, 0, -1}));
+  ASSERT_EQ(0x1ffu, encodeSnorm1010102(Vec3f{1, 0, 0}));
+  ASSERT_EQ(0x201u << 10, encodeSnorm1010102(Vec3f{0, -1, 0}));
+  
+  // The axes come back exactly.
+  const Vec3f axes[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+  for (unsigned int i = 0; i < 6; i++)
+  {
+    ASSERT_EQ_V3F(decodeOct32(encodeOct32(axes[i])), axes[i]);
+    ASSERT_EQ_V3F(decodeOct16(encodeOct16(axes[i])), axes[i]);
+    ASSERT_EQ_V3F(decodeSnorm1010102(encodeSnorm1010102(axes[i])), axes[i]);
+  }
+  
+  // The documented error bounds, and decoded vectors are unit length.
+  const unsigned int count = 20000;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    const Vec3d n = spherePoint(i, count);
+    const Vec3d oct32 = decodeOct32<double>(encodeOct32(n));
+    const Vec3d oct16 = decodeOct16<double>(encodeOct16(n));
+    const Vec3d snorm = decodeSnorm1010102<double>(encodeSnorm1010102(n));
+    ASSERT_LT(angleDegrees(n, oct32), 0.004);
+    ASSERT_LT(angleDegrees(n, oct16), 0.96);
+    ASSERT_LT(angleDegrees(n, snorm), 0.1);
+    ASSERT_LT(std::abs(mag(oct16) - 1), 1e-12);
+  }
+}
+
+UTEST_F(UnitVectorTest, arrays)
+{
+  // The array overloads encode to the same bits as the scalar ones, tails included.
+  const unsigned int count = 37;
+  Vec3f src[count];
+  Vec3d srcd[count];
+  for (unsigned int i = 0; i < count; i++)
+  {
+    srcd[i] = spherePoint(i, count);
+    src[i] = Vec3f{static_cast<float>(srcd[i].x), static_cast<float>(srcd[i].y), static_cast<float>(srcd[i].z)};
+  }
+  std::uint32_t oct32[count];
+  std::uint16_t oct16[count];
+  std::uint32_t snorm[count];
+  std::uint32_t oct32d[count];
+  Vec3f decoded[count];
+  Vec3d decodedd[count];
+  
+  encodeOct32(src, oct32, count);
+  decodeOct32(oct32, decoded, count);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    ASSERT_EQ(encodeOct32(src[i]), oct32[i]);
+    ASSERT_NEARLY_EQ_V3F(decodeOct32(oct32[i]), decoded[i]);
+  }
+  encodeOct16(src, oct16, count);
+  decodeOct16(oct16, decoded, count);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    ASSERT_EQ(encodeOct16(src[i]), oct16[i]);
+    ASSERT_NEARLY_EQ_V3F(decodeOct16(oct16[i]), decoded[i]);
+  }
+  encodeSnorm1010102(src, snorm, count);
+  decodeSnorm1010102(snorm, decoded, count);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    ASSERT_EQ(encodeSnorm1010102(src[i]), snorm[i]);
+    ASSERT_NEARLY_EQ_V3F(decodeSnorm1010102(snorm[i]), decoded[i]);
+  }
+  encodeOct32(srcd, oct32d, count);
+  decodeOct32(oct32d, decodedd, count);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    ASSERT_EQ(encodeOct32(srcd[i]), oct32d[i]);
+    ASSERT_NEARLY_EQ_V3F(decodeOct32<double>(oct32d[i]), decodedd[i]);
+  }
+}
+
 DEFINE_FIXTURE(MatfTest)
 
 UTEST_F(MatfTest, defaultCtor)
@@ -959,6 +2669,39 @@ UTEST_F(MatfTest, addition)
   }
 }
 
+UTEST_F(MatfTest, chainedArithmetic)
+{
+  const Mat4f a{1, 2, 3, 4,
+                5, 6, 7, 8,
+                9, 10, 11, 12,
+                13, 14, 15, 16};
+  const Mat4f b = transpose(a);
+  {
+    const Mat4f result = (a + b) * 0.5f - Mat4f(1) / 2.0f;
+    const Mat4f expected{0.5f, 3.5f, 6, 8.5f,
+                         3.5f, 5.5f, 8.5f, 11,
+                         6, 8.5f, 10.5f, 13.5f,
+                         8.5f, 11, 13.5f, 15.5f};
+    ASSERT_NEARLY_EQ_M4F(result, expected);
+  }
+  {
+    // Products are not element-wise and still evaluate eagerly inside a chain.
+    const Mat4f result = a * (b - a) + -a;
+    const Mat4f expected = a * Mat4f(b - a) - a;
+    ASSERT_NEARLY_EQ_M4F(result, expected);
+  }
+  {
+    Mat3f m{1, 2, 3,
+            4, 5, 6,
+            7, 8, 9};
+    m = 2.0f * m - m;
+    const Mat3f expected{1, 2, 3,
+                         4, 5, 6,
+                         7, 8, 9};
+    ASSERT_NEARLY_EQ_M3F(m, expected);
+  }
+}
+
 UTEST_F(MatfTest, negate)
 {
   // TODO
@@ -1094,6 +2837,29 @@ UTEST_F(MatfTest, multiplyMatrix)
   }
 }
 
+UTEST_F(MatfTest, multiplyDouble)
+{
+  const Mat4d m1{1,  2,  3,  4,
+                 5,  6,  7,  8,
+                 9,  10, 11, 12,
+                 13, 14, 15, 16};
+  const Mat4d m2{2,  3,  4, 5,
+                 6,  7,  8, 9,
+                 10, 11, 12, 13,
+                 14, 15, 16, 17};
+  const Mat4d result = m1 * m2;
+  const Mat4d expected{100, 110, 120, 130,
+                       228, 254, 280, 306,
+                       356, 398, 440, 482,
+                       484, 542, 600, 658};
+  ASSERT_EQ_M4F(result, expected);
+  
+  const Vec4d v{0.5, 0.25, 2, 4};
+  const Vec4d resultV = m1 * v;
+  const Vec4d expectedV{23, 50, 77, 104};
+  ASSERT_EQ_V4F(resultV, expectedV);
+}
+
 UTEST_F(MatfTest, determinant)
 {
   // Checked with https://www.wolframalpha.com/
@@ -1158,6 +2924,106 @@ UTEST_F(MatfTest, inverse)
   }
 }
 
+UTEST_F(MatfTest, inverseBatch)
+{
+  Mat4f m[11];
+  for (unsigned int i = 0; i < 11; i++)
+  {
+    const float f = static_cast<float>(i);
+    m[i] = makeRotation4D(0.1f * f, 0.2f, -0.3f * f) * Mat4f{1 + 0.05f * f};
+    m[i].d[3][0] = f;
+    m[i].d[3][1] = -2 * f;
+  }
+  m[5] = Mat4f{0};
+  Mat4f inverses[11];
+  float determinants[11];
+  bool singular[11];
+  inverseBatch(m, inverses, 11, singular);
+  determinantBatch(m, determinants, 11);
+  for (unsigned int i = 0; i < 11; i++)
+  {
+    ASSERT_NEARLY_EQ_F(determinants[i], determinant(m[i]));
+    ASSERT_EQ(i == 5, singular[i]);
+    if (i == 5)
+    {
+      ASSERT_EQ_M4F(inverses[i], Mat4f{0});
+    }
+    else
+    {
+      const Mat4f expected = inverse(m[i]);
+      ASSERT_NEARLY_EQ_M4F(inverses[i], expected);
+    }
+  }
+  
+  Mat4d md[3] = {Mat4d{2}, Mat4d{4}, Mat4d{0.5}};
+  inverseBatch(md, md, 3);
+  ASSERT_EQ_M4F(md[0], Mat4d{0.5});
+  ASSERT_EQ_M4F(md[1], Mat4d{0.25});
+  ASSERT_EQ_M4F(md[2], Mat4d{2});
+}
+
+UTEST_F(MatfTest, normalMatrix)
+{
+  const Mat4f m = makeTranslation(Vec3f{1, 2, 3}) * makeRotation4D(0.3f, -0.2f, 0.7f) * makeScale4D(Vec3f{2, 0.5f, -1.5f});
+  const Mat3f linear{m};
+  const Mat3f expectedLinear{Vec3f{m[0]}, Vec3f{m[1]}, Vec3f{m[2]}};
+  ASSERT_EQ_M3F(linear, expectedLinear);
+  const Mat3f expected = transpose(inverse(linear));
+  const Mat3f normal = normalMatrix(m);
+  const Mat3f fromAffine = normalMatrix(Affinef{m});
+  const Mat3f fromMat3 = normalMatrix(linear);
+  ASSERT_NEARLY_EQ_M3F(normal, expected);
+  ASSERT_EQ_M3F(fromAffine, normal);
+  ASSERT_EQ_M3F(fromMat3, normal);
+  // The cofactor form is the same matrix times the determinant.
+  const Mat3f cofactor = normalMatrix<float, NormalForm::Cofactor>(m);
+  const Mat3f expectedCofactor = expected * determinant(linear);
+  ASSERT_NEARLY_EQ_M3F(cofactor, expectedCofactor);
+  
+  Mat4f models[11];
+  Affinef affines[11];
+  for (unsigned int i = 0; i < 11; i++)
+  {
+    const float f = static_cast<float>(i);
+    models[i] = makeRotation4D(0.1f * f, 0.2f, -0.3f * f) * makeScale4D(Vec3f{1 + 0.1f * f, 1, 2 - 0.1f * f});
+    models[i].d[3][0] = f;
+    affines[i] = Affinef{models[i]};
+  }
+  Mat3f normals[11];
+  Mat3f affineNormals[11];
+  normalMatrixBatch(models, normals, 11);
+  normalMatrixBatch<float, NormalForm::Cofactor>(affines, affineNormals, 11);
+  for (unsigned int i = 0; i < 11; i++)
+  {
+    const Mat3f expectedNormal = normalMatrix(models[i]);
+    const Mat3f expectedCofactorNormal = normalMatrix<float, NormalForm::Cofactor>(models[i]);
+    ASSERT_NEARLY_EQ_M3F(normals[i], expectedNormal);
+    ASSERT_NEARLY_EQ_M3F(affineNormals[i], expectedCofactorNormal);
+  }
+  
+  const Mat4d md[3] = {Mat4d{2}, makeScale4D(Vec3d{2, 4, 8}), Mat4d{0.5}};
+  Mat3d nd[3];
+  normalMatrixBatch(md, nd, 3);
+  ASSERT_EQ_M3F(nd[0], Mat3d{0.5});
+  ASSERT_EQ_M3F(nd[1], makeScale3D(Vec3d{0.5, 0.25, 0.125}));
+  ASSERT_EQ_M3F(nd[2], Mat3d{2});
+  
+#if defined(NEON_PARALLEL)
+  ThreadPool pool(2);
+  std::vector<Mat4f> many(500);
+  std::vector<Mat3f> serial(500);
+  std::vector<Mat3f> parallel(500);
+  for (unsigned int i = 0; i < 500; i++)
+    many[i] = models[i % 11];
+  normalMatrixBatch(many.data(), serial.data(), 500);
+  normalMatrixBatch(pool, many.data(), parallel.data(), 500);
+  for (unsigned int i = 0; i < 500; i++)
+  {
+    ASSERT_NEARLY_EQ_M3F(parallel[i], serial[i]);
+  }
+#endif
+}
+
 UTEST_F(MatfTest, transpose)
 {
   {
@@ -1192,6 +3058,94 @@ UTEST_F(MatfTest, transpose)
   }
 }
 
+UTEST_F(MatfTest, nonSquare)
+{
+  const Mat4f m{1, 2,  3,  4,
+                5, 6,  7,  8,
+                9, 10, 11, 12,
+                0, 0,  0,  1};
+  const Mat3x4<float> top{1, 2,  3,  4,
+                          5, 6,  7,  8,
+                          9, 10, 11, 12};
+  {
+    const Vec4f p{1, -1, 2, 1};
+    const Vec3f result = top * p;
+    const Vec4f full = m * p;
+    const Vec3f expected{full};
+    ASSERT_EQ_V3F(result, expected);
+  }
+  {
+    // A 3x4 times a 4x4 matrix keeps the first three rows of the full product.
+    const Mat4f mm = m * m;
+    const Mat3x4<float> result = top * m;
+    for (unsigned int r = 0; r < 3; r++)
+    {
+      for (unsigned int c = 0; c < 4; c++)
+        ASSERT_EQ(result(r, c), mm(r, c));
+    }
+  }
+  {
+    const Mat2x3<float> a{1, 2, 3,
+                          4, 5, 6};
+    const Mat3x2<float> at = transpose(a);
+    ASSERT_EQ(at(2, 0), 3.0f);
+    ASSERT_EQ(at(0, 1), 4.0f);
+    const Mat2f aat = a * at;
+    const Mat2f expected{14, 32,
+                         32, 77};
+    ASSERT_EQ_M2F(aat, expected);
+    const Mat2x3<float> sum = (a + a) * 0.5f - a;
+    ASSERT_EQ(sum(1, 2), 0.0f);
+  }
+  {
+    const Vec<float, 5> v{1, 2, 3, 4, 5};
+    const Vec<float, 5> w = 2.0f * v - Vec<float, 5>(1);
+    ASSERT_EQ(w[4], 9.0f);
+    ASSERT_EQ(dot(v, w), 95.0f);
+    ASSERT_NEARLY_EQ_F(mag(normalize(w)), 1.0f);
+  }
+}
+
+UTEST_F(MatfTest, compileTime)
+{
+  static_assert(std::is_trivially_copyable<Vec3f>::value, "Vec3f should be trivially copyable");
+  static_assert(std::is_trivially_copyable<Vec4d>::value, "Vec4d should be trivially copyable");
+  static_assert(std::is_trivially_copyable<Mat3f>::value, "Mat3f should be trivially copyable");
+  static_assert(std::is_trivially_copyable<Mat4d>::value, "Mat4d should be trivially copyable");
+  static_assert(std::is_trivially_copyable<Affinef>::value, "Affinef should be trivially copyable");
+  static_assert(std::is_trivially_copyable<Quatf>::value, "Quatf should be trivially copyable");
+  
+  constexpr Vec3f x{1, 0, 0};
+  constexpr Vec3f y{0, 1, 0};
+  static_assert(cross(x, y).z == 1, "cross should fold");
+  static_assert(dot(Vec4f{1, 2, 3, 4}, Vec4f{1, 1, 1, 1}) == 10, "dot should fold");
+  
+  constexpr Mat4f inverseZ = makeInverseZ();
+  constexpr Mat4f translation = makeTranslation(Vec3f{1, 2, 3});
+  static_assert(inverseZ.d[2][2] == -1 && translation.d[3][1] == 2, "makers should fold");
+  static_assert(Mat4f(Mat3f(2)).d[1][1] == 2, "conversions should fold");
+  static_assert(Mat3f(translation).d[2][2] == 1, "conversions should fold");
+  static_assert(determinant(Mat2f{1, 2, 3, 4}) == -2, "determinant should fold");
+#if __cplusplus >= 201402L
+  static_assert(transpose(translation).d[1][3] == 2, "transpose should fold");
+#endif
+  // Expression nodes are only evaluated at run time.
+#if !defined(NEON_EXPR_TEMPLATES)
+  static_assert((translation * 2.0f).d[3][2] == 6, "scaling should fold");
+#if __cplusplus >= 201402L
+  constexpr Mat4f scale = makeScale4D(Vec3f{2, 4, 8});
+  static_assert(inverse(scale).d[2][2] == 0.125f, "inverse should fold");
+  static_assert(determinant(scale) == 64, "determinant should fold");
+  static_assert(normalMatrix(scale).d[1][1] == 0.25f, "normalMatrix should fold");
+#endif
+#endif
+  
+  const Mat4f m = translation * inverseZ;
+  const Vec4f p = m * Vec4f{1, 1, 1, 1};
+  const Vec4f expected{2, 3, 2, 1};
+  ASSERT_EQ_V4F(p, expected);
+}
+
 DEFINE_FIXTURE(MatrixTransformations)
 
 // TODO(Fouad): Test each function properly.
@@ -1265,4 +3219,180 @@ UTEST_F(MatrixTransformations, mvpInRhcToNdcInLhc)
   ASSERT_NEARLY_EQ_V4F(vpPoint, expectedVpPoint);
 }
 
+UTEST_F(MatrixTransformations, perspective)
+{
+  // 90 degrees, aspect 2, near 1 and far 10.
+  const float fovy = static_cast<float>(degToRad) * 90.0f;
+  const Mat4f zeroToOne = makePerspective<float, NdcDepth::ZeroToOne>(fovy, 2, 1, 10);
+  const Mat4f negativeOneToOne = makePerspective<float, NdcDepth::NegativeOneToOne>(fovy, 2, 1, 10);
+  const Mat4f expectedZeroToOne{0.5f, 0, 0,             0,
+                                0,    1, 0,             0,
+                                0,    0, -10.0f / 9.0f, -10.0f / 9.0f,
+                                0,    0, -1,            0};
+  const Mat4f expectedNegativeOneToOne{0.5f, 0, 0,             0,
+                                       0,    1, 0,             0,
+                                       0,    0, -11.0f / 9.0f, -20.0f / 9.0f,
+                                       0,    0, -1,            0};
+  ASSERT_NEARLY_EQ_M4F(zeroToOne, expectedZeroToOne);
+  ASSERT_NEARLY_EQ_M4F(negativeOneToOne, expectedNegativeOneToOne);
+  
+  // The near and far planes land on the ends of each depth range.
+  const Vec4f nearPoint{0, 0, -1, 1};
+  const Vec4f farPoint{0, 0, -10, 1};
+  const Vec4f nearZeroToOne = zeroToOne * nearPoint;
+  const Vec4f farZeroToOne = zeroToOne * farPoint;
+  const Vec4f nearNegativeOneToOne = negativeOneToOne * nearPoint;
+  const Vec4f farNegativeOneToOne = negativeOneToOne * farPoint;
+  ASSERT_NEARLY_EQ_F(nearZeroToOne.z / nearZeroToOne.w, 0.0f);
+  ASSERT_NEARLY_EQ_F(farZeroToOne.z / farZeroToOne.w, 1.0f);
+  ASSERT_NEARLY_EQ_F(nearNegativeOneToOne.z / nearNegativeOneToOne.w, -1.0f);
+  ASSERT_NEARLY_EQ_F(farNegativeOneToOne.z / farNegativeOneToOne.w, 1.0f);
+}
+
+UTEST_F(MatrixTransformations, frustumPlanes)
+{
+  const float fovy = static_cast<float>(degToRad) * 90.0f;
+  const float halfSqrt2 = std::sqrt(0.5f);
+  const Vec4f expected[] = {Vec4f{halfSqrt2, 0, -halfSqrt2, 0},
+                            Vec4f{-halfSqrt2, 0, -halfSqrt2, 0},
+                            Vec4f{0, halfSqrt2, -halfSqrt2, 0},
+                            Vec4f{0, -halfSqrt2, -halfSqrt2, 0},
+                            Vec4f{0, 0, -1, -1},
+                            Vec4f{0, 0, 1, 10}};
+  // Both depth conventions describe the same volume.
+  const Frustumf frustums[] = {Frustumf(makePerspective<float, NdcDepth::ZeroToOne>(fovy, 1, 1, 10), NdcDepth::ZeroToOne),
+                               Frustumf(makePerspective<float, NdcDepth::NegativeOneToOne>(fovy, 1, 1, 10), NdcDepth::NegativeOneToOne)};
+  for (const Frustumf& frustum : frustums)
+  {
+    for (unsigned int k = 0; k < Frustumf::SideCount; k++)
+    {
+      const Vec4f plane = frustum.planes[k];
+      const Vec4f expectedPlane = expected[k];
+      ASSERT_NEARLY_EQ_F(plane.x, expectedPlane.x);
+      ASSERT_NEARLY_EQ_F(plane.y, expectedPlane.y);
+      ASSERT_NEARLY_EQ_F(plane.z, expectedPlane.z);
+      ASSERT_LT(std::abs(plane.w - expectedPlane.w), 1e-4f);
+    }
+    ASSERT_TRUE(frustum.contains(Vec3f{0, 0, -5}));
+    ASSERT_TRUE(frustum.contains(Vec3f{4.9f, -4.9f, -5}));
+    ASSERT_FALSE(frustum.contains(Vec3f{0, 0, -0.5f}));
+    ASSERT_FALSE(frustum.contains(Vec3f{0, 0, -11}));
+    ASSERT_FALSE(frustum.contains(Vec3f{5.1f, 0, -5}));
+    ASSERT_TRUE(frustum.intersectsSphere(Vec3f{0, 0, -10.5f}, 1));
+    ASSERT_FALSE(frustum.intersectsSphere(Vec3f{0, 0, 2}, 1));
+    ASSERT_TRUE(frustum.intersectsAabb(Vec3f{5, 5, -6}, Vec3f{7, 7, -4}));
+    ASSERT_FALSE(frustum.intersectsAabb(Vec3f{6, -1, -5}, Vec3f{7, 1, -4}));
+  }
+  
+  const Frustumf ortho(makeOrthographic(1.0f, 10.0f, -2.0f, 2.0f, 2.0f, -2.0f));
+  ASSERT_TRUE(ortho.contains(Vec3f{1.9f, -1.9f, -9.9f}));
+  ASSERT_FALSE(ortho.contains(Vec3f{2.1f, 0, -5}));
+  ASSERT_FALSE(ortho.contains(Vec3f{0, 0, -0.9f}));
+}
+
+UTEST_F(MatrixTransformations, frustumCulling)
+{
+  const Mat4f view = makeLookAt(Vec3f{0, 0, 10}, Vec3f{0}, Vec3f{0, 1, 0});
+  const Mat4f projection = makePerspective(static_cast<float>(degToRad) * 90.0f, 1.0f, 1.0f, 100.0f);
+  const Frustumf frustum(projection * view);
+  
+  // A row of objects crossing the frustum at z = 0, ten units in front of the camera, plus a tail.
+  const std::size_t count = 43;
+  Vec3Stream<float> centers(count);
+  Vec3Stream<float> mins(count);
+  Vec3Stream<float> maxs(count);
+  float radii[count];
+  for (std::size_t i = 0; i < count; i++)
+  {
+    const Vec3f c{-52.7f + 2.5f * static_cast<float>(i), 0, 0};
+    centers.set(i, c);
+    mins.set(i, Vec3f{c.x - 1, c.y - 1, c.z - 1});
+    maxs.set(i, Vec3f{c.x + 1, c.y + 1, c.z + 1});
+    radii[i] = 1;
+  }
+  
+  std::uint32_t sphereBits[2] = {~0u, ~0u};
+  std::uint32_t boxBits[2] = {0, 0};
+  cullSpheres(frustum, centers, radii, sphereBits);
+  cullAabbs(frustum, mins, maxs, boxBits);
+  
+  std::size_t visibleSpheres = 0;
+  for (std::size_t i = 0; i < count; i++)
+  {
+    const bool sphere = ((sphereBits[i / 32] >> (i % 32)) & 1u) != 0;
+    const bool box = ((boxBits[i / 32] >> (i % 32)) & 1u) != 0;
+    ASSERT_EQ(sphere, frustum.intersectsSphere(centers[i], radii[i]));
+    ASSERT_EQ(box, frustum.intersectsAabb(mins[i], maxs[i]));
+    visibleSpheres += sphere ? 1 : 0;
+  }
+  // |x| <= 10 + sqrt(2) at z = 0.
+  ASSERT_EQ(visibleSpheres, 9u);
+  // Bits past count are untouched.
+  ASSERT_EQ(sphereBits[1] >> (count - 32), ~0u >> (count - 32));
+}
+
+UTEST_F(MatrixTransformations, fastTrig)
+{
+  const std::size_t count = 203;
+  float angles[count];
+  float sines[count];
+  float cosines[count];
+  double anglesD[count];
+  double sinesD[count];
+  double cosinesD[count];
+  for (std::size_t i = 0; i < count; i++)
+  {
+    anglesD[i] = -100.0 + static_cast<double>(i) * 0.987654321;
+    angles[i] = static_cast<float>(anglesD[i]);
+  }
+  sinCos<float, Precision::Fast>(angles, sines, cosines, count);
+  sinCos<double, Precision::Fast>(anglesD, sinesD, cosinesD, count);
+  for (std::size_t i = 0; i < count; i++)
+  {
+    ASSERT_LT(std::abs(sines[i] - std::sin(static_cast<double>(angles[i]))), 2e-7);
+    ASSERT_LT(std::abs(cosines[i] - std::cos(static_cast<double>(angles[i]))), 2e-7);
+    ASSERT_LT(std::abs(sinesD[i] - std::sin(anglesD[i])), 4e-16);
+    ASSERT_LT(std::abs(cosinesD[i] - std::cos(anglesD[i])), 4e-16);
+    float s = 0;
+    float c = 0;
+    sinCos<float, Precision::Fast>(angles[i], s, c);
+    ASSERT_LT(std::abs(s - sines[i]), 2e-7f);
+    ASSERT_LT(std::abs(c - cosines[i]), 2e-7f);
+  }
+  
+  // Non-finite angles give NaN on both the scalar and the pack path.
+  float special[3] = {std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+                      std::numeric_limits<float>::quiet_NaN()};
+  float specialSines[3];
+  float specialCosines[3];
+  sinCos<float, Precision::Fast>(special, specialSines, specialCosines, 3);
+  for (std::size_t i = 0; i < 3; i++)
+  {
+    float s = 0;
+    float c = 0;
+    sinCos<float, Precision::Fast>(special[i], s, c);
+    ASSERT_TRUE(std::isnan(s));
+    ASSERT_TRUE(std::isnan(c));
+    ASSERT_TRUE(std::isnan(specialSines[i]));
+    ASSERT_TRUE(std::isnan(specialCosines[i]));
+  }
+  
+  const float yaw = 0.3f;
+  const float pitch = -1.2f;
+  const float roll = 2.9f;
+  const Mat3f exact = makeRotation3D(yaw, pitch, roll);
+  const Mat3f fast = makeRotation3D<float, Precision::Fast>(yaw, pitch, roll);
+  const Mat4f exactPerspective = makePerspective(1.1f, 1.5f, 0.1f, 100.0f);
+  const Mat4f fastPerspective = makePerspective<float, NdcDepth::ZeroToOne, Precision::Fast>(1.1f, 1.5f, 0.1f, 100.0f);
+  for (unsigned int i = 0; i < 4; i++)
+  {
+    for (unsigned int j = 0; j < 4; j++)
+    {
+      if (i < 3 && j < 3)
+        ASSERT_NEARLY_EQ_F(fast(i, j), exact(i, j));
+      ASSERT_NEARLY_EQ_F(fastPerspective(i, j), exactPerspective(i, j));
+    }
+  }
+}
+
 UTEST_MAIN()